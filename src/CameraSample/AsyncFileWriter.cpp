@@ -27,12 +27,15 @@
 */
 
 #include "AsyncFileWriter.h"
-#include "MJPEGEncoder.h"
+#include "Metrics.h"
 
 #include <QTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QDir>
+#include <QElapsedTimer>
+
+#include <new>
 
 AsyncWriter::AsyncWriter(int size, QObject *parent):
     QObject(parent),
@@ -60,40 +63,58 @@ void AsyncWriter::start()
     });
 }
 
+void AsyncWriter::setBufferCount(int count, int preallocated)
+{
+    if(count <= 0)
+        return;
+    mBufferCount = count;
+    mPreallocated = preallocated;
+}
+
 void AsyncWriter::initBuffers(unsigned bufferSize)
 {
-    if(bufferSize <= mBufferSize)
+    if(mPool && mPool->count() == mBufferCount && bufferSize <= mPool->bufferSize())
         return;
 
-    if(mBuffers.empty())
-        mBuffers.resize(maxQueuSize);
-    FastAllocator alloc;
-    for(auto & buffer : mBuffers )
-        buffer.reset((unsigned char*)alloc.allocate(bufferSize));
-    mBufferSize = bufferSize;
+    //Tasks still holding buffers of the old pool keep it alive
+    mPool = std::make_shared<WriterBufferPool>(mBufferCount, bufferSize, mPreallocated);
 }
 
-unsigned char* AsyncWriter::getBuffer()
+FileWriterTask* AsyncWriter::createTask(int timeout)
 {
-    if(mBuffers.empty())
+    if(!mPool)
         return nullptr;
 
-    unsigned char* ret = mBuffers[mCurrentBuffer].get();
-
-    mCurrentBuffer = (mCurrentBuffer + 1) % maxQueuSize;
+    unsigned char* buf = nullptr;
+    {
+        Metrics::ScopedTimer timer(Metrics::mtWriterLeaseWait);
+        buf = mPool->acquire(timeout);
+    }
+    if(buf == nullptr)
+    {
+        mDropped++;
+        return nullptr;
+    }
 
-    return ret;
+    FileWriterTask* task = new FileWriterTask();
+    task->data = buf;
+    task->size = mPool->bufferSize();
+    task->pool = mPool;
+    return task;
 }
 
 void AsyncWriter::put(FileWriterTask* task)
 {
-    if(mTasks.count() > maxQueuSize)
+    if(task == nullptr)
+        return;
+
+    //Queue is bounded by the pool, pre-trigger ring included, so push never waits here.
+    //Push fails only if the writer is stopped, nobody will write the task then
+    if(!mTasks.push(task))
     {
-        delete task;
         mDropped++;
+        delete task;
     }
-    else
-        mTasks.push(task);
 }
 
 void AsyncWriter::setMaxSize(int sz)
@@ -107,59 +128,91 @@ void AsyncWriter::setMaxSize(int sz)
 void AsyncWriter::startWriting()
 {
     mWriting = true;
-    QMutex mut;
 
     mProcessed = 0;
     mDropped = 0;
 
-    while(!mCancel)
-    {
-        mut.lock();
-        mStart.wait(&mut);
-        mut.unlock();
+    //Take everything queued at once, so producers do not
+    //contend with the writer for the queue lock on every frame
+    std::vector<FileWriterTask*> batch;
+    batch.reserve(size_t(mBufferCount));
 
-        while(mTasks.count() > 0)
+    //drain returns 0 only when the queue is closed and empty
+    while(mTasks.drain(batch) > 0)
+    {
+        for(FileWriterTask* task : batch)
         {
-            FileWriterTask* task = mTasks.pop();
-            if(task)
-            {
-                processTask(task);
-                mProcessed++;
-                if(mMaxSize >= 0)
-                {
-                    if(mProcessed <= mMaxSize)
-                        emit progress((mProcessed * 100) / mMaxSize);
-                }
-                delete task;
-            }
+            writeTask(task);
+            mTasks.done();
         }
-        mFinish.wakeAll();
+        batch.clear();
     }
     mWriting = false;
 }
 
-void AsyncWriter::waitFinish()
+void AsyncWriter::writeTask(FileWriterTask* task)
 {
-    if(mTasks.isEmpty())
+    if(task == nullptr)
         return;
 
-    QMutex lock;
-    QMutexLocker l(&lock);
-    mFinish.wait(&lock, 3000);
+    {
+        Metrics::ScopedTimer timer(Metrics::mtWriterWrite);
+        processTask(task);
+    }
+    if(task->meta.hostTimestamp > 0)
+        Metrics::recordNs(Metrics::mtWriterLatency, FrameMetadata::now() - task->meta.hostTimestamp);
+    const int processed = ++mProcessed;
+    if(mMaxSize > 0)
+    {
+        if(processed <= mMaxSize)
+            emit progress((processed * 100) / mMaxSize);
+    }
+    delete task;
 }
 
+void AsyncWriter::setError(const QString& message)
+{
+    {
+        QMutexLocker lock(&mErrorLock);
+        if(mFailed)
+            return;
+        mErrorString = message;
+        mFailed = true;
+    }
+    qDebug("%s", qPrintable(message));
+    emit error(message);
+}
+
+void AsyncWriter::clearError()
+{
+    QMutexLocker lock(&mErrorLock);
+    mErrorString.clear();
+    mFailed = false;
+}
+
+QString AsyncWriter::errorString() const
+{
+    QMutexLocker lock(&mErrorLock);
+    return mErrorString;
+}
+
+bool AsyncWriter::flush(int timeout)
+{
+    return mTasks.waitDone(timeout);
+}
 
 void AsyncWriter::stop()
 {
-    mCancel = true;
-    wake();
+    mTasks.close();
 }
 
 void AsyncWriter::clear()
 {
-    QMutexLocker lock(&mLock);
-    while(mTasks.count() > 0)
-        delete mTasks.pop();
+    std::vector<FileWriterTask*> tasks;
+    const int count = mTasks.drain(tasks, 0);
+    for(FileWriterTask* task : tasks)
+        delete task;
+    mTasks.done(count);
 }
 
 AsyncFileWriter::AsyncFileWriter(int size, QObject *parent):
@@ -173,17 +226,166 @@ AsyncFileWriter::AsyncFileWriter(int size, QObject *parent):
     start();
 }
 
+AsyncFileWriter::~AsyncFileWriter()
+{
+    stop();
+    clear();
+}
+
+bool AsyncFileWriter::setVolumes(const QStringList& dirs, int threads)
+{
+    if(!mVolumes.empty())
+        return false;
+
+    //Directories are created once per session, not checked for every file
+    for(const QString& dir : dirs)
+    {
+        if(!QDir().mkpath(dir))
+            return false;
+    }
+
+    for(const QString& dir : dirs)
+    {
+        std::unique_ptr<Volume> volume(new Volume());
+        volume->path = QDir::cleanPath(dir);
+        mVolumes.push_back(std::move(volume));
+    }
+    if(mVolumes.empty())
+        return true;
+
+    const int count = qMax(threads, int(mVolumes.size()));
+    for(int i = 0; i < count; i++)
+    {
+        Volume* volume = mVolumes[size_t(i) % mVolumes.size()].get();
+        volume->threads.emplace_back([this, volume](){volumeLoop(volume);});
+    }
+
+    mSessionTimer.start();
+    return true;
+}
+
+void AsyncFileWriter::put(FileWriterTask* task)
+{
+    if(mVolumes.empty())
+    {
+        AsyncWriter::put(task);
+        return;
+    }
+    if(task == nullptr)
+        return;
+
+    Volume* volume = mVolumes[mNextVolume++ % mVolumes.size()].get();
+    task->fileName = volume->path + QLatin1Char('/') + task->fileName;
+    if(!volume->tasks.push(task))
+    {
+        mDropped++;
+        delete task;
+        return;
+    }
+
+    const int queued = volume->tasks.count();
+    int maxQueued = volume->maxQueued.load(std::memory_order_relaxed);
+    while(queued > maxQueued &&
+          !volume->maxQueued.compare_exchange_weak(maxQueued, queued, std::memory_order_relaxed))
+    {
+    }
+}
+
+void AsyncFileWriter::volumeLoop(Volume* volume)
+{
+    //Several threads can serve a volume, so take tasks one by one
+    FileWriterTask* task = nullptr;
+    while(volume->tasks.popWait(task))
+    {
+        const quint64 size = task ? task->size : 0;
+        writeTask(task);
+        volume->frames.fetch_add(1, std::memory_order_relaxed);
+        volume->bytes.fetch_add(size, std::memory_order_relaxed);
+        volume->tasks.done();
+    }
+}
+
+void AsyncFileWriter::stop()
+{
+    //Threads write what is already queued before they exit
+    for(auto& volume : mVolumes)
+        volume->tasks.close();
+    for(auto& volume : mVolumes)
+    {
+        for(auto& thread : volume->threads)
+            thread.join();
+        volume->threads.clear();
+    }
+    AsyncWriter::stop();
+}
+
+void AsyncFileWriter::clear()
+{
+    for(auto& volume : mVolumes)
+    {
+        std::vector<FileWriterTask*> tasks;
+        const int count = volume->tasks.drain(tasks, 0);
+        for(FileWriterTask* task : tasks)
+            delete task;
+        volume->tasks.done(count);
+    }
+    AsyncWriter::clear();
+}
+
+bool AsyncFileWriter::flush(int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for(auto& volume : mVolumes)
+    {
+        const int left = timeout < 0 ? -1 : qMax(0, timeout - int(timer.elapsed()));
+        if(!volume->tasks.waitDone(left))
+            return false;
+    }
+    return AsyncWriter::flush(timeout < 0 ? -1 : qMax(0, timeout - int(timer.elapsed())));
+}
+
+int AsyncFileWriter::queueSize()
+{
+    int ret = AsyncWriter::queueSize();
+    for(auto& volume : mVolumes)
+        ret += volume->tasks.count();
+    return ret;
+}
+
+QVector<AsyncFileWriter::VolumeStats> AsyncFileWriter::volumeStats() const
+{
+    QVector<VolumeStats> ret;
+    const double seconds = mSessionTimer.isValid() ? mSessionTimer.elapsed() / 1000. : 0;
+    for(auto& volume : mVolumes)
+    {
+        VolumeStats stats;
+        stats.path = volume->path;
+        stats.queued = volume->tasks.count();
+        stats.maxQueued = volume->maxQueued.load(std::memory_order_relaxed);
+        stats.frames = volume->frames.load(std::memory_order_relaxed);
+        if(seconds > 0)
+            stats.throughput = volume->bytes.load(std::memory_order_relaxed) / (1024. * 1024.) / seconds;
+        ret.push_back(stats);
+    }
+    return ret;
+}
+
 void AsyncFileWriter::processTask(FileWriterTask* task)
 {
     if(task == nullptr)
         return;
 
-    QString path = QFileInfo(task->fileName).path();
-    QDir dir(path);
-    if(!dir.exists())
+    //Without volumes nobody created the directory up front
+    if(mVolumes.empty())
     {
-        if(!dir.mkpath(path))
-            return;
+        QString path = QFileInfo(task->fileName).path();
+        QDir dir(path);
+        if(!dir.exists())
+        {
+            if(!dir.mkpath(path))
+                return;
+        }
     }
 
     QFile f(task->fileName);
@@ -206,25 +408,55 @@ AsyncMJPEGWriter::AsyncMJPEGWriter(int size, QObject *parent):
     start();
 }
 
-bool AsyncMJPEGWriter::open(int width, int height, int fps, fastJpegFormat_t fmt, const QString& outFileName)
+bool AsyncMJPEGWriter::open(int width, int height, double fps, const QString& outFileName)
 {
+    close();
+    mMuxerPtr.reset();
+
+    clearError();
     if(!QFileInfo::exists(QFileInfo(outFileName).path()))
+    {
+        setError(QStringLiteral("Cannot open %1, folder does not exist").arg(outFileName));
         return false;
+    }
 
-    if(mEncoderPtr)
-        mEncoderPtr->close();
-
-    mEncoderPtr.reset(new MJPEGEncoder(width, height, fps, fmt, outFileName));
-    return mEncoderPtr->isOpened();
+    mWidth = width;
+    mHeight = height;
+    mFps = fps;
+    mSegments.start(outFileName);
+    mSegmentCount = 1;
 
+    mMuxerPtr.reset(createMuxer(mSegments.currentFileName()));
+    return !mMuxerPtr.isNull();
 }
 
 void AsyncMJPEGWriter::close()
 {
-    if(!mEncoderPtr)
+    if(mNextMuxerPtr)
+    {
+        //Opened ahead and never used
+        mNextMuxerPtr->close();
+        mNextMuxerPtr.reset();
+        QFile::remove(mSegments.nextFileName());
+    }
+
+    if(!mMuxerPtr)
         return;
 
-    mEncoderPtr->close();
+    mMuxerPtr->close();
+}
+
+AviMuxer* AsyncMJPEGWriter::createMuxer(const QString& fileName)
+{
+    AviMuxer* muxer = new AviMuxer();
+    if(muxer->open(fileName, mWidth, mHeight, mFps))
+        return muxer;
+
+    //Frames stay in the current segment, or are dropped without one
+    setError(QStringLiteral("Cannot open segment %1").arg(fileName));
+    delete muxer;
+    QFile::remove(fileName);
+    return nullptr;
 }
 
 void AsyncMJPEGWriter::processTask(FileWriterTask* task)
@@ -232,8 +464,248 @@ void AsyncMJPEGWriter::processTask(FileWriterTask* task)
     if(task == nullptr)
         return;
 
-    if(!mEncoderPtr)
+    if(!mMuxerPtr || !mMuxerPtr->isOpened())
+    {
+        mDropped++;
+        return;
+    }
+
+    //Frame chunk header and index entries on top of JPEG data
+    const qint64 size = qint64(task->size) + 32;
+    //A file with full AVI index is finished like a full segment
+    if(mSegments.isFull(size, task->meta.hostTimestamp) ||
+       (mSegments.isEnabled() && mMuxerPtr->isFull(task->size)))
+    {
+        if(!mNextMuxerPtr)
+            mNextMuxerPtr.reset(createMuxer(mSegments.nextFileName()));
+
+        //Without the next file frames stay in the current one
+        if(mNextMuxerPtr)
+        {
+            mMuxerPtr.swap(mNextMuxerPtr);
+            mNextMuxerPtr->close();
+            mNextMuxerPtr.reset();
+            mSegments.next();
+            mSegmentCount++;
+        }
+    }
+
+    if(!mMuxerPtr->addFrame(task->data, task->size, &task->meta))
+    {
+        mDropped++;
+        //Muxer stays open only when it refuses frames it cannot index
+        if(mMuxerPtr->isOpened())
+            setError(QStringLiteral("AVI index is full, %1").arg(mSegments.currentFileName()));
+        else
+            setError(QStringLiteral("Cannot write %1").arg(mSegments.currentFileName()));
         return;
+    }
+    mSegments.add(size, task->meta.hostTimestamp);
 
-    mEncoderPtr->addJPEGFrame(task->data, int(task->size));
+    if(mSegments.isEnabled() && mSegments.frames() == 1 && !mNextMuxerPtr)
+        mNextMuxerPtr.reset(createMuxer(mSegments.nextFileName()));
+}
+
+AsyncRawWriter::AsyncRawWriter(int size, QObject *parent):
+    AsyncWriter(size, parent)
+{
+    mMaxSize = size;
+    mWorkThread.setObjectName(QStringLiteral("Raw Writer Thread"));
+    moveToThread(&mWorkThread);
+
+    mWorkThread.start();
+    start();
+}
+
+bool AsyncRawWriter::open(const QString& outFileName, const RawContainer::FileHeader& header, int queueDepth)
+{
+    close();
+    {
+        QMutexLocker lock(&mContainerLock);
+        mContainerPtr.reset();
+    }
+
+    clearError();
+    if(!QFileInfo::exists(QFileInfo(outFileName).path()))
+    {
+        setError(QStringLiteral("Cannot open %1, folder does not exist").arg(outFileName));
+        return false;
+    }
+
+    mHeader = header;
+    mQueueDepth = queueDepth;
+    mSegments.start(outFileName);
+    mSegmentCount = 1;
+
+    RawContainerWriter* container = createContainer(mSegments.currentFileName());
+    QMutexLocker lock(&mContainerLock);
+    mContainerPtr.reset(container);
+    return container != nullptr;
+}
+
+void AsyncRawWriter::close()
+{
+    if(mNextContainerPtr)
+    {
+        //Opened ahead and never used
+        mNextContainerPtr->close();
+        mNextContainerPtr.reset();
+        QFile::remove(mSegments.nextFileName());
+    }
+
+    if(mContainerPtr)
+        mContainerPtr->close();
+}
+
+DirectFileWriter::Backend AsyncRawWriter::backend() const
+{
+    QMutexLocker lock(&mContainerLock);
+    return mContainerPtr ? mContainerPtr->backend() : DirectFileWriter::wbBuffered;
+}
+
+double AsyncRawWriter::throughput() const
+{
+    QMutexLocker lock(&mContainerLock);
+    return mContainerPtr ? mContainerPtr->throughput() : 0;
+}
+
+RawContainerWriter* AsyncRawWriter::createContainer(const QString& fileName)
+{
+    RawContainerWriter* container = new RawContainerWriter();
+    if(container->open(fileName, mHeader, mQueueDepth))
+        return container;
+
+    setError(QStringLiteral("Cannot open segment %1").arg(fileName));
+    delete container;
+    QFile::remove(fileName);
+    return nullptr;
+}
+
+void AsyncRawWriter::processTask(FileWriterTask* task)
+{
+    if(task == nullptr)
+        return;
+
+    if(!mContainerPtr || !mContainerPtr->isOpened())
+    {
+        mDropped++;
+        return;
+    }
+
+    const qint64 size = qint64(RawContainer::chunkSize(task->size));
+    if(mSegments.isFull(size, task->meta.hostTimestamp))
+    {
+        if(!mNextContainerPtr)
+            mNextContainerPtr.reset(createContainer(mSegments.nextFileName()));
+
+        //Without the next file frames stay in the current one
+        if(mNextContainerPtr)
+        {
+            {
+                QMutexLocker lock(&mContainerLock);
+                mContainerPtr.swap(mNextContainerPtr);
+            }
+            //Writes index and footer of the finished segment
+            mNextContainerPtr->close();
+            mNextContainerPtr.reset();
+            mSegments.next();
+            mSegmentCount++;
+        }
+    }
+
+    if(!mContainerPtr->addFrame(task->data, task->size, task->meta))
+    {
+        //Write errors are sticky, later frames fail too
+        mDropped++;
+        setError(QStringLiteral("Cannot write %1").arg(mSegments.currentFileName()));
+        return;
+    }
+    mSegments.add(size, task->meta.hostTimestamp);
+
+    if(mSegments.isEnabled() && mSegments.frames() == 1 && !mNextContainerPtr)
+        mNextContainerPtr.reset(createContainer(mSegments.nextFileName()));
+}
+
+WriterBufferPool::WriterBufferPool(int count, unsigned bufferSize, int preallocated) :
+    mCount(qMax(count, 1)),
+    mBufferSize(bufferSize)
+{
+    if(preallocated < 0 || preallocated > mCount)
+        preallocated = mCount;
+
+    FastAllocator alloc;
+    mBuffers.reserve(size_t(mCount));
+    mFree.reserve(size_t(mCount));
+    for(int i = 0; i < qMax(preallocated, 1); i++)
+    {
+        mBuffers.emplace_back(static_cast<unsigned char*>(alloc.allocate(bufferSize)));
+        mFree.push_back(mBuffers.back().get());
+    }
+}
+
+unsigned char* WriterBufferPool::allocate()
+{
+    FastAllocator alloc;
+    try
+    {
+        return static_cast<unsigned char*>(alloc.allocate(mBufferSize));
+    }
+    catch(std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+unsigned char* WriterBufferPool::acquire(int timeout)
+{
+    QMutexLocker lock(&mLock);
+
+    //Pool grows once per buffer, releases wait only for that
+    if(mFree.empty() && int(mBuffers.size()) < mCount)
+    {
+        unsigned char* buffer = allocate();
+        if(buffer != nullptr)
+        {
+            mBuffers.emplace_back(buffer);
+            return buffer;
+        }
+    }
+
+    if(mFree.empty() && timeout > 0)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        qint64 left = timeout;
+        while(mFree.empty() && left > 0)
+        {
+            mReleased.wait(&mLock, static_cast<unsigned long>(left));
+            left = timeout - timer.elapsed();
+        }
+    }
+
+    if(mFree.empty())
+    {
+        mExhausted.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    unsigned char* ret = mFree.back();
+    mFree.pop_back();
+    return ret;
+}
+
+void WriterBufferPool::release(unsigned char* buffer)
+{
+    if(buffer == nullptr)
+        return;
+
+    QMutexLocker lock(&mLock);
+    mFree.push_back(buffer);
+    mReleased.wakeOne();
+}
+
+int WriterBufferPool::leased() const
+{
+    QMutexLocker lock(&mLock);
+    return int(mBuffers.size() - mFree.size());
 }
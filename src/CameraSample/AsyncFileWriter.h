@@ -33,18 +33,73 @@
 #include <QWaitCondition>
 #include <QMutex>
 #include <QThread>
+#include <QStringList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QScopedPointer>
 
 #include "AsyncQueue.h"
 #include "FastAllocator.h"
-#include "MJPEGEncoder.h"
+#include "AviMuxer.h"
+#include "RawContainer.h"
+#include "SegmentRotation.h"
+#include "FrameMetadata.h"
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <thread>
 
+/// Fixed set of equal size buffers for writer tasks.
+/// A buffer is leased to one task and returns to the pool when the task is deleted,
+/// so a buffer still queued for writing is never handed out again.
+/// Buffers over the preallocated ones are allocated on first use and then kept.
+class WriterBufferPool
+{
+public:
+    /// Negative preallocated allocates all count buffers at once
+    WriterBufferPool(int count, unsigned bufferSize, int preallocated = -1);
+
+    /// Waits up to timeout ms for a free buffer, returns nullptr if all are still leased
+    unsigned char* acquire(int timeout = 0);
+    void release(unsigned char* buffer);
+
+    int      count() const {return mCount;}
+    int      leased() const;
+    unsigned bufferSize() const {return mBufferSize;}
+    /// Number of acquire calls which got no buffer
+    quint64  exhausted() const {return mExhausted.load(std::memory_order_relaxed);}
+
+private:
+    /// nullptr if there is no memory
+    unsigned char* allocate();
+
+    int      mCount = 0;
+    unsigned mBufferSize = 0;
+    std::vector<std::unique_ptr<unsigned char, FastAllocator>> mBuffers;
+    std::vector<unsigned char*> mFree;
+
+    mutable QMutex mLock;
+    QWaitCondition mReleased;
+    std::atomic<quint64> mExhausted {0};
+};
 
 struct FileWriterTask
 {
-    unsigned char* data;
+    FileWriterTask() = default;
+    FileWriterTask(const FileWriterTask&) = delete;
+    FileWriterTask& operator=(const FileWriterTask&) = delete;
+    ~FileWriterTask()
+    {
+        if(pool && data)
+            pool->release(data);
+    }
+
+    unsigned char* data = nullptr;
     unsigned int size{};
     QString fileName;
+    FrameMetadata meta;
+    /// Pool data is leased from, buffer is returned on delete
+    std::shared_ptr<WriterBufferPool> pool;
 };
 
 class AsyncWriter : public QObject
@@ -54,22 +109,37 @@ public:
     explicit AsyncWriter(int size = -1, QObject *parent = nullptr);
     ~AsyncWriter();
 
+    /// Number of buffers for tasks in flight, applied by the next initBuffers.
+    /// Only preallocated of them are allocated at once, negative means all.
+    void setBufferCount(int count, int preallocated = -1);
     void initBuffers(unsigned bufferSize);
-    unsigned char* getBuffer();
+    /// Task with a leased buffer of bufferSize() bytes. Waits up to timeout ms
+    /// while all buffers are in use, then returns nullptr and counts the frame as dropped,
+    /// so the producer can skip encoding.
+    FileWriterTask* createTask(int timeout = 0);
     void start();
-    void stop();
-    void put(FileWriterTask* task);
-    void clear();
-    void wake(){mStart.wakeAll();}
-    void waitFinish();
+    /// Writes tasks already queued and ends the writer thread, later puts are rejected
+    virtual void stop();
+    virtual void put(FileWriterTask* task);
+    virtual void clear();
+    /// Blocks until every task put before the call is processed.
+    /// Returns false on timeout, timeout < 0 waits forever.
+    virtual bool flush(int timeout = -1);
     void setMaxSize(int sz);
-    int  queueSize(){return mTasks.count();}
+    virtual int queueSize(){return mTasks.count();}
     int  getProcessedFrames(){return mProcessed;}
     int  getDroppedFrames(){return mDropped;}
-    unsigned bufferSize() {return mBufferSize;}
+    unsigned bufferSize() {return mPool ? mPool->bufferSize() : 0;}
+    int  bufferCount() {return mPool ? mPool->count() : 0;}
+    int  buffersLeased() {return mPool ? mPool->leased() : 0;}
+    /// True after the writer lost frames it cannot store, e.g. a file it cannot open or index
+    bool failed() const {return mFailed;}
+    /// Description of the first failure
+    QString errorString() const;
 
 signals:
     void progress(int percent);
+    void error(const QString& message);
 
 public slots:
 
@@ -77,51 +147,145 @@ protected:
     virtual void processTask(FileWriterTask* task) = 0;
 
     void startWriting();
+    /// Processes the task, updates counters and deletes it
+    void writeTask(FileWriterTask* task);
+    /// Keeps the first message and emits error
+    void setError(const QString& message);
+    void clearError();
 
-    bool mCancel {false};
-    bool mWriting {false};
+    std::atomic<bool> mWriting {false};
 
-    unsigned mBufferSize {0};
-    unsigned mCurrentBuffer{0};
-    std::vector<std::unique_ptr<unsigned char, FastAllocator>> mBuffers;
+    int mBufferCount = 32;
+    int mPreallocated = -1;
+    std::shared_ptr<WriterBufferPool> mPool;
 
-    QMutex mLock;
-    QWaitCondition mStart;
-    QWaitCondition mFinish;
     QThread mWorkThread;
     AsyncQueue<FileWriterTask*> mTasks;
 
     int mMaxSize = -1;
-    int mProcessed = 0;
-    int mDropped = 0;
+    std::atomic<int> mProcessed {0};
+    std::atomic<int> mDropped {0};
 
-    const uint maxQueuSize = 32;
+    std::atomic<bool> mFailed {false};
+    QString mErrorString;
+    mutable QMutex mErrorLock;
 };
 
 
+/// Writes every task to its own file.
+/// Frames can be striped round robin over several volumes,
+/// each volume has its own queue and writer threads.
 class AsyncFileWriter : public AsyncWriter
 {
     Q_OBJECT
 public:
+    struct VolumeStats
+    {
+        QString path;
+        int     queued = 0;
+        int     maxQueued = 0;
+        quint64 frames = 0;
+        /// Average write throughput since setVolumes, MB/s
+        double  throughput = 0;
+    };
+
     explicit AsyncFileWriter(int size = -1, QObject *parent = nullptr);
+    ~AsyncFileWriter();
+
+    /// Creates output directories and starts writer threads, threads are
+    /// spread over volumes with at least one per volume. Must be called before
+    /// the first put, task file names are then relative to the volume.
+    /// Without volumes tasks are written to their file names by the single writer thread.
+    bool setVolumes(const QStringList& dirs, int threads = 0);
+
+    void stop() override;
+    void put(FileWriterTask* task) override;
+    void clear() override;
+    bool flush(int timeout = -1) override;
+    int  queueSize() override;
+
+    QVector<VolumeStats> volumeStats() const;
 
 protected:
     virtual void processTask(FileWriterTask* task);
+
+private:
+    struct Volume
+    {
+        QString path;
+        AsyncQueue<FileWriterTask*> tasks;
+        std::vector<std::thread> threads;
+        std::atomic<int> maxQueued {0};
+        std::atomic<quint64> frames {0};
+        std::atomic<quint64> bytes {0};
+    };
+
+    void volumeLoop(Volume* volume);
+
+    std::vector<std::unique_ptr<Volume>> mVolumes;
+    std::atomic<unsigned> mNextVolume {0};
+    QElapsedTimer mSessionTimer;
 };
 
 
+/// Writes JPEG frames to AVI files, split into segments when limits are set.
+/// The next segment is opened on the writer thread ahead of time,
+/// so a rollover only swaps muxers and the old file gets its index on close.
 class AsyncMJPEGWriter : public AsyncWriter
 {
     Q_OBJECT
 public:
     explicit AsyncMJPEGWriter(int size = -1, QObject *parent = nullptr);
-    bool open(int width, int height, int fps, fastJpegFormat_t fmt, const QString& outFileName);
+    /// Applied by the next open
+    void setSegmentLimits(const SegmentRotation::Limits& limits){mSegments.setLimits(limits);}
+    bool open(int width, int height, double fps, const QString& outFileName);
     void close();
+    int  segmentCount() const {return mSegmentCount;}
 
 protected:
     virtual void processTask(FileWriterTask* task);
 
 private:
-    QScopedPointer<MJPEGEncoder> mEncoderPtr;
+    AviMuxer* createMuxer(const QString& fileName);
+
+    QScopedPointer<AviMuxer> mMuxerPtr;
+    QScopedPointer<AviMuxer> mNextMuxerPtr;
+    SegmentRotation mSegments;
+    std::atomic<int> mSegmentCount {0};
+    int mWidth = 0;
+    int mHeight = 0;
+    double mFps = 0;
+};
+
+
+/// Appends raw frames to RawContainer files, split into segments like AsyncMJPEGWriter
+class AsyncRawWriter : public AsyncWriter
+{
+    Q_OBJECT
+public:
+    explicit AsyncRawWriter(int size = -1, QObject *parent = nullptr);
+    /// Applied by the next open
+    void setSegmentLimits(const SegmentRotation::Limits& limits){mSegments.setLimits(limits);}
+    /// queueDepth > 0 writes with O_DIRECT and io_uring where available
+    bool open(const QString& outFileName, const RawContainer::FileHeader& header, int queueDepth = 0);
+    void close();
+    int  segmentCount() const {return mSegmentCount;}
+    DirectFileWriter::Backend backend() const;
+    double throughput() const;
+
+protected:
+    virtual void processTask(FileWriterTask* task);
+
+private:
+    RawContainerWriter* createContainer(const QString& fileName);
+
+    QScopedPointer<RawContainerWriter> mContainerPtr;
+    QScopedPointer<RawContainerWriter> mNextContainerPtr;
+    SegmentRotation mSegments;
+    std::atomic<int> mSegmentCount {0};
+    RawContainer::FileHeader mHeader {};
+    int mQueueDepth = 0;
+    /// Guards container swap against stats readers
+    mutable QMutex mContainerLock;
 };
 #endif // ASYNCJPEGWRITER_H
@@ -29,72 +29,191 @@
 #ifndef ASYNCQUEUE_H
 #define ASYNCQUEUE_H
 
-#include <QThread>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
 #include <QQueue>
 
+#include <vector>
 
+/// Bounded blocking queue for many producers and one consumer.
+/// Consumer marks popped items done, so producers can wait until
+/// everything pushed so far is processed.
 template<class T> class AsyncQueue
 {
 public:
-
-        AsyncQueue(uint _max = -1) : mMax(_max)
+        /// capacity 0 means unbounded
+        explicit AsyncQueue(int capacity = 0) : mCapacity(capacity)
         {
         }
 
         ~AsyncQueue()
         {
-            clear();
+            close();
+        }
+
+        void setCapacity(int capacity)
+        {
+            QMutexLocker lock(&mMutex);
+            mCapacity = capacity;
+            mNotFull.wakeAll();
         }
 
-        uint count()
+        int count()
         {
             QMutexLocker lock(&mMutex);
-            int count = mQueue.count();
-            return count;
+            return mQueue.count();
         }
 
         bool isFull()
         {
-            if(-1 == mMax)
+            QMutexLocker lock(&mMutex);
+            return full();
+        }
+
+        bool isEmpty()
+        {
+            QMutexLocker lock(&mMutex);
+            return mQueue.isEmpty();
+        }
+
+        /// Waits while the queue is full, returns false if the queue is closed
+        bool push(const T& t)
+        {
+            QMutexLocker lock(&mMutex);
+            while(full() && !mClosed)
+                mNotFull.wait(&mMutex);
+            return enqueue(t);
+        }
+
+        /// Returns false at once if the queue is full or closed
+        bool tryPush(const T& t)
+        {
+            QMutexLocker lock(&mMutex);
+            if(full())
+                return false;
+            return enqueue(t);
+        }
+
+        /// Waits up to timeout ms (forever if negative) for an item.
+        /// Returns false on timeout or when the queue is closed and empty.
+        bool popWait(T& t, int timeout = -1)
+        {
+            QMutexLocker lock(&mMutex);
+            if(!waitNotEmpty(timeout))
                 return false;
+            t = mQueue.dequeue();
+            mNotFull.wakeAll();
+            return true;
+        }
 
+        /// Moves all queued items to out, waiting for the first one like popWait.
+        /// Returns number of items taken.
+        int drain(std::vector<T>& out, int timeout = -1)
+        {
             QMutexLocker lock(&mMutex);
-            int count = mQueue.count();
-            return count >= mMax;
+            if(!waitNotEmpty(timeout))
+                return 0;
+            const int ret = mQueue.count();
+            while(!mQueue.isEmpty())
+                out.push_back(mQueue.dequeue());
+            mNotFull.wakeAll();
+            return ret;
         }
 
-        bool isEmpty()
+        /// Called by consumer when popped items are processed
+        void done(int items = 1)
         {
             QMutexLocker lock(&mMutex);
-            bool empty = mQueue.isEmpty();
-            return empty;
+            mDone += quint64(items);
+            mDoneCond.wakeAll();
         }
 
-        void clear()
+        /// Waits until every item pushed before the call is marked done.
+        /// Returns false on timeout.
+        bool waitDone(int timeout = -1)
         {
             QMutexLocker lock(&mMutex);
-            mQueue.clear();
+            const quint64 target = mPushed;
+            QElapsedTimer timer;
+            timer.start();
+            while(mDone < target)
+            {
+                if(timeout < 0)
+                {
+                    mDoneCond.wait(&mMutex);
+                    continue;
+                }
+                const qint64 left = timeout - timer.elapsed();
+                if(left <= 0)
+                    return false;
+                mDoneCond.wait(&mMutex, static_cast<unsigned long>(left));
+            }
+            return true;
         }
 
-        void push(const T& t)
+        /// Wakes all waiters. Push fails from now on,
+        /// consumer still gets items queued before.
+        void close()
         {
             QMutexLocker lock(&mMutex);
-            mQueue.enqueue(t);
+            mClosed = true;
+            mNotEmpty.wakeAll();
+            mNotFull.wakeAll();
         }
 
-        T pop()
+        bool isClosed()
         {
             QMutexLocker lock(&mMutex);
-            T i = mQueue.dequeue();
-            return i;
+            return mClosed;
         }
 
     private:
+        bool full() const
+        {
+            return mCapacity > 0 && mQueue.count() >= mCapacity;
+        }
+
+        bool enqueue(const T& t)
+        {
+            if(mClosed)
+                return false;
+            mQueue.enqueue(t);
+            mPushed++;
+            mNotEmpty.wakeOne();
+            return true;
+        }
+
+        bool waitNotEmpty(int timeout)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            while(mQueue.isEmpty())
+            {
+                if(mClosed)
+                    return false;
+                if(timeout < 0)
+                {
+                    mNotEmpty.wait(&mMutex);
+                    continue;
+                }
+                const qint64 left = timeout - timer.elapsed();
+                if(left <= 0)
+                    return false;
+                mNotEmpty.wait(&mMutex, static_cast<unsigned long>(left));
+            }
+            return true;
+        }
 
         QQueue<T> mQueue;
         QMutex mMutex;
-        int mMax;
+        QWaitCondition mNotEmpty;
+        QWaitCondition mNotFull;
+        QWaitCondition mDoneCond;
+        int mCapacity = 0;
+        bool mClosed = false;
+        quint64 mPushed = 0;
+        quint64 mDone = 0;
 };
 
 #endif // ASYNCQUEUE_H
@@ -0,0 +1,477 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "AviMuxer.h"
+#include "Metrics.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    /// RIFF size limit, first one stays readable by players without OpenDML support
+    const quint64 RiffLimit = 1024ull * 1024 * 1024;
+    /// Super index entries reserved in header, one per RIFF
+    const int SuperIndexSize = 256;
+    const size_t WriteBufferSize = 1024 * 1024;
+    /// Longer gaps in capture time are not filled, timing continues after the last frame
+    const int MaxGapSeconds = 10;
+
+    const quint32 AVIF_HASINDEX = 0x10;
+    const quint32 AVIIF_KEYFRAME = 0x10;
+    const char AVI_INDEX_OF_INDEXES = 0;
+    const char AVI_INDEX_OF_CHUNKS = 1;
+
+    void putFourCC(QByteArray& ba, const char* fcc)
+    {
+        ba.append(fcc, 4);
+    }
+
+    void putU16(QByteArray& ba, quint16 value)
+    {
+        ba.append(char(value & 0xFF));
+        ba.append(char(value >> 8));
+    }
+
+    void putU32(QByteArray& ba, quint32 value)
+    {
+        putU16(ba, quint16(value & 0xFFFF));
+        putU16(ba, quint16(value >> 16));
+    }
+
+    void putU64(QByteArray& ba, quint64 value)
+    {
+        putU32(ba, quint32(value & 0xFFFFFFFF));
+        putU32(ba, quint32(value >> 32));
+    }
+
+    void setU32(char* dst, quint32 value)
+    {
+        for(int i = 0; i < 4; i++)
+            dst[i] = char((value >> (8 * i)) & 0xFF);
+    }
+
+    /// Writes list header, returns its position for endList
+    int beginList(QByteArray& ba, const char* type)
+    {
+        const int pos = ba.size();
+        putFourCC(ba, "LIST");
+        putU32(ba, 0);
+        putFourCC(ba, type);
+        return pos;
+    }
+
+    void endList(QByteArray& ba, int pos)
+    {
+        setU32(ba.data() + pos + 4, quint32(ba.size() - pos - 8));
+    }
+}
+
+AviMuxer::~AviMuxer()
+{
+    close();
+}
+
+bool AviMuxer::open(const QString& fileName, int width, int height, double fps)
+{
+    close();
+
+    mFile.setFileName(fileName);
+    if(!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+        return false;
+
+    mFailed = false;
+    mPos = 0;
+    mBuffer.resize(WriteBufferSize);
+    mBuffered = 0;
+
+    mWidth = width;
+    mHeight = height;
+    //Fractional frame rates are kept with millisecond precision
+    mScale = 1000;
+    mRate = quint32(qMax(qRound(fps * mScale), 1));
+
+    mFirstRiffSize = 0;
+    mFirstMoviSize = 0;
+    mSuperIndex.clear();
+    mSuperIndex.reserve(SuperIndexSize);
+    mIndex.clear();
+    mIndex.reserve(size_t(qMin(RiffLimit / 4096, quint64(mRate) / mScale * 60 + 1)));
+
+    mTotalFrames = 0;
+    mFirstRiffFrames = 0;
+    mEmptyFrames = 0;
+    mMaxChunk = 0;
+    mDataBytes = 0;
+    mFirstTimestamp = 0;
+    mNextSlot = 0;
+
+    //Placeholder with the final layout, filled in on close
+    const QByteArray hdr = header();
+    mRiffPos = 0;
+    mMoviPos = quint64(hdr.size()) - 12;
+    return append(hdr.constData(), quint64(hdr.size()));
+}
+
+bool AviMuxer::addFrame(const unsigned char* data, unsigned size, const FrameMetadata* meta)
+{
+    if(!isOpened())
+        return false;
+
+    qint64 slot = mNextSlot;
+    if(meta != nullptr && meta->hostTimestamp > 0)
+    {
+        if(mFirstTimestamp == 0)
+            mFirstTimestamp = meta->hostTimestamp;
+
+        const double slotNs = 1000000000. * mScale / mRate;
+        slot = std::llround(double(meta->hostTimestamp - mFirstTimestamp) / slotNs);
+        if(slot - mNextSlot > qint64(MaxGapSeconds) * mRate / mScale)
+        {
+            slot = mNextSlot;
+            mFirstTimestamp = meta->hostTimestamp - qint64(double(slot) * slotNs);
+        }
+    }
+
+    //Playback keeps real timing when frames were dropped
+    while(mNextSlot < slot)
+    {
+        if(!writeChunk(nullptr, 0))
+            return false;
+        mEmptyFrames++;
+    }
+
+    return writeChunk(data, size);
+}
+
+void AviMuxer::close()
+{
+    if(!mFile.isOpen())
+        return;
+
+    if(!mFailed && finishRiff() && flushBuffer())
+    {
+        const QByteArray hdr = header();
+        if(!mFile.seek(0) || mFile.write(hdr) != hdr.size())
+            mFailed = true;
+    }
+
+    mFile.close();
+    mBuffer.clear();
+    mBuffer.shrink_to_fit();
+}
+
+QByteArray AviMuxer::header() const
+{
+    const quint32 frameTime = quint32(1000000ull * mScale / mRate);
+    const double duration = double(mTotalFrames) * mScale / mRate;
+    const quint32 bytesPerSec = duration > 0 ? quint32(double(mDataBytes) / duration) : 0;
+
+    QByteArray ba;
+    putFourCC(ba, "RIFF");
+    putU32(ba, mFirstRiffSize);
+    putFourCC(ba, "AVI ");
+
+    const int hdrl = beginList(ba, "hdrl");
+
+    putFourCC(ba, "avih");
+    putU32(ba, 56);
+    putU32(ba, frameTime);
+    putU32(ba, bytesPerSec);
+    putU32(ba, 0);                      //padding granularity
+    putU32(ba, AVIF_HASINDEX);
+    putU32(ba, quint32(mFirstRiffFrames));
+    putU32(ba, 0);                      //initial frames
+    putU32(ba, 1);                      //streams
+    putU32(ba, mMaxChunk);
+    putU32(ba, quint32(mWidth));
+    putU32(ba, quint32(mHeight));
+    for(int i = 0; i < 4; i++)
+        putU32(ba, 0);
+
+    const int strl = beginList(ba, "strl");
+
+    putFourCC(ba, "strh");
+    putU32(ba, 56);
+    putFourCC(ba, "vids");
+    putFourCC(ba, "MJPG");
+    putU32(ba, 0);                      //flags
+    putU16(ba, 0);                      //priority
+    putU16(ba, 0);                      //language
+    putU32(ba, 0);                      //initial frames
+    putU32(ba, mScale);
+    putU32(ba, mRate);
+    putU32(ba, 0);                      //start
+    putU32(ba, quint32(mTotalFrames));
+    putU32(ba, mMaxChunk);
+    putU32(ba, 0xFFFFFFFF);             //quality
+    putU32(ba, 0);                      //sample size
+    putU16(ba, 0);
+    putU16(ba, 0);
+    putU16(ba, quint16(mWidth));
+    putU16(ba, quint16(mHeight));
+
+    putFourCC(ba, "strf");
+    putU32(ba, 40);
+    putU32(ba, 40);
+    putU32(ba, quint32(mWidth));
+    putU32(ba, quint32(mHeight));
+    putU16(ba, 1);                      //planes
+    putU16(ba, 24);                     //bit count
+    putFourCC(ba, "MJPG");
+    putU32(ba, quint32(mWidth * mHeight * 3));
+    for(int i = 0; i < 4; i++)
+        putU32(ba, 0);
+
+    //OpenDML super index, entries are reserved for all RIFFs
+    putFourCC(ba, "indx");
+    putU32(ba, 24 + SuperIndexSize * 16);
+    putU16(ba, 4);                      //longs per entry
+    ba.append(char(0));                 //index sub type
+    ba.append(AVI_INDEX_OF_INDEXES);
+    putU32(ba, quint32(mSuperIndex.size()));
+    putFourCC(ba, "00dc");
+    for(int i = 0; i < 3; i++)
+        putU32(ba, 0);
+    for(int i = 0; i < SuperIndexSize; i++)
+    {
+        const bool used = size_t(i) < mSuperIndex.size();
+        putU64(ba, used ? mSuperIndex[size_t(i)].offset : 0);
+        putU32(ba, used ? mSuperIndex[size_t(i)].size : 0);
+        putU32(ba, used ? mSuperIndex[size_t(i)].duration : 0);
+    }
+
+    endList(ba, strl);
+
+    const int odml = beginList(ba, "odml");
+    putFourCC(ba, "dmlh");
+    putU32(ba, 248);
+    putU32(ba, quint32(mTotalFrames));
+    ba.append(244, char(0));
+    endList(ba, odml);
+
+    endList(ba, hdrl);
+
+    putFourCC(ba, "LIST");
+    putU32(ba, mFirstMoviSize);
+    putFourCC(ba, "movi");
+
+    return ba;
+}
+
+quint64 AviMuxer::indexSize(size_t count) const
+{
+    quint64 size = 32 + count * 8;
+    if(mSuperIndex.empty())
+        size += 8 + count * 16;
+    return size;
+}
+
+bool AviMuxer::isFull(unsigned size) const
+{
+    //The current RIFF takes an entry when finished
+    if(mSuperIndex.size() + 1 < size_t(SuperIndexSize))
+        return false;
+
+    const quint64 chunk = 8 + size + (size & 1);
+    return !mIndex.empty() && mPos + chunk - mRiffPos + indexSize(mIndex.size() + 1) > RiffLimit;
+}
+
+bool AviMuxer::writeChunk(const unsigned char* data, unsigned size)
+{
+    if(isFull(size))
+        return false;
+
+    const quint64 chunk = 8 + size + (size & 1);
+    if(!mIndex.empty() && mPos + chunk - mRiffPos + indexSize(mIndex.size() + 1) > RiffLimit)
+    {
+        if(!finishRiff() || !startRiff())
+            return false;
+    }
+
+    mIndex.push_back({mPos, size});
+
+    char hdr[8] = {'0', '0', 'd', 'c'};
+    setU32(hdr + 4, size);
+    if(!append(hdr, 8) || !append(data, size))
+        return false;
+    if(size & 1)
+    {
+        const char pad = 0;
+        if(!append(&pad, 1))
+            return false;
+    }
+
+    mTotalFrames++;
+    if(mSuperIndex.empty())
+        mFirstRiffFrames++;
+    mNextSlot++;
+    mMaxChunk = qMax(mMaxChunk, quint32(chunk));
+    mDataBytes += size;
+    return true;
+}
+
+bool AviMuxer::startRiff()
+{
+    if(mSuperIndex.size() >= size_t(SuperIndexSize))
+    {
+        mFailed = true;
+        return false;
+    }
+
+    mRiffPos = mPos;
+    mMoviPos = mPos + 12;
+    mIndex.clear();
+
+    QByteArray ba;
+    putFourCC(ba, "RIFF");
+    putU32(ba, 0);
+    putFourCC(ba, "AVIX");
+    putFourCC(ba, "LIST");
+    putU32(ba, 0);
+    putFourCC(ba, "movi");
+    return append(ba.constData(), quint64(ba.size()));
+}
+
+bool AviMuxer::finishRiff()
+{
+    //Standard index closes movi list, offsets are relative to RIFF start
+    const quint64 ixPos = mPos;
+    QByteArray ix;
+    ix.reserve(int(32 + mIndex.size() * 8));
+    putFourCC(ix, "ix00");
+    putU32(ix, quint32(24 + mIndex.size() * 8));
+    putU16(ix, 2);                      //longs per entry
+    ix.append(char(0));                 //index sub type
+    ix.append(AVI_INDEX_OF_CHUNKS);
+    putU32(ix, quint32(mIndex.size()));
+    putFourCC(ix, "00dc");
+    putU64(ix, mRiffPos);
+    putU32(ix, 0);
+    for(const IndexEntry& entry : mIndex)
+    {
+        putU32(ix, quint32(entry.offset + 8 - mRiffPos));
+        putU32(ix, entry.size);
+    }
+    if(!append(ix.constData(), quint64(ix.size())))
+        return false;
+
+    const bool first = mSuperIndex.empty();
+    mSuperIndex.push_back({ixPos, quint32(ix.size()), quint32(mIndex.size())});
+
+    const quint32 moviSize = quint32(mPos - mMoviPos - 8);
+    if(first)
+    {
+        //Legacy index for players without OpenDML, offsets are relative to movi fourcc
+        QByteArray idx1;
+        idx1.reserve(int(8 + mIndex.size() * 16));
+        putFourCC(idx1, "idx1");
+        putU32(idx1, quint32(mIndex.size() * 16));
+        for(const IndexEntry& entry : mIndex)
+        {
+            putFourCC(idx1, "00dc");
+            putU32(idx1, entry.size > 0 ? AVIIF_KEYFRAME : 0);
+            putU32(idx1, quint32(entry.offset - mMoviPos - 8));
+            putU32(idx1, entry.size);
+        }
+        if(!append(idx1.constData(), quint64(idx1.size())))
+            return false;
+
+        mFirstMoviSize = moviSize;
+        mFirstRiffSize = quint32(mPos - mRiffPos - 8);
+        return true;
+    }
+
+    return patch(mMoviPos + 4, moviSize) &&
+           patch(mRiffPos + 4, quint32(mPos - mRiffPos - 8));
+}
+
+bool AviMuxer::append(const void* data, quint64 size)
+{
+    if(mFailed)
+        return false;
+    if(size == 0)
+        return true;
+
+    if(mBuffered + size > mBuffer.size())
+    {
+        if(!flushBuffer())
+            return false;
+    }
+
+    if(size > mBuffer.size())
+    {
+        const qint64 start = FrameMetadata::now();
+        if(mFile.write(static_cast<const char*>(data), qint64(size)) != qint64(size))
+        {
+            mFailed = true;
+            return false;
+        }
+        Metrics::recordNs(Metrics::mtDiskWrite, FrameMetadata::now() - start);
+    }
+    else
+    {
+        memcpy(mBuffer.data() + mBuffered, data, size);
+        mBuffered += size;
+    }
+    mPos += size;
+    return true;
+}
+
+bool AviMuxer::flushBuffer()
+{
+    if(mFailed)
+        return false;
+    if(mBuffered == 0)
+        return true;
+
+    const qint64 start = FrameMetadata::now();
+    if(mFile.write(mBuffer.data(), qint64(mBuffered)) != qint64(mBuffered))
+    {
+        mFailed = true;
+        return false;
+    }
+    Metrics::recordNs(Metrics::mtDiskWrite, FrameMetadata::now() - start);
+    mBuffered = 0;
+    return true;
+}
+
+bool AviMuxer::patch(quint64 pos, quint32 value)
+{
+    if(!flushBuffer())
+        return false;
+
+    QByteArray ba;
+    putU32(ba, value);
+    if(!mFile.seek(qint64(pos)) || mFile.write(ba) != ba.size() || !mFile.seek(qint64(mPos)))
+    {
+        mFailed = true;
+        return false;
+    }
+    return true;
+}
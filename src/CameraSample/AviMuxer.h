@@ -0,0 +1,120 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef AVIMUXER_H
+#define AVIMUXER_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+
+#include <vector>
+
+#include "FrameMetadata.h"
+
+/// Writes already encoded JPEG frames to AVI with OpenDML indexes.
+/// The first RIFF is kept under 1 GB with a legacy idx1 index, later data goes to
+/// AVIX extensions, each with its own standard index referenced from the super index
+/// in the stream header, so files are not limited to 2 or 4 GB.
+/// Frames are placed on the frame rate grid by capture time, missed slots are filled
+/// with empty chunks. Chunks are gathered in a write buffer and index entries are kept
+/// in reserved tables, so a frame costs a memcpy and headers are written on close.
+class AviMuxer
+{
+public:
+    AviMuxer() = default;
+    ~AviMuxer();
+
+    bool open(const QString& fileName, int width, int height, double fps);
+    bool isOpened() const {return mFile.isOpen() && !mFailed;}
+    /// True if a frame of size bytes needs a RIFF the super index has no entry for.
+    /// Such frames are refused, the file stays valid and is finished by close.
+    bool isFull(unsigned size) const;
+    /// Appends JPEG frame, frame time is taken from capture timestamp if meta is set
+    bool addFrame(const unsigned char* data, unsigned size, const FrameMetadata* meta = nullptr);
+    /// Writes indexes and headers
+    void close();
+
+    /// Frame slots written, including empty ones
+    int     frameCount() const {return mTotalFrames;}
+    int     emptyFrames() const {return mEmptyFrames;}
+    quint64 size() const {return mPos;}
+
+private:
+    struct IndexEntry
+    {
+        /// Absolute position of chunk header
+        quint64 offset;
+        quint32 size;
+    };
+
+    struct SuperIndexEntry
+    {
+        quint64 offset;
+        quint32 size;
+        quint32 duration;
+    };
+
+    QByteArray header() const;
+    bool writeChunk(const unsigned char* data, unsigned size);
+    /// Index bytes the current RIFF needs with count chunks
+    quint64 indexSize(size_t count) const;
+    bool startRiff();
+    bool finishRiff();
+    bool append(const void* data, quint64 size);
+    bool flushBuffer();
+    bool patch(quint64 pos, quint32 value);
+
+    QFile   mFile;
+    bool    mFailed = false;
+    quint64 mPos = 0;
+    std::vector<char> mBuffer;
+    size_t  mBuffered = 0;
+
+    int     mWidth = 0;
+    int     mHeight = 0;
+    quint32 mRate = 0;
+    quint32 mScale = 1;
+
+    quint64 mRiffPos = 0;
+    quint64 mMoviPos = 0;
+    quint32 mFirstRiffSize = 0;
+    quint32 mFirstMoviSize = 0;
+    std::vector<IndexEntry> mIndex;
+    std::vector<SuperIndexEntry> mSuperIndex;
+
+    int     mTotalFrames = 0;
+    int     mFirstRiffFrames = 0;
+    int     mEmptyFrames = 0;
+    quint32 mMaxChunk = 0;
+    quint64 mDataBytes = 0;
+    qint64  mFirstTimestamp = 0;
+    qint64  mNextSlot = 0;
+};
+
+#endif // AVIMUXER_H
@@ -0,0 +1,1077 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "CPUKernels.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2  __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__)
+#define CPU_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+//Scalar helpers mirror SIMD instructions exactly (pavgw, paddusw, psubusw)
+inline unsigned short avg16(unsigned a, unsigned b)
+{
+    return static_cast<unsigned short>((a + b + 1) >> 1);
+}
+
+inline unsigned short adds16(unsigned a, unsigned b)
+{
+    return static_cast<unsigned short>(std::min(a + b, 65535u));
+}
+
+inline unsigned short subs16(unsigned a, unsigned b)
+{
+    return static_cast<unsigned short>(a > b ? a - b : 0);
+}
+
+//Reflect index over the image border, keeps Bayer parity
+inline int mirror(int x, int width)
+{
+    if(x < 0)
+        return -x;
+    if(x >= width)
+        return 2 * (width - 1) - x;
+    return x;
+}
+
+inline unsigned short samPixel(unsigned v, const unsigned short* black, const float* gain, int x, float maxVal)
+{
+    if(black)
+        v = subs16(v, black[x]);
+    float f = float(v);
+    if(gain)
+        f *= gain[x];
+    f = std::min(std::max(f, 0.f), maxVal);
+    return static_cast<unsigned short>(std::lrintf(f));
+}
+
+void samScalar(const unsigned short* src, const unsigned short* black, const float* gain,
+               unsigned short* dst, int begin, int end, unsigned short maxVal)
+{
+    for(int x = begin; x < end; x++)
+        dst[x] = samPixel(src[x], black, gain, x, maxVal);
+}
+
+void bpcScalar(const unsigned short* up2, const unsigned short* cur, const unsigned short* down2,
+               unsigned short* dst, int begin, int end, int width)
+{
+    for(int x = begin; x < end; x++)
+    {
+        unsigned short l = cur[mirror(x - 2, width)];
+        unsigned short r = cur[mirror(x + 2, width)];
+        unsigned short mn = std::min(std::min(l, r), std::min(up2[x], down2[x]));
+        unsigned short mx = std::max(std::max(l, r), std::max(up2[x], down2[x]));
+        dst[x] = std::min(std::max(cur[x], mn), mx);
+    }
+}
+
+void debayerScalar(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                   bool xAtEven, unsigned short* dstX, unsigned short* dstG, unsigned short* dstY,
+                   int begin, int end, int width)
+{
+    for(int x = begin; x < end; x++)
+    {
+        int xl = mirror(x - 1, width);
+        int xr = mirror(x + 1, width);
+
+        unsigned short h2 = avg16(cur[xl], cur[xr]);
+        unsigned short v2 = avg16(up[x], down[x]);
+        if(((x & 1) == 0) == xAtEven)
+        {
+            //X pixel: green from the cross, Y from the diagonals
+            dstX[x] = cur[x];
+            dstG[x] = avg16(h2, v2);
+            dstY[x] = avg16(avg16(up[xl], up[xr]), avg16(down[xl], down[xr]));
+        }
+        else
+        {
+            //Green pixel: X from the row, Y from the column
+            dstX[x] = h2;
+            dstG[x] = cur[x];
+            dstY[x] = v2;
+        }
+    }
+}
+
+inline unsigned short shrink(unsigned short c, unsigned short blur, unsigned short threshold)
+{
+    unsigned short pos = subs16(c, adds16(blur, threshold));
+    unsigned short neg = subs16(blur, adds16(c, threshold));
+    return subs16(adds16(blur, pos), neg);
+}
+
+void denoiseScalar(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                   unsigned short threshold, unsigned short* dst, int begin, int end, int width)
+{
+    for(int x = begin; x < end; x++)
+    {
+        int xl = mirror(x - 1, width);
+        int xr = mirror(x + 1, width);
+        unsigned short hu = avg16(avg16(up[xl], up[xr]), up[x]);
+        unsigned short hc = avg16(avg16(cur[xl], cur[xr]), cur[x]);
+        unsigned short hd = avg16(avg16(down[xl], down[xr]), down[x]);
+        unsigned short blur = avg16(avg16(hu, hd), hc);
+        dst[x] = shrink(cur[x], blur, threshold);
+    }
+}
+
+//Pixel group is two 12 bit pixels in three bytes or four 10 bit pixels in five bytes
+inline int groupPixels(CPUKernels::PackedLayout layout)
+{
+    return layout == CPUKernels::plGenICam10p ? 4 : 2;
+}
+
+inline int groupBytes(CPUKernels::PackedLayout layout)
+{
+    return layout == CPUKernels::plGenICam10p ? 5 : 3;
+}
+
+template<CPUKernels::PackedLayout layout>
+inline void unpackGroup(const unsigned char* s, unsigned short* d)
+{
+    switch(layout)
+    {
+    case CPUKernels::plXimea12:
+        d[0] = static_cast<unsigned short>((s[0] << 4) | (s[2] & 0x0F));
+        d[1] = static_cast<unsigned short>((s[1] << 4) | (s[2] >> 4));
+        break;
+    case CPUKernels::plMono12Packed:
+        d[0] = static_cast<unsigned short>((s[0] << 4) | (s[1] & 0x0F));
+        d[1] = static_cast<unsigned short>((s[2] << 4) | (s[1] >> 4));
+        break;
+    case CPUKernels::plGenICam12p:
+        d[0] = static_cast<unsigned short>(s[0] | ((s[1] & 0x0F) << 8));
+        d[1] = static_cast<unsigned short>((s[1] >> 4) | (s[2] << 4));
+        break;
+    case CPUKernels::plGenICam10p:
+        d[0] = static_cast<unsigned short>(s[0] | ((s[1] & 0x03) << 8));
+        d[1] = static_cast<unsigned short>((s[1] >> 2) | ((s[2] & 0x0F) << 6));
+        d[2] = static_cast<unsigned short>((s[2] >> 4) | ((s[3] & 0x3F) << 4));
+        d[3] = static_cast<unsigned short>((s[3] >> 6) | (s[4] << 2));
+        break;
+    }
+}
+
+template<CPUKernels::PackedLayout layout>
+void unpackScalarT(const unsigned char* src, unsigned short* dst, int begin, int width)
+{
+    const int pixels = groupPixels(layout);
+    const int bytes = groupBytes(layout);
+
+    int x = begin;
+    src += x / pixels * bytes;
+    for(; x + pixels <= width; x += pixels, src += bytes)
+        unpackGroup<layout>(src, dst + x);
+
+    if(x < width)
+    {
+        //Incomplete last group, missing bytes are zero
+        unsigned char s[5] = {};
+        unsigned short d[4];
+        std::copy(src, src + CPUKernels::packedBytes(layout, width) - CPUKernels::packedBytes(layout, x), s);
+        unpackGroup<layout>(s, d);
+        std::copy(d, d + (width - x), dst + x);
+    }
+}
+
+void byteSwapScalar(const unsigned short* src, unsigned short* dst, int begin, int count)
+{
+    for(int i = begin; i < count; i++)
+        dst[i] = static_cast<unsigned short>((src[i] << 8) | (src[i] >> 8));
+}
+
+void unpackScalar(CPUKernels::PackedLayout layout, const unsigned char* src, unsigned short* dst, int begin, int width)
+{
+    switch(layout)
+    {
+    case CPUKernels::plXimea12:
+        unpackScalarT<CPUKernels::plXimea12>(src, dst, begin, width);
+        break;
+    case CPUKernels::plMono12Packed:
+        unpackScalarT<CPUKernels::plMono12Packed>(src, dst, begin, width);
+        break;
+    case CPUKernels::plGenICam12p:
+        unpackScalarT<CPUKernels::plGenICam12p>(src, dst, begin, width);
+        break;
+    case CPUKernels::plGenICam10p:
+        unpackScalarT<CPUKernels::plGenICam10p>(src, dst, begin, width);
+        break;
+    }
+}
+
+#if defined(CPU_KERNELS_X86) || defined(CPU_KERNELS_NEON)
+
+//Eight pixels are unpacked from 12 or 10 bytes with one byte shuffle.
+//Bit stream layouts take both bytes a pixel spans to a 16 bit word and
+//shift it by multiplication and constant right shift.
+//Other layouts take MSB byte and byte with LSB nibbles separately.
+struct UnpackTable
+{
+    //Source bytes of each output word, 0x80 gives zero
+    unsigned char word[16];
+    //Byte holding LSB nibble of each pixel
+    unsigned char nibble[16];
+    unsigned short mult[8];
+    int shift;
+    //Bytes taken by eight pixels
+    int bytes;
+    bool stream;
+};
+
+const unsigned char Z = 0x80;
+
+const UnpackTable& unpackTable(CPUKernels::PackedLayout layout)
+{
+    static const UnpackTable tables[] =
+    {
+        //plXimea12
+        {{0, Z, 1, Z, 3, Z, 4, Z, 6, Z, 7, Z, 9, Z, 10, Z},
+         {2, Z, 2, Z, 5, Z, 5, Z, 8, Z, 8, Z, 11, Z, 11, Z},
+         {}, 0, 12, false},
+        //plMono12Packed
+        {{0, Z, 2, Z, 3, Z, 5, Z, 6, Z, 8, Z, 9, Z, 11, Z},
+         {1, Z, 1, Z, 4, Z, 4, Z, 7, Z, 7, Z, 10, Z, 10, Z},
+         {}, 0, 12, false},
+        //plGenICam12p
+        {{0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11},
+         {},
+         {16, 1, 16, 1, 16, 1, 16, 1}, 4, 12, true},
+        //plGenICam10p
+        {{0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9},
+         {},
+         {64, 16, 4, 1, 64, 16, 4, 1}, 6, 10, true}
+    };
+    return tables[layout];
+}
+
+#endif
+
+#ifdef CPU_KERNELS_X86
+
+TARGET_SSE41 int samSSE41(const unsigned short* src, const unsigned short* black, const float* gain,
+                          unsigned short* dst, int width, unsigned short maxVal)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 maxv = _mm_set1_ps(float(maxVal));
+    int x = 0;
+    for(; x + 8 <= width; x += 8)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        if(black)
+            s = _mm_subs_epu16(s, _mm_loadu_si128(reinterpret_cast<const __m128i*>(black + x)));
+
+        __m128 lo = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(s));
+        __m128 hi = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(s, 8)));
+        if(gain)
+        {
+            lo = _mm_mul_ps(lo, _mm_loadu_ps(gain + x));
+            hi = _mm_mul_ps(hi, _mm_loadu_ps(gain + x + 4));
+        }
+        lo = _mm_min_ps(_mm_max_ps(lo, zero), maxv);
+        hi = _mm_min_ps(_mm_max_ps(hi, zero), maxv);
+
+        __m128i res = _mm_packus_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), res);
+    }
+    return x;
+}
+
+TARGET_AVX2 int samAVX2(const unsigned short* src, const unsigned short* black, const float* gain,
+                        unsigned short* dst, int width, unsigned short maxVal)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 maxv = _mm256_set1_ps(float(maxVal));
+    int x = 0;
+    for(; x + 16 <= width; x += 16)
+    {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        if(black)
+            s = _mm256_subs_epu16(s, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(black + x)));
+
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(s)));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(s, 1)));
+        if(gain)
+        {
+            lo = _mm256_mul_ps(lo, _mm256_loadu_ps(gain + x));
+            hi = _mm256_mul_ps(hi, _mm256_loadu_ps(gain + x + 8));
+        }
+        lo = _mm256_min_ps(_mm256_max_ps(lo, zero), maxv);
+        hi = _mm256_min_ps(_mm256_max_ps(hi, zero), maxv);
+
+        //packus works within 128 bit lanes, restore order
+        __m256i res = _mm256_packus_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+        res = _mm256_permute4x64_epi64(res, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), res);
+    }
+    return x;
+}
+
+TARGET_SSE41 int bpcSSE41(const unsigned short* up2, const unsigned short* cur, const unsigned short* down2,
+                          unsigned short* dst, int width)
+{
+    int x = 2;
+    for(; x + 8 + 2 <= width; x += 8)
+    {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x));
+        __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x - 2));
+        __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x + 2));
+        __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up2 + x));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down2 + x));
+        __m128i mn = _mm_min_epu16(_mm_min_epu16(l, r), _mm_min_epu16(u, d));
+        __m128i mx = _mm_max_epu16(_mm_max_epu16(l, r), _mm_max_epu16(u, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_min_epu16(_mm_max_epu16(c, mn), mx));
+    }
+    return x;
+}
+
+TARGET_AVX2 int bpcAVX2(const unsigned short* up2, const unsigned short* cur, const unsigned short* down2,
+                        unsigned short* dst, int width)
+{
+    int x = 2;
+    for(; x + 16 + 2 <= width; x += 16)
+    {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + x));
+        __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + x - 2));
+        __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + x + 2));
+        __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up2 + x));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down2 + x));
+        __m256i mn = _mm256_min_epu16(_mm256_min_epu16(l, r), _mm256_min_epu16(u, d));
+        __m256i mx = _mm256_max_epu16(_mm256_max_epu16(l, r), _mm256_max_epu16(u, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_min_epu16(_mm256_max_epu16(c, mn), mx));
+    }
+    return x;
+}
+
+TARGET_SSE41 int debayerSSE41(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                              bool xAtEven, unsigned short* dstX, unsigned short* dstG, unsigned short* dstY, int width)
+{
+    //Starts at even column, so lane parity equals column parity
+    int x = 2;
+    for(; x + 8 + 1 <= width; x += 8)
+    {
+        __m128i c  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x));
+        __m128i l  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x - 1));
+        __m128i r  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x + 1));
+        __m128i u  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+        __m128i d  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x));
+        __m128i ul = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x - 1));
+        __m128i ur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x + 1));
+        __m128i dl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x - 1));
+        __m128i dr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x + 1));
+
+        __m128i h2 = _mm_avg_epu16(l, r);
+        __m128i v2 = _mm_avg_epu16(u, d);
+        __m128i cross = _mm_avg_epu16(h2, v2);
+        __m128i diag = _mm_avg_epu16(_mm_avg_epu16(ul, ur), _mm_avg_epu16(dl, dr));
+
+        //0xAA takes odd lanes from the second operand
+        __m128i outX, outG, outY;
+        if(xAtEven)
+        {
+            outX = _mm_blend_epi16(c, h2, 0xAA);
+            outG = _mm_blend_epi16(cross, c, 0xAA);
+            outY = _mm_blend_epi16(diag, v2, 0xAA);
+        }
+        else
+        {
+            outX = _mm_blend_epi16(h2, c, 0xAA);
+            outG = _mm_blend_epi16(c, cross, 0xAA);
+            outY = _mm_blend_epi16(v2, diag, 0xAA);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstX + x), outX);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstG + x), outG);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstY + x), outY);
+    }
+    return x;
+}
+
+TARGET_AVX2 int debayerAVX2(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                            bool xAtEven, unsigned short* dstX, unsigned short* dstG, unsigned short* dstY, int width)
+{
+    int x = 2;
+    for(; x + 16 + 1 <= width; x += 16)
+    {
+        __m256i c  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + x));
+        __m256i l  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + x - 1));
+        __m256i r  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + x + 1));
+        __m256i u  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x));
+        __m256i d  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x));
+        __m256i ul = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x - 1));
+        __m256i ur = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x + 1));
+        __m256i dl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x - 1));
+        __m256i dr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x + 1));
+
+        __m256i h2 = _mm256_avg_epu16(l, r);
+        __m256i v2 = _mm256_avg_epu16(u, d);
+        __m256i cross = _mm256_avg_epu16(h2, v2);
+        __m256i diag = _mm256_avg_epu16(_mm256_avg_epu16(ul, ur), _mm256_avg_epu16(dl, dr));
+
+        //Blend mask is applied to both 128 bit lanes
+        __m256i outX, outG, outY;
+        if(xAtEven)
+        {
+            outX = _mm256_blend_epi16(c, h2, 0xAA);
+            outG = _mm256_blend_epi16(cross, c, 0xAA);
+            outY = _mm256_blend_epi16(diag, v2, 0xAA);
+        }
+        else
+        {
+            outX = _mm256_blend_epi16(h2, c, 0xAA);
+            outG = _mm256_blend_epi16(c, cross, 0xAA);
+            outY = _mm256_blend_epi16(v2, diag, 0xAA);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dstX + x), outX);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dstG + x), outG);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dstY + x), outY);
+    }
+    return x;
+}
+
+TARGET_SSE41 inline __m128i hblurSSE41(const unsigned short* p)
+{
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - 1));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    return _mm_avg_epu16(_mm_avg_epu16(l, r), c);
+}
+
+TARGET_SSE41 int denoiseSSE41(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                              unsigned short threshold, unsigned short* dst, int width)
+{
+    const __m128i t = _mm_set1_epi16(short(threshold));
+    int x = 1;
+    for(; x + 8 + 1 <= width; x += 8)
+    {
+        __m128i blur = _mm_avg_epu16(_mm_avg_epu16(hblurSSE41(up + x), hblurSSE41(down + x)), hblurSSE41(cur + x));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x));
+        __m128i pos = _mm_subs_epu16(c, _mm_adds_epu16(blur, t));
+        __m128i neg = _mm_subs_epu16(blur, _mm_adds_epu16(c, t));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_subs_epu16(_mm_adds_epu16(blur, pos), neg));
+    }
+    return x;
+}
+
+TARGET_AVX2 inline __m256i hblurAVX2(const unsigned short* p)
+{
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p - 1));
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    return _mm256_avg_epu16(_mm256_avg_epu16(l, r), c);
+}
+
+TARGET_AVX2 int denoiseAVX2(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                            unsigned short threshold, unsigned short* dst, int width)
+{
+    const __m256i t = _mm256_set1_epi16(short(threshold));
+    int x = 1;
+    for(; x + 16 + 1 <= width; x += 16)
+    {
+        __m256i blur = _mm256_avg_epu16(_mm256_avg_epu16(hblurAVX2(up + x), hblurAVX2(down + x)), hblurAVX2(cur + x));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + x));
+        __m256i pos = _mm256_subs_epu16(c, _mm256_adds_epu16(blur, t));
+        __m256i neg = _mm256_subs_epu16(blur, _mm256_adds_epu16(c, t));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_subs_epu16(_mm256_adds_epu16(blur, pos), neg));
+    }
+    return x;
+}
+
+TARGET_SSE41 int unpackSSE41(const UnpackTable& t, const unsigned char* src, unsigned short* dst, int width, int bytes)
+{
+    const __m128i word = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.word));
+    int x = 0;
+    int offset = 0;
+    if(t.stream)
+    {
+        const __m128i mult = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.mult));
+        const __m128i shift = _mm_cvtsi32_si128(t.shift);
+        for(; x + 8 <= width && offset + 16 <= bytes; x += 8, offset += t.bytes)
+        {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + offset));
+            __m128i w = _mm_mullo_epi16(_mm_shuffle_epi8(s, word), mult);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_srl_epi16(w, shift));
+        }
+        return x;
+    }
+
+    const __m128i nibble = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.nibble));
+    const __m128i lowMask = _mm_set1_epi16(0x0F);
+    for(; x + 8 <= width && offset + 16 <= bytes; x += 8, offset += t.bytes)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + offset));
+        __m128i msb = _mm_slli_epi16(_mm_shuffle_epi8(s, word), 4);
+        __m128i n = _mm_shuffle_epi8(s, nibble);
+        n = _mm_blend_epi16(_mm_and_si128(n, lowMask), _mm_srli_epi16(n, 4), 0xAA);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(msb, n));
+    }
+    return x;
+}
+
+TARGET_SSE41 int byteSwapSSE41(const unsigned short* src, unsigned short* dst, int count)
+{
+    const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    int x = 0;
+    for(; x + 16 <= count; x += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_shuffle_epi8(a, swap));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 8), _mm_shuffle_epi8(b, swap));
+    }
+    return x;
+}
+
+TARGET_AVX2 int byteSwapAVX2(const unsigned short* src, unsigned short* dst, int count)
+{
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    int x = 0;
+    for(; x + 32 <= count; x += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x + 16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_shuffle_epi8(a, swap));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x + 16), _mm256_shuffle_epi8(b, swap));
+    }
+    return x;
+}
+
+//Second group of eight pixels goes to the upper lane, shuffles work within lanes
+TARGET_AVX2 inline __m256i loadUnpackPair(const unsigned char* src, int second)
+{
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + second));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+TARGET_AVX2 int unpackAVX2(const UnpackTable& t, const unsigned char* src, unsigned short* dst, int width, int bytes)
+{
+    const __m256i word = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t.word)));
+    int x = 0;
+    int offset = 0;
+    if(t.stream)
+    {
+        const __m256i mult = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t.mult)));
+        const __m128i shift = _mm_cvtsi32_si128(t.shift);
+        for(; x + 16 <= width && offset + t.bytes + 16 <= bytes; x += 16, offset += 2 * t.bytes)
+        {
+            __m256i s = loadUnpackPair(src + offset, t.bytes);
+            __m256i w = _mm256_mullo_epi16(_mm256_shuffle_epi8(s, word), mult);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_srl_epi16(w, shift));
+        }
+        return x;
+    }
+
+    const __m256i nibble = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(t.nibble)));
+    const __m256i lowMask = _mm256_set1_epi16(0x0F);
+    for(; x + 16 <= width && offset + t.bytes + 16 <= bytes; x += 16, offset += 2 * t.bytes)
+    {
+        __m256i s = loadUnpackPair(src + offset, t.bytes);
+        __m256i msb = _mm256_slli_epi16(_mm256_shuffle_epi8(s, word), 4);
+        __m256i n = _mm256_shuffle_epi8(s, nibble);
+        n = _mm256_blend_epi16(_mm256_and_si256(n, lowMask), _mm256_srli_epi16(n, 4), 0xAA);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(msb, n));
+    }
+    return x;
+}
+
+#endif // CPU_KERNELS_X86
+
+#ifdef CPU_KERNELS_NEON
+
+int samNEON(const unsigned short* src, const unsigned short* black, const float* gain,
+            unsigned short* dst, int width, unsigned short maxVal)
+{
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    const float32x4_t maxv = vdupq_n_f32(float(maxVal));
+    int x = 0;
+    for(; x + 8 <= width; x += 8)
+    {
+        uint16x8_t s = vld1q_u16(src + x);
+        if(black)
+            s = vqsubq_u16(s, vld1q_u16(black + x));
+
+        float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(s)));
+        float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(s)));
+        if(gain)
+        {
+            lo = vmulq_f32(lo, vld1q_f32(gain + x));
+            hi = vmulq_f32(hi, vld1q_f32(gain + x + 4));
+        }
+        lo = vminq_f32(vmaxq_f32(lo, zero), maxv);
+        hi = vminq_f32(vmaxq_f32(hi, zero), maxv);
+
+        //Round to nearest even like lrintf
+        uint16x8_t res = vcombine_u16(vqmovn_u32(vcvtnq_u32_f32(lo)), vqmovn_u32(vcvtnq_u32_f32(hi)));
+        vst1q_u16(dst + x, res);
+    }
+    return x;
+}
+
+int bpcNEON(const unsigned short* up2, const unsigned short* cur, const unsigned short* down2,
+            unsigned short* dst, int width)
+{
+    int x = 2;
+    for(; x + 8 + 2 <= width; x += 8)
+    {
+        uint16x8_t c = vld1q_u16(cur + x);
+        uint16x8_t l = vld1q_u16(cur + x - 2);
+        uint16x8_t r = vld1q_u16(cur + x + 2);
+        uint16x8_t u = vld1q_u16(up2 + x);
+        uint16x8_t d = vld1q_u16(down2 + x);
+        uint16x8_t mn = vminq_u16(vminq_u16(l, r), vminq_u16(u, d));
+        uint16x8_t mx = vmaxq_u16(vmaxq_u16(l, r), vmaxq_u16(u, d));
+        vst1q_u16(dst + x, vminq_u16(vmaxq_u16(c, mn), mx));
+    }
+    return x;
+}
+
+int debayerNEON(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                bool xAtEven, unsigned short* dstX, unsigned short* dstG, unsigned short* dstY, int width)
+{
+    static const uint16_t oddLanes[8] = {0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF};
+    const uint16x8_t odd = vld1q_u16(oddLanes);
+    int x = 2;
+    for(; x + 8 + 1 <= width; x += 8)
+    {
+        uint16x8_t c  = vld1q_u16(cur + x);
+        uint16x8_t h2 = vrhaddq_u16(vld1q_u16(cur + x - 1), vld1q_u16(cur + x + 1));
+        uint16x8_t v2 = vrhaddq_u16(vld1q_u16(up + x), vld1q_u16(down + x));
+        uint16x8_t cross = vrhaddq_u16(h2, v2);
+        uint16x8_t diag = vrhaddq_u16(vrhaddq_u16(vld1q_u16(up + x - 1), vld1q_u16(up + x + 1)),
+                                      vrhaddq_u16(vld1q_u16(down + x - 1), vld1q_u16(down + x + 1)));
+        if(xAtEven)
+        {
+            vst1q_u16(dstX + x, vbslq_u16(odd, h2, c));
+            vst1q_u16(dstG + x, vbslq_u16(odd, c, cross));
+            vst1q_u16(dstY + x, vbslq_u16(odd, v2, diag));
+        }
+        else
+        {
+            vst1q_u16(dstX + x, vbslq_u16(odd, c, h2));
+            vst1q_u16(dstG + x, vbslq_u16(odd, cross, c));
+            vst1q_u16(dstY + x, vbslq_u16(odd, diag, v2));
+        }
+    }
+    return x;
+}
+
+inline uint16x8_t hblurNEON(const unsigned short* p)
+{
+    return vrhaddq_u16(vrhaddq_u16(vld1q_u16(p - 1), vld1q_u16(p + 1)), vld1q_u16(p));
+}
+
+int denoiseNEON(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                unsigned short threshold, unsigned short* dst, int width)
+{
+    const uint16x8_t t = vdupq_n_u16(threshold);
+    int x = 1;
+    for(; x + 8 + 1 <= width; x += 8)
+    {
+        uint16x8_t blur = vrhaddq_u16(vrhaddq_u16(hblurNEON(up + x), hblurNEON(down + x)), hblurNEON(cur + x));
+        uint16x8_t c = vld1q_u16(cur + x);
+        uint16x8_t pos = vqsubq_u16(c, vqaddq_u16(blur, t));
+        uint16x8_t neg = vqsubq_u16(blur, vqaddq_u16(c, t));
+        vst1q_u16(dst + x, vqsubq_u16(vqaddq_u16(blur, pos), neg));
+    }
+    return x;
+}
+
+int byteSwapNEON(const unsigned short* src, unsigned short* dst, int count)
+{
+    int x = 0;
+    for(; x + 16 <= count; x += 16)
+    {
+        uint8x16_t a = vld1q_u8(reinterpret_cast<const uint8_t*>(src + x));
+        uint8x16_t b = vld1q_u8(reinterpret_cast<const uint8_t*>(src + x + 8));
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst + x), vrev16q_u8(a));
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst + x + 8), vrev16q_u8(b));
+    }
+    return x;
+}
+
+int unpackNEON(const UnpackTable& t, const unsigned char* src, unsigned short* dst, int width, int bytes)
+{
+    const uint8x16_t word = vld1q_u8(t.word);
+    int x = 0;
+    int offset = 0;
+    if(t.stream)
+    {
+        const uint16x8_t mult = vld1q_u16(t.mult);
+        const int16x8_t shift = vdupq_n_s16(static_cast<int16_t>(-t.shift));
+        for(; x + 8 <= width && offset + 16 <= bytes; x += 8, offset += t.bytes)
+        {
+            uint8x16_t s = vld1q_u8(src + offset);
+            uint16x8_t w = vmulq_u16(vreinterpretq_u16_u8(vqtbl1q_u8(s, word)), mult);
+            vst1q_u16(dst + x, vshlq_u16(w, shift));
+        }
+        return x;
+    }
+
+    const uint8x16_t nibble = vld1q_u8(t.nibble);
+    const uint16x8_t lowMask = vdupq_n_u16(0x0F);
+    const uint16x8_t oddLanes = vreinterpretq_u16_u32(vdupq_n_u32(0xFFFF0000));
+    for(; x + 8 <= width && offset + 16 <= bytes; x += 8, offset += t.bytes)
+    {
+        uint8x16_t s = vld1q_u8(src + offset);
+        uint16x8_t msb = vshlq_n_u16(vreinterpretq_u16_u8(vqtbl1q_u8(s, word)), 4);
+        uint16x8_t n = vreinterpretq_u16_u8(vqtbl1q_u8(s, nibble));
+        n = vbslq_u16(oddLanes, vshrq_n_u16(n, 4), vandq_u16(n, lowMask));
+        vst1q_u16(dst + x, vorrq_u16(msb, n));
+    }
+    return x;
+}
+
+#endif // CPU_KERNELS_NEON
+}
+
+CPUKernels::SimdLevel CPUKernels::detectedLevel()
+{
+    static const SimdLevel level = []()
+    {
+#if defined(CPU_KERNELS_X86)
+#ifdef _MSC_VER
+        int regs[4] = {};
+        __cpuid(regs, 0);
+        const int maxLeaf = regs[0];
+        __cpuid(regs, 1);
+        const bool sse41 = (regs[2] & (1 << 19)) != 0;
+        const bool osxsave = (regs[2] & (1 << 27)) != 0;
+        bool avx2 = false;
+        if(maxLeaf >= 7 && osxsave && (_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(regs, 7, 0);
+            avx2 = (regs[1] & (1 << 5)) != 0;
+        }
+#else
+        __builtin_cpu_init();
+        const bool sse41 = __builtin_cpu_supports("sse4.1");
+        const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+        if(avx2)
+            return slAVX2;
+        if(sse41)
+            return slSSE41;
+        return slScalar;
+#elif defined(CPU_KERNELS_NEON)
+        return slNEON;
+#else
+        return slScalar;
+#endif
+    }();
+    return level;
+}
+
+int& CPUKernels::currentLevel()
+{
+    static int level = detectedLevel();
+    return level;
+}
+
+CPUKernels::SimdLevel CPUKernels::simdLevel()
+{
+    return SimdLevel(currentLevel());
+}
+
+void CPUKernels::setSimdLevel(SimdLevel level)
+{
+    const SimdLevel detected = detectedLevel();
+    if(level == slNEON && detected != slNEON)
+        return;
+    if(level > detected)
+        return;
+    currentLevel() = level;
+}
+
+const char* CPUKernels::simdName(SimdLevel level)
+{
+    switch(level)
+    {
+    case slSSE41:
+        return "SSE4.1";
+    case slAVX2:
+        return "AVX2";
+    case slNEON:
+        return "NEON";
+    default:
+        return "scalar";
+    }
+}
+
+void CPUKernels::sam(const unsigned short* src, const unsigned short* black, const float* gain,
+                     unsigned short* dst, int width, unsigned short maxVal)
+{
+    int x = 0;
+    switch(simdLevel())
+    {
+#ifdef CPU_KERNELS_X86
+    case slAVX2:
+        x = samAVX2(src, black, gain, dst, width, maxVal);
+        break;
+    case slSSE41:
+        x = samSSE41(src, black, gain, dst, width, maxVal);
+        break;
+#endif
+#ifdef CPU_KERNELS_NEON
+    case slNEON:
+        x = samNEON(src, black, gain, dst, width, maxVal);
+        break;
+#endif
+    default:
+        break;
+    }
+    samScalar(src, black, gain, dst, x, width, maxVal);
+}
+
+void CPUKernels::lut(const unsigned short* src, const unsigned short* lutEven, const unsigned short* lutOdd,
+                     int shift, unsigned short* dst, int width)
+{
+    //Table lookups do not vectorize, unroll by Bayer pair instead
+    int x = 0;
+    for(; x + 2 <= width; x += 2)
+    {
+        dst[x] = lutEven[src[x] >> shift];
+        dst[x + 1] = lutOdd[src[x + 1] >> shift];
+    }
+    if(x < width)
+        dst[x] = lutEven[src[x] >> shift];
+}
+
+void CPUKernels::lut(const unsigned char* src, const unsigned short* lutEven, const unsigned short* lutOdd,
+                     unsigned short* dst, int width)
+{
+    int x = 0;
+    for(; x + 2 <= width; x += 2)
+    {
+        dst[x] = lutEven[src[x]];
+        dst[x + 1] = lutOdd[src[x + 1]];
+    }
+    if(x < width)
+        dst[x] = lutEven[src[x]];
+}
+
+void CPUKernels::bpc(const unsigned short* up2, const unsigned short* cur, const unsigned short* down2,
+                     unsigned short* dst, int width)
+{
+    int x = 2;
+    switch(simdLevel())
+    {
+#ifdef CPU_KERNELS_X86
+    case slAVX2:
+        x = bpcAVX2(up2, cur, down2, dst, width);
+        break;
+    case slSSE41:
+        x = bpcSSE41(up2, cur, down2, dst, width);
+        break;
+#endif
+#ifdef CPU_KERNELS_NEON
+    case slNEON:
+        x = bpcNEON(up2, cur, down2, dst, width);
+        break;
+#endif
+    default:
+        break;
+    }
+    bpcScalar(up2, cur, down2, dst, 0, std::min(2, width), width);
+    bpcScalar(up2, cur, down2, dst, std::max(x, 2), width, width);
+}
+
+void CPUKernels::debayer(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                         bool xAtEven, unsigned short* dstX, unsigned short* dstG, unsigned short* dstY, int width)
+{
+    int x = 2;
+    switch(simdLevel())
+    {
+#ifdef CPU_KERNELS_X86
+    case slAVX2:
+        x = debayerAVX2(up, cur, down, xAtEven, dstX, dstG, dstY, width);
+        break;
+    case slSSE41:
+        x = debayerSSE41(up, cur, down, xAtEven, dstX, dstG, dstY, width);
+        break;
+#endif
+#ifdef CPU_KERNELS_NEON
+    case slNEON:
+        x = debayerNEON(up, cur, down, xAtEven, dstX, dstG, dstY, width);
+        break;
+#endif
+    default:
+        break;
+    }
+    debayerScalar(up, cur, down, xAtEven, dstX, dstG, dstY, 0, std::min(2, width), width);
+    debayerScalar(up, cur, down, xAtEven, dstX, dstG, dstY, std::max(x, 2), width, width);
+}
+
+void CPUKernels::denoise(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                         unsigned short threshold, unsigned short* dst, int width)
+{
+    int x = 1;
+    switch(simdLevel())
+    {
+#ifdef CPU_KERNELS_X86
+    case slAVX2:
+        x = denoiseAVX2(up, cur, down, threshold, dst, width);
+        break;
+    case slSSE41:
+        x = denoiseSSE41(up, cur, down, threshold, dst, width);
+        break;
+#endif
+#ifdef CPU_KERNELS_NEON
+    case slNEON:
+        x = denoiseNEON(up, cur, down, threshold, dst, width);
+        break;
+#endif
+    default:
+        break;
+    }
+    denoiseScalar(up, cur, down, threshold, dst, 0, std::min(1, width), width);
+    denoiseScalar(up, cur, down, threshold, dst, std::max(x, 1), width, width);
+}
+
+void CPUKernels::packRGB8(const unsigned short* r, const unsigned short* g, const unsigned short* b,
+                          const unsigned char* lut8, unsigned char* dst, int width)
+{
+    for(int x = 0; x < width; x++)
+    {
+        dst[0] = lut8[r[x] >> 2];
+        dst[1] = lut8[g[x] >> 2];
+        dst[2] = lut8[b[x] >> 2];
+        dst += 3;
+    }
+}
+
+void CPUKernels::packRGB16(const unsigned short* r, const unsigned short* g, const unsigned short* b,
+                           const unsigned short* lut16, unsigned short* dst, int width)
+{
+    for(int x = 0; x < width; x++)
+    {
+        dst[0] = lut16[r[x] >> 2];
+        dst[1] = lut16[g[x] >> 2];
+        dst[2] = lut16[b[x] >> 2];
+        dst += 3;
+    }
+}
+
+void CPUKernels::rgbToNV12(const unsigned char* rgb0, const unsigned char* rgb1,
+                           unsigned char* y0, unsigned char* y1, unsigned char* uv, int width)
+{
+    auto luma = [](int r, int g, int b)
+    {
+        return static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    };
+
+    for(int x = 0; x + 1 < width; x += 2)
+    {
+        const unsigned char* p0 = rgb0 + x * 3;
+        const unsigned char* p1 = rgb1 + x * 3;
+        y0[x] = luma(p0[0], p0[1], p0[2]);
+        y0[x + 1] = luma(p0[3], p0[4], p0[5]);
+        y1[x] = luma(p1[0], p1[1], p1[2]);
+        y1[x + 1] = luma(p1[3], p1[4], p1[5]);
+
+        int r = (p0[0] + p0[3] + p1[0] + p1[3] + 2) >> 2;
+        int g = (p0[1] + p0[4] + p1[1] + p1[4] + 2) >> 2;
+        int b = (p0[2] + p0[5] + p1[2] + p1[5] + 2) >> 2;
+        uv[x] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        uv[x + 1] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+}
+
+int CPUKernels::packedBytes(PackedLayout layout, int width)
+{
+    if(layout == plGenICam10p)
+        return (width * 5 + 3) / 4;
+    return (width * 3 + 1) / 2;
+}
+
+void CPUKernels::unpack(PackedLayout layout, const unsigned char* src, unsigned short* dst, int width)
+{
+    int x = 0;
+#if defined(CPU_KERNELS_X86) || defined(CPU_KERNELS_NEON)
+    const UnpackTable& table = unpackTable(layout);
+    const int bytes = packedBytes(layout, width);
+#endif
+    switch(simdLevel())
+    {
+#ifdef CPU_KERNELS_X86
+    case slAVX2:
+        x = unpackAVX2(table, src, dst, width, bytes);
+        break;
+    case slSSE41:
+        x = unpackSSE41(table, src, dst, width, bytes);
+        break;
+#endif
+#ifdef CPU_KERNELS_NEON
+    case slNEON:
+        x = unpackNEON(table, src, dst, width, bytes);
+        break;
+#endif
+    default:
+        break;
+    }
+    unpackScalar(layout, src, dst, x, width);
+}
+
+void CPUKernels::byteSwap16(const unsigned short* src, unsigned short* dst, int count)
+{
+    int x = 0;
+    switch(simdLevel())
+    {
+#ifdef CPU_KERNELS_X86
+    case slAVX2:
+        x = byteSwapAVX2(src, dst, count);
+        break;
+    case slSSE41:
+        x = byteSwapSSE41(src, dst, count);
+        break;
+#endif
+#ifdef CPU_KERNELS_NEON
+    case slNEON:
+        x = byteSwapNEON(src, dst, count);
+        break;
+#endif
+    default:
+        break;
+    }
+    byteSwapScalar(src, dst, x, count);
+}
@@ -0,0 +1,121 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef CPUKERNELS_H
+#define CPUKERNELS_H
+
+/// Row kernels of the CPU processing pipeline.
+/// Every kernel has a scalar implementation and SSE4.1/AVX2 (x86)
+/// or NEON (ARM) ones which give bit exact results.
+/// Implementation is selected at runtime by CPU features.
+class CPUKernels
+{
+public:
+    enum SimdLevel
+    {
+        slScalar = 0,
+        slSSE41,
+        slAVX2,
+        slNEON
+    };
+
+    /// Packed camera pixel layouts
+    enum PackedLayout
+    {
+        /// 12 bit: MSB bytes of two pixels, then byte with both LSB nibbles.
+        /// Same as FAST_RAW_XIMEA12 of Fastvideo SDK.
+        plXimea12 = 0,
+        /// 12 bit GigE Vision Mono12Packed/BayerXX12Packed:
+        /// MSB byte of first pixel, LSB nibbles, MSB byte of second pixel
+        plMono12Packed,
+        /// GenICam PFNC Mono12p/BayerXX12p: LSB first bit stream
+        plGenICam12p,
+        /// GenICam PFNC Mono10p/BayerXX10p: LSB first bit stream, four pixels in five bytes
+        plGenICam10p
+    };
+
+    /// Best level supported by both build and CPU
+    static SimdLevel detectedLevel();
+    /// Level kernels currently run with
+    static SimdLevel simdLevel();
+    /// Force lower level, for example to compare with scalar reference.
+    /// Level higher than detected one is ignored.
+    static void setSimdLevel(SimdLevel level);
+    static const char* simdName(SimdLevel level);
+
+    /// dst = (src - black) * gain clamped to [0, maxVal].
+    /// black and gain can be null.
+    static void sam(const unsigned short* src, const unsigned short* black, const float* gain,
+                    unsigned short* dst, int width, unsigned short maxVal);
+
+    /// dst[x] = lut[src[x] >> shift], even and odd pixels use their own table
+    static void lut(const unsigned short* src, const unsigned short* lutEven, const unsigned short* lutOdd,
+                    int shift, unsigned short* dst, int width);
+    static void lut(const unsigned char* src, const unsigned short* lutEven, const unsigned short* lutOdd,
+                    unsigned short* dst, int width);
+
+    /// Hot/dead pixel correction: pixel is clamped to the range of
+    /// four nearest pixels of the same color (two pixels apart)
+    static void bpc(const unsigned short* up2, const unsigned short* cur, const unsigned short* down2,
+                    unsigned short* dst, int width);
+
+    /// Bilinear debayer of one row to planar output.
+    /// Row contains color X (red or blue) and green, Y is the other of red and blue.
+    /// xAtEven tells if X is at even columns.
+    static void debayer(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                        bool xAtEven, unsigned short* dstX, unsigned short* dstG, unsigned short* dstY, int width);
+
+    /// Single level shrinkage denoise: 3x3 binomial blur plus detail
+    /// soft-thresholded by threshold
+    static void denoise(const unsigned short* up, const unsigned short* cur, const unsigned short* down,
+                        unsigned short threshold, unsigned short* dst, int width);
+
+    /// Interleave planes to 8 bit RGB through 14 bit indexed table
+    static void packRGB8(const unsigned short* r, const unsigned short* g, const unsigned short* b,
+                         const unsigned char* lut8, unsigned char* dst, int width);
+    /// Interleave planes to 16 bit RGB through 14 bit indexed table
+    static void packRGB16(const unsigned short* r, const unsigned short* g, const unsigned short* b,
+                          const unsigned short* lut16, unsigned short* dst, int width);
+
+    /// Two RGB rows to two luma rows and one interleaved chroma row (BT.601, video range)
+    static void rgbToNV12(const unsigned char* rgb0, const unsigned char* rgb1,
+                          unsigned char* y0, unsigned char* y1, unsigned char* uv, int width);
+
+    /// Bytes taken by row of width packed pixels
+    static int packedBytes(PackedLayout layout, int width);
+    /// Unpack row to 16 bit, values stay in low 12 (10) bits
+    static void unpack(PackedLayout layout, const unsigned char* src, unsigned short* dst, int width);
+
+    /// Swaps bytes of count 16 bit values, e.g. to big endian PGM. src and dst can be the same.
+    static void byteSwap16(const unsigned short* src, unsigned short* dst, int count);
+
+private:
+    static int& currentLevel();
+};
+
+#endif // CPUKERNELS_H
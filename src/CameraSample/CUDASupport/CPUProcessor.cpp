@@ -0,0 +1,716 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "CPUProcessor.h"
+#include "CPUKernels.h"
+#include "JpegEncoder.h"
+#include "Metrics.h"
+#include "SurfaceTraits.hpp"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QDebug>
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+enum
+{
+    cRed = 0,
+    cGreen,
+    cBlue
+};
+
+inline unsigned alignedWidth(unsigned width)
+{
+    return ( ( width + FAST_ALIGNMENT - 1 ) / FAST_ALIGNMENT ) * FAST_ALIGNMENT;
+}
+
+inline unsigned mirrorRow(int y, int height)
+{
+    if(y < 0)
+        return unsigned(-y);
+    if(y >= height)
+        return unsigned(2 * (height - 1) - y);
+    return unsigned(y);
+}
+
+template<class T>
+std::unique_ptr<T, ImageAllocator> allocatePlane(size_t bytesCount)
+{
+    return std::unique_ptr<T, ImageAllocator>(
+                static_cast<T*>(ImageAllocator::allocate(bytesCount, mbHost)),
+                ImageAllocator(mbHost));
+}
+
+inline float elapsedMs(const QElapsedTimer& timer)
+{
+    return float(timer.nsecsElapsed()) / 1000000.f;
+}
+}
+
+CPUProcessor::CPUProcessor(bool grayscale, QObject* parent) :
+    ProcessorBase(parent),
+    mGrayscale(grayscale)
+{
+    setThreadCount(0);
+    stats[QStringLiteral("totalMem")] = 0;
+    stats[QStringLiteral("freeMem")] = 0;
+}
+
+CPUProcessor::~CPUProcessor()
+{
+    freeFilters();
+    mInitialised = false;
+}
+
+void CPUProcessor::setThreadCount(int count)
+{
+    QMutexLocker lock(&mut);
+    mThreads = count > 0 ? count : qMax(1, QThread::idealThreadCount());
+}
+
+template<class F>
+void CPUProcessor::forStripes(int rows, F func)
+{
+    const int stripes = qMax(1, qMin(mStripes, rows));
+
+#pragma omp parallel for num_threads(stripes) schedule(static, 1)
+    for(int s = 0; s < stripes; s++)
+        func(s, rows * s / stripes, rows * (s + 1) / stripes);
+}
+
+fastStatus_t CPUProcessor::Init(CUDAProcessorOptions& options)
+{
+    if(mInitialised)
+    {
+        mInitialised = false;
+        freeFilters();
+    }
+
+    if(info)
+        qDebug("Initialising CPUProcessor...");
+
+    mut.lock();
+
+    mLastError = FAST_OK;
+    mErrString = QString();
+
+    stats[QStringLiteral("inputWidth")] = options.Width;
+    stats[QStringLiteral("inputHeight")] = options.Height;
+
+    if(options.MaxWidth < 2 || options.MaxHeight < 3)
+        return InitFailed("Unsupported image size", FAST_INVALID_SIZE);
+
+    mInputFmt = options.SurfaceFmt;
+    mBitsPerChannel = GetBitsPerChannelFromSurface(mInputFmt);
+    if(mBitsPerChannel < 8 || mBitsPerChannel > 16)
+        return InitFailed("Unsupported surface format", FAST_UNSUPPORTED_FORMAT);
+
+    //Same table sizes as FAST_LUT_xx_16 filters, 16 bit data is looked up by 14 MSB
+    mLutShift = qMax(0, mBitsPerChannel - 14);
+
+    mMaxWidth = options.MaxWidth;
+    mMaxHeight = options.MaxHeight;
+    BayerFormat = options.BayerFormat;
+
+    fastStatus_t ret = allocateBuffers();
+    if(ret != FAST_OK)
+        return InitFailed("Cannot allocate host memory", ret);
+
+    mLutGains[cRed] = mLutGains[cGreen] = mLutGains[cBlue] = -1.f;
+    mLinLut.lut.clear();
+
+    for(int i = 0; i < 16384; i++)
+        outLut.lut[i] = static_cast<unsigned short>(i * 4);
+    mOutLut8.resize(16384);
+
+    stats[QStringLiteral("allocatedMem")] = 0;
+    stats[QStringLiteral("threads")] = mStripes;
+    publishStats();
+
+    if(info)
+        qDebug("CPUProcessor uses %d threads, %s kernels", mStripes,
+               CPUKernels::simdName(CPUKernels::simdLevel()));
+
+    mInitOptions = options;
+
+    emit initialized(QString());
+    mInitialised = true;
+
+    mut.unlock();
+
+    return FAST_OK;
+}
+
+fastStatus_t CPUProcessor::allocateBuffers()
+{
+    const unsigned pitch = alignedWidth(mMaxWidth);
+    const size_t plane = size_t(pitch) * mMaxHeight * sizeof(unsigned short);
+    const int channels = mGrayscale ? 1 : 3;
+
+    mRawPitch = size_t(pitch) * (mBitsPerChannel > 8 ? 2 : 1);
+
+    try
+    {
+        mRaw = allocatePlane<unsigned char>(mRawPitch * mMaxHeight);
+        mBayer = allocatePlane<unsigned short>(plane);
+        mBpcBuffer = allocatePlane<unsigned short>(plane);
+        for(int c = 0; c < channels; c++)
+        {
+            if(!mGrayscale)
+                mPlanes[c] = allocatePlane<unsigned short>(plane);
+            mDenoised[c] = allocatePlane<unsigned short>(plane);
+        }
+        mScratch = allocatePlane<unsigned short>(size_t(pitch) * 2 * sizeof(unsigned short) * mThreads);
+        mRgb8 = allocatePlane<unsigned char>(size_t(mMaxWidth) * mMaxHeight * 3);
+    }
+    catch(std::bad_alloc&)
+    {
+        return FAST_INSUFFICIENT_HOST_MEMORY;
+    }
+
+    mStripes = mThreads;
+    return FAST_OK;
+}
+
+void CPUProcessor::freeFilters()
+{
+    if(info)
+        qDebug("CPUProcessor::freeFilters");
+
+    Close();
+
+    QMutexLocker lock(&mut);
+    mRaw.reset();
+    mBayer.reset();
+    mBpcBuffer.reset();
+    for(int c = 0; c < 3; c++)
+    {
+        mPlanes[c].reset();
+        mDenoised[c].reset();
+        mOutPlanes[c] = nullptr;
+    }
+    mScratch.reset();
+    mRgb8.reset();
+
+    mLastError = FAST_OK;
+}
+
+fastStatus_t CPUProcessor::Close()
+{
+    QMutexLocker locker(&mut);
+    return FAST_OK;
+}
+
+int CPUProcessor::cfaColor(unsigned x, unsigned y) const
+{
+    //Color of top left, top right, bottom left and bottom right pixels
+    static const int rggb[4] = {cRed, cGreen, cGreen, cBlue};
+    static const int bggr[4] = {cBlue, cGreen, cGreen, cRed};
+    static const int gbrg[4] = {cGreen, cBlue, cRed, cGreen};
+    static const int grbg[4] = {cGreen, cRed, cBlue, cGreen};
+
+    const int idx = int((y & 1) * 2 + (x & 1));
+    switch(BayerFormat)
+    {
+    case FAST_BAYER_BGGR:
+        return bggr[idx];
+    case FAST_BAYER_GBRG:
+        return gbrg[idx];
+    case FAST_BAYER_GRBG:
+        return grbg[idx];
+    default:
+        return rggb[idx];
+    }
+}
+
+void CPUProcessor::updateLuts(const CUDAProcessorOptions& opts)
+{
+    float gains[3] = {opts.Red * opts.eV, opts.Green * opts.eV, opts.Blue * opts.eV};
+    if(mGrayscale)
+        gains[cRed] = gains[cGreen] = gains[cBlue] = 1.f;
+
+    const bool linChanged = mLinLut.lut.isEmpty() ||
+            mLutBlack != opts.BlackLevel ||
+            mLutWhite != opts.WhiteLevel ||
+            mLutLinearization != opts.LinearizationLut;
+
+    if(linChanged)
+    {
+        mLutBlack = opts.BlackLevel;
+        mLutWhite = opts.WhiteLevel;
+        mLutLinearization = opts.LinearizationLut;
+
+        double scale = 1. / (double(mLutWhite - mLutBlack));
+        mLinLut.lut.fill(0, 1 << (mBitsPerChannel - mLutShift));
+        InitLut<HostLut>(mLinLut, mLutBlack, scale, mLutLinearization);
+    }
+
+    for(int c = 0; c < 3; c++)
+    {
+        if(!linChanged && gains[c] == mLutGains[c])
+            continue;
+
+        mLutGains[c] = gains[c];
+        HostLut& wb = mWbLut[c];
+        wb.lut.resize(mLinLut.lut.size());
+        for(int i = 0; i < wb.lut.size(); i++)
+            wb.lut[i] = static_cast<unsigned short>(qMin(65535.f, std::nearbyint(mLinLut.lut[i] * gains[c])));
+    }
+
+    for(int i = 0; i < 16384; i++)
+        mOutLut8[i] = static_cast<unsigned char>(outLut.lut[i] >> 8);
+}
+
+void CPUProcessor::linearizeRow(unsigned y, unsigned short* scratch, const unsigned short* lutEven,
+                                const unsigned short* lutOdd, unsigned short* dst)
+{
+    const int width = int(mWidth);
+    const unsigned char* raw = mRaw.get() + y * mRawPitch;
+    const size_t offset = size_t(y) * mWidth;
+    const float* gain = mSamGain ? mSamGain + offset : nullptr;
+
+    if(mBitsPerChannel <= 8)
+    {
+        if(!mSamApplied)
+        {
+            CPUKernels::lut(raw, lutEven, lutOdd, dst, width);
+            return;
+        }
+
+        //SAM works on 16 bit data, widen row and black shift first
+        unsigned short* black = nullptr;
+        for(int x = 0; x < width; x++)
+            scratch[x] = raw[x];
+        if(mSamBlack)
+        {
+            black = scratch + alignedWidth(mMaxWidth);
+            const unsigned char* b8 = static_cast<const unsigned char*>(mSamBlack) + offset;
+            for(int x = 0; x < width; x++)
+                black[x] = b8[x];
+        }
+        CPUKernels::sam(scratch, black, gain, scratch, width, 255);
+        CPUKernels::lut(scratch, lutEven, lutOdd, 0, dst, width);
+        return;
+    }
+
+    const unsigned short* src = reinterpret_cast<const unsigned short*>(raw);
+    if(mSamApplied)
+    {
+        const unsigned short* black = mSamBlack ? static_cast<const unsigned short*>(mSamBlack) + offset : nullptr;
+        CPUKernels::sam(src, black, gain, scratch, width,
+                        static_cast<unsigned short>((1u << mBitsPerChannel) - 1));
+        src = scratch;
+    }
+    CPUKernels::lut(src, lutEven, lutOdd, mLutShift, dst, width);
+}
+
+fastStatus_t CPUProcessor::Transform(ImageT* image, CUDAProcessorOptions& opts, const FrameMetadata& meta)
+{
+    QMutexLocker locker(&mut);
+    if(image == nullptr)
+    {
+        mLastError = FAST_INVALID_VALUE;
+        mErrString = QStringLiteral("Got null pointer data");
+        return mLastError;
+    }
+
+    float fullTime = 0.;
+
+    if(!mInitialised)
+        return mLastError;
+
+    mErrString = QString();
+    mLastError = FAST_OK;
+
+    if(image->backend() != mbHost)
+        return TransformFailed("Image is not in host memory", FAST_INVALID_VALUE);
+
+    const unsigned imgWidth  = image->w;
+    const unsigned imgHeight = image->h;
+
+    if(imgWidth > mMaxWidth || imgHeight > mMaxHeight || imgWidth < 2 || imgHeight < 3)
+        return TransformFailed("Unsupported image size", FAST_INVALID_FORMAT);
+
+    if(image->surfaceFmt != mInputFmt)
+        return TransformFailed("Unsupported surface format", FAST_UNSUPPORTED_FORMAT);
+
+    Metrics::nextFrame();
+
+    mWidth = imgWidth;
+    mHeight = imgHeight;
+    BayerFormat = opts.BayerFormat;
+
+    QElapsedTimer cpuTimer;
+    cpuTimer.start();
+    QElapsedTimer stageTimer;
+
+    //Import, packed data has XIMEA layout as for GPU unpacker
+    stageTimer.start();
+    {
+        const unsigned char* src = image->data.get();
+        const bool packed = opts.Packed && mBitsPerChannel > 8;
+        const size_t srcPitch = packed ? size_t(CPUKernels::packedBytes(CPUKernels::plXimea12, int(imgWidth))) : image->wPitch;
+        const size_t rowBytes = size_t(imgWidth) * (mBitsPerChannel > 8 ? 2 : 1);
+        forStripes(int(imgHeight), [&](int, int begin, int end)
+        {
+            for(int y = begin; y < end; y++)
+            {
+                const unsigned char* in = src + y * srcPitch;
+                unsigned char* out = mRaw.get() + y * mRawPitch;
+                if(packed)
+                    CPUKernels::unpack(CPUKernels::plXimea12, in, reinterpret_cast<unsigned short*>(out), int(imgWidth));
+                else
+                    memcpy(out, in, rowBytes);
+            }
+        });
+    }
+    if(info)
+    {
+        float ms = elapsedMs(stageTimer);
+        fullTime += ms;
+        Metrics::record(opts.Packed ? Metrics::mtRawUnpacker : Metrics::mtHostToDevice, ms);
+    }
+
+    //SAM, linearization and white balance in one pass
+    stageTimer.restart();
+    updateLuts(opts);
+    mSamApplied = opts.EnableSAM && (opts.MatrixA != nullptr || opts.MatrixB != nullptr);
+    mSamGain = opts.MatrixA;
+    mSamBlack = opts.MatrixB;
+    forStripes(int(imgHeight), [&](int stripe, int begin, int end)
+    {
+        unsigned short* scratch = mScratch.get() + size_t(stripe) * alignedWidth(mMaxWidth) * 2;
+        for(int y = begin; y < end; y++)
+        {
+            const unsigned short* lutEven = mWbLut[cfaColor(0, unsigned(y))].lut.constData();
+            const unsigned short* lutOdd = mWbLut[cfaColor(1, unsigned(y))].lut.constData();
+            linearizeRow(unsigned(y), scratch, lutEven, lutOdd, mBayer.get() + size_t(y) * imgWidth);
+        }
+    });
+    if(info)
+    {
+        float ms = elapsedMs(stageTimer);
+        fullTime += ms;
+        Metrics::record(Metrics::mtLinearizationLut, ms);
+    }
+
+    const unsigned short* bayer = mBayer.get();
+
+    //BPC
+    if(opts.EnableBPC)
+    {
+        stageTimer.restart();
+        forStripes(int(imgHeight), [&](int, int begin, int end)
+        {
+            for(int y = begin; y < end; y++)
+            {
+                CPUKernels::bpc(bayer + mirrorRow(y - 2, int(imgHeight)) * imgWidth,
+                                bayer + size_t(y) * imgWidth,
+                                bayer + mirrorRow(y + 2, int(imgHeight)) * imgWidth,
+                                mBpcBuffer.get() + size_t(y) * imgWidth,
+                                int(imgWidth));
+            }
+        });
+        bayer = mBpcBuffer.get();
+        if(info)
+        {
+            float ms = elapsedMs(stageTimer);
+            fullTime += ms;
+            Metrics::record(Metrics::mtBpc, ms);
+        }
+    }
+
+    //Debayer
+    const unsigned short* planes[3] = {bayer, bayer, bayer};
+    if(!mGrayscale)
+    {
+        stageTimer.restart();
+        forStripes(int(imgHeight), [&](int, int begin, int end)
+        {
+            for(int y = begin; y < end; y++)
+            {
+                const int c0 = cfaColor(0, unsigned(y));
+                const int c1 = cfaColor(1, unsigned(y));
+                const int colorX = c0 == cGreen ? c1 : c0;
+                const int colorY = cRed + cBlue - colorX;
+                const size_t offset = size_t(y) * imgWidth;
+                CPUKernels::debayer(bayer + mirrorRow(y - 1, int(imgHeight)) * imgWidth,
+                                    bayer + offset,
+                                    bayer + mirrorRow(y + 1, int(imgHeight)) * imgWidth,
+                                    c0 != cGreen,
+                                    mPlanes[colorX].get() + offset,
+                                    mPlanes[cGreen].get() + offset,
+                                    mPlanes[colorY].get() + offset,
+                                    int(imgWidth));
+            }
+        });
+        for(int c = 0; c < 3; c++)
+            planes[c] = mPlanes[c].get();
+
+        if(info)
+        {
+            float ms = elapsedMs(stageTimer);
+            fullTime += ms;
+            Metrics::record(Metrics::mtDebayer, ms);
+        }
+    }
+
+    //Denoise
+    if(opts.EnableDenoise)
+    {
+        stageTimer.restart();
+        const float threshold = opts.DenoiseParams.threshold[0] * opts.DenoiseParams.threshold_per_level[0] * 256.f;
+        const unsigned short t = static_cast<unsigned short>(qBound(0.f, threshold, 65535.f));
+        const int channels = mGrayscale ? 1 : 3;
+        forStripes(int(imgHeight), [&](int, int begin, int end)
+        {
+            for(int c = 0; c < channels; c++)
+            {
+                const unsigned short* src = planes[c];
+                for(int y = begin; y < end; y++)
+                {
+                    CPUKernels::denoise(src + mirrorRow(y - 1, int(imgHeight)) * imgWidth,
+                                        src + size_t(y) * imgWidth,
+                                        src + mirrorRow(y + 1, int(imgHeight)) * imgWidth,
+                                        t,
+                                        mDenoised[c].get() + size_t(y) * imgWidth,
+                                        int(imgWidth));
+                }
+            }
+        });
+        for(int c = 0; c < 3; c++)
+            planes[c] = mDenoised[mGrayscale ? 0 : c].get();
+
+        if(info)
+        {
+            float ms = elapsedMs(stageTimer);
+            fullTime += ms;
+            Metrics::record(Metrics::mtDenoise, ms);
+        }
+    }
+
+    //Output LUT and 16 to 8 bit conversion in one pass
+    stageTimer.restart();
+    forStripes(int(imgHeight), [&](int, int begin, int end)
+    {
+        for(int y = begin; y < end; y++)
+        {
+            const size_t offset = size_t(y) * imgWidth;
+            CPUKernels::packRGB8(planes[cRed] + offset, planes[cGreen] + offset, planes[cBlue] + offset,
+                                 mOutLut8.constData(), mRgb8.get() + offset * 3, int(imgWidth));
+        }
+    });
+    for(int c = 0; c < 3; c++)
+        mOutPlanes[c] = planes[c];
+
+    if(info)
+    {
+        float ms = elapsedMs(stageTimer);
+        fullTime += ms;
+        Metrics::record(Metrics::mtOutLut, ms);
+
+        Metrics::record(Metrics::mtTotalGPUCPU, elapsedMs(cpuTimer));
+        Metrics::record(Metrics::mtTotalGPU, fullTime);
+    }
+
+    mLastMeta = meta;
+    if(meta.hostTimestamp > 0)
+        Metrics::record(Metrics::mtLatency, float(FrameMetadata::now() - meta.hostTimestamp) / 1000000.f);
+
+    locker.unlock();
+    emit finished();
+    return FAST_OK;
+}
+
+void* CPUProcessor::GetFrameBuffer()
+{
+    if(!mInitialised)
+        return nullptr;
+    else
+        return mRgb8.get();
+}
+
+fastStatus_t CPUProcessor::export8bitData(void* dstPtr, bool forceRGB)
+{
+    Q_UNUSED(forceRGB)
+
+    if(!mInitialised || mOutPlanes[0] == nullptr)
+        return FAST_INVALID_HANDLE;
+
+    const size_t rowBytes = size_t(mWidth) * 3;
+    const size_t pitch = 3 * alignedWidth(mWidth) * sizeof(unsigned char);
+    unsigned char* dst = static_cast<unsigned char*>(dstPtr);
+    for(unsigned y = 0; y < mHeight; y++)
+        memcpy(dst + y * pitch, mRgb8.get() + y * rowBytes, rowBytes);
+
+    return FAST_OK;
+}
+
+fastStatus_t CPUProcessor::exportJPEGData(void* dstPtr, unsigned jpegQuality, unsigned& size)
+{
+    if(!mInitialised || mOutPlanes[0] == nullptr)
+    {
+        size = 0;
+        return FAST_INVALID_HANDLE;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    jpeg_encoder_pool::lease encoder(jpeg_encoder_pool::instance());
+
+    //Stream goes to the destination directly, size is its capacity
+    if(!encoder->encode(mRgb8.get(), int(mWidth), int(mHeight), 3, static_cast<uchar*>(dstPtr), size, int(jpegQuality)))
+    {
+        size = 0;
+        return TransformFailed("JPEG encoding failed", FAST_INSUFFICIENT_HOST_MEMORY);
+    }
+
+    if(info)
+        Metrics::record(Metrics::mtMjpegEncoder, elapsedMs(timer));
+
+    return FAST_OK;
+}
+
+fastStatus_t CPUProcessor::exportNV12Data(void* dstPtr)
+{
+    if(!mInitialised || mOutPlanes[0] == nullptr)
+        return FAST_INVALID_HANDLE;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const unsigned width = mWidth;
+    const unsigned char* rgb = mRgb8.get();
+    unsigned char* luma = static_cast<unsigned char*>(dstPtr);
+    unsigned char* chroma = luma + size_t(width) * mHeight;
+
+    forStripes(int(mHeight / 2), [&](int, int begin, int end)
+    {
+        for(int i = begin; i < end; i++)
+        {
+            const size_t y = size_t(i) * 2;
+            CPUKernels::rgbToNV12(rgb + y * width * 3, rgb + (y + 1) * width * 3,
+                                  luma + y * width, luma + (y + 1) * width,
+                                  chroma + size_t(i) * width, int(width));
+        }
+    });
+
+    if(info)
+        Metrics::record(Metrics::mtExportToHost, elapsedMs(timer));
+
+    return FAST_OK;
+}
+
+fastStatus_t CPUProcessor::exportRawData(void* dstPtr, unsigned int& w, unsigned int& h, unsigned int& pitch)
+{
+    const unsigned bpc = mBitsPerChannel > 8 ? 2 : 1;
+
+    w = mWidth;
+    h = mHeight;
+    pitch = alignedWidth(mWidth) * bpc;
+
+    if(dstPtr == nullptr)
+        return FAST_OK;
+
+    if(!mInitialised)
+        return FAST_INVALID_HANDLE;
+
+    unsigned char* dst = static_cast<unsigned char*>(dstPtr);
+    for(unsigned y = 0; y < h; y++)
+        memcpy(dst + y * pitch, mRaw.get() + y * mRawPitch, w * bpc);
+
+    return FAST_OK;
+}
+
+fastStatus_t CPUProcessor::exportLinearizedRaw(void* dstPtr, unsigned int& w, unsigned int& h, unsigned int& pitch)
+{
+    w = mWidth;
+    h = mHeight;
+    pitch = alignedWidth(mWidth) * sizeof(unsigned short);
+
+    if(dstPtr == nullptr)
+        return FAST_OK;
+
+    if(!mInitialised || mLinLut.lut.isEmpty())
+        return FAST_INVALID_HANDLE;
+
+    //Linearized data is not kept, run SAM and LUT again without white balance
+    const unsigned short* lut = mLinLut.lut.constData();
+    unsigned char* dst = static_cast<unsigned char*>(dstPtr);
+    forStripes(int(h), [&](int stripe, int begin, int end)
+    {
+        unsigned short* scratch = mScratch.get() + size_t(stripe) * alignedWidth(mMaxWidth) * 2;
+        for(int y = begin; y < end; y++)
+            linearizeRow(unsigned(y), scratch, lut, lut, reinterpret_cast<unsigned short*>(dst + y * pitch));
+    });
+
+    return FAST_OK;
+}
+
+fastStatus_t CPUProcessor::export16bitData(void* dstPtr, unsigned int& w, unsigned int& h, unsigned int& pitch)
+{
+    w = mWidth;
+    h = mHeight;
+
+    unsigned int nPitch = alignedWidth(mWidth) * sizeof(unsigned short);
+    if(!isGrayscale())
+        nPitch *= 3;
+
+    pitch = nPitch;
+
+    if(dstPtr == nullptr)
+        return FAST_OK;
+
+    if(!mInitialised || mOutPlanes[0] == nullptr)
+        return FAST_INVALID_HANDLE;
+
+    unsigned char* dst = static_cast<unsigned char*>(dstPtr);
+    forStripes(int(h), [&](int, int begin, int end)
+    {
+        for(int y = begin; y < end; y++)
+        {
+            const size_t offset = size_t(y) * w;
+            unsigned short* row = reinterpret_cast<unsigned short*>(dst + y * pitch);
+            if(mGrayscale)
+            {
+                for(unsigned x = 0; x < w; x++)
+                    row[x] = outLut.lut[mOutPlanes[0][offset + x] >> 2];
+                continue;
+            }
+            CPUKernels::packRGB16(mOutPlanes[cRed] + offset, mOutPlanes[cGreen] + offset, mOutPlanes[cBlue] + offset,
+                                  outLut.lut, row, int(w));
+        }
+    });
+
+    return FAST_OK;
+}
@@ -0,0 +1,136 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef CPUPROCESSOR_H
+#define CPUPROCESSOR_H
+
+#include "ProcessorBase.h"
+#include "MemoryBackend.h"
+
+/// Processor working on host memory, no CUDA device needed.
+/// Runs the same stage chain as CUDAProcessorBase: import/unpack, SAM,
+/// linearization LUT, white balance, BPC, debayer, denoise, output LUT
+/// and 16 to 8 bit conversion. Each stage is split into horizontal stripes
+/// processed in parallel, rows are processed with SIMD kernels (CPUKernels).
+/// SAM, LUTs, white balance and bit depth conversion follow GPU formulas
+/// and can be used as a reference for GPU output.
+/// BPC, debayer (bilinear) and denoise (one level shrinkage) are simplified
+/// versions of Fastvideo SDK filters.
+class CPUProcessor : public ProcessorBase
+{
+public:
+    explicit CPUProcessor(bool grayscale = false, QObject* parent = nullptr);
+    ~CPUProcessor() override;
+
+    fastStatus_t Init(CUDAProcessorOptions& options) override;
+    fastStatus_t Transform(ImageT* image, CUDAProcessorOptions& opts, const FrameMetadata& meta) override;
+    fastStatus_t Close() override;
+    void         freeFilters() override;
+
+    fastStatus_t export8bitData(void* dstPtr, bool forceRGB = true) override;
+    fastStatus_t exportJPEGData(void* dstPtr, unsigned jpegQuality, unsigned& size) override;
+    fastStatus_t exportNV12Data(void* dstPtr) override;
+    fastStatus_t exportRawData(void* dstPtr, unsigned int& w, unsigned int& h, unsigned int& pitch) override;
+    fastStatus_t export16bitData(void* dstPtr, unsigned int& w, unsigned int& h, unsigned int& pitch) override;
+    fastStatus_t exportLinearizedRaw(void* dstPtr, unsigned int& w, unsigned int& h, unsigned int& pitch) override;
+
+    void*         GetFrameBuffer() override;
+    MemoryBackend backend() const override {return mbHost;}
+    bool          isGrayscale() override {return mGrayscale;}
+
+    /// Number of stripes processed in parallel, 0 means one per CPU core.
+    /// Takes effect on next Init.
+    void setThreadCount(int count);
+    int  threadCount() const {return mThreads;}
+
+protected:
+    //Debayer and denoise have no static state, only buffers depend on options
+    int backEndChanges() const override {return CUDAProcessorOptions::ocNone;}
+
+private:
+    typedef std::unique_ptr<unsigned short, ImageAllocator> Plane16;
+    typedef std::unique_ptr<unsigned char, ImageAllocator>  Plane8;
+
+    struct HostLut
+    {
+        QVector<unsigned short> lut;
+    };
+
+    bool     mGrayscale = false;
+    int      mThreads = 1;
+    //Stripe count buffers are allocated for
+    int      mStripes = 1;
+
+    unsigned mMaxWidth = 0;
+    unsigned mMaxHeight = 0;
+    unsigned mWidth = 0;
+    unsigned mHeight = 0;
+
+    fastSurfaceFormat_t mInputFmt = FAST_I16;
+    int      mBitsPerChannel = 16;
+    int      mLutShift = 0;
+    bool     mSamApplied = false;
+    const float* mSamGain = nullptr;
+    const void*  mSamBlack = nullptr;
+
+    //Unpacked input, 8 or 16 bits per pixel
+    Plane8   mRaw;
+    size_t   mRawPitch = 0;
+    //Linearized and white balanced Bayer image
+    Plane16  mBayer;
+    Plane16  mBpcBuffer;
+    //Debayered planes and denoised planes
+    Plane16  mPlanes[3];
+    Plane16  mDenoised[3];
+    //Per stripe rows for SAM
+    Plane16  mScratch;
+    //Display image, tightly packed RGB
+    Plane8   mRgb8;
+    //Planes of the last transformed frame
+    const unsigned short* mOutPlanes[3] = {};
+
+    //Linearization LUT and white balanced LUTs for R, G, B
+    HostLut  mLinLut;
+    HostLut  mWbLut[3];
+    unsigned short mLutBlack = 0;
+    unsigned short mLutWhite = 0;
+    QVector<unsigned short> mLutLinearization;
+    float    mLutGains[3] = {-1.f, -1.f, -1.f};
+    QVector<unsigned char> mOutLut8;
+
+    template<class F>
+    void forStripes(int rows, F func);
+
+    fastStatus_t allocateBuffers();
+    void updateLuts(const CUDAProcessorOptions& opts);
+    int  cfaColor(unsigned x, unsigned y) const;
+    void linearizeRow(unsigned y, unsigned short* scratch, const unsigned short* lutEven,
+                      const unsigned short* lutOdd, unsigned short* dst);
+};
+
+#endif // CPUPROCESSOR_H
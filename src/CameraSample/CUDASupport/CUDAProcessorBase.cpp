@@ -29,6 +29,7 @@
 #include "CUDAProcessorBase.h"
 #include "FFCReader.h"
 #include "FPNReader.h"
+#include "Metrics.h"
 #include <QElapsedTimer>
 
 void dumpBufferInfo(fastDeviceSurfaceBufferHandle_t buffer, const QString & bufferName)
@@ -46,7 +47,7 @@ void dumpBufferInfo(fastDeviceSurfaceBufferHandle_t buffer, const QString & buff
 }
 
 CUDAProcessorBase::CUDAProcessorBase(QObject* parent) :
-    QObject(parent)
+    ProcessorBase(parent)
 {
     jfifInfo.h_Bytestream = nullptr;
     jfifInfo.exifSections = nullptr;
@@ -139,6 +140,34 @@ void CUDAProcessorBase::freeFilters()
     }
 
 
+    if(hDeviceToHostRawAdapter != nullptr)
+    {
+        fastExportToHostDestroy(hDeviceToHostRawAdapter);
+        hDeviceToHostRawAdapter = nullptr;
+        cudaMemoryInfo("Destroyed hDeviceToHostRawAdapter");
+    }
+
+    if(hDeviceToHostLinRawAdapter != nullptr)
+    {
+        fastExportToHostDestroy(hDeviceToHostLinRawAdapter);
+        hDeviceToHostLinRawAdapter = nullptr;
+        cudaMemoryInfo("Destroyed hDeviceToHostLinRawAdapter");
+    }
+
+    freeBackEnd();
+
+    mLastError = FAST_OK;
+
+    clearExifSections();
+
+    if(Globals::gEnableLog && mInitialised)
+    {
+        fastTraceClose();
+    }
+}
+
+void CUDAProcessorBase::freeBackEnd()
+{
     if( hDebayer != nullptr )
     {
         fastDebayerDestroy( hDebayer );
@@ -167,20 +196,6 @@ void CUDAProcessorBase::freeFilters()
         cudaMemoryInfo("Destroyed hDeviceToHost16Adapter");
     }
 
-    if(hDeviceToHostRawAdapter != nullptr)
-    {
-        fastExportToHostDestroy(hDeviceToHostRawAdapter);
-        hDeviceToHostRawAdapter = nullptr;
-        cudaMemoryInfo("Destroyed hDeviceToHostRawAdapter");
-    }
-
-    if(hDeviceToHostLinRawAdapter != nullptr)
-    {
-        fastExportToHostDestroy(hDeviceToHostLinRawAdapter);
-        hDeviceToHostLinRawAdapter = nullptr;
-        cudaMemoryInfo("Destroyed hDeviceToHostLinRawAdapter");
-    }
-
     if(hOutLut != nullptr)
     {
         fastImageFiltersDestroy(hOutLut);
@@ -209,8 +224,6 @@ void CUDAProcessorBase::freeFilters()
         hExportToDevice = nullptr;
     }
 
-    mLastError = FAST_OK;
-
     if(hJpegEncoder != nullptr)
     {
         fastJpegEncoderDestroy( hJpegEncoder );
@@ -225,8 +238,6 @@ void CUDAProcessorBase::freeFilters()
         qDebug("Destroyed jfifInfo.h_Bytestream");
     }
 
-    clearExifSections();
-
     if(hSdiExportToHost){
         fastSDIExportToHostDestroy(hSdiExportToHost);
         hSdiExportToHost = nullptr;
@@ -245,11 +256,6 @@ void CUDAProcessorBase::freeFilters()
         cudaFree( hGLBuffer );
         hGLBuffer  = nullptr;
     }
-
-    if(Globals::gEnableLog && mInitialised)
-    {
-        fastTraceClose();
-    }
 }
 
 fastStatus_t CUDAProcessorBase::Init(CUDAProcessorOptions &options)
@@ -291,8 +297,8 @@ fastStatus_t CUDAProcessorBase::Init(CUDAProcessorOptions &options)
         fastEnableInterfaceSynchronization(true);
     }
 
-    stats[QStringLiteral("inputWidth")] = -1;
-    stats[QStringLiteral("inputHeight")] = -1;
+    stats[QStringLiteral("inputWidth")] = options.Width;
+    stats[QStringLiteral("inputHeight")] = options.Height;
 
     fastSurfaceFormat_t srcSurfaceFmt  = options.SurfaceFmt;
 
@@ -352,11 +358,12 @@ fastStatus_t CUDAProcessorBase::Init(CUDAProcessorOptions &options)
     cudaMemoryInfo("Created hDeviceToHostRawAdapter");
 
     //SAM
+    prepareSamMatrices(options);
     if(options.SurfaceFmt == FAST_I8)
     {
         fastSam_t samParameter;
-        samParameter.correctionMatrix = options.MatrixA;
-        samParameter.blackShiftMatrix = (char*)options.MatrixB;
+        samParameter.correctionMatrix = mSamGain;
+        samParameter.blackShiftMatrix = (char*)mSamBlack;
         ret = fastImageFilterCreate(
                     &hSam,
 
@@ -373,8 +380,8 @@ fastStatus_t CUDAProcessorBase::Init(CUDAProcessorOptions &options)
     else
     {
         fastSam16_t samParameter;
-        samParameter.correctionMatrix = options.MatrixA;
-        samParameter.blackShiftMatrix = (short*)options.MatrixB;
+        samParameter.correctionMatrix = mSamGain;
+        samParameter.blackShiftMatrix = (short*)mSamBlack;
         ret = fastImageFilterCreate(
                     &hSam,
 
@@ -587,6 +594,99 @@ fastStatus_t CUDAProcessorBase::Init(CUDAProcessorOptions &options)
         return InitFailed("fastMuxCreate hBpcMux failed",ret);
     cudaMemoryInfo("Created hBpcMux");
 
+    for(int i = 0; i < 16384; i++)
+        outLut.lut[i] = static_cast<unsigned short>(i * 4);//rgbLut[0][i];
+
+    ret = createBackEnd(options);
+    if(ret != FAST_OK)
+        return ret;
+
+    updateMemoryStats();
+    publishStats();
+    mInitOptions = options;
+
+    emit initialized(QString());
+    mInitialised = true;
+
+    mut.unlock();
+
+    return FAST_OK;
+}
+
+fastStatus_t CUDAProcessorBase::applyChanges(int changes, CUDAProcessorOptions &options)
+{
+    //Filter gets the matrices by next Transform, a missing one is replaced by neutral
+    if(changes & CUDAProcessorOptions::ocSam)
+        prepareSamMatrices(options);
+
+    if(changes & CUDAProcessorOptions::ocJpeg)
+    {
+        jfifInfo.restartInterval = options.JpegRestartInterval;
+        if(!isGrayscale())
+            jfifInfo.jpegFmt = options.JpegSamplingFmt;
+    }
+
+    if(changes & backEndChanges())
+    {
+        if(info)
+            qDebug("Rebuilding stages from debayer on");
+
+        freeBackEnd();
+        fastStatus_t ret = createBackEnd(options);
+        if(ret != FAST_OK)
+            return ret;
+        updateMemoryStats();
+    }
+    return FAST_OK;
+}
+
+void CUDAProcessorBase::prepareSamMatrices(const CUDAProcessorOptions &options)
+{
+    const int count = int(options.MaxWidth * options.MaxHeight);
+
+    if(options.MatrixA != nullptr)
+    {
+        mSamUnitGain.clear();
+        mSamUnitGain.squeeze();
+        mSamGain = options.MatrixA;
+    }
+    else
+    {
+        if(mSamUnitGain.size() != count)
+            mSamUnitGain.fill(1.F, count);
+        mSamGain = mSamUnitGain.data();
+    }
+
+    if(options.MatrixB != nullptr)
+    {
+        mSamZeroBlack.clear();
+        mSamZeroBlack.squeeze();
+        mSamBlack = options.MatrixB;
+    }
+    else
+    {
+        //8 bit black shift is char, others are short
+        const int size = options.SurfaceFmt == FAST_I8 ? count : count * int(sizeof(short));
+        if(mSamZeroBlack.size() != size)
+            mSamZeroBlack.fill(0, size);
+        mSamBlack = mSamZeroBlack.data();
+    }
+
+    //Neutral matrices alone do not change the image
+    mSamActive = options.MatrixA != nullptr || options.MatrixB != nullptr;
+}
+
+fastStatus_t CUDAProcessorBase::createBackEnd(CUDAProcessorOptions& options)
+{
+    fastStatus_t ret;
+    FastAllocator alloc;
+
+    fastSurfaceFormat_t srcSurfaceFmt = FAST_I16;
+    unsigned int maxWidth = options.MaxWidth;
+    unsigned int maxHeight = options.MaxHeight;
+
+    fastDeviceSurfaceBufferHandle_t *bufferPtr = &bpcMuxBuffer;
+
     ret = fastDebayerCreate(
                 &hDebayer,
 
@@ -651,9 +751,7 @@ fastStatus_t CUDAProcessorBase::Init(CUDAProcessorOptions &options)
         }
     }
 
-    //Output LUT
-    for(int i = 0; i < 16384; i++)
-        outLut.lut[i] = static_cast<unsigned short>(i * 4);//rgbLut[0][i];
+    //Output LUT, table is kept when back end is rebuilt
     ret = fastImageFilterCreate(
                 &hOutLut,
 
@@ -810,6 +908,11 @@ fastStatus_t CUDAProcessorBase::Init(CUDAProcessorOptions &options)
         }
     }
 
+    return FAST_OK;
+}
+
+void CUDAProcessorBase::updateMemoryStats()
+{
     size_t  requestedMemSpace = 0;
     unsigned tmp = 0;
     if(hDebayer)
@@ -877,25 +980,6 @@ fastStatus_t CUDAProcessorBase::Init(CUDAProcessorOptions &options)
     stats[QStringLiteral("totalMem")] = totalMem;
     stats[QStringLiteral("freeMem")] = freeMem;
     stats[QStringLiteral("allocatedMem")] = requestedMemSpace;
-
-    emit initialized(QString());
-    mInitialised = true;
-
-    mut.unlock();
-
-    return FAST_OK;
-}
-
-fastStatus_t CUDAProcessorBase::InitFailed(const char *errStr, fastStatus_t ret)
-{
-    mErrString = errStr;
-    mLastError = ret;
-    mInitialised = false;
-
-    emit error();
-    mut.unlock();
-    freeFilters();
-    return ret;
 }
 
 fastSurfaceFormat_t CUDAProcessorBase::getInputSurfaceFmt()
@@ -918,7 +1002,7 @@ QSize CUDAProcessorBase::getMaxInputSize()
     return {int(bufferInfo.maxWidth),int(bufferInfo.maxHeight)};
 }
 
-fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &opts)
+fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &opts, const FrameMetadata& meta)
 {
     QMutexLocker locker(&mut);
     if(image == nullptr)
@@ -940,24 +1024,7 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
     if(info)
         fastGpuTimerCreate(&profileTimer);
 
-    stats[QStringLiteral("hHostToDeviceAdapter")] = -1;
-    stats[QStringLiteral("hRawUnpacker")] = -1;
-    stats[QStringLiteral("hSam")] = -1;
-    stats[QStringLiteral("hBpc")] = -1;
-    stats[QStringLiteral("hWhiteBalance")] = -1;
-    stats[QStringLiteral("hDebayer")] = -1;
-    stats[QStringLiteral("hDenoise")] = -1;
-
-    stats[QStringLiteral("hOutLut")] = -1;
-    stats[QStringLiteral("h16to8Transform")] = -1;
-    stats[QStringLiteral("hCrop")] = -1;
-    stats[QStringLiteral("hDeviceToHostAdapter")] = -1;
-    stats[QStringLiteral("hExportToDevice")] = -1;
-    stats[QStringLiteral("hMjpegEncoder")] = -1;
-    stats[QStringLiteral("totalTime")] = -1;
-    stats[QStringLiteral("totalFps")] = -1;
-    stats[QStringLiteral("totalGPUTime")] = -1;
-    stats[QStringLiteral("totalGPUCPUTime")] = -1;
+    Metrics::nextFrame();
 
     fastStatus_t ret = FAST_OK;
     unsigned imgWidth  = image->w;
@@ -966,18 +1033,15 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
     if(imgWidth > opts.MaxWidth || imgHeight > opts.MaxHeight )
         return TransformFailed("Unsupported image size",FAST_INVALID_FORMAT,profileTimer);
 
-    stats[QStringLiteral("inputWidth")] = imgWidth;
-    stats[QStringLiteral("inputHeight")] = imgHeight;
-
     QElapsedTimer cpuTimer;
     cpuTimer.start();
 
     if(info)
         fastGpuTimerStart(profileTimer);
-    QString key;
+    Metrics::Metric metric = Metrics::mtCount;
     if(hDeviceToDeviceAdapter != nullptr)
     {
-        key = QStringLiteral("hHostToDeviceAdapter");
+        metric = Metrics::mtHostToDevice;
         ret = fastImportFromDeviceCopy(
                     hDeviceToDeviceAdapter,
 
@@ -992,7 +1056,7 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
     }
     else if(hRawUnpacker != nullptr)
     {
-        key = QStringLiteral("hRawUnpacker");
+        metric = Metrics::mtRawUnpacker;
         ret = fastRawImportFromDeviceDecode(
                     hRawUnpacker,
 
@@ -1012,12 +1076,12 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
         fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
         fullTime += elapsedTimeGpu;
-        stats[key] = elapsedTimeGpu;
+        Metrics::record(metric, elapsedTimeGpu);
     }
 
     if(hSam && hSamMux)
     {
-        if(opts.EnableSAM)
+        if(opts.EnableSAM && mSamActive)
         {
             if(info)
             {
@@ -1026,9 +1090,10 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
 
             if(image->surfaceFmt == FAST_I8)
             {
+                //Null matrices keep ones the filter already has
                 fastSam_t samParameter;
-                samParameter.correctionMatrix = nullptr;
-                samParameter.blackShiftMatrix = nullptr;
+                samParameter.correctionMatrix = mSamChanged ? mSamGain : nullptr;
+                samParameter.blackShiftMatrix = mSamChanged ? static_cast<char*>(mSamBlack) : nullptr;
                 ret = fastImageFiltersTransform(
                             hSam,
                             &samParameter,
@@ -1039,8 +1104,8 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
             else
             {
                 fastSam16_t samParameter;
-                samParameter.correctionMatrix = nullptr;
-                samParameter.blackShiftMatrix = nullptr;
+                samParameter.correctionMatrix = mSamChanged ? mSamGain : nullptr;
+                samParameter.blackShiftMatrix = mSamChanged ? static_cast<short*>(mSamBlack) : nullptr;
                 ret = fastImageFiltersTransform(
                             hSam,
                             &samParameter,
@@ -1057,14 +1122,14 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
                 fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
                 fullTime += elapsedTimeGpu;
-                stats[QStringLiteral("hSAM")] = elapsedTimeGpu;
+                Metrics::record(Metrics::mtSam, elapsedTimeGpu);
             }
 
+            mSamChanged = false;
             fastMuxSelect(hSamMux, 1);
         }
         else
         {
-            stats[QStringLiteral("hSAM")] = -1;
             fastMuxSelect(hSamMux, 0);
         }
     }
@@ -1144,7 +1209,7 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerStop(profileTimer);
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
-            stats[QStringLiteral("hLinearizationLut")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mtLinearizationLut, elapsedTimeGpu);
             fullTime += elapsedTimeGpu;
         }
     }
@@ -1179,7 +1244,7 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerStop(profileTimer);
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
             fullTime += elapsedTimeGpu;
-            stats[QStringLiteral("hWhiteBalance")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mtWhiteBalance, elapsedTimeGpu);
         }
     }
 
@@ -1211,14 +1276,13 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
                 fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
                 fullTime += elapsedTimeGpu;
-                stats[QStringLiteral("hBpc")] = elapsedTimeGpu;
+                Metrics::record(Metrics::mtBpc, elapsedTimeGpu);
             }
 
             fastMuxSelect(hBpcMux, 1);
         }
         else
         {
-            stats[QStringLiteral("hBpc")] = -1;
             fastMuxSelect(hBpcMux, 0);
         }
     }
@@ -1246,7 +1310,7 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
         fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
         fullTime += elapsedTimeGpu;
-        stats[QStringLiteral("hDebayer")] = elapsedTimeGpu;
+        Metrics::record(Metrics::mtDebayer, elapsedTimeGpu);
     }
 
     if(ret != FAST_OK && info)
@@ -1280,12 +1344,11 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
                 fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
                 fullTime += elapsedTimeGpu;
-                stats[QStringLiteral("hDenoise")] = elapsedTimeGpu;
+                Metrics::record(Metrics::mtDenoise, elapsedTimeGpu);
             }
         }
         else
         {
-            stats[QStringLiteral("hDenoise")] = -1;
             fastMuxSelect(hDenoiseMux, 0);
         }
     }
@@ -1314,7 +1377,7 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
             fullTime += elapsedTimeGpu;
-            stats[QStringLiteral("hOutLut")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mtOutLut, elapsedTimeGpu);
         }
     }
 
@@ -1344,7 +1407,7 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
             fullTime += elapsedTimeGpu;
-            stats[QStringLiteral("h16to8Transform")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mt16to8Transform, elapsedTimeGpu);
         }
     }
 
@@ -1376,7 +1439,7 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
             fullTime += elapsedTimeGpu;
-            stats[QStringLiteral("hExportToDevice")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mtExportToDevice, elapsedTimeGpu);
         }
     }
 
@@ -1384,10 +1447,14 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
     {
         cudaDeviceSynchronize();
         float mcs = float(cpuTimer.nsecsElapsed()) / 1000000.f;
-        stats[QStringLiteral("totalGPUCPUTime")] = mcs;
-        stats[QStringLiteral("totalGPUTime")] = fullTime;
+        Metrics::record(Metrics::mtTotalGPUCPU, mcs);
+        Metrics::record(Metrics::mtTotalGPU, fullTime);
     }
 
+    mLastMeta = meta;
+    if(meta.hostTimestamp > 0)
+        Metrics::record(Metrics::mtLatency, float(FrameMetadata::now() - meta.hostTimestamp) / 1000000.f);
+
     if(profileTimer)
     {
         fastGpuTimerDestroy(profileTimer);
@@ -1401,15 +1468,12 @@ fastStatus_t CUDAProcessorBase::Transform(ImageT *image, CUDAProcessorOptions &o
 
 fastStatus_t CUDAProcessorBase::TransformFailed(const char *errStr, fastStatus_t ret, fastGpuTimerHandle_t profileTimer)
 {
-    mLastError = ret;
-    mErrString = errStr;
     if(profileTimer)
     {
         fastGpuTimerDestroy(profileTimer);
         profileTimer = nullptr;
     }
-    emit error();
-    return ret;
+    return ProcessorBase::TransformFailed(errStr, ret);
 }
 
 fastStatus_t CUDAProcessorBase::Close()
@@ -1422,6 +1486,7 @@ fastStatus_t CUDAProcessorBase::Close()
 
     stats[QStringLiteral("totalMem")] = totalMem;
     stats[QStringLiteral("freeMem")] = freeMem;
+    publishStats();
 
     return FAST_OK;
 }
@@ -1540,8 +1605,6 @@ fastStatus_t  CUDAProcessorBase::export16bitData(void* dstPtr, unsigned int &w,
 
 fastStatus_t CUDAProcessorBase::exportJPEGData(void* dstPtr, unsigned jpegQuality, unsigned& size)
 {
-    stats[QStringLiteral("hMjpegEncoder")] = -1;
-
     if(!mInitialised || hJpegEncoder == nullptr)
     {
         size = 0;
@@ -1571,21 +1634,24 @@ fastStatus_t CUDAProcessorBase::exportJPEGData(void* dstPtr, unsigned jpegQualit
                 &jfifInfo
                 );
     if(ret != FAST_OK)
+    {
+        size = 0;
         return TransformFailed("fastJpegEncode failed", ret, profileTimer);
+    }
 
+    //Size is the capacity of dstPtr, it is checked by the store
     ret = fastJfifStoreToMemory(reinterpret_cast<unsigned char*>(dstPtr), &size, &jfifInfo);
     if(ret != FAST_OK)
-        return TransformFailed("fastJpegEncode failed", ret, profileTimer);
+    {
+        size = 0;
+        return TransformFailed("fastJfifStoreToMemory failed", ret, profileTimer);
+    }
 
     if(info)
     {
         fastGpuTimerStop(profileTimer);
         fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
-        stats[QStringLiteral("hMjpegEncoder")] = elapsedTimeGpu;
-    }
-    else
-    {
-        stats[QStringLiteral("hMjpegEncoder")] = -1;
+        Metrics::record(Metrics::mtMjpegEncoder, elapsedTimeGpu);
     }
 
     if(profileTimer)
@@ -1630,11 +1696,7 @@ fastStatus_t CUDAProcessorBase::exportNV12Data(void *dstPtr)
     {
         fastGpuTimerStop(profileTimer);
         fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
-        stats[QStringLiteral("fastSDIExportToHostCopy")] = elapsedTimeGpu;
-    }
-    else
-    {
-        stats[QStringLiteral("fastSDIExportToHostCopy")] = -1;
+        Metrics::record(Metrics::mtExportToHost, elapsedTimeGpu);
     }
 
     if(profileTimer)
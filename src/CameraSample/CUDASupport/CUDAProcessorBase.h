@@ -29,7 +29,7 @@
 #ifndef CUDAPROCESSORBASE_H
 #define CUDAPROCESSORBASE_H
 
-#include "CUDAProcessorOptions.h"
+#include "ProcessorBase.h"
 #include <list>
 #include <memory>
 
@@ -52,8 +52,8 @@
 #include <QPair>
 #include <QThread>
 #include <QSharedMemory>
-#include <QApplication>
-#include <QDesktopWidget>
+#include <QCoreApplication>
+#include <QSize>
 #include <QDir>
 #include <QFileInfo>
 #include <QDateTime>
@@ -73,69 +73,61 @@
 #include <cuda.h>
 
 
-class CUDAProcessorBase : public QObject
+class CUDAProcessorBase : public ProcessorBase
 {
     Q_OBJECT
 public:
     CUDAProcessorBase(QObject* parent = nullptr);
     ~CUDAProcessorBase() override;
 
-    virtual fastStatus_t Init(CUDAProcessorOptions & options);
-    virtual fastStatus_t InitFailed(const char *errStr, fastStatus_t ret);
+    fastStatus_t Init(CUDAProcessorOptions & options) override;
 
-    virtual fastStatus_t Transform(ImageT *image, CUDAProcessorOptions& opts);
+    fastStatus_t Transform(ImageT *image, CUDAProcessorOptions& opts, const FrameMetadata& meta) override;
     virtual fastStatus_t TransformFailed(const char *errStr, fastStatus_t ret, fastGpuTimerHandle_t profileTimer);
 
-    virtual fastStatus_t Close();
-    virtual void         freeFilters();
+    fastStatus_t Close() override;
+    void         freeFilters() override;
 
-    virtual fastStatus_t export8bitData(void* dstPtr, bool forceRGB = true);
-    virtual fastStatus_t exportJPEGData(void* dstPtr, unsigned jpegQuality, unsigned &size);
-    virtual fastStatus_t exportNV12Data(void* dstPtr);
+    fastStatus_t export8bitData(void* dstPtr, bool forceRGB = true) override;
+    fastStatus_t exportJPEGData(void* dstPtr, unsigned jpegQuality, unsigned &size) override;
+    fastStatus_t exportNV12Data(void* dstPtr) override;
 
-    fastStatus_t exportRawData(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch);
-    fastStatus_t export16bitData(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch);
-    fastStatus_t exportLinearizedRaw(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch);
+    fastStatus_t exportRawData(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch) override;
+    fastStatus_t export16bitData(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch) override;
+    fastStatus_t exportLinearizedRaw(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch) override;
 
     fastSurfaceFormat_t getInputSurfaceFmt();
     QSize        getMaxInputSize();
     void cudaMemoryInfo(const char *str);
     void clearExifSections();
 
-    virtual void* GetFrameBuffer();
-
-    virtual bool isGrayscale(){return false;}
-    QString getLastErrorDescription(){ return mErrString; }
-    fastStatus_t getLastError(){ return mLastError; }
-    bool isInitialized(){return mInitialised;}
-    void setInfo(bool info)
-    {
-        QMutexLocker lock(&mut);
-        this->info = info;
-    }
+    void* GetFrameBuffer() override;
+    MemoryBackend backend() const override {return mbCUDA;}
 
     bool haveCUDAJpeg()
     {
         return (hJpegEncoder != nullptr);
     }
 
-
-    fastBayerPattern_t       BayerFormat;
-    QMutex                   mut;
-    QMap<QString, float>     stats;
     fastExportToHostHandle_t hBitmapExport = nullptr;
-    fastLut_16_t             outLut;
 
 protected:
-    bool         info = true;
+    ///Updates JPEG encoder parameters and rebuilds back end stages
+    fastStatus_t applyChanges(int changes, CUDAProcessorOptions& options) override;
+
+    ///Create stages from debayer to output adapters and JPEG encoder.
+    ///Called with mut locked, on error mut is unlocked by InitFailed.
+    fastStatus_t createBackEnd(CUDAProcessorOptions& options);
+    void         freeBackEnd();
+    void         updateMemoryStats();
+    ///Points SAM filter to matrices of options. Neutral matrices stand for missing ones,
+    ///so a matrix can be added or removed by Transform without creating the filter again
+    void         prepareSamMatrices(const CUDAProcessorOptions& options);
 
     static const int JPEG_HEADER_SIZE = 1024;
     static const int FRAME_TIME = 2;
 
     fastSurfaceFormat_t surfaceFmt {};
-    bool                mInitialised = false;
-    QString             mErrString;
-    fastStatus_t        mLastError {};
 
     fastImportFromDeviceHandle_t    hDeviceToDeviceAdapter = nullptr;
     fastDeviceSurfaceBufferHandle_t srcBuffer = nullptr;
@@ -146,6 +138,12 @@ protected:
     fastDeviceSurfaceBufferHandle_t samBuffer = nullptr;
     fastMuxHandle_t                 hSamMux = nullptr;
     fastDeviceSurfaceBufferHandle_t samMuxBuffer = nullptr;
+    //Neutral SAM matrices, kept only while options miss a matrix
+    QVector<float>                  mSamUnitGain;
+    QVector<unsigned char>          mSamZeroBlack;
+    float*                          mSamGain = nullptr;
+    void*                           mSamBlack = nullptr;
+    bool                            mSamActive = false;
 
     fastImageFiltersHandle_t        hBpc = nullptr;
     fastDeviceSurfaceBufferHandle_t bpcBuffer = nullptr;
@@ -195,44 +193,7 @@ protected:
     //OpenGL stuff
     void*                      hGLBuffer = nullptr;
     fastExportToDeviceHandle_t hExportToDevice = nullptr;
-
-    template<typename T>
-    void InitLut(T & param, unsigned short blackLevel, double scale, const QVector<unsigned short> & linearizationLut = QVector<unsigned short>());
-
-signals:
-    void initialized(const QString& info);
-    void finished();
-    void error();
-protected:
-
 };
-template<typename T>
-void CUDAProcessorBase::InitLut(T & param, unsigned short blackLevel, double scale, const QVector<unsigned short> & linearizationLut)
-{
-    if(linearizationLut.empty())
-    {
-        int i = 0;
-        for(auto& l : param.lut)
-        {
-            l = static_cast<unsigned short>(qBound<double>(0, (i - blackLevel)  * scale, 1) * 65535);
-            i++;
-        }
-    }
-    else
-    {
-        auto itr = linearizationLut.begin();
-        for(auto & l : param.lut)
-        {
-            if( itr != linearizationLut.end() )
-            {
-                l = static_cast<unsigned short>(qBound<double>(0, (*itr - blackLevel)  * scale, 1) * 65535);
-                ++itr;
-                continue;
-            }
-            break;
-        }
-    }
-}
 
 Q_DECLARE_TYPEINFO(fastJpegExifSection_t, Q_COMPLEX_TYPE);
 
@@ -27,6 +27,7 @@
 */
 
 #include "CUDAProcessorGray.h"
+#include "Metrics.h"
 
 #ifdef STATIC_BUILD
 extern "C"  fastStatus_t fastEnableWatermark(bool isEnabled);
@@ -102,8 +103,8 @@ fastStatus_t CUDAProcessorGray::Init(CUDAProcessorOptions &options)
         fastEnableInterfaceSynchronization(true);
     }
 
-    stats[QStringLiteral("inputWidth")] = -1;
-    stats[QStringLiteral("inputHeight")] = -1;
+    stats[QStringLiteral("inputWidth")] = options.Width;
+    stats[QStringLiteral("inputHeight")] = options.Height;
 
     fastSurfaceFormat_t srcSurfaceFmt  = options.SurfaceFmt;
 
@@ -163,11 +164,12 @@ fastStatus_t CUDAProcessorGray::Init(CUDAProcessorOptions &options)
     cudaMemoryInfo("Created hDeviceToHostRawAdapter");
 
     //SAM
+    prepareSamMatrices(options);
     if(options.SurfaceFmt == FAST_I8)
     {
         fastSam_t samParameter;
-        samParameter.correctionMatrix = options.MatrixA;
-        samParameter.blackShiftMatrix = (char*)options.MatrixB;
+        samParameter.correctionMatrix = mSamGain;
+        samParameter.blackShiftMatrix = (char*)mSamBlack;
         ret = fastImageFilterCreate(
                &hSam,
 
@@ -184,8 +186,8 @@ fastStatus_t CUDAProcessorGray::Init(CUDAProcessorOptions &options)
     else
     {
         fastSam16_t samParameter;
-        samParameter.correctionMatrix = options.MatrixA;
-        samParameter.blackShiftMatrix = (short*)options.MatrixB;
+        samParameter.correctionMatrix = mSamGain;
+        samParameter.blackShiftMatrix = (short*)mSamBlack;
         ret = fastImageFilterCreate(
                &hSam,
 
@@ -637,6 +639,8 @@ fastStatus_t CUDAProcessorGray::Init(CUDAProcessorOptions &options)
     stats[QStringLiteral("totalMem")] = totalMem;
     stats[QStringLiteral("freeMem")] = freeMem;
     stats[QStringLiteral("allocatedMem")] = requestedMemSpace;
+    publishStats();
+    mInitOptions = options;
 
     emit initialized(QString());
     mInitialised = true;
@@ -646,7 +650,7 @@ fastStatus_t CUDAProcessorGray::Init(CUDAProcessorOptions &options)
     return FAST_OK;
 }
 
-fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &opts)
+fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &opts, const FrameMetadata& meta)
 {
     QMutexLocker locker(&mut);
 
@@ -672,24 +676,7 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
     if(info)
         fastGpuTimerCreate(&profileTimer);
 
-    stats[QStringLiteral("hHostToDeviceAdapter")] = -1;
-    stats[QStringLiteral("hRawUnpacker")] = -1;
-    stats[QStringLiteral("hSam")] = -1;
-    stats[QStringLiteral("hBpc")] = -1;
-    stats[QStringLiteral("hWhiteBalance")] = -1;
-    stats[QStringLiteral("hDebayer")] = -1;
-    stats[QStringLiteral("hDenoise")] = -1;
-
-    stats[QStringLiteral("hOutLut")] = -1;
-    stats[QStringLiteral("h16to8Transform")] = -1;
-    stats[QStringLiteral("hCrop")] = -1;
-    stats[QStringLiteral("hDeviceToHostAdapter")] = -1;
-    stats[QStringLiteral("hExportToDevice")] = -1;
-    stats[QStringLiteral("hMjpegEncoder")] = -1;
-    stats[QStringLiteral("totalTime")] = -1;
-    stats[QStringLiteral("totalFps")] = -1;
-    stats[QStringLiteral("totalGPUTime")] = -1;
-    stats[QStringLiteral("totalGPUCPUTime")] = -1;
+    Metrics::nextFrame();
 
     fastStatus_t ret = FAST_OK;
     unsigned imgWidth  = image->w;
@@ -698,15 +685,12 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
     if(imgWidth > opts.MaxWidth || imgHeight > opts.MaxHeight )
         return TransformFailed("Unsupported image size",FAST_INVALID_FORMAT,profileTimer);
 
-    stats[QStringLiteral("inputWidth")] = imgWidth;
-    stats[QStringLiteral("inputHeight")] = imgHeight;
-
     if(info)
         fastGpuTimerStart(profileTimer);
-    QString key;
+    Metrics::Metric metric = Metrics::mtCount;
     if(hDeviceToDeviceAdapter != nullptr)
     {
-        key = QStringLiteral("hHostToDeviceAdapter");
+        metric = Metrics::mtHostToDevice;
         ret = fastImportFromDeviceCopy(
                     hDeviceToDeviceAdapter,
 
@@ -721,7 +705,7 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
     }
     else if(hRawUnpacker != nullptr)
     {
-        key = QStringLiteral("hRawUnpacker");
+        metric = Metrics::mtRawUnpacker;
         ret = fastRawImportFromDeviceDecode(
                     hRawUnpacker,
 
@@ -741,12 +725,12 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
         fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
         fullTime += elapsedTimeGpu;
-        stats[key] = elapsedTimeGpu;
+        Metrics::record(metric, elapsedTimeGpu);
     }
 
     if(hSam && hSamMux)
     {
-        if(opts.EnableSAM)
+        if(opts.EnableSAM && mSamActive)
         {
             if(info)
             {
@@ -755,9 +739,10 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
 
             if(image->surfaceFmt == FAST_I8)
             {
+                //Null matrices keep ones the filter already has
                 fastSam_t samParameter;
-                samParameter.correctionMatrix = nullptr;
-                samParameter.blackShiftMatrix = nullptr;
+                samParameter.correctionMatrix = mSamChanged ? mSamGain : nullptr;
+                samParameter.blackShiftMatrix = mSamChanged ? static_cast<char*>(mSamBlack) : nullptr;
                 ret = fastImageFiltersTransform(
                            hSam,
                            &samParameter,
@@ -768,8 +753,8 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
             else
             {
                 fastSam16_t samParameter;
-                samParameter.correctionMatrix = nullptr;
-                samParameter.blackShiftMatrix = nullptr;
+                samParameter.correctionMatrix = mSamChanged ? mSamGain : nullptr;
+                samParameter.blackShiftMatrix = mSamChanged ? static_cast<short*>(mSamBlack) : nullptr;
                 ret = fastImageFiltersTransform(
                            hSam,
                            &samParameter,
@@ -786,14 +771,14 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
                 fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
                 fullTime += elapsedTimeGpu;
-                stats[QStringLiteral("hSAM")] = elapsedTimeGpu;
+                Metrics::record(Metrics::mtSam, elapsedTimeGpu);
             }
 
+            mSamChanged = false;
             fastMuxSelect(hSamMux, 1);
         }
         else
         {
-            stats[QStringLiteral("hSAM")] = -1;
             fastMuxSelect(hSamMux, 0);
         }
     }
@@ -873,7 +858,7 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerStop(profileTimer);
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
-            stats[QStringLiteral("hLinearizationLut")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mtLinearizationLut, elapsedTimeGpu);
             fullTime += elapsedTimeGpu;
         }
     }
@@ -906,14 +891,13 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
                 fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
                 fullTime += elapsedTimeGpu;
-                stats[QStringLiteral("hBpc")] = elapsedTimeGpu;
+                Metrics::record(Metrics::mtBpc, elapsedTimeGpu);
             }
 
             fastMuxSelect(hBpcMux, 1);
         }
         else
         {
-            stats[QStringLiteral("hBpc")] = -1;
             fastMuxSelect(hBpcMux, 0);
         }
     }
@@ -947,12 +931,11 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
                 fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
                 fullTime += elapsedTimeGpu;
-                stats[QStringLiteral("hDenoise")] = elapsedTimeGpu;
+                Metrics::record(Metrics::mtDenoise, elapsedTimeGpu);
             }
         }
         else
         {
-            stats[QStringLiteral("hDenoise")] = -1;
             fastMuxSelect(hDenoiseMux, 0);
         }
     }
@@ -981,7 +964,7 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
             fullTime += elapsedTimeGpu;
-            stats[QStringLiteral("hOutLut")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mtOutLut, elapsedTimeGpu);
         }
     }
 
@@ -1011,7 +994,7 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
             fullTime += elapsedTimeGpu;
-            stats[QStringLiteral("h16to8Transform")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mt16to8Transform, elapsedTimeGpu);
         }
     }
 
@@ -1044,7 +1027,7 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
             fullTime += elapsedTimeGpu;
-            stats[QStringLiteral("hGrayToRGBTransform")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mtGrayToRGBTransform, elapsedTimeGpu);
         }
     }
 
@@ -1076,7 +1059,7 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
             fastGpuTimerGetTime(profileTimer, &elapsedTimeGpu);
 
             fullTime += elapsedTimeGpu;
-            stats[QStringLiteral("hExportToDevice")] = elapsedTimeGpu;
+            Metrics::record(Metrics::mtExportToDevice, elapsedTimeGpu);
         }
     }
 
@@ -1085,10 +1068,14 @@ fastStatus_t CUDAProcessorGray::Transform(ImageT *image, CUDAProcessorOptions &o
         cudaDeviceSynchronize();
 
         float mcs = float(cpuTimer.elapsed());
-        stats[QStringLiteral("totalGPUCPUTime")] = mcs;
-        stats[QStringLiteral("totalGPUTime")] = fullTime;
+        Metrics::record(Metrics::mtTotalGPUCPU, mcs);
+        Metrics::record(Metrics::mtTotalGPU, fullTime);
     }
 
+    mLastMeta = meta;
+    if(meta.hostTimestamp > 0)
+        Metrics::record(Metrics::mtLatency, float(FrameMetadata::now() - meta.hostTimestamp) / 1000000.f);
+
     locker.unlock();
 
     if(profileTimer)
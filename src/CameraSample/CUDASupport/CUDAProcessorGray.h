@@ -36,12 +36,17 @@ public:
     CUDAProcessorGray(QObject *parent = nullptr);
     ~CUDAProcessorGray() override;
     virtual fastStatus_t Init(CUDAProcessorOptions& options);
-    virtual fastStatus_t Transform(ImageT *image, CUDAProcessorOptions& opts) override;
+    virtual fastStatus_t Transform(ImageT *image, CUDAProcessorOptions& opts, const FrameMetadata& meta) override;
     virtual bool isGrayscale() override {return true;}
     virtual void freeFilters() override;
     virtual fastStatus_t export8bitData(void* dstPtr, bool forceRGB = true) override;
 //    virtual fastStatus_t exportJPEGData(void* dstPtr, unsigned jpegQuality, unsigned &size);
 
+protected:
+    //No debayer, denoise is rebuilt with the whole pipeline
+    virtual int initChanges() const override {return CUDAProcessorOptions::ocInput | CUDAProcessorOptions::ocDenoise;}
+    virtual int backEndChanges() const override {return CUDAProcessorOptions::ocNone;}
+
 private:
     fastSurfaceConverterHandle_t    hGrayToRGBTransform = nullptr;
     fastDeviceSurfaceBufferHandle_t dstGrayBuffer = nullptr;
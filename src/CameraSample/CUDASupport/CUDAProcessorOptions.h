@@ -30,7 +30,6 @@
 #define CUDAPROCESSOROPTIONS_H
 
 #include "fastvideo_sdk.h"
-#include "fastvideo_nppGeometry.h"
 #include "fastvideo_denoise.h"
 
 #include <memory.h>
@@ -49,7 +48,26 @@ public:
         vcH264,
         vcMJPG,
         vcJPG,
-        vcPGM
+        vcPGM,
+        /// Unprocessed frames in a single RawContainer file
+        vcRAW
+    };
+
+    /// Option groups which differ in work needed to apply them.
+    /// Options not listed here are read by Transform on every frame.
+    enum OptionsChange
+    {
+        ocNone    = 0,
+        /// SAM matrix changed, added or removed, passed to SAM filter by next Transform
+        ocSam     = 1 << 0,
+        /// JPEG restart interval or sampling format
+        ocJpeg    = 1 << 1,
+        /// Debayer algorithm
+        ocDebayer = 1 << 2,
+        /// Static denoise parameters
+        ocDenoise = 1 << 3,
+        /// Input size, format or packing
+        ocInput   = 1 << 4
     };
 
     CUDAProcessorOptions()
@@ -162,6 +180,32 @@ public:
     }
     ~CUDAProcessorOptions() = default;
 
+    /// Mask of OptionsChange telling how other options differ from these
+    int changes(const CUDAProcessorOptions& other) const
+    {
+        int ret = ocNone;
+        if(MaxWidth != other.MaxWidth ||
+           MaxHeight != other.MaxHeight ||
+           SurfaceFmt != other.SurfaceFmt ||
+           Packed != other.Packed)
+            ret |= ocInput;
+
+        if(MatrixA != other.MatrixA || MatrixB != other.MatrixB)
+            ret |= ocSam;
+
+        if(JpegRestartInterval != other.JpegRestartInterval ||
+           JpegSamplingFmt != other.JpegSamplingFmt)
+            ret |= ocJpeg;
+
+        if(BayerType != other.BayerType)
+            ret |= ocDebayer;
+
+        if(memcmp(&DenoiseStaticParams, &other.DenoiseStaticParams, sizeof(denoise_static_parameters_t)) != 0)
+            ret |= ocDenoise;
+
+        return ret;
+    }
+
     bool isValid()
     {
         return (Width > 0 &&
@@ -34,12 +34,12 @@
 #include <memory>
 #include <cstring>
 #include "alignment.hpp"
-#include "CudaAllocator.h"
+#include "MemoryBackend.h"
 
 template<class T>
 class GPUImage {
 public:
-    std::unique_ptr<T, CudaAllocator> data;
+    std::unique_ptr<T, ImageAllocator> data;
     unsigned w;
     unsigned h;
     unsigned wPitch;
@@ -60,15 +60,30 @@ public:
         surfaceFmt = img.surfaceFmt;
 
         unsigned fullSize = wPitch * h;
+        if(!img.data)
+            return;
 
+        if(!allocate(fullSize * sizeof(T), img.backend()))
+            return;
+        ImageAllocator::copy(data.get(), img.data.get(), fullSize * sizeof(T), backend());
+    };
+
+    MemoryBackend backend() const {
+        return data.get_deleter().backend();
+    }
+
+    bool allocate(size_t bytesCount, MemoryBackend memBackend) {
         try {
-			data.reset((T*)CudaAllocator::allocate(fullSize));
+            data = std::unique_ptr<T, ImageAllocator>(
+                        static_cast<T*>(ImageAllocator::allocate(bytesCount, memBackend)),
+                        ImageAllocator(memBackend));
         } catch (std::bad_alloc& ba) {
             fprintf(stderr, "Memory allocation failed: %s\n", ba.what());
-            return;
+            data.reset();
+            return false;
         }
-        cudaMemcpy(data.get(), img.data.get(), fullSize * sizeof(T), cudaMemcpyDeviceToDevice);
-    };
+        return true;
+    }
 
     unsigned GetBytesPerPixel() const {
         return uDivUp(bitsPerChannel, 8u);
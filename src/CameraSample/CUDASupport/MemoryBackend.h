@@ -0,0 +1,191 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef MEMORYBACKEND_H
+#define MEMORYBACKEND_H
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifndef HOST_ONLY
+#include <cuda_runtime.h>
+#endif
+
+/// Where image buffers are allocated and processed
+enum MemoryBackend
+{
+    /// CUDA device memory, processed with Fastvideo SDK
+    mbCUDA = 0,
+    /// Pageable host memory, processed on CPU
+    mbHost
+};
+
+/// Allocator and unique_ptr deleter for image buffers.
+/// Deleter remembers backend the pointer was allocated with,
+/// so buffers of different backends can live side by side.
+/// With HOST_ONLY defined CUDA is not referenced at all.
+class ImageAllocator
+{
+public:
+    /// Host buffers are aligned for the widest SIMD load used by CPU processing
+    static const size_t hostAlignment = 64;
+
+    ImageAllocator(MemoryBackend backend = mbCUDA) : mBackend(backend){}
+
+    MemoryBackend backend() const {return mBackend;}
+
+    static void* allocate(size_t bytesCount, MemoryBackend backend)
+    {
+        void* p = nullptr;
+        if(backend == mbHost)
+        {
+            size_t size = (bytesCount + hostAlignment - 1) / hostAlignment * hostAlignment;
+#ifdef _WIN32
+            p = _aligned_malloc(size, hostAlignment);
+#else
+            if(posix_memalign(&p, hostAlignment, size) != 0)
+                p = nullptr;
+#endif
+        }
+#ifndef HOST_ONLY
+        else if(cudaMalloc(&p, bytesCount) != cudaSuccess)
+        {
+            p = nullptr;
+        }
+#endif
+        if(p == nullptr)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    static void deallocate(void* p, MemoryBackend backend)
+    {
+        if(p == nullptr)
+            return;
+
+        if(backend == mbHost)
+        {
+#ifdef _WIN32
+            _aligned_free(p);
+#else
+            free(p);
+#endif
+        }
+#ifndef HOST_ONLY
+        else
+        {
+            cudaFree(p);
+        }
+#endif
+    }
+
+    void operator()(void* p)
+    {
+        deallocate(p, mBackend);
+    }
+
+    /// Copy bytesCount bytes from host memory to buffer allocated with backend
+    static bool upload(void* dst, const void* src, size_t bytesCount, MemoryBackend backend)
+    {
+        if(backend == mbHost)
+        {
+            memcpy(dst, src, bytesCount);
+            return true;
+        }
+#ifndef HOST_ONLY
+        return cudaMemcpy(dst, src, bytesCount, cudaMemcpyHostToDevice) == cudaSuccess;
+#else
+        return false;
+#endif
+    }
+
+    /// Copy bytesCount bytes between two buffers allocated with backend
+    static bool copy(void* dst, const void* src, size_t bytesCount, MemoryBackend backend)
+    {
+        if(backend == mbHost)
+        {
+            memcpy(dst, src, bytesCount);
+            return true;
+        }
+#ifndef HOST_ONLY
+        return cudaMemcpy(dst, src, bytesCount, cudaMemcpyDeviceToDevice) == cudaSuccess;
+#else
+        return false;
+#endif
+    }
+
+    /// CUDA is available if the build has it and there is at least one device
+    static bool isAvailable(MemoryBackend backend)
+    {
+        if(backend == mbHost)
+            return true;
+#ifndef HOST_ONLY
+        int count = 0;
+        return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+#else
+        return false;
+#endif
+    }
+
+    /// Backend used for newly allocated camera buffers.
+    /// CUDA if available, host otherwise.
+    static MemoryBackend defaultBackend()
+    {
+        return defaultBackendRef();
+    }
+
+    /// Returns false if backend is not available
+    static bool setDefaultBackend(MemoryBackend backend)
+    {
+        if(!isAvailable(backend))
+            return false;
+        defaultBackendRef() = backend;
+        return true;
+    }
+
+    static const char* backendName(MemoryBackend backend)
+    {
+        return backend == mbHost ? "host" : "cuda";
+    }
+
+private:
+    static MemoryBackend& defaultBackendRef()
+    {
+        static MemoryBackend backend = isAvailable(mbCUDA) ? mbCUDA : mbHost;
+        return backend;
+    }
+
+    MemoryBackend mBackend;
+};
+
+#endif // MEMORYBACKEND_H
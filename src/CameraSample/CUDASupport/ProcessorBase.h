@@ -0,0 +1,179 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef PROCESSORBASE_H
+#define PROCESSORBASE_H
+
+#include "CUDAProcessorOptions.h"
+#include "FrameBuffer.h"
+#include "MemoryBackend.h"
+
+#include "fastvideo_sdk.h"
+
+#include <QObject>
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+/// Interface of image processors used by RawProcessor, GUI and headless runner.
+/// Has no Fastvideo SDK or CUDA calls, so host only builds can use it
+/// without SDK libraries. GPU processors derive from CUDAProcessorBase,
+/// host processor is CPUProcessor.
+class ProcessorBase : public QObject
+{
+    Q_OBJECT
+public:
+    ProcessorBase(QObject* parent = nullptr) : QObject(parent){}
+
+    virtual fastStatus_t Init(CUDAProcessorOptions & options) = 0;
+    virtual fastStatus_t InitFailed(const char *errStr, fastStatus_t ret);
+    ///Apply options doing as little as possible: full Init only if input changed,
+    ///other stages are rebuilt only if their static parameters changed,
+    ///per frame parameters are left to the next Transform.
+    virtual fastStatus_t Reconfigure(CUDAProcessorOptions & options);
+
+    virtual fastStatus_t Transform(ImageT *image, CUDAProcessorOptions& opts, const FrameMetadata& meta) = 0;
+
+    virtual fastStatus_t Close() = 0;
+    virtual void         freeFilters() = 0;
+
+    virtual fastStatus_t export8bitData(void* dstPtr, bool forceRGB = true) = 0;
+    ///size is the capacity of dstPtr on input and the JPEG size on output.
+    ///If the JPEG does not fit, FAST_INSUFFICIENT_HOST_MEMORY is returned and size is 0.
+    virtual fastStatus_t exportJPEGData(void* dstPtr, unsigned jpegQuality, unsigned &size) = 0;
+    virtual fastStatus_t exportNV12Data(void* dstPtr) = 0;
+
+    virtual fastStatus_t exportRawData(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch) = 0;
+    virtual fastStatus_t export16bitData(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch) = 0;
+    virtual fastStatus_t exportLinearizedRaw(void* dstPtr, unsigned int &w, unsigned int &h, unsigned int &pitch) = 0;
+
+    ///Metadata of the last transformed frame
+    FrameMetadata lastFrameMetadata()
+    {
+        QMutexLocker lock(&mut);
+        return mLastMeta;
+    }
+
+    virtual void* GetFrameBuffer() = 0;
+    ///Memory input frames are expected in and GetFrameBuffer() points to
+    virtual MemoryBackend backend() const = 0;
+
+    virtual bool isGrayscale(){return false;}
+    QString getLastErrorDescription(){ return mErrString; }
+    fastStatus_t getLastError(){ return mLastError; }
+    bool isInitialized(){return mInitialised;}
+    void setInfo(bool info)
+    {
+        QMutexLocker lock(&mut);
+        this->info = info;
+    }
+
+    ///Copy of stats, does not wait for the frame being transformed.
+    ///Per frame stage times are kept in Metrics.
+    QMap<QString, float> statsSnapshot()
+    {
+        QMutexLocker lock(&mStatsLock);
+        return mPublishedStats;
+    }
+
+    fastBayerPattern_t       BayerFormat {};
+    QMutex                   mut;
+    QMap<QString, float>     stats;
+    fastLut_16_t             outLut;
+
+protected:
+    ///Option changes which need full Init
+    virtual int initChanges() const {return CUDAProcessorOptions::ocInput;}
+    ///Option changes which need stages from debayer on to be rebuilt
+    virtual int backEndChanges() const {return CUDAProcessorOptions::ocDebayer | CUDAProcessorOptions::ocDenoise;}
+
+    ///Apply changes which do not need full Init.
+    ///Called by Reconfigure with mut locked, on error mut is unlocked by InitFailed.
+    virtual fastStatus_t applyChanges(int changes, CUDAProcessorOptions& options);
+
+    fastStatus_t TransformFailed(const char *errStr, fastStatus_t ret);
+
+    ///Makes stats visible to statsSnapshot, called with mut locked
+    void         publishStats()
+    {
+        QMutexLocker lock(&mStatsLock);
+        mPublishedStats = stats;
+    }
+
+    template<typename T>
+    void InitLut(T & param, unsigned short blackLevel, double scale, const QVector<unsigned short> & linearizationLut = QVector<unsigned short>());
+
+    bool         info = true;
+
+    FrameMetadata       mLastMeta;
+    bool                mInitialised = false;
+    //Options processor was built with
+    CUDAProcessorOptions mInitOptions;
+    //New SAM matrices have to be passed to the filter
+    bool                mSamChanged = false;
+    QMutex              mStatsLock;
+    QMap<QString, float> mPublishedStats;
+    QString             mErrString;
+    fastStatus_t        mLastError {};
+
+signals:
+    void initialized(const QString& info);
+    void finished();
+    void error();
+};
+
+template<typename T>
+void ProcessorBase::InitLut(T & param, unsigned short blackLevel, double scale, const QVector<unsigned short> & linearizationLut)
+{
+    if(linearizationLut.empty())
+    {
+        int i = 0;
+        for(auto& l : param.lut)
+        {
+            l = static_cast<unsigned short>(qBound<double>(0, (i - blackLevel)  * scale, 1) * 65535);
+            i++;
+        }
+    }
+    else
+    {
+        auto itr = linearizationLut.begin();
+        for(auto & l : param.lut)
+        {
+            if( itr != linearizationLut.end() )
+            {
+                l = static_cast<unsigned short>(qBound<double>(0, (*itr - blackLevel)  * scale, 1) * 65535);
+                ++itr;
+                continue;
+            }
+            break;
+        }
+    }
+}
+
+#endif // PROCESSORBASE_H
@@ -33,3 +33,20 @@ CameraBase::CameraBase() :
 {
 
 }
+
+bool CameraBase::unpackOnHost()
+{
+    if(!isPackedFormat())
+        return false;
+
+    //GPU raw unpacker supports XIMEA layout only
+    return mInputBuffer.backend() == mbHost || mPackedLayout != CPUKernels::plXimea12;
+}
+
+bool CameraBase::uploadFrame(unsigned char* dst, const void* src, size_t size)
+{
+    if(unpackOnHost())
+        return mInputBuffer.uploadUnpacked(dst, src, mPackedLayout);
+
+    return mInputBuffer.upload(dst, src, size);
+}
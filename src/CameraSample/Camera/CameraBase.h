@@ -59,7 +59,8 @@ public:
         cif10bpp,    ///10 bit per pixel in 16 bit
         cif12bpp,    ///12 bit per pixel in 16 bit
         cif12bpp_p,  ///12 bit per pixel packed (2 pixel in 3 bytes)
-        cif16bpp     ///16 bit per pixel
+        cif16bpp,    ///16 bit per pixel
+        cif10bpp_p   ///10 bit per pixel packed (4 pixel in 5 bytes)
     } cmrImageFormat;
 
     typedef enum{
@@ -123,7 +124,11 @@ public:
     ///Get camera parameter information. Return true on success, false otherwise.
     virtual bool getParameterInfo(cmrParameterInfo& info) = 0;
 
-    bool isPacked(){return mImageFormat == cif12bpp_p;}
+    ///Return true if frames in input buffer are packed and have to be unpacked by GPU
+    bool isPacked(){return isPackedFormat() && !unpackOnHost();}
+    ///Return true if camera delivers packed pixels
+    bool isPackedFormat(){return mImageFormat == cif12bpp_p || mImageFormat == cif10bpp_p;}
+    CPUKernels::PackedLayout packedLayout(){return mPackedLayout;}
     bool isColor(){return mIsColor;}
 
     int width() {return mWidth;}
@@ -145,6 +150,12 @@ signals:
     void stateChanged(CameraBase::cmrCameraState newState);
 
 protected:
+    ///Packed frames are expanded on CPU while copied to the input buffer
+    ///if they go to host memory or GPU unpacker does not support the layout
+    bool unpackOnHost();
+    ///Copy frame from driver buffer to slot returned by mInputBuffer.acquire()
+    bool uploadFrame(unsigned char* dst, const void* src, size_t size);
+
     QString mModel;
     QString mManufacturer;
     QString mSerial;
@@ -164,6 +175,7 @@ protected:
     fastBayerPattern_t  mPattern = FAST_BAYER_NONE;
     fastSurfaceFormat_t mSurfaceFormat = FAST_I8;
     cmrImageFormat      mImageFormat = cif8bpp;
+    CPUKernels::PackedLayout mPackedLayout = CPUKernels::plXimea12;
     bool                mStreaming = false;
     CircularBuffer      mInputBuffer;
     RawProcessor*       mRawProc = nullptr;
@@ -28,7 +28,9 @@
 
 #include "FrameBuffer.h"
 #include "SurfaceTraits.hpp"
-#include <QDateTime>
+#include "Metrics.h"
+
+#include <QMutexLocker>
 
 CircularBuffer::CircularBuffer(QObject *parent) : QObject(parent)
 {
@@ -37,8 +39,6 @@ CircularBuffer::CircularBuffer(QObject *parent) : QObject(parent)
 
 bool CircularBuffer::allocate(int width, int height, fastSurfaceFormat_t format)
 {
-    QMutexLocker lock(&mMutex);
-
     int pitch = GetPitchFromSurface(format, width);
     int bpc = GetBitsPerChannelFromSurface(format);
 
@@ -47,24 +47,27 @@ bool CircularBuffer::allocate(int width, int height, fastSurfaceFormat_t format)
     //so we double buffer size just in case
     int bytesAlloc = height * pitch * 2;
 
-    mImages.resize(numBuffers);
+    mImages.resize(mDepth);
+    mMeta.fill(FrameMetadata(), mDepth);
 
     mAllocated = 0;
-    mCurrent = 0;
-    mLast = -1;
+    mHead = 0;
+    mTail = 0;
+    mHeld = noSlot;
+    mAcquired = noSlot;
+    mRewrite = false;
+    mSeq = 0;
+    mLastTimestamp = 0;
+    mFrameInterval = 0;
 
-    for(int i = 0; i < numBuffers; i++)
+    for(int i = 0; i < mDepth; i++)
     {
         mImages[i].w = width;
         mImages[i].h = height;
         mImages[i].surfaceFmt = format;
         mImages[i].wPitch = pitch;
         mImages[i].bitsPerChannel = bpc;
-        try
-        {
-			mImages[i].data.reset(static_cast<unsigned char*>(CudaAllocator::allocate(bytesAlloc)));
-        }
-        catch(...)
+        if(!mImages[i].allocate(bytesAlloc, mBackend))
         {
             mImages.clear();
             return false;
@@ -72,10 +75,62 @@ bool CircularBuffer::allocate(int width, int height, fastSurfaceFormat_t format)
     }
 
     mAllocated = bytesAlloc;
-    mRead = mWritten = 0;
+    mRead = 0;
+    mWritten = 0;
+    for(PolicyCounters& counters : mCounters)
+    {
+        counters.dropped = 0;
+        counters.blockedTime = 0;
+        counters.blocked = 0;
+    }
     return true;
 }
 
+void CircularBuffer::setDepth(int depth)
+{
+    //One slot is held by the consumer and at least one is needed for the producer
+    mDepth = qMax(2, depth);
+}
+
+int CircularBuffer::depth()
+{
+    return mDepth;
+}
+
+void CircularBuffer::setBackend(MemoryBackend backend)
+{
+    if(ImageAllocator::isAvailable(backend))
+        mBackend = backend;
+}
+
+void CircularBuffer::setPolicy(FramePolicy policy, int param)
+{
+    if(policy < fpLatest || policy >= fpCount)
+        return;
+
+    mPolicyParam = param;
+    mPolicy = policy;
+
+    //Blocked producer has to reevaluate new policy
+    wakeProducer();
+}
+
+QString CircularBuffer::policyName(FramePolicy policy)
+{
+    switch(policy)
+    {
+    case fpLatest:
+        return QStringLiteral("latest");
+    case fpBlock:
+        return QStringLiteral("block");
+    case fpDropOldest:
+        return QStringLiteral("dropOldest");
+    default:
+        break;
+    }
+    return QString();
+}
+
 int CircularBuffer::width()
 {
     return mImages.isEmpty() ? 0 : mImages.front().w;
@@ -99,31 +154,267 @@ fastSurfaceFormat_t CircularBuffer::surfaceFmt()
     return  mImages.isEmpty() ? FAST_I8 : mImages.front().surfaceFmt;
 }
 
-unsigned char* CircularBuffer::getBuffer()
+bool CircularBuffer::hasSpace(quint64 head, int limit)
+{
+    //Tail has to be loaded before the held position.
+    //Consumer publishes held position before it moves the tail,
+    //so a stale tail always guards the slot which is about to be held.
+    const quint64 tail = mTail.load();
+    const quint64 held = mHeld.load();
+
+    if(head - tail >= quint64(limit))
+        return false;
+
+    return held == noSlot || head - held < quint64(mImages.size());
+}
+
+unsigned char* CircularBuffer::acquire()
 {
     if(mImages.isEmpty())
         return nullptr;
 
-    int num = (mCurrent + 1) % numBuffers;
-    if(num == mLast)
-        num = (mCurrent + 2) % numBuffers;
-    mCurrent = num;
-    return mImages[mCurrent].data.get();
+    mSeq++;
+    mAcquired = noSlot;
+    mRewrite = false;
+
+    const int depth = mImages.size();
+    quint64 head = mHead.load(std::memory_order_relaxed);
+    PolicyCounters* counters = nullptr;
+
+    qint64 waitStart = 0;
+    bool drop = false;
+    for(;;)
+    {
+        //Policy can be changed while the producer waits
+        const FramePolicy policy = mPolicy.load();
+        const int param = mPolicyParam.load();
+        counters = &mCounters[policy];
+
+        int limit = depth;
+        if(policy == fpDropOldest)
+        {
+            //Oldest frame has to be evicted before the slot held by the consumer is reached
+            limit = qMax(1, depth - 2);
+            if(param > 0)
+                limit = qMin(limit, param);
+        }
+
+        if(hasSpace(head, limit))
+            break;
+
+        if(policy == fpBlock)
+        {
+            const qint64 now = FrameMetadata::now();
+            if(waitStart == 0)
+                waitStart = now;
+
+            const qint64 elapsed = (now - waitStart) / 1000000;
+            if(param <= 0 || elapsed >= param)
+            {
+                drop = true;
+                break;
+            }
+
+            QMutexLocker lock(&mWaitMutex);
+            mWaiting = true;
+            if(!hasSpace(head, limit))
+                mWaitCond.wait(&mWaitMutex, static_cast<unsigned long>(param - elapsed));
+            mWaiting = false;
+            continue;
+        }
+
+        quint64 tail = mTail.load();
+        const quint64 held = mHeld.load();
+        //Evicting the oldest frame does not free the slot held by the consumer
+        const bool heldBlocks = held != noSlot && head - held >= quint64(depth);
+        if(heldBlocks || head - tail < quint64(limit))
+        {
+            //Queue is not full, the slot is held by the consumer.
+            //Incoming frame has to win, so the newest queued frame is written over.
+            //The whole queue is taken back, until commit the consumer finds it empty
+            //and can not get a frame older than the one being replaced.
+            //Consumer may take the newest frame at the same time, then just try again.
+            if(head > tail)
+            {
+                if(mTail.compare_exchange_strong(tail, head))
+                {
+                    counters->dropped.fetch_add(head - tail, std::memory_order_relaxed);
+                    mRewrite = true;
+                    head--;
+                    break;
+                }
+                continue;
+            }
+
+            //Nothing can be freed, so drop the incoming frame.
+            drop = true;
+            break;
+        }
+
+        //Drop the oldest queued frame.
+        //Consumer may take it at the same time, then just try again.
+        if(mTail.compare_exchange_strong(tail, tail + 1))
+            counters->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if(waitStart != 0)
+    {
+        const qint64 blocked = FrameMetadata::now() - waitStart;
+        counters->blockedTime.fetch_add(quint64(blocked), std::memory_order_relaxed);
+        counters->blocked.fetch_add(1, std::memory_order_relaxed);
+        Metrics::recordNs(Metrics::mtCaptureBlocked, blocked);
+    }
+
+    if(drop)
+    {
+        counters->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    mAcquired = head;
+    return mImages[int(head % quint64(depth))].data.get();
+}
+
+void CircularBuffer::commit(const FrameMetadata& meta)
+{
+    if(mAcquired == noSlot)
+        return;
+
+    const quint64 depth = quint64(mImages.size());
+    FrameMetadata& slotMeta = mMeta[int(mAcquired % depth)];
+    slotMeta = meta;
+    if(slotMeta.seq == 0)
+        slotMeta.seq = mSeq;
+    if(slotMeta.hostTimestamp == 0)
+        slotMeta.hostTimestamp = FrameMetadata::now();
+
+    if(mLastTimestamp > 0)
+    {
+        const qint64 interval = slotMeta.hostTimestamp - mLastTimestamp;
+        mFrameInterval.store(interval, std::memory_order_relaxed);
+        Metrics::recordNs(Metrics::mtCaptureInterval, interval);
+    }
+    mLastTimestamp = slotMeta.hostTimestamp;
+
+    mHead.store(mAcquired + 1, std::memory_order_release);
+    //Rewritten newest frame is queued again
+    if(mRewrite)
+        mTail.store(mAcquired);
+    mRewrite = false;
+    mAcquired = noSlot;
+    mWritten.fetch_add(1, std::memory_order_relaxed);
 }
 
-ImageT* CircularBuffer::getLastImage()
+bool CircularBuffer::upload(unsigned char* dst, const void* src, size_t size)
 {
-    if(mImages.isEmpty() || mLast < 0)
+    if(dst == nullptr || mImages.isEmpty() || size > size_t(mAllocated))
+        return false;
+
+    //Slots keep backend they were allocated with
+    return ImageAllocator::upload(dst, src, size, mImages[0].backend());
+}
+
+bool CircularBuffer::uploadUnpacked(unsigned char* dst, const void* src, CPUKernels::PackedLayout layout, size_t srcPitch)
+{
+    if(dst == nullptr || src == nullptr || mImages.isEmpty())
+        return false;
+
+    const ImageT& img = mImages[0];
+    if(img.bitsPerChannel <= 8)
+        return false;
+
+    const int width = int(img.w);
+    const int height = int(img.h);
+    const size_t pitch = img.wPitch;
+    if(srcPitch == 0)
+        srcPitch = size_t(CPUKernels::packedBytes(layout, width));
+
+    unsigned char* out = dst;
+    if(img.backend() != mbHost)
+    {
+        mStaging.resize(int(pitch / sizeof(unsigned short) * img.h));
+        out = reinterpret_cast<unsigned char*>(mStaging.data());
+    }
+
+    const unsigned char* in = static_cast<const unsigned char*>(src);
+    for(int y = 0; y < height; y++)
+        CPUKernels::unpack(layout, in + y * srcPitch, reinterpret_cast<unsigned short*>(out + y * pitch), width);
+
+    if(out == dst)
+        return true;
+
+    return ImageAllocator::upload(dst, out, pitch * img.h, img.backend());
+}
+
+ImageT* CircularBuffer::consume(FrameMetadata* meta)
+{
+    if(mImages.isEmpty())
         return nullptr;
-    mRead++;
-//    qDebug("Reading image = %d, ts = %u", mLast, QDateTime::currentDateTime().toMSecsSinceEpoch());
-    return &(mImages[mLast]);
+
+    release();
+
+    const FramePolicy policy = mPolicy.load();
+    const quint64 depth = quint64(mImages.size());
+    quint64 tail = mTail.load();
+    quint64 pos = 0;
+    for(;;)
+    {
+        const quint64 head = mHead.load(std::memory_order_acquire);
+        if(head == tail)
+        {
+            mHeld = noSlot;
+            return nullptr;
+        }
+
+        //Latest policy takes the newest frame, everything before it is stale
+        pos = (policy == fpLatest) ? head - 1 : tail;
+        mHeld = pos;
+
+        //On failure producer dropped the oldest frame and tail is reloaded
+        if(mTail.compare_exchange_weak(tail, pos + 1))
+            break;
+    }
+
+    if(pos > tail)
+        mCounters[policy].dropped.fetch_add(pos - tail, std::memory_order_relaxed);
+    mRead.fetch_add(1, std::memory_order_relaxed);
+
+    if(meta)
+        *meta = mMeta[int(pos % depth)];
+
+    wakeProducer();
+    return &(mImages[int(pos % depth)]);
 }
 
 void CircularBuffer::release()
 {
-    mLast = mCurrent;
-    mWritten++;
-    mDropped = mWritten - mRead;
-//    qDebug("Read = %d, written = %d, ts = %u", mRead, mWritten, QDateTime::currentDateTime().toMSecsSinceEpoch());
+    if(mHeld.load(std::memory_order_relaxed) == noSlot)
+        return;
+
+    mHeld = noSlot;
+    wakeProducer();
+}
+
+int CircularBuffer::count() const
+{
+    const quint64 tail = mTail.load();
+    const quint64 head = mHead.load();
+    return head > tail ? int(head - tail) : 0;
+}
+
+quint64 CircularBuffer::dropped() const
+{
+    quint64 ret = 0;
+    for(const PolicyCounters& counters : mCounters)
+        ret += counters.dropped.load(std::memory_order_relaxed);
+    return ret;
+}
+
+void CircularBuffer::wakeProducer()
+{
+    if(!mWaiting.load())
+        return;
+
+    QMutexLocker lock(&mWaitMutex);
+    mWaitCond.wakeAll();
 }
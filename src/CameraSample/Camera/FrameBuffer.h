@@ -32,26 +32,81 @@
 #include <QObject>
 #include <QVector>
 #include <QMutex>
-#include <QMutexLocker>
+#include <QWaitCondition>
+
+#include <atomic>
 
 //#include "Image.h"
 //#include "FastAllocator.h"
 #include "GPUImage.h"
+#include "CPUKernels.h"
+#include "FrameMetadata.h"
 
 typedef GPUImage<unsigned char> ImageT;
 
+/// Lock-free single producer / single consumer frame ring.
+/// Camera thread is a producer: acquire() -> fill -> commit().
+/// Processing thread is a consumer: consume() -> process -> release().
+/// Slot held by the consumer is never overwritten by the producer.
+/// What happens when the ring is full is defined by the back-pressure policy.
+/// With the latest policy a frame which can not get a slot replaces the newest queued one.
 class CircularBuffer : public QObject
 {
     Q_OBJECT
 public:
+    enum FramePolicy
+    {
+        /// Consumer gets the newest frame, older ones are dropped (live preview)
+        fpLatest = 0,
+        /// Nothing is dropped, producer waits up to policy parameter ms
+        /// for a free slot and drops the frame only on timeout (recording)
+        fpBlock,
+        /// Consumer gets frames in order, producer keeps at most
+        /// policy parameter frames queued and drops the oldest one.
+        /// Queue is limited to depth - 2, a slot is held by the consumer and one is written
+        fpDropOldest,
+
+        fpCount
+    };
 
     explicit CircularBuffer(QObject *parent = nullptr);
     ~CircularBuffer() = default;
 
     bool allocate(int width, int height, fastSurfaceFormat_t format = FAST_I16);
-    unsigned char* getBuffer();
-    ImageT* getLastImage();
+
+    /// Number of slots, applied on next allocate()
+    void setDepth(int depth);
+    int depth();
+
+    /// Memory the slots are allocated in, applied on next allocate()
+    void setBackend(MemoryBackend backend);
+    MemoryBackend backend() const {return mBackend;}
+
+    /// Can be changed while streaming.
+    /// param is block timeout in ms for fpBlock and queue length for fpDropOldest
+    void setPolicy(FramePolicy policy, int param = 0);
+    FramePolicy policy() const {return mPolicy.load();}
+    int policyParam() const {return mPolicyParam.load();}
+    static QString policyName(FramePolicy policy);
+
+    /// Producer: get free slot to write to, nullptr if the frame has to be dropped
+    unsigned char* acquire();
+    /// Producer: publish slot returned by acquire().
+    /// Zero sequence and host timestamp are filled in by the buffer.
+    void commit(const FrameMetadata& meta = FrameMetadata());
+    /// Producer: copy frame from host memory to slot returned by acquire()
+    bool upload(unsigned char* dst, const void* src, size_t size);
+    /// Producer: unpack frame from host memory to 16 bit slot returned by acquire().
+    /// Host slots are written in one pass, device slots get data through host staging buffer.
+    /// srcPitch 0 means rows are not padded.
+    bool uploadUnpacked(unsigned char* dst, const void* src, CPUKernels::PackedLayout layout, size_t srcPitch = 0);
+
+    /// Consumer: get next frame according to policy, nullptr if there is nothing new
+    ImageT* consume(FrameMetadata* meta = nullptr);
+    /// Consumer: return frame obtained by consume() back to the ring
     void release();
+    /// Number of committed frames not yet consumed
+    int count() const;
 
     int width();
     int height();
@@ -59,26 +114,74 @@ public:
     int size();
     fastSurfaceFormat_t surfaceFmt();
 
+    /// Frames committed by the producer
+    quint64 written() const {return mWritten.load(std::memory_order_relaxed);}
+    /// Frames taken by the consumer
+    quint64 read() const {return mRead.load(std::memory_order_relaxed);}
+    /// Frames lost while policy was active
+    quint64 dropped(FramePolicy policy) const {return mCounters[policy].dropped.load(std::memory_order_relaxed);}
+    /// Frames lost with any policy
+    quint64 dropped() const;
+    /// Time producer spent waiting for a free slot while policy was active, nanoseconds
+    quint64 blockedTime(FramePolicy policy) const {return mCounters[policy].blockedTime.load(std::memory_order_relaxed);}
+    /// Number of times producer had to wait while policy was active
+    quint64 blocked(FramePolicy policy) const {return mCounters[policy].blocked.load(std::memory_order_relaxed);}
+    /// Host time between two last committed frames, ns
+    qint64 frameInterval() const {return mFrameInterval.load(std::memory_order_relaxed);}
+
 signals:
 
 public slots:
 
 private:
-    const int numBuffers = 4;
+    static const quint64 noSlot = ~quint64(0);
 
-    //Currently written buffer
-    int mCurrent = 0;
+    struct PolicyCounters
+    {
+        std::atomic<quint64> dropped {0};
+        std::atomic<quint64> blockedTime {0};
+        std::atomic<quint64> blocked {0};
+    };
 
-    //Last written buffer
-    int mLast = -1;
+    int mDepth = 4;
+    MemoryBackend mBackend = ImageAllocator::defaultBackend();
 
     QVector<ImageT> mImages;
-    QMutex mMutex;
+    QVector<FrameMetadata> mMeta;
     int mAllocated = 0;
-
-    int mRead = 0;
-    int mWritten = 0;
-    int mDropped = 0;
+    //Unpacked frame waiting for upload to device slot
+    QVector<unsigned short> mStaging;
+
+    std::atomic<FramePolicy> mPolicy {fpLatest};
+    std::atomic<int> mPolicyParam {0};
+
+    //Next position to be written, owned by producer
+    std::atomic<quint64> mHead {0};
+    //Next position to be read. Moved by consumer, and by producer
+    //when it drops the oldest frame or takes the queue back to write
+    //over the newest one, so always changed with CAS while both run
+    std::atomic<quint64> mTail {0};
+    //Position held by the consumer, noSlot if none
+    std::atomic<quint64> mHeld {noSlot};
+    //Position acquired by producer, noSlot if none
+    quint64 mAcquired = noSlot;
+    //Acquired position is the newest queued frame taken back to be written over
+    bool mRewrite = false;
+    quint64 mSeq = 0;
+    qint64 mLastTimestamp = 0;
+    std::atomic<qint64> mFrameInterval {0};
+
+    //Used only when producer is blocked
+    QMutex mWaitMutex;
+    QWaitCondition mWaitCond;
+    std::atomic<bool> mWaiting {false};
+
+    std::atomic<quint64> mRead {0};
+    std::atomic<quint64> mWritten {0};
+    PolicyCounters mCounters[fpCount];
+
+    bool hasSpace(quint64 head, int limit);
+    void wakeProducer();
 };
 
 #endif // FRAMEBUFFER_H
@@ -103,6 +103,7 @@ bool GeniCamCamera::open(uint32_t devID)
         if(pixelFormats.contains(BayerRG12p))
         {
             mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plGenICam12p;
             mSurfaceFormat = FAST_I12;
             mPattern = FAST_BAYER_RGGB;
             fmtString = "BayerRG12p";
@@ -112,6 +113,7 @@ bool GeniCamCamera::open(uint32_t devID)
         else if(pixelFormats.contains(BayerGB12p))
         {
             mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plGenICam12p;
             mSurfaceFormat = FAST_I12;
             mPattern = FAST_BAYER_GBRG;
             fmtString = "BayerGB12p";
@@ -121,6 +123,7 @@ bool GeniCamCamera::open(uint32_t devID)
         else if(pixelFormats.contains(BayerGR12p))
         {
             mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plGenICam12p;
             mSurfaceFormat = FAST_I12;
             mPattern = FAST_BAYER_GRBG;
             fmtString = "BayerGR12p";
@@ -130,6 +133,7 @@ bool GeniCamCamera::open(uint32_t devID)
         else if(pixelFormats.contains(BayerBG12p))
         {
             mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plGenICam12p;
             mSurfaceFormat = FAST_I12;
             mPattern = FAST_BAYER_BGGR;
             fmtString = "BayerBG12p";
@@ -139,6 +143,7 @@ bool GeniCamCamera::open(uint32_t devID)
         else if(pixelFormats.contains(Mono12p))
         {
             mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plGenICam12p;
             mSurfaceFormat = FAST_I12;
             mPattern = FAST_BAYER_NONE;
             fmtString = "Mono12p";
@@ -146,6 +151,58 @@ bool GeniCamCamera::open(uint32_t devID)
             mIsColor = false;
         }
 
+        //12 bit packed, GigE Vision layout
+        else if(pixelFormats.contains(BayerRG12Packed))
+        {
+            mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plMono12Packed;
+            mSurfaceFormat = FAST_I12;
+            mPattern = FAST_BAYER_RGGB;
+            fmtString = "BayerRG12Packed";
+            mWhite = 4095;
+            mIsColor = true;
+        }
+        else if(pixelFormats.contains(BayerGB12Packed))
+        {
+            mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plMono12Packed;
+            mSurfaceFormat = FAST_I12;
+            mPattern = FAST_BAYER_GBRG;
+            fmtString = "BayerGB12Packed";
+            mWhite = 4095;
+            mIsColor = true;
+        }
+        else if(pixelFormats.contains(BayerGR12Packed))
+        {
+            mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plMono12Packed;
+            mSurfaceFormat = FAST_I12;
+            mPattern = FAST_BAYER_GRBG;
+            fmtString = "BayerGR12Packed";
+            mWhite = 4095;
+            mIsColor = true;
+        }
+        else if(pixelFormats.contains(BayerBG12Packed))
+        {
+            mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plMono12Packed;
+            mSurfaceFormat = FAST_I12;
+            mPattern = FAST_BAYER_BGGR;
+            fmtString = "BayerBG12Packed";
+            mWhite = 4095;
+            mIsColor = true;
+        }
+        else if(pixelFormats.contains(Mono12Packed))
+        {
+            mImageFormat = cif12bpp_p;
+            mPackedLayout = CPUKernels::plMono12Packed;
+            mSurfaceFormat = FAST_I12;
+            mPattern = FAST_BAYER_NONE;
+            fmtString = "Mono12Packed";
+            mWhite = 4095;
+            mIsColor = false;
+        }
+
         //12 bit unpacked
         else if(pixelFormats.contains(BayerRG12))
         {
@@ -193,6 +250,58 @@ bool GeniCamCamera::open(uint32_t devID)
             mIsColor = false;
         }
 
+        //10 bit packed
+        else if(pixelFormats.contains(BayerRG10p))
+        {
+            mImageFormat = cif10bpp_p;
+            mPackedLayout = CPUKernels::plGenICam10p;
+            mSurfaceFormat = FAST_I10;
+            mPattern = FAST_BAYER_RGGB;
+            fmtString = "BayerRG10p";
+            mWhite = 1023;
+            mIsColor = true;
+        }
+        else if(pixelFormats.contains(BayerGB10p))
+        {
+            mImageFormat = cif10bpp_p;
+            mPackedLayout = CPUKernels::plGenICam10p;
+            mSurfaceFormat = FAST_I10;
+            mPattern = FAST_BAYER_GBRG;
+            fmtString = "BayerGB10p";
+            mWhite = 1023;
+            mIsColor = true;
+        }
+        else if(pixelFormats.contains(BayerGR10p))
+        {
+            mImageFormat = cif10bpp_p;
+            mPackedLayout = CPUKernels::plGenICam10p;
+            mSurfaceFormat = FAST_I10;
+            mPattern = FAST_BAYER_GRBG;
+            fmtString = "BayerGR10p";
+            mWhite = 1023;
+            mIsColor = true;
+        }
+        else if(pixelFormats.contains(BayerBG10p))
+        {
+            mImageFormat = cif10bpp_p;
+            mPackedLayout = CPUKernels::plGenICam10p;
+            mSurfaceFormat = FAST_I10;
+            mPattern = FAST_BAYER_BGGR;
+            fmtString = "BayerBG10p";
+            mWhite = 1023;
+            mIsColor = true;
+        }
+        else if(pixelFormats.contains(Mono10p))
+        {
+            mImageFormat = cif10bpp_p;
+            mPackedLayout = CPUKernels::plGenICam10p;
+            mSurfaceFormat = FAST_I10;
+            mPattern = FAST_BAYER_NONE;
+            fmtString = "Mono10p";
+            mWhite = 1023;
+            mIsColor = false;
+        }
+
         //8 bit
         else if(pixelFormats.contains(BayerRG8))
         {
@@ -308,10 +417,17 @@ void GeniCamCamera::startStreaming()
         return;
     streams[0]->open();
     streams[0]->startStreaming();
-    QElapsedTimer tmr;
+
+    FrameMetadata meta;
+    getParameter(prmExposureTime, meta.exposure);
+    {
+        GenApi::CFloatPtr ptrGain = mDevice->getRemoteNodeMap()->_GetNode("Gain");
+        if(GenApi::IsReadable(ptrGain))
+            meta.gain = float(ptrGain->GetValue());
+    }
+
     while(mState == cstStreaming)
     {
-        tmr.restart();
         const rcg::Buffer* buffer = streams[0]->grab(3000);
         if(buffer == nullptr)
             continue;
@@ -327,15 +443,23 @@ void GeniCamCamera::startStreaming()
         if(buffer->getImagePresent(1))
         {
             const unsigned char* in = static_cast<const unsigned char *>(buffer->getBase(1));
-            unsigned char* out = mInputBuffer.getBuffer();
-            size_t sz = buffer->getSize(1);
-            cudaMemcpy(out, in, sz, cudaMemcpyHostToDevice);
-            mInputBuffer.release();
+            meta.hostTimestamp = FrameMetadata::now();
+            meta.seq = buffer->getFrameID();
+            meta.sensorTimestamp = qint64(buffer->getTimestampNS());
+            if(mExposure > 0)
+                meta.exposure = mExposure;
+
+            unsigned char* out = mInputBuffer.acquire();
+            if(out != nullptr)
+            {
+                size_t sz = buffer->getSize(1);
+                uploadFrame(out, in, sz);
+                mInputBuffer.commit(meta);
+            }
         }
 
         {
             QMutexLocker l(&mLock);
-            mRawProc->acqTimeNsec = tmr.nsecsElapsed();
             mRawProc->wake();
         }
     }
@@ -459,6 +583,7 @@ bool GeniCamCamera::setParameter(cmrCameraParameter param, float val)
             if(IsWritable(ptrFloat))
             {
                 ptrFloat->SetValue(val);
+                mExposure = val;
                 return true;
             }
         }
@@ -470,6 +595,7 @@ bool GeniCamCamera::setParameter(cmrCameraParameter param, float val)
                 if(IsWritable(ptrInt))
                 {
                     ptrInt->SetValue(val);
+                    mExposure = val;
                     return true;
                 }
             }
@@ -30,6 +30,8 @@ protected:
 
 private:
     bool mStreaming = false;
+    //Last exposure set while streaming, us
+    float mExposure = 0;
     void startStreaming();
     std::shared_ptr<rcg::Device> mDevice;
 };
@@ -27,7 +27,7 @@
 */
 
 #include "PGMCamera.h"
-#include "MainWindow.h"
+#include "ppm.h"
 #include "RawProcessor.h"
 
 PGMCamera::PGMCamera(const QString &fileName,
@@ -154,10 +154,19 @@ void PGMCamera::startStreaming()
     if(!mInputImage.data)
         return;
 
+    FrameMetadata meta;
+    meta.exposure = 1000000.F / mFPS;
     while(mState == cstStreaming)
     {
-        cudaMemcpy(mInputBuffer.getBuffer(), mInputImage.data.get(), mInputImage.wPitch * mInputImage.h, cudaMemcpyHostToDevice);
-        mInputBuffer.release();
+        meta.seq++;
+        meta.hostTimestamp = FrameMetadata::now();
+
+        unsigned char* dst = mInputBuffer.acquire();
+        if(dst != nullptr)
+        {
+            mInputBuffer.upload(dst, mInputImage.data.get(), mInputImage.wPitch * mInputImage.h);
+            mInputBuffer.commit(meta);
+        }
         QThread::msleep(1000 / mFPS);
 
         {
@@ -192,9 +201,12 @@ bool PGMCamera::getParameter(cmrCameraParameter param, float& val)
 
 bool PGMCamera::setParameter(cmrCameraParameter param, float val)
 {
-    Q_UNUSED(param)
-    Q_UNUSED(val)
-    return false;
+    //Frame rate is the only simulated parameter, used to load processing in benchmarks
+    if(param != prmFrameRate || val <= 0)
+        return false;
+
+    mFPS = val;
+    return true;
 }
 
 bool PGMCamera::getParameterInfo(cmrParameterInfo& info)
@@ -0,0 +1,195 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "RawFileCamera.h"
+#include "RawProcessor.h"
+
+RawFileCamera::RawFileCamera(const QString& fileName) :
+    mFileName(fileName)
+{
+    mCameraThread.setObjectName(QStringLiteral("RawFileCameraThread"));
+    moveToThread(&mCameraThread);
+    mCameraThread.start();
+}
+
+RawFileCamera::~RawFileCamera()
+{
+    mCameraThread.quit();
+    mCameraThread.wait(3000);
+}
+
+bool RawFileCamera::open(uint32_t devID)
+{
+    Q_UNUSED(devID)
+
+    mState = cstClosed;
+
+    mManufacturer = QStringLiteral("Fastvideo");
+    mModel = QStringLiteral("Raw file player");
+    mSerial = QStringLiteral("0000");
+
+    if(!mReader.open(mFileName) || mReader.frameCount() == 0)
+        return false;
+
+    const RawContainer::FileHeader& header = mReader.header();
+    mWidth = int(header.width);
+    mHeight = int(header.height);
+    mSurfaceFormat = static_cast<fastSurfaceFormat_t>(header.surfaceFmt);
+    mPattern = static_cast<fastBayerPattern_t>(header.pattern);
+    mIsColor = header.isColor != 0;
+    mWhite = int(header.whiteLevel);
+    mBblack = int(header.blackLevel);
+
+    if(header.bitsPerChannel <= 8)
+        mImageFormat = cif8bpp;
+    else if(header.bitsPerChannel <= 10)
+        mImageFormat = cif10bpp;
+    else if(header.bitsPerChannel <= 12)
+        mImageFormat = cif12bpp;
+    else
+        mImageFormat = cif16bpp;
+
+    mInputBuffer.allocate(mWidth, mHeight, mSurfaceFormat);
+
+    //Frames are uploaded as is, rows have to match input buffer
+    if(unsigned(mInputBuffer.pitch()) != header.pitch)
+    {
+        mReader.close();
+        return false;
+    }
+
+    //Recorded frame rate
+    mFPS = 30;
+    FrameMetadata first;
+    FrameMetadata last;
+    mReader.frame(0, &first);
+    mReader.frame(mReader.frameCount() - 1, &last);
+    if(mReader.frameCount() > 1 && last.hostTimestamp > first.hostTimestamp)
+        mFPS = float((mReader.frameCount() - 1) * 1000000000. / (last.hostTimestamp - first.hostTimestamp));
+
+    mState = cstStopped;
+    emit stateChanged(cstStopped);
+    return true;
+}
+
+bool RawFileCamera::start()
+{
+    mState = cstStreaming;
+    emit stateChanged(cstStreaming);
+    QTimer::singleShot(0, this, [this](){startStreaming();});
+    return true;
+}
+
+bool RawFileCamera::stop()
+{
+    mState = cstStopped;
+    emit stateChanged(cstStopped);
+
+    return true;
+}
+
+void RawFileCamera::close()
+{
+    stop();
+    mReader.close();
+    mState = cstClosed;
+    emit stateChanged(cstClosed);
+}
+
+void RawFileCamera::startStreaming()
+{
+    if(mState != cstStreaming)
+        return;
+
+    if(!mReader.isOpened())
+        return;
+
+    //Sequence keeps growing when file is looped
+    quint64 seq = 0;
+    int index = 0;
+    while(mState == cstStreaming)
+    {
+        FrameMetadata meta;
+        unsigned size = 0;
+        const unsigned char* src = mReader.frame(index, &meta, &size);
+        index = (index + 1) % mReader.frameCount();
+
+        meta.seq = ++seq;
+        meta.hostTimestamp = FrameMetadata::now();
+
+        unsigned char* dst = mInputBuffer.acquire();
+        if(dst != nullptr)
+        {
+            mInputBuffer.upload(dst, src, size);
+            mInputBuffer.commit(meta);
+        }
+        QThread::usleep(static_cast<unsigned long>(1000000 / mFPS));
+
+        {
+            QMutexLocker l(&mLock);
+            mRawProc->wake();
+        }
+    }
+}
+
+bool RawFileCamera::getParameter(cmrCameraParameter param, float& val)
+{
+    if(param < 0 || param > prmLast)
+        return false;
+
+    switch (param)
+    {
+    case prmFrameRate:
+        val = mFPS;
+        return true;
+
+    case prmExposureTime:
+        val = 1000 / mFPS;
+        return true;
+
+    default:
+        break;
+    }
+
+    return false;
+}
+
+bool RawFileCamera::setParameter(cmrCameraParameter param, float val)
+{
+    if(param != prmFrameRate || val <= 0)
+        return false;
+
+    mFPS = val;
+    return true;
+}
+
+bool RawFileCamera::getParameterInfo(cmrParameterInfo& info)
+{
+    Q_UNUSED(info)
+    return false;
+}
@@ -29,7 +29,7 @@
 #ifdef SUPPORT_XIMEA
 #include "XimeaCamera.h"
 
-#include "MainWindow.h"
+#include <QDebug>
 #include "RawProcessor.h"
 
 #include <QByteArray>
@@ -221,18 +221,28 @@ void XimeaCamera::startStreaming()
     image.bp_size = frameData.size();
     image.bp = frameData.data();
 
-    QElapsedTimer tmr;
+    FrameMetadata meta;
     while(mState == cstStreaming)
     {
-        tmr.restart();
         ret = xiGetImage(hDevice, 5000, &image);
-        unsigned char* dst = mInputBuffer.getBuffer();
-        cudaMemcpy(dst, frameData.data(), image.bp_size, cudaMemcpyHostToDevice);
-        mInputBuffer.release();
+        if(ret != XI_OK)
+            continue;
+
+        meta.hostTimestamp = FrameMetadata::now();
+        meta.seq = image.nframe;
+        meta.sensorTimestamp = qint64(image.tsSec) * 1000000000 + qint64(image.tsUSec) * 1000;
+        meta.exposure = image.exposure_time_us;
+        meta.gain = image.gain_db;
+
+        unsigned char* dst = mInputBuffer.acquire();
+        if(dst != nullptr)
+        {
+            uploadFrame(dst, frameData.data(), image.bp_size);
+            mInputBuffer.commit(meta);
+        }
 
         {
             QMutexLocker l(&mLock);
-            mRawProc->acqTimeNsec = tmr.nsecsElapsed();
             mRawProc->wake();
         }
     }
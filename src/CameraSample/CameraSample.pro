@@ -6,13 +6,33 @@ include(../common_funcs.pri)
 win32: include(../common.pri)
 unix:  include(../common_unix.pri)
 
+# qmake CONFIG+=host_only
+# Camera frames are kept in host memory and processed by CPUProcessor.
+# GPU processors are not built, neither CUDA nor Fastvideo SDK is needed.
+host_only {
+    DEFINES += HOST_ONLY
+    include($$PWD/host_only/host_only.pri)
+}
+
+# qmake CONFIG+=uring
+# Raw container recording can bypass page cache with O_DIRECT and io_uring, requires liburing.
+unix:uring {
+    DEFINES += USE_URING
+    LIBS += -luring
+}
+
+# CPU processor runs image stripes in parallel with OpenMP, win32 gets /openmp from common.pri
+unix {
+    QMAKE_CXXFLAGS += -fopenmp
+    LIBS += -fopenmp
+}
+
 TARGET = $$PROJECT_NAME
 TEMPLATE = app
 
 #INCLUDEPATH += ./CUDASupport
 #INCLUDEPATH += ./Camera
 #INCLUDEPATH += ./Widgets
-INCLUDEPATH += $$OTHER_LIB_PATH/FastvideoSDK/core_samples
 INCLUDEPATH += $$PWD
 INCLUDEPATH += $$PWD/CUDASupport
 INCLUDEPATH += $$PWD/Widgets
@@ -24,27 +44,34 @@ SOURCES += main.cpp\
     Widgets/GLImageViewer.cpp \
     Globals.cpp \
     AppSettings.cpp \
-    CUDASupport/CUDAProcessorBase.cpp \
+    CUDASupport/ProcessorBase.cpp \
     FFCReader.cpp \
     FPNReader.cpp \
     ppm.cpp \
-    helper_jpeg_load.cpp \
-    helper_jpeg_store.cpp \
     Widgets/DenoiseController.cpp \
     Camera/CameraBase.cpp \
     Camera/FrameBuffer.cpp \
     Camera/PGMCamera.cpp \
+    Camera/RawFileCamera.cpp \
     RawProcessor.cpp \
     AsyncFileWriter.cpp \
-    $$OTHER_LIB_PATH/FastvideoSDK/common/SurfaceTraits.cpp \
-    $$OTHER_LIB_PATH/FastvideoSDK/common/alignment.cpp \
-    CUDASupport/CUDAProcessorGray.cpp \
+    PreTriggerBuffer.cpp \
+    SegmentRotation.cpp \
+    JpegQualityController.cpp \
+    Metrics.cpp \
+    CUDASupport/CPUProcessor.cpp \
+    CUDASupport/CPUKernels.cpp \
     MJPEGEncoder.cpp \
+    AviMuxer.cpp \
+    RawContainer.cpp \
+    DirectFileWriter.cpp \
     Camera/GeniCamCamera.cpp \
     Widgets/GtGWidget.cpp \
     Widgets/CameraSetupWidget.cpp \
     RtspServer/CTPTransport.cpp \
     RtspServer/JpegEncoder.cpp \
+    RtspServer/JfifParser.cpp \
+    RtspServer/JpegParallelEncoder.cpp \
     RtspServer/RTSPStreamerServer.cpp \
     RtspServer/TcpClient.cpp \
     RtspServer/vutils.cpp
@@ -82,38 +109,66 @@ contains( DEFINES, SUPPORT_XIMEA ){
    SOURCES += Camera/XimeaCamera.cpp
 }
 
-win32: SOURCES += $$OTHER_LIB_PATH/FastvideoSDK/core_samples/SurfaceTraitsInternal.cpp
+!host_only {
+    INCLUDEPATH += $$OTHER_LIB_PATH/FastvideoSDK/core_samples
+
+    SOURCES += CUDASupport/CUDAProcessorBase.cpp \
+        CUDASupport/CUDAProcessorGray.cpp \
+        helper_jpeg_load.cpp \
+        helper_jpeg_store.cpp \
+        $$OTHER_LIB_PATH/FastvideoSDK/common/SurfaceTraits.cpp \
+        $$OTHER_LIB_PATH/FastvideoSDK/common/alignment.cpp
+
+    win32: SOURCES += $$OTHER_LIB_PATH/FastvideoSDK/core_samples/SurfaceTraitsInternal.cpp
+
+    HEADERS += CUDASupport/CUDAProcessorBase.h \
+        CUDASupport/CUDAProcessorGray.h \
+        CUDASupport/CudaAllocator.h \
+        helper_jpeg.hpp
+}
 
 HEADERS  += MainWindow.h \
     Widgets/GLImageViewer.h \
     CUDASupport/CUDAProcessorOptions.h \
     Globals.h \
     AppSettings.h \
-    CUDASupport/CUDAProcessorBase.h \
+    CUDASupport/ProcessorBase.h \
     FFCReader.h \
     FPNReader.h \
     ppm.h \
-    helper_jpeg.hpp \
     Widgets/DenoiseController.h \
     Camera/CameraBase.h \
     Camera/XimeaCamera.h \
     Camera/FrameBuffer.h \
+    Camera/FrameMetadata.h \
     Camera/PGMCamera.h \
+    Camera/RawFileCamera.h \
     RawProcessor.h \
     AsyncFileWriter.h \
+    PreTriggerBuffer.h \
+    SegmentRotation.h \
+    JpegQualityController.h \
     AsyncQueue.h \
-    CUDASupport/CUDAProcessorGray.h \
+    PipelineScheduler.h \
+    Metrics.h \
+    CUDASupport/CPUProcessor.h \
+    CUDASupport/CPUKernels.h \
     MJPEGEncoder.h \
+    AviMuxer.h \
+    RawContainer.h \
+    DirectFileWriter.h \
     Camera/GeniCamCamera.h \
     Widgets/GtGWidget.h \
     Widgets/CameraSetupWidget.h \
     RtspServer/common_utils.h \
     RtspServer/CTPTransport.h \
     RtspServer/JpegEncoder.h \
+    RtspServer/JfifParser.h \
+    RtspServer/JpegParallelEncoder.h \
     RtspServer/RTSPStreamerServer.h \
     RtspServer/TcpClient.h \
     RtspServer/vutils.h \
-    CUDASupport/CudaAllocator.h \
+    CUDASupport/MemoryBackend.h \
     CUDASupport/GPUImage.h
     version.h
 
@@ -149,8 +204,10 @@ win32 {
         copyToDestdir($$[QT_INSTALL_BINS]/$$ifile)
     }
 
-    copyToDestdir($$FASTVIDEO_DLL)
-    copyToDestdir($$CUDA_DLL)
+    !host_only {
+        copyToDestdir($$FASTVIDEO_DLL)
+        copyToDestdir($$CUDA_DLL)
+    }
 }
 copyToDestdir($$FASTVIDEO_EXTRA_DLLS)
 
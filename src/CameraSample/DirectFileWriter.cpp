@@ -0,0 +1,346 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "DirectFileWriter.h"
+#include "Metrics.h"
+
+#include <cstring>
+#include <cerrno>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    /// O_DIRECT needs offsets, sizes and memory aligned to logical block size
+    const unsigned DirectAlignment = 4096;
+    /// Data is submitted to io_uring in blocks of this size
+    const unsigned BlockSize = 4 * 1024 * 1024;
+}
+
+DirectFileWriter::~DirectFileWriter()
+{
+    close();
+}
+
+bool DirectFileWriter::open(const QString& fileName, int queueDepth)
+{
+    close();
+
+    mPos = 0;
+    mWritten = 0;
+    mAllocated = 0;
+    mFailed = false;
+    mBackend = wbBuffered;
+
+#ifdef USE_URING
+    if(queueDepth > 0 && openUring(fileName, queueDepth))
+        mBackend = wbUring;
+#else
+    Q_UNUSED(queueDepth)
+#endif
+
+    if(mBackend == wbBuffered)
+    {
+        mFile.setFileName(fileName);
+        if(!mFile.open(QFile::WriteOnly | QFile::Truncate | QFile::Unbuffered))
+            return false;
+    }
+
+    mOpened = true;
+    mTimer.start();
+    return true;
+}
+
+void DirectFileWriter::close()
+{
+    if(!mOpened)
+        return;
+
+#ifdef USE_URING
+    if(mBackend == wbUring)
+        closeUring();
+#endif
+
+    if(mBackend == wbBuffered)
+    {
+        //Drop preallocated space left
+        mFile.resize(qint64(mPos));
+        mFile.close();
+    }
+    mOpened = false;
+}
+
+bool DirectFileWriter::write(const void* data, quint64 size)
+{
+    if(size == 0)
+        return !mFailed;
+    if(!mOpened || mFailed || data == nullptr)
+        return false;
+
+    bool ret = false;
+    if(mBackend == wbBuffered)
+        ret = writeBuffered(data, size);
+#ifdef USE_URING
+    else
+        ret = writeUring(data, size);
+#endif
+
+    if(!ret)
+        mFailed = true;
+    mWritten.store(mPos, std::memory_order_relaxed);
+    return ret;
+}
+
+bool DirectFileWriter::writeBuffered(const void* data, quint64 size)
+{
+    const qint64 start = FrameMetadata::now();
+    if(mFile.write(static_cast<const char*>(data), qint64(size)) != qint64(size))
+        return false;
+
+    //Small writes like chunk headers would only blur the histogram
+    if(size >= DirectAlignment)
+        Metrics::recordNs(Metrics::mtDiskWrite, FrameMetadata::now() - start);
+
+    mPos += size;
+    return true;
+}
+
+bool DirectFileWriter::preallocate(quint64 size)
+{
+    if(!mOpened)
+        return false;
+    if(size <= mAllocated)
+        return true;
+
+#ifdef Q_OS_LINUX
+    int fd = mFile.handle();
+#ifdef USE_URING
+    if(mBackend == wbUring)
+        fd = mFd;
+#endif
+    //Reserves blocks without writing zeros. No emulation by writing,
+    //it would not work with O_DIRECT, so space is not reserved where unsupported.
+    if(fallocate(fd, 0, off_t(mAllocated), off_t(size - mAllocated)) != 0)
+        return false;
+#else
+    if(!mFile.resize(qint64(size)))
+        return false;
+#endif
+
+    mAllocated = size;
+    return true;
+}
+
+QString DirectFileWriter::backendName(Backend backend)
+{
+    switch(backend)
+    {
+    case wbUring:
+        return QStringLiteral("O_DIRECT io_uring");
+    default:
+        return QStringLiteral("buffered");
+    }
+}
+
+double DirectFileWriter::throughput() const
+{
+    if(!mTimer.isValid() || mTimer.elapsed() <= 0)
+        return 0;
+
+    return mWritten.load(std::memory_order_relaxed) / (1024. * 1024.) / (mTimer.elapsed() / 1000.);
+}
+
+#ifdef USE_URING
+bool DirectFileWriter::openUring(const QString& fileName, int queueDepth)
+{
+    mFd = ::open(QFile::encodeName(fileName).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if(mFd < 0)
+        return false;
+
+    if(io_uring_queue_init(unsigned(queueDepth), &mRing, 0) < 0)
+    {
+        ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    mBlocks.assign(size_t(queueDepth), Block());
+    mMemory.clear();
+    try
+    {
+        FastAllocator alloc;
+        for(auto& block : mBlocks)
+        {
+            //Allocator alignment is not guaranteed to be enough for O_DIRECT
+            unsigned char* mem = static_cast<unsigned char*>(alloc.allocate(BlockSize + DirectAlignment));
+            mMemory.emplace_back(mem);
+            block.data = reinterpret_cast<unsigned char*>(
+                        (reinterpret_cast<quintptr>(mem) + DirectAlignment - 1) & ~quintptr(DirectAlignment - 1));
+        }
+    }
+    catch(...)
+    {
+        io_uring_queue_exit(&mRing);
+        ::close(mFd);
+        mFd = -1;
+        mBlocks.clear();
+        mMemory.clear();
+        return false;
+    }
+
+    mCurrent = 0;
+    mInFlight = 0;
+    return true;
+}
+
+void DirectFileWriter::closeUring()
+{
+    //Last block is padded to alignment, file is trimmed afterwards
+    Block& block = mBlocks[mCurrent];
+    if(!mFailed && !block.busy && block.size > 0)
+    {
+        const unsigned size = (block.size + DirectAlignment - 1) / DirectAlignment * DirectAlignment;
+        memset(block.data + block.size, 0, size - block.size);
+        block.size = size;
+        submit(block);
+    }
+
+    while(mInFlight > 0 && reap(true))
+    {
+    }
+
+    if(ftruncate(mFd, off_t(mPos)) != 0)
+        mFailed = true;
+
+    io_uring_queue_exit(&mRing);
+    ::close(mFd);
+    mFd = -1;
+    mBlocks.clear();
+    mMemory.clear();
+}
+
+bool DirectFileWriter::writeUring(const void* data, quint64 size)
+{
+    const unsigned char* src = static_cast<const unsigned char*>(data);
+    while(size > 0)
+    {
+        Block& block = mBlocks[mCurrent];
+
+        //Block is still written from the previous round, queue is full
+        while(block.busy)
+        {
+            if(!reap(true))
+                return false;
+        }
+
+        if(block.size == 0)
+            block.offset = mPos;
+
+        const unsigned count = unsigned(qMin<quint64>(BlockSize - block.size, size));
+        memcpy(block.data + block.size, src, count);
+        block.size += count;
+        src += count;
+        size -= count;
+        mPos += count;
+
+        if(block.size == BlockSize)
+        {
+            if(!submit(block))
+                return false;
+            mCurrent = (mCurrent + 1) % mBlocks.size();
+        }
+    }
+
+    //Collect finished writes without waiting
+    while(mInFlight > 0 && reap(false))
+    {
+    }
+    return !mFailed;
+}
+
+bool DirectFileWriter::submit(Block& block)
+{
+    //Ring has an entry for every block, so there is always one free
+    io_uring_sqe* sqe = io_uring_get_sqe(&mRing);
+    if(sqe == nullptr)
+        return false;
+
+    io_uring_prep_write(sqe, mFd, block.data, block.size, block.offset);
+    io_uring_sqe_set_data(sqe, &block);
+    block.busy = true;
+    block.submitted = FrameMetadata::now();
+
+    if(io_uring_submit(&mRing) < 1)
+    {
+        block.busy = false;
+        return false;
+    }
+    mInFlight++;
+    return true;
+}
+
+bool DirectFileWriter::reap(bool wait)
+{
+    io_uring_cqe* cqe = nullptr;
+    int ret = 0;
+    if(wait)
+    {
+        do
+        {
+            ret = io_uring_wait_cqe(&mRing, &cqe);
+        }
+        while(ret == -EINTR);
+    }
+    else
+    {
+        ret = io_uring_peek_cqe(&mRing, &cqe);
+    }
+
+    if(ret < 0 || cqe == nullptr)
+    {
+        //Nothing finished yet is not an error
+        if(wait)
+            mFailed = true;
+        return false;
+    }
+
+    Block* block = static_cast<Block*>(io_uring_cqe_get_data(cqe));
+    if(cqe->res < 0 || unsigned(cqe->res) != block->size)
+        mFailed = true;
+    io_uring_cqe_seen(&mRing, cqe);
+
+    Metrics::recordNs(Metrics::mtDiskWrite, FrameMetadata::now() - block->submitted);
+    block->busy = false;
+    block->size = 0;
+    mInFlight--;
+    return !mFailed;
+}
+#endif
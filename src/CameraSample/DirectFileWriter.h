@@ -0,0 +1,120 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef DIRECTFILEWRITER_H
+#define DIRECTFILEWRITER_H
+
+#include <QFile>
+#include <QString>
+#include <QElapsedTimer>
+
+#include <memory>
+#include <vector>
+#include <atomic>
+
+#include "FastAllocator.h"
+
+#ifdef USE_URING
+#include <liburing.h>
+#endif
+
+/// Sequential file writer for sustained raw recording.
+/// Direct backend (Linux, qmake CONFIG+=uring) opens the file with O_DIRECT,
+/// copies data into aligned blocks and submits them to io_uring with up to
+/// queue depth blocks in flight, so recording does not go through the page cache.
+/// Buffered QFile writes are used if direct backend is not requested,
+/// not built or not supported by kernel or filesystem.
+/// Write errors are sticky, all writes after the first failed one fail too.
+class DirectFileWriter
+{
+public:
+    typedef enum{
+        wbBuffered = 0,
+        wbUring
+    } Backend;
+
+    DirectFileWriter() = default;
+    ~DirectFileWriter();
+
+    /// queueDepth > 0 asks for direct backend with this number of blocks in flight
+    bool open(const QString& fileName, int queueDepth = 0);
+    /// Writes data left, waits for blocks in flight and trims file to written size
+    void close();
+    bool isOpened() const {return mOpened;}
+
+    /// Appends data at pos()
+    bool write(const void* data, quint64 size);
+    /// Reserves file space up to size bytes
+    bool preallocate(quint64 size);
+
+    quint64 pos() const {return mPos;}
+    Backend backend() const {return mBackend;}
+    static QString backendName(Backend backend);
+    /// Average write speed since open, MB/s
+    double throughput() const;
+
+private:
+    bool writeBuffered(const void* data, quint64 size);
+
+    QFile   mFile;
+    Backend mBackend = wbBuffered;
+    bool    mOpened = false;
+    bool    mFailed = false;
+    quint64 mPos = 0;
+    quint64 mAllocated = 0;
+    /// mPos for stats readers on other threads
+    std::atomic<quint64> mWritten {0};
+    QElapsedTimer mTimer;
+
+#ifdef USE_URING
+    struct Block
+    {
+        unsigned char* data = nullptr;
+        quint64 offset = 0;
+        unsigned size = 0;
+        qint64 submitted = 0;
+        bool busy = false;
+    };
+
+    bool openUring(const QString& fileName, int queueDepth);
+    void closeUring();
+    bool writeUring(const void* data, quint64 size);
+    bool submit(Block& block);
+    /// Takes one completion, waits for it if wait is set
+    bool reap(bool wait);
+
+    int mFd = -1;
+    io_uring mRing {};
+    std::vector<std::unique_ptr<unsigned char, FastAllocator>> mMemory;
+    std::vector<Block> mBlocks;
+    size_t  mCurrent = 0;
+    int     mInFlight = 0;
+#endif
+};
+
+#endif // DIRECTFILEWRITER_H
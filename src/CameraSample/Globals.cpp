@@ -29,7 +29,7 @@
 #include "Globals.h"
 #include <QFileInfo>
 #include <QDir>
-#include <QApplication>
+#include <QCoreApplication>
 
 
 bool Globals::gEnableLog = false;
@@ -0,0 +1,165 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "JpegQualityController.h"
+
+namespace
+{
+    /// Adjustments kept for history
+    const int HistorySize = 64;
+    /// Bandwidth within this band around target is held
+    const double BandwidthHigh = 1.05;
+    const double BandwidthLow = 0.9;
+    /// Fast average above slow one by this factor is a growing frame size
+    const double TrendFactor = 1.2;
+}
+
+void JpegQualityController::setSettings(const Settings& settings)
+{
+    QMutexLocker lock(&mLock);
+    mSettings = settings;
+    mSettings.minQuality = qBound(1u, mSettings.minQuality, 100u);
+    mSettings.maxQuality = qBound(mSettings.minQuality, mSettings.maxQuality, 100u);
+    mSettings.step = qMax(mSettings.step, 1u);
+}
+
+JpegQualityController::Settings JpegQualityController::settings() const
+{
+    QMutexLocker lock(&mLock);
+    return mSettings;
+}
+
+void JpegQualityController::start(unsigned quality)
+{
+    QMutexLocker lock(&mLock);
+    mQuality = qBound(mSettings.minQuality, quality, mSettings.maxQuality);
+    mDropped = false;
+    mFastBytes = 0;
+    mSlowBytes = 0;
+    mInterval = 0;
+    mLastTimestamp = 0;
+    mSinceChange = 0;
+    mChanges = 0;
+    mHistory.clear();
+    mActive = mSettings.enabled;
+}
+
+void JpegQualityController::stop()
+{
+    mActive = false;
+}
+
+void JpegQualityController::update(double load, unsigned frameBytes, qint64 timestamp)
+{
+    if(!mActive)
+        return;
+
+    QMutexLocker lock(&mLock);
+
+    if(mFastBytes == 0)
+    {
+        mFastBytes = frameBytes;
+        mSlowBytes = frameBytes;
+    }
+    mFastBytes += (frameBytes - mFastBytes) * 0.3;
+    mSlowBytes += (frameBytes - mSlowBytes) * 0.05;
+
+    if(mLastTimestamp > 0 && timestamp > mLastTimestamp)
+    {
+        const double interval = double(timestamp - mLastTimestamp);
+        mInterval = mInterval > 0 ? mInterval + (interval - mInterval) * 0.1 : interval;
+    }
+    mLastTimestamp = timestamp;
+    const double bandwidth = mInterval > 0 ? mFastBytes * 1000000000. / mInterval : 0;
+
+    const bool dropped = mDropped.exchange(false);
+    if(++mSinceChange < mSettings.holdFrames && !dropped)
+        return;
+
+    const double target = mSettings.targetBandwidth;
+    int delta = 0;
+    if(dropped || load >= mSettings.highLoad)
+        delta = -int(mSettings.step);
+    else if(target > 0 && bandwidth > target * BandwidthHigh)
+        delta = -1;
+    else if(load > mSettings.lowLoad && mFastBytes > mSlowBytes * TrendFactor)
+        delta = -1;
+    else if(load <= mSettings.lowLoad && (target <= 0 || bandwidth < target * BandwidthLow))
+        delta = 1;
+
+    apply(delta, load, timestamp);
+}
+
+void JpegQualityController::apply(int delta, double load, qint64 timestamp)
+{
+    if(delta == 0)
+        return;
+
+    const unsigned quality = unsigned(qBound(int(mSettings.minQuality),
+                                             int(mQuality) + delta,
+                                             int(mSettings.maxQuality)));
+    if(quality == mQuality)
+        return;
+
+    mQuality = quality;
+    mSinceChange = 0;
+    mChanges++;
+
+    Adjustment adjustment;
+    adjustment.timestamp = timestamp;
+    adjustment.quality = quality;
+    adjustment.load = load;
+    adjustment.bandwidth = mInterval > 0 ? mFastBytes * 1000000000. / mInterval : 0;
+    if(mHistory.size() >= HistorySize)
+        mHistory.removeFirst();
+    mHistory.append(adjustment);
+}
+
+int JpegQualityController::changes() const
+{
+    QMutexLocker lock(&mLock);
+    return mChanges;
+}
+
+double JpegQualityController::bytesPerFrame() const
+{
+    QMutexLocker lock(&mLock);
+    return mFastBytes;
+}
+
+double JpegQualityController::bandwidth() const
+{
+    QMutexLocker lock(&mLock);
+    return mInterval > 0 ? mFastBytes * 1000000000. / mInterval : 0;
+}
+
+QVector<JpegQualityController::Adjustment> JpegQualityController::history() const
+{
+    QMutexLocker lock(&mLock);
+    return mHistory;
+}
@@ -0,0 +1,112 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef JPEGQUALITYCONTROLLER_H
+#define JPEGQUALITYCONTROLLER_H
+
+#include <QMutex>
+#include <QVector>
+
+#include <atomic>
+
+/// Closed loop JPEG quality control for recording and streaming.
+/// Output load (writer buffers in use, RTSP queue) and bytes per frame are fed
+/// after every encoded frame. Quality goes down by a step when the load is high,
+/// a frame was dropped or the target bandwidth is exceeded, and goes back up one
+/// at a time when the load is low and there is bandwidth left. After a change
+/// the controller holds the quality for a number of frames, so the effect of the
+/// change is seen before the next one.
+class JpegQualityController
+{
+public:
+    struct Settings
+    {
+        bool     enabled = false;
+        unsigned minQuality = 50;
+        unsigned maxQuality = 95;
+        /// Load 0..1 at which quality goes down and below which it can go up
+        double   highLoad = 0.75;
+        double   lowLoad = 0.25;
+        /// Bytes per second to hold, 0 follows the load only
+        double   targetBandwidth = 0;
+        unsigned step = 5;
+        /// Frames after a change before the next one
+        int      holdFrames = 30;
+    };
+
+    struct Adjustment
+    {
+        /// Capture time of the frame which caused the change, ns
+        qint64   timestamp = 0;
+        unsigned quality = 0;
+        double   load = 0;
+        /// Estimated output, bytes per second
+        double   bandwidth = 0;
+    };
+
+    void setSettings(const Settings& settings);
+    Settings settings() const;
+
+    /// Starts control from quality, clamped to the bounds
+    void start(unsigned quality);
+    void stop();
+    bool isActive() const {return mActive;}
+
+    /// Quality for the next frame
+    unsigned quality() const {return mQuality;}
+    /// Feeds load and size of an encoded frame, can change quality
+    void update(double load, unsigned frameBytes, qint64 timestamp);
+    /// Output had no room for a frame, quality goes down with the next update
+    void dropped() {mDropped = true;}
+
+    int    changes() const;
+    double bytesPerFrame() const;
+    double bandwidth() const;
+    /// Last changes, oldest first
+    QVector<Adjustment> history() const;
+
+private:
+    void apply(int delta, double load, qint64 timestamp);
+
+    mutable QMutex mLock;
+    Settings mSettings;
+    std::atomic<bool> mActive {false};
+    std::atomic<unsigned> mQuality {0};
+    std::atomic<bool> mDropped {false};
+
+    //Averages of frame size, fast one follows scene changes, slow one is the trend base
+    double mFastBytes = 0;
+    double mSlowBytes = 0;
+    double mInterval = 0;
+    qint64 mLastTimestamp = 0;
+    int    mSinceChange = 0;
+    int    mChanges = 0;
+    QVector<Adjustment> mHistory;
+};
+
+#endif // JPEGQUALITYCONTROLLER_H
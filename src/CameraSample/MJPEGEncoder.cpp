@@ -65,6 +65,9 @@ MJPEGEncoder::MJPEGEncoder(int width,
     }
 
     mFramesProcessed = 0;
+    mFps = fps;
+    mFirstTimestamp = 0;
+    mLastPts = -1;
 
     out_stream = avformat_new_stream(mFmtCtx, nullptr);
     if(!out_stream)
@@ -150,7 +153,7 @@ MJPEGEncoder::~MJPEGEncoder()
     close();
 }
 
-bool MJPEGEncoder::addJPEGFrame(unsigned char *jpgPtr, int jpgSize)
+bool MJPEGEncoder::addJPEGFrame(unsigned char *jpgPtr, int jpgSize, const FrameMetadata* meta)
 {
     if(mErr < 0)
         return false;
@@ -173,8 +176,22 @@ bool MJPEGEncoder::addJPEGFrame(unsigned char *jpgPtr, int jpgSize)
     videoPkt.stream_index = 0; //Output video stream
     videoPkt.data= jpgPtr;
     videoPkt.size = jpgSize;
-    videoPkt.pts = mFramesProcessed;
-    videoPkt.dts = mFramesProcessed;
+
+    //Stream time base is 1/fps, so a gap in capture time
+    //becomes a gap in pts and the muxer keeps real timing
+    qint64 pts = mFramesProcessed;
+    if(meta != nullptr && meta->hostTimestamp > 0)
+    {
+        if(mFirstTimestamp == 0)
+            mFirstTimestamp = meta->hostTimestamp;
+        pts = av_rescale(meta->hostTimestamp - mFirstTimestamp, mFps, 1000000000);
+    }
+    if(pts <= mLastPts)
+        pts = mLastPts + 1;
+    mLastPts = pts;
+
+    videoPkt.pts = pts;
+    videoPkt.dts = pts;
 
     mFramesProcessed++;
 
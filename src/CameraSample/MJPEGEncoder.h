@@ -32,6 +32,7 @@
 #include <QString>
 #include <QMutex>
 #include "fastvideo_sdk.h"
+#include "FrameMetadata.h"
 
 struct AVFormatContext;
 struct AVFrame;
@@ -46,11 +47,15 @@ public:
                  const QString& outFileName);
     ~MJPEGEncoder();
     bool isOpened(){return mErr >= 0;}
-    bool addJPEGFrame(unsigned char *jpgPtr, int jpgSize);
+    ///Frame presentation time is taken from capture timestamp if meta is set
+    bool addJPEGFrame(unsigned char *jpgPtr, int jpgSize, const FrameMetadata* meta = nullptr);
     void close();
 private:
     AVFormatContext* mFmtCtx = nullptr;
     int mFramesProcessed = 0;
+    int mFps = 0;
+    qint64 mFirstTimestamp = 0;
+    qint64 mLastPts = -1;
     int mErr = 0;
 
     QMutex mLock;
@@ -31,15 +31,19 @@
 
 #include <QTimer>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
+#include <QDebug>
 
 #include <iterator>
 
 #include "ppm.h"
 #include "PGMCamera.h"
+#include "RawFileCamera.h"
 #include "RawProcessor.h"
 #include "FPNReader.h"
 #include "FFCReader.h"
+#include "SurfaceTraits.hpp"
 //#include "GtGWidget.h"
 
 #ifdef SUPPORT_XIMEA
@@ -60,12 +64,14 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->setupUi(this);
 
     int devCount = 0;
-    cudaGetDeviceCount(&devCount);
+#ifndef HOST_ONLY
+    if(cudaGetDeviceCount(&devCount) != cudaSuccess)
+        devCount = 0;
+#endif
 
+    //Without CUDA device camera frames are kept in host memory and processed on CPU
     if(devCount == 0)
-    {
-        return;
-    }
+        ImageAllocator::setDefaultBackend(mbHost);
 
     mRendererPtr.reset(new GLRenderer());
 
@@ -92,6 +98,7 @@ MainWindow::MainWindow(QWidget *parent) :
         gammaSRGB[i] = static_cast<unsigned short>(y * 65535);
     }
 
+#ifndef HOST_ONLY
     cudaDeviceProp devProps;
     for(int i = 0; i < devCount; i++)
     {
@@ -99,6 +106,10 @@ MainWindow::MainWindow(QWidget *parent) :
             continue;
         ui->cboCUDADevice->addItem(QString::fromLatin1(devProps.name), QVariant(i));
     }
+#endif
+    ui->cboCUDADevice->addItem(QStringLiteral("CPU"), QVariant(-1));
+    if(devCount == 0)
+        ui->cboCUDADevice->setCurrentIndex(ui->cboCUDADevice->count() - 1);
     {
         QSignalBlocker b(ui->cboBayerPattern);
         ui->cboBayerPattern->addItem("RGGB", FAST_BAYER_RGGB);
@@ -130,6 +141,7 @@ MainWindow::MainWindow(QWidget *parent) :
         ui->cboOutFormat->addItem(QStringLiteral("JPEG"), CUDAProcessorOptions::vcJPG);
         ui->cboOutFormat->addItem(QStringLiteral("Motion JPEG"), CUDAProcessorOptions::vcMJPG);
         ui->cboOutFormat->addItem(QStringLiteral("PGM"), CUDAProcessorOptions::vcPGM);
+        ui->cboOutFormat->addItem(QStringLiteral("Raw container"), CUDAProcessorOptions::vcRAW);
     }
 
     QSignalBlocker b3(ui->cboGamma);
@@ -229,6 +241,10 @@ void MainWindow::initNewCamera(CameraBase* cmr, uint32_t devID)
             this,
             SLOT(onCameraStateChanged(CameraBase::cmrCameraState)));
 
+    //Frames go to host memory when CPU processing is selected
+    bool cpu = ui->cboCUDADevice->currentData().toInt() < 0;
+    mCameraPtr->getFrameBuffer()->setBackend(cpu ? mbHost : mbCUDA);
+
     if(!mCameraPtr->open(devID))
         return;
 
@@ -297,7 +313,7 @@ void MainWindow::openPGMFile(bool isBayer)
     QString fileName = QFileDialog::getOpenFileName(this,
                                                     QStringLiteral("Select pgm file"),
                                                     QDir::homePath(),
-                                                    QStringLiteral("Images (*.pgm)"));
+                                                    QStringLiteral("Images (*.pgm);;Raw recordings (*.fvraw)"));
 
     if(fileName.isEmpty())
         return;
@@ -305,6 +321,13 @@ void MainWindow::openPGMFile(bool isBayer)
     if(mCameraPtr)
         mCameraPtr->stop();
 
+    //Recording keeps its own geometry and bayer pattern
+    if(QFileInfo(fileName).suffix().compare(QLatin1String("fvraw"), Qt::CaseInsensitive) == 0)
+    {
+        initNewCamera(new RawFileCamera(fileName), 0);
+        return;
+    }
+
     initNewCamera(new PGMCamera(
                       fileName,
                       (fastBayerPattern_t)ui->cboBayerPattern->currentData().toInt(),
@@ -319,7 +342,7 @@ void MainWindow::raw2Rgb(bool update, bool init)
         return;
     mProcessorPtr->updateOptions(mOptions);
     if(init)
-        mProcessorPtr->init();
+        mProcessorPtr->reconfigure();
 
     mProcessorPtr->wake();
 
@@ -413,6 +436,7 @@ void MainWindow::onShrinkageChanged(int newSrinkage)
     if(!mProcessorPtr)
         return;
 
+    ui->denoiseCtlr->getStaticDenoiseParams(mOptions.DenoiseStaticParams);
     raw2Rgb(true, true);
 }
 
@@ -569,7 +593,7 @@ void MainWindow::on_cboGamma_currentIndexChanged(int index)
         return;
 
     OutputGamma g = (OutputGamma)(ui->cboGamma->currentData().toInt());
-    CUDAProcessorBase* proc = mProcessorPtr->getCUDAProcessor();
+    ProcessorBase* proc = mProcessorPtr->getProcessor();
     if(proc == nullptr)
         return;
     {
@@ -770,6 +794,18 @@ void MainWindow::onGPUFinished()
 
     QMap<QString, float> stats(mProcessorPtr->getStats());
 
+    //Last value and 99th percentile since start
+    auto stageTime = [&stats](const QString& key, const QString& title)
+    {
+        float last = stats.value(key, -1);
+        if(last <= 0)
+            return QString();
+        return trUtf8("%1 = %2 ms (p99 %3 ms)\n").
+                arg(title).
+                arg(double(last), 0, 'f', 2).
+                arg(double(stats.value(key + QStringLiteral("_p99"))), 0, 'f', 2);
+    };
+
 
     float val = stats[QStringLiteral("allocatedMem")];
     float viewportMem = stats[QStringLiteral("totalViewportMemory")];
@@ -787,71 +823,121 @@ void MainWindow::onGPUFinished()
     if(w > 0 && h > 0)
         strInfo += trUtf8("Input image: %1x%2 pixels\n").arg(w).arg(h);
 
-    val = stats[QStringLiteral("hRawUnpacker")];
-    if(val > 0)
-        strInfo += trUtf8("Raw Unpacker = %1 ms\n").arg(double(val), 0, 'f', 2);
-
-    val = stats[QStringLiteral("hHostToDeviceAdapter")];
-    if(val > 0)
-        strInfo += trUtf8("Host-to-device transfer = %1 ms\n").arg(double(val), 0, 'f', 2);
+    strInfo += stageTime(QStringLiteral("hRawUnpacker"), trUtf8("Raw Unpacker"));
+    strInfo += stageTime(QStringLiteral("hHostToDeviceAdapter"), trUtf8("Host-to-device transfer"));
+    strInfo += stageTime(QStringLiteral("hSAM"), trUtf8("Dark frame and flat field correction"));
+    strInfo += stageTime(QStringLiteral("hLinearizationLut"), trUtf8("Linearization LUT"));
+    strInfo += stageTime(QStringLiteral("hBpc"), trUtf8("Bad pixels correction"));
+    strInfo += stageTime(QStringLiteral("hWhiteBalance"), trUtf8("White balance"));
+    strInfo += stageTime(QStringLiteral("hDebayer"), trUtf8("Debayer"));
+    strInfo += stageTime(QStringLiteral("hDenoise"), trUtf8("Denoise"));
+    strInfo += stageTime(QStringLiteral("hOutLut"), trUtf8("Output gamma"));
+    strInfo += stageTime(QStringLiteral("h16to8Transform"), trUtf8("16 to 8 bit transform"));
 
-    val = stats[QStringLiteral("hSAM")];
-    if(val > 0)
-        strInfo += trUtf8("Dark frame and flat field correction = %1 ms\n").arg(double(val), 0, 'f', 2);
+//    val = stats[QStringLiteral("hHistogram")];
+//    if(val > 0)
+//        strInfo += trUtf8("Histogram = %1 ms\n").arg(double(val), 0, 'f', 2);
 
-    val = stats[QStringLiteral("hLinearizationLut")];
-    if(val > 0)
-        strInfo += trUtf8("Linearization LUT = %1 ms\n").arg(double(val), 0, 'f', 2);
+    strInfo += stageTime(QStringLiteral("hMjpegEncoder"), trUtf8("JPEG encoder time"));
+    strInfo += stageTime(QStringLiteral("hDeviceToHostAdapter"), trUtf8("Device-to-host transfer"));
+    strInfo += stageTime(QStringLiteral("hExportToDevice"), trUtf8("Viewport texture copy"));
 
-    val = stats[QStringLiteral("hBpc")];
-    if(val > 0)
-        strInfo += trUtf8("Bad pixels correction = %1 ms\n").arg(double(val), 0, 'f', 2);
+    val = stats[QStringLiteral("procFrames")];
+    if(val >= 0)
+        strInfo += trUtf8("Frames written = %1\n").arg(int(val));
 
-    val = stats[QStringLiteral("hWhiteBalance")];
-    if(val > 0)
-        strInfo += trUtf8("White balance = %1 ms\n").arg(double(val), 0, 'f', 2);
+    val = stats[QStringLiteral("droppedFrames")];
+    if(val >= 0)
+        strInfo += trUtf8("Frames dropped = %1\n").arg(int(val));
 
-    val = stats[QStringLiteral("hDebayer")];
-    if(val > 0)
-        strInfo += trUtf8("Debayer = %1 ms\n").arg(double(val), 0, 'f', 2);
+    if(stats.value(QStringLiteral("writerFailed")) > 0)
+        strInfo += trUtf8("Recording failed: %1\n").arg(mProcessorPtr->getWriterError());
 
-    val = stats[QStringLiteral("hDenoise")];
+    val = stats.value(QStringLiteral("writerBuffers"), -1);
     if(val > 0)
-        strInfo += trUtf8("Denoise = %1 ms\n").arg(double(val), 0, 'f', 2);
-
+    {
+        strInfo += trUtf8("Writer buffers used = %1 of %2\n").
+                arg(int(stats[QStringLiteral("writerBuffersLeased")])).
+                arg(int(val));
+    }
+    strInfo += stageTime(QStringLiteral("writerLeaseWait"), trUtf8("Writer buffer wait"));
 
-    val = stats[QStringLiteral("hOutLut")];
-    if(val > 0)
-        strInfo += trUtf8("Output gamma = %1 ms\n").arg(double(val), 0, 'f', 2);
+    const int volumes = int(stats.value(QStringLiteral("writerVolumes"), 0));
+    for(int i = 0; volumes > 1 && i < volumes; i++)
+    {
+        strInfo += trUtf8("Volume %1: %2 MB/s, queue %3 (max %4)\n").
+                arg(i + 1).
+                arg(double(stats[QStringLiteral("volume%1_MBps").arg(i)]), 0, 'f', 1).
+                arg(int(stats[QStringLiteral("volume%1_queue").arg(i)])).
+                arg(int(stats[QStringLiteral("volume%1_queueMax").arg(i)]));
+    }
 
-    val = stats[QStringLiteral("h16to8Transform")];
-    if(val > 0)
-        strInfo += trUtf8("16 to 8 bit transform = %1 ms\n").arg(double(val), 0, 'f', 2);
+    val = stats.value(QStringLiteral("rawMBps"), -1);
+    if(val >= 0)
+    {
+        strInfo += trUtf8("Raw writer = %1 MB/s (%2)\n").
+                arg(double(val), 0, 'f', 1).
+                arg(DirectFileWriter::backendName(
+                        static_cast<DirectFileWriter::Backend>(int(stats[QStringLiteral("rawBackend")]))));
+    }
+    strInfo += stageTime(QStringLiteral("diskWrite"), trUtf8("Disk write"));
 
-//    val = stats[QStringLiteral("hHistogram")];
-//    if(val > 0)
-//        strInfo += trUtf8("Histogram = %1 ms\n").arg(double(val), 0, 'f', 2);
+    val = stats.value(QStringLiteral("segments"), -1);
+    if(val > 1)
+        strInfo += trUtf8("Segments = %1\n").arg(int(val));
 
-    val = stats[QStringLiteral("hMjpegEncoder")];
-    if(val > 0)
-        strInfo += trUtf8("JPEG encoder time: %1 ms\n").arg(double(val), 0, 'f', 2);
+    val = stats.value(QStringLiteral("preTriggerFrames"), -1);
+    if(val >= 0)
+    {
+        strInfo += trUtf8("Pre-trigger = %1 frames, %2 s%3\n").
+                arg(int(val)).
+                arg(double(stats[QStringLiteral("preTriggerSeconds")]), 0, 'f', 1).
+                arg(stats[QStringLiteral("triggered")] > 0 ? trUtf8(", recording") : QString());
+    }
 
-    val = stats[QStringLiteral("hDeviceToHostAdapter")];
-    if(val > 0)
-        strInfo += trUtf8("Device-to-host transfer = %1 ms\n").arg(double(val), 0, 'f', 2);
+    val = stats.value(QStringLiteral("jpegQuality"), -1);
+    if(val >= 0)
+    {
+        strInfo += trUtf8("JPEG quality = %1 (adaptive, %2 changes), %3 KB/frame, %4 MB/s\n").
+                arg(int(val)).
+                arg(int(stats[QStringLiteral("jpegQualityChanges")])).
+                arg(double(stats[QStringLiteral("jpegBytesPerFrame")]) / 1024, 0, 'f', 0).
+                arg(double(stats[QStringLiteral("jpegMBps")]), 0, 'f', 1);
+    }
 
-    val = stats[QStringLiteral("hExportToDevice")];
+    val = stats[QStringLiteral("captureFrames")];
     if(val > 0)
-        strInfo += trUtf8("Viewport texture copy = %1 ms\n").arg(double(val), 0, 'f', 2);
+    {
+        QString policy = CircularBuffer::policyName(
+                    static_cast<CircularBuffer::FramePolicy>(int(stats[QStringLiteral("capturePolicy")])));
+        strInfo += trUtf8("Frames captured = %1, dropped = %2 (%3 policy = %4, blocked %5 ms)\n").
+                arg(qint64(val)).
+                arg(qint64(stats[QStringLiteral("captureDropped")])).
+                arg(policy).
+                arg(qint64(stats[QStringLiteral("captureDropped_%1").arg(policy)])).
+                arg(double(stats[QStringLiteral("captureBlockedTime_%1").arg(policy)]), 0, 'f', 1);
+    }
 
-    val = stats[QStringLiteral("procFrames")];
-    if(val >= 0)
-        strInfo += trUtf8("Frames written = %1\n").arg(int(val));
 
-    val = stats[QStringLiteral("droppedFrames")];
-    if(val >= 0)
-        strInfo += trUtf8("Frames dropped = %1\n").arg(int(val));
+    strInfo += stageTime(QStringLiteral("latency"), trUtf8("Capture to output latency"));
+    strInfo += stageTime(QStringLiteral("captureInterval"), trUtf8("Capture interval"));
+    strInfo += stageTime(QStringLiteral("writerWrite"), trUtf8("File write"));
+    strInfo += stageTime(QStringLiteral("writerLatency"), trUtf8("Capture to file latency"));
+    strInfo += stageTime(QStringLiteral("rtspEncode"), trUtf8("RTSP encode"));
+    strInfo += stageTime(QStringLiteral("rtspSend"), trUtf8("RTSP send"));
+    strInfo += stageTime(QStringLiteral("reconfigure"), trUtf8("Reconfigure"));
 
+    for(const QString& stage : RawProcessor::pipelineStages())
+    {
+        val = stats[QStringLiteral("pipelineTime_%1").arg(stage)];
+        if(val <= 0)
+            continue;
+        strInfo += trUtf8("Stage %1 = %2 ms, busy %3%, queue %4\n").
+                arg(stage).
+                arg(double(val), 0, 'f', 2).
+                arg(double(stats[QStringLiteral("pipelineOccupancy_%1").arg(stage)]), 0, 'f', 0).
+                arg(double(stats[QStringLiteral("pipelineQueue_%1").arg(stage)]), 0, 'f', 1);
+    }
 
     float totalGPU = stats[QStringLiteral("totalGPUTime")];
     if(totalGPU > 0)
@@ -32,7 +32,7 @@
 #include <QMainWindow>
 #include <QLabel>
 
-#include "CUDAProcessorBase.h"
+#include "ProcessorBase.h"
 #include "FrameBuffer.h"
 #include "CameraBase.h"
 #include "GLImageViewer.h"
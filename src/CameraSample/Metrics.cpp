@@ -0,0 +1,233 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "Metrics.h"
+
+#include <QtAlgorithms>
+
+#include <atomic>
+
+namespace
+{
+//16 sub-buckets for every power of two
+const int SubBits = 4;
+const int SubBuckets = 1 << SubBits;
+//Longer values go to the last bucket
+const int MaxBits = 40;
+const int BucketCount = (MaxBits - SubBits + 1) * SubBuckets;
+//Encoding and output run a few frames behind the processor
+const quint64 CurrentFrames = 8;
+
+struct Histogram
+{
+    std::atomic<quint64> buckets[BucketCount];
+    std::atomic<quint64> sum;
+    std::atomic<quint64> last;
+    std::atomic<quint64> max;
+    //Minimum + 1, zero means no values
+    std::atomic<quint64> min;
+    std::atomic<quint64> frame;
+};
+
+//Zero initialized, so no constructors run before main
+Histogram gHistograms[Metrics::mtCount];
+std::atomic<quint64> gFrame;
+
+int bucketIndex(quint64 value)
+{
+    if(value < quint64(SubBuckets))
+        return int(value);
+
+    const int msb = 63 - int(qCountLeadingZeroBits(value));
+    if(msb >= MaxBits)
+        return BucketCount - 1;
+
+    const int shift = msb - SubBits;
+    return (shift + 1) * SubBuckets + int((value >> shift) & (SubBuckets - 1));
+}
+
+//Middle of the bucket value range
+quint64 bucketValue(int idx)
+{
+    if(idx < SubBuckets)
+        return quint64(idx);
+
+    const int shift = idx / SubBuckets - 1;
+    const quint64 lower = quint64(SubBuckets + idx % SubBuckets) << shift;
+    return lower + ((quint64(1) << shift) >> 1);
+}
+
+double toMs(quint64 ns)
+{
+    return double(ns) / 1000000.;
+}
+}
+
+void Metrics::recordNs(Metric metric, qint64 ns)
+{
+    if(metric < 0 || metric >= mtCount)
+        return;
+
+    const quint64 value = ns > 0 ? quint64(ns) : 0;
+    Histogram& h = gHistograms[metric];
+
+    h.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(value, std::memory_order_relaxed);
+    h.last.store(value, std::memory_order_relaxed);
+    h.frame.store(gFrame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    quint64 cur = h.max.load(std::memory_order_relaxed);
+    while(value > cur && !h.max.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+        ;
+
+    cur = h.min.load(std::memory_order_relaxed);
+    while((cur == 0 || value + 1 < cur) && !h.min.compare_exchange_weak(cur, value + 1, std::memory_order_relaxed))
+        ;
+}
+
+void Metrics::nextFrame()
+{
+    gFrame.fetch_add(1, std::memory_order_relaxed);
+}
+
+Metrics::Snapshot Metrics::snapshot(Metric metric)
+{
+    Snapshot ret;
+    if(metric < 0 || metric >= mtCount)
+        return ret;
+
+    const Histogram& h = gHistograms[metric];
+
+    //Buckets are copied first, so percentiles are taken from a consistent set
+    quint64 counts[BucketCount];
+    for(int i = 0; i < BucketCount; i++)
+    {
+        counts[i] = h.buckets[i].load(std::memory_order_relaxed);
+        ret.count += counts[i];
+    }
+    if(ret.count == 0)
+        return ret;
+
+    const quint64 maxVal = h.max.load(std::memory_order_relaxed);
+    const quint64 minVal = h.min.load(std::memory_order_relaxed);
+
+    ret.last = toMs(h.last.load(std::memory_order_relaxed));
+    ret.max = toMs(maxVal);
+    ret.min = minVal > 0 ? toMs(minVal - 1) : 0;
+    ret.mean = toMs(h.sum.load(std::memory_order_relaxed)) / double(ret.count);
+    ret.current = h.frame.load(std::memory_order_relaxed) + CurrentFrames >= gFrame.load(std::memory_order_relaxed);
+
+    const double percents[] = {50, 95, 99};
+    double* values[] = {&ret.p50, &ret.p95, &ret.p99};
+    int idx = 0;
+    quint64 seen = 0;
+    for(int p = 0; p < 3; p++)
+    {
+        const quint64 rank = qMax<quint64>(1, quint64(percents[p] / 100. * double(ret.count) + 0.5));
+        while(idx < BucketCount - 1 && seen + counts[idx] < rank)
+            seen += counts[idx++];
+        *values[p] = toMs(qMin(bucketValue(idx), maxVal));
+    }
+
+    return ret;
+}
+
+void Metrics::reset()
+{
+    for(Histogram& h : gHistograms)
+    {
+        for(auto& bucket : h.buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        h.sum.store(0, std::memory_order_relaxed);
+        h.last.store(0, std::memory_order_relaxed);
+        h.max.store(0, std::memory_order_relaxed);
+        h.min.store(0, std::memory_order_relaxed);
+    }
+}
+
+QString Metrics::name(Metric metric)
+{
+    switch(metric)
+    {
+    case mtHostToDevice:
+        return QStringLiteral("hHostToDeviceAdapter");
+    case mtRawUnpacker:
+        return QStringLiteral("hRawUnpacker");
+    case mtSam:
+        return QStringLiteral("hSAM");
+    case mtLinearizationLut:
+        return QStringLiteral("hLinearizationLut");
+    case mtBpc:
+        return QStringLiteral("hBpc");
+    case mtWhiteBalance:
+        return QStringLiteral("hWhiteBalance");
+    case mtDebayer:
+        return QStringLiteral("hDebayer");
+    case mtDenoise:
+        return QStringLiteral("hDenoise");
+    case mtOutLut:
+        return QStringLiteral("hOutLut");
+    case mt16to8Transform:
+        return QStringLiteral("h16to8Transform");
+    case mtGrayToRGBTransform:
+        return QStringLiteral("hGrayToRGBTransform");
+    case mtExportToDevice:
+        return QStringLiteral("hExportToDevice");
+    case mtMjpegEncoder:
+        return QStringLiteral("hMjpegEncoder");
+    case mtExportToHost:
+        return QStringLiteral("fastSDIExportToHostCopy");
+    case mtTotalGPU:
+        return QStringLiteral("totalGPUTime");
+    case mtTotalGPUCPU:
+        return QStringLiteral("totalGPUCPUTime");
+    case mtLatency:
+        return QStringLiteral("latency");
+    case mtReconfigure:
+        return QStringLiteral("reconfigure");
+    case mtCaptureInterval:
+        return QStringLiteral("captureInterval");
+    case mtCaptureBlocked:
+        return QStringLiteral("captureBlocked");
+    case mtWriterWrite:
+        return QStringLiteral("writerWrite");
+    case mtWriterLatency:
+        return QStringLiteral("writerLatency");
+    case mtWriterLeaseWait:
+        return QStringLiteral("writerLeaseWait");
+    case mtDiskWrite:
+        return QStringLiteral("diskWrite");
+    case mtRtspEncode:
+        return QStringLiteral("rtspEncode");
+    case mtRtspSend:
+        return QStringLiteral("rtspSend");
+    default:
+        break;
+    }
+    return QString();
+}
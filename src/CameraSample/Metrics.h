@@ -0,0 +1,137 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+
+#include "FrameMetadata.h"
+
+/// Fixed set of pipeline metrics indexed by enum.
+/// Every metric keeps a log-linear histogram of durations (about 6% resolution,
+/// from 1 ns to 18 minutes). Values are recorded lock-free and without allocations
+/// from any thread, snapshots never block the recording threads.
+class Metrics
+{
+public:
+    enum Metric
+    {
+        //Processor stages, recorded for every transformed frame
+        mtHostToDevice = 0,
+        mtRawUnpacker,
+        mtSam,
+        mtLinearizationLut,
+        mtBpc,
+        mtWhiteBalance,
+        mtDebayer,
+        mtDenoise,
+        mtOutLut,
+        mt16to8Transform,
+        mtGrayToRGBTransform,
+        mtExportToDevice,
+        mtMjpegEncoder,
+        mtExportToHost,
+        mtTotalGPU,
+        mtTotalGPUCPU,
+        /// Capture to processor output
+        mtLatency,
+        /// Option change applied by processor, full Init included
+        mtReconfigure,
+
+        //Camera threads
+        /// Interval between frames put to the input buffer
+        mtCaptureInterval,
+        /// Time camera waited for a free input buffer slot
+        mtCaptureBlocked,
+
+        //File writer
+        mtWriterWrite,
+        /// Capture to file written
+        mtWriterLatency,
+        /// Time producer waited for a free writer buffer
+        mtWriterLeaseWait,
+        /// Raw recording block write, submit to completion
+        mtDiskWrite,
+
+        //RTSP server
+        mtRtspEncode,
+        mtRtspSend,
+
+        mtCount
+    };
+
+    struct Snapshot
+    {
+        quint64 count = 0;
+        //Values are in ms
+        double  last = 0;
+        double  min = 0;
+        double  max = 0;
+        double  mean = 0;
+        double  p50 = 0;
+        double  p95 = 0;
+        double  p99 = 0;
+        /// Recorded for one of the last processed frames,
+        /// false for stages switched off
+        bool    current = false;
+    };
+
+    /// Records time from construction to destruction
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Metric metric) :
+            mMetric(metric),
+            mStart(FrameMetadata::now())
+        {
+        }
+        ~ScopedTimer()
+        {
+            recordNs(mMetric, FrameMetadata::now() - mStart);
+        }
+
+    private:
+        Metric mMetric;
+        qint64 mStart;
+    };
+
+    static void record(Metric metric, double ms){recordNs(metric, qint64(ms * 1000000.));}
+    static void recordNs(Metric metric, qint64 ns);
+    /// Called by processor before the stages of a new frame are recorded
+    static void nextFrame();
+
+    static Snapshot snapshot(Metric metric);
+    static void reset();
+
+    /// Key of the metric in RawProcessor::getStats
+    static QString name(Metric metric);
+    static bool isProcessorStage(Metric metric){return metric <= mtLatency;}
+};
+
+#endif // METRICS_H
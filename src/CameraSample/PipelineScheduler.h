@@ -0,0 +1,329 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef PIPELINESCHEDULER_H
+#define PIPELINESCHEDULER_H
+
+#include <QMap>
+#include <QString>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Runs frames through a chain of stages with several frames in flight.
+/// T is a frame type, scheduler owns a fixed pool of them.
+/// Producer takes a free frame with acquire(), fills it and passes it on with submit().
+/// Each stage has its own worker threads and a bounded input queue,
+/// stage blocks when the queue of the next stage is full, acquire() blocks
+/// when all frames are in flight. Frames leave every stage in submit order,
+/// even if the stage has more than one worker.
+template<class T> class PipelineScheduler
+{
+public:
+    typedef std::function<void(T&)> StageFunc;
+
+    explicit PipelineScheduler(int frames = 3)
+    {
+        for(int i = 0; i < qMax(1, frames); i++)
+        {
+            mSlots.emplace_back(new Slot());
+            mFree.push_back(mSlots.back().get());
+        }
+    }
+
+    ~PipelineScheduler()
+    {
+        stop();
+    }
+
+    /// Stages run in the order they are added, has to be called before start()
+    void addStage(const QString& name, StageFunc func, int workers = 1, int queueSize = 1)
+    {
+        std::unique_ptr<Stage> stage(new Stage());
+        stage->name = name;
+        stage->func = func;
+        stage->workers = qMax(1, workers);
+        stage->queueSize = size_t(qMax(1, queueSize));
+        mStages.push_back(std::move(stage));
+    }
+
+    void start()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        if(mRunning || mStages.empty())
+            return;
+
+        mRunning = true;
+        mStop = false;
+        lock.unlock();
+
+        resetStats();
+        for(size_t s = 0; s < mStages.size(); s++)
+        {
+            for(int w = 0; w < mStages[s]->workers; w++)
+                mStages[s]->threads.emplace_back([this, s](){workerLoop(s);});
+        }
+    }
+
+    /// Finishes frames in flight and stops workers
+    void stop()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        if(!mRunning)
+            return;
+
+        mRunning = false;
+        mCond.notify_all();
+        mCond.wait(lock, [this](){return mInFlight == 0;});
+        mStop = true;
+        mCond.notify_all();
+        lock.unlock();
+
+        for(auto& stage : mStages)
+        {
+            for(auto& thread : stage->threads)
+                thread.join();
+            stage->threads.clear();
+        }
+    }
+
+    /// Free frame to be filled by producer, nullptr if scheduler is stopped
+    T* acquire()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        const Clock::time_point start = Clock::now();
+        mCond.wait(lock, [this](){return !mFree.empty() || !mRunning;});
+        mAcquireWait += Clock::now() - start;
+        if(!mRunning)
+            return nullptr;
+
+        Slot* slot = mFree.front();
+        mFree.pop_front();
+        mInFlight++;
+        return &slot->frame;
+    }
+
+    /// Passes frame obtained by acquire() to the first stage
+    void submit(T* frame)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        Slot* slot = findSlot(frame);
+        if(slot == nullptr)
+            return;
+
+        slot->seq = mNextSeq++;
+        pushToStage(lock, 0, slot);
+    }
+
+    /// Waits until frames submitted so far passed the last stage.
+    /// Frames submitted meanwhile are not waited for.
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        const quint64 target = mNextSeq;
+        mCond.wait(lock, [this, target](){return mFinished >= target;});
+    }
+
+    int frameCount() const {return int(mSlots.size());}
+
+    void resetStats()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStatsStart = Clock::now();
+        mAcquireWait = Clock::duration::zero();
+        for(auto& stage : mStages)
+        {
+            stage->busy = Clock::duration::zero();
+            stage->blocked = Clock::duration::zero();
+            stage->frames = 0;
+            stage->depthSum = 0;
+            stage->maxDepth = 0;
+        }
+    }
+
+    /// Per stage occupancy in percent of worker time, average processing time (ms),
+    /// average and max input queue depth and time spent waiting for next stage (ms)
+    QMap<QString, float> stats()
+    {
+        QMap<QString, float> ret;
+
+        std::lock_guard<std::mutex> lock(mLock);
+        const double elapsed = toMs(Clock::now() - mStatsStart);
+        for(auto& stage : mStages)
+        {
+            const double busy = toMs(stage->busy);
+            const double frames = double(qMax<quint64>(1, stage->frames));
+
+            ret[QStringLiteral("pipelineOccupancy_%1").arg(stage->name)] =
+                    elapsed > 0 ? float(100. * busy / (elapsed * stage->workers)) : 0.F;
+            ret[QStringLiteral("pipelineTime_%1").arg(stage->name)] = float(busy / frames);
+            ret[QStringLiteral("pipelineQueue_%1").arg(stage->name)] = float(double(stage->depthSum) / frames);
+            ret[QStringLiteral("pipelineMaxQueue_%1").arg(stage->name)] = float(stage->maxDepth);
+            ret[QStringLiteral("pipelineBlockedTime_%1").arg(stage->name)] = float(toMs(stage->blocked));
+        }
+        ret[QStringLiteral("pipelineInFlight")] = float(mInFlight);
+        ret[QStringLiteral("pipelineFrames")] = float(mSlots.size());
+        ret[QStringLiteral("pipelineAcquireWait")] = float(toMs(mAcquireWait));
+
+        return ret;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Slot
+    {
+        T frame;
+        quint64 seq = 0;
+    };
+
+    struct Stage
+    {
+        QString name;
+        StageFunc func;
+        int workers = 1;
+        size_t queueSize = 1;
+        std::deque<Slot*> queue;
+        std::vector<std::thread> threads;
+
+        //Frames finished ahead of preceding ones
+        std::map<quint64, Slot*> done;
+        quint64 nextSeq = 0;
+        bool flushing = false;
+
+        Clock::duration busy {};
+        Clock::duration blocked {};
+        quint64 frames = 0;
+        quint64 depthSum = 0;
+        size_t  maxDepth = 0;
+    };
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::vector<std::unique_ptr<Stage>> mStages;
+    std::vector<std::unique_ptr<Slot>> mSlots;
+    std::deque<Slot*> mFree;
+    quint64 mNextSeq = 0;
+    //Frames passed the last stage, they leave it in submit order
+    quint64 mFinished = 0;
+    int  mInFlight = 0;
+    bool mRunning = false;
+    bool mStop = false;
+
+    Clock::time_point mStatsStart = Clock::now();
+    Clock::duration   mAcquireWait {};
+
+    static double toMs(Clock::duration d)
+    {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+
+    Slot* findSlot(T* frame)
+    {
+        for(auto& slot : mSlots)
+        {
+            if(&slot->frame == frame)
+                return slot.get();
+        }
+        return nullptr;
+    }
+
+    //Called with mLock held, blocks while stage queue is full
+    void pushToStage(std::unique_lock<std::mutex>& lock, size_t index, Slot* slot)
+    {
+        if(index >= mStages.size())
+        {
+            mFree.push_back(slot);
+            mInFlight--;
+            mFinished++;
+            mCond.notify_all();
+            return;
+        }
+
+        Stage* stage = mStages[index].get();
+        mCond.wait(lock, [stage](){return stage->queue.size() < stage->queueSize;});
+
+        //Depth is number of frames waiting ahead of the new one
+        stage->depthSum += stage->queue.size();
+        stage->queue.push_back(slot);
+        stage->maxDepth = qMax(stage->maxDepth, stage->queue.size());
+        mCond.notify_all();
+    }
+
+    void workerLoop(size_t index)
+    {
+        Stage* stage = mStages[index].get();
+
+        std::unique_lock<std::mutex> lock(mLock);
+        for(;;)
+        {
+            mCond.wait(lock, [this, stage](){return !stage->queue.empty() || mStop;});
+            if(stage->queue.empty())
+                break;
+
+            Slot* slot = stage->queue.front();
+            stage->queue.pop_front();
+            mCond.notify_all();
+            lock.unlock();
+
+            const Clock::time_point start = Clock::now();
+            stage->func(slot->frame);
+            const Clock::duration busy = Clock::now() - start;
+
+            lock.lock();
+            stage->busy += busy;
+            stage->frames++;
+
+            //Restore submit order before passing frames on
+            stage->done[slot->seq] = slot;
+            if(stage->flushing)
+                continue;
+
+            stage->flushing = true;
+            const Clock::time_point blockStart = Clock::now();
+            while(!stage->done.empty() && stage->done.begin()->first == stage->nextSeq)
+            {
+                Slot* next = stage->done.begin()->second;
+                stage->done.erase(stage->done.begin());
+                stage->nextSeq++;
+                pushToStage(lock, index + 1, next);
+            }
+            stage->blocked += Clock::now() - blockStart;
+            stage->flushing = false;
+        }
+    }
+};
+
+#endif // PIPELINESCHEDULER_H
@@ -0,0 +1,110 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "PreTriggerBuffer.h"
+
+PreTriggerBuffer::~PreTriggerBuffer()
+{
+    clear();
+}
+
+void PreTriggerBuffer::setLimits(int maxFrames, qint64 maxAge, qint64 maxBytes)
+{
+    QMutexLocker lock(&mLock);
+    mMaxFrames = maxFrames;
+    mMaxAge = maxAge;
+    mMaxBytes = maxBytes;
+}
+
+qint64 PreTriggerBuffer::residentSize(const FileWriterTask* task)
+{
+    return task->pool ? qint64(task->pool->bufferSize()) : qint64(task->size);
+}
+
+void PreTriggerBuffer::push(FileWriterTask* task)
+{
+    if(task == nullptr)
+        return;
+
+    std::vector<FileWriterTask*> expired;
+    {
+        QMutexLocker lock(&mLock);
+        mTasks.push_back(task);
+        mBytes += residentSize(task);
+
+        const qint64 newest = task->meta.hostTimestamp;
+        while(mTasks.size() > 1 &&
+              ((mMaxFrames > 0 && int(mTasks.size()) > mMaxFrames) ||
+               (mMaxBytes > 0 && mBytes > mMaxBytes) ||
+               (mMaxAge > 0 && newest - mTasks.front()->meta.hostTimestamp > mMaxAge)))
+        {
+            mBytes -= residentSize(mTasks.front());
+            expired.push_back(mTasks.front());
+            mTasks.pop_front();
+        }
+    }
+
+    //Buffers go back to the pool outside of the lock
+    for(FileWriterTask* t : expired)
+        delete t;
+}
+
+std::vector<FileWriterTask*> PreTriggerBuffer::take()
+{
+    QMutexLocker lock(&mLock);
+    std::vector<FileWriterTask*> ret(mTasks.begin(), mTasks.end());
+    mTasks.clear();
+    mBytes = 0;
+    return ret;
+}
+
+void PreTriggerBuffer::clear()
+{
+    for(FileWriterTask* task : take())
+        delete task;
+}
+
+int PreTriggerBuffer::count() const
+{
+    QMutexLocker lock(&mLock);
+    return int(mTasks.size());
+}
+
+qint64 PreTriggerBuffer::bytes() const
+{
+    QMutexLocker lock(&mLock);
+    return mBytes;
+}
+
+qint64 PreTriggerBuffer::span() const
+{
+    QMutexLocker lock(&mLock);
+    if(mTasks.size() < 2)
+        return 0;
+    return mTasks.back()->meta.hostTimestamp - mTasks.front()->meta.hostTimestamp;
+}
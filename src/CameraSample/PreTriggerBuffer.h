@@ -0,0 +1,74 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef PRETRIGGERBUFFER_H
+#define PRETRIGGERBUFFER_H
+
+#include <QMutex>
+
+#include <deque>
+#include <vector>
+
+#include "AsyncFileWriter.h"
+
+/// Ring of writer tasks recorded before a trigger.
+/// Tasks keep their leased writer buffers, so nothing is copied on the live path.
+/// Resident memory is bounded by the frame and byte limits, oldest tasks are deleted
+/// when a limit is reached, which returns their buffers to the pool.
+class PreTriggerBuffer
+{
+public:
+    PreTriggerBuffer() = default;
+    ~PreTriggerBuffer();
+
+    /// Zero or negative limit means no limit, maxAge is in ns of capture time
+    void setLimits(int maxFrames, qint64 maxAge, qint64 maxBytes = 0);
+    /// Takes ownership of the task
+    void push(FileWriterTask* task);
+    /// Moves all tasks out, oldest first
+    std::vector<FileWriterTask*> take();
+    void clear();
+
+    int count() const;
+    /// Memory held by kept tasks, whole writer buffers
+    qint64 bytes() const;
+    /// Capture time between oldest and newest task, ns
+    qint64 span() const;
+
+private:
+    static qint64 residentSize(const FileWriterTask* task);
+
+    mutable QMutex mLock;
+    std::deque<FileWriterTask*> mTasks;
+    int    mMaxFrames = 0;
+    qint64 mMaxAge = 0;
+    qint64 mMaxBytes = 0;
+    qint64 mBytes = 0;
+};
+
+#endif // PRETRIGGERBUFFER_H
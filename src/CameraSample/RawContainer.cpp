@@ -0,0 +1,274 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "RawContainer.h"
+
+#include <cstring>
+#include <limits>
+
+using namespace RawContainer;
+
+namespace
+{
+    /// File grows by this amount when preallocated space is used up
+    const quint64 PreallocateStep = 256 * 1024 * 1024;
+}
+
+RawContainerWriter::~RawContainerWriter()
+{
+    close();
+}
+
+bool RawContainerWriter::open(const QString& fileName, const FileHeader& header, int queueDepth)
+{
+    close();
+
+    if(!mFile.open(fileName, queueDepth))
+        return false;
+
+    FileHeader hdr = header;
+    memcpy(hdr.magic, HeaderMagic, sizeof(hdr.magic));
+    hdr.version = Version;
+    hdr.headerSize = sizeof(FileHeader);
+
+    //First frame starts at Alignment
+    QByteArray block(int(Alignment), 0);
+    memcpy(block.data(), &hdr, sizeof(hdr));
+
+    mPos = 0;
+    mAllocated = 0;
+    mIndex.clear();
+    mPadding = QByteArray(int(Alignment), 0);
+
+    //Preallocation is only a hint, recording goes on where it is not supported
+    mAllocated = mFile.preallocate(PreallocateStep) ? PreallocateStep : 0;
+    if(!mFile.write(block.constData(), quint64(block.size())))
+    {
+        mFile.close();
+        return false;
+    }
+    mPos = Alignment;
+    return true;
+}
+
+bool RawContainerWriter::addFrame(const unsigned char* data, unsigned size, const FrameMetadata& meta)
+{
+    if(!mFile.isOpened() || data == nullptr)
+        return false;
+
+    const quint64 chunk = chunkSize(size);
+    if(mAllocated > 0 && mPos + chunk > mAllocated)
+    {
+        const quint64 allocate = qMax(mAllocated + PreallocateStep, mPos + chunk);
+        mAllocated = mFile.preallocate(allocate) ? allocate : 0;
+    }
+
+    FrameHeader hdr {};
+    hdr.magic = FrameMagic;
+    hdr.size = size;
+    hdr.seq = meta.seq;
+    hdr.hostTimestamp = meta.hostTimestamp;
+    hdr.sensorTimestamp = meta.sensorTimestamp;
+    hdr.exposure = meta.exposure;
+    hdr.gain = meta.gain;
+
+    FrameTrailer trailer {TrailerMagic, size};
+
+    //Trailer is written last, recovery scan stops at a frame without it.
+    //Write errors are sticky, a failed chunk is the last one in file.
+    const quint64 padding = chunk - sizeof(hdr) - size - sizeof(trailer);
+    if(!mFile.write(&hdr, sizeof(hdr)) ||
+       !mFile.write(data, size) ||
+       !mFile.write(&trailer, sizeof(trailer)) ||
+       !mFile.write(mPadding.constData(), padding))
+        return false;
+
+    mIndex.append(mPos);
+    mPos += chunk;
+    return true;
+}
+
+void RawContainerWriter::close()
+{
+    if(!mFile.isOpened())
+        return;
+
+    Footer footer {};
+    footer.indexOffset = mPos;
+    footer.frameCount = quint64(mIndex.size());
+    memcpy(footer.magic, FooterMagic, sizeof(footer.magic));
+
+    mFile.write(mIndex.constData(), quint64(mIndex.size()) * sizeof(quint64));
+    mFile.write(&footer, sizeof(footer));
+
+    //Drops preallocated space left, footer has to be at the end of file
+    mFile.close();
+    mIndex.clear();
+}
+
+RawContainerReader::~RawContainerReader()
+{
+    close();
+}
+
+bool RawContainerReader::open(const QString& fileName)
+{
+    close();
+
+    mFile.setFileName(fileName);
+    if(!mFile.open(QFile::ReadOnly))
+        return false;
+
+    mSize = quint64(mFile.size());
+    if(mSize < Alignment)
+    {
+        close();
+        return false;
+    }
+
+    mData = mFile.map(0, qint64(mSize));
+    if(mData == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    memcpy(&mHeader, mData, sizeof(mHeader));
+    if(memcmp(mHeader.magic, HeaderMagic, sizeof(mHeader.magic)) != 0 ||
+       mHeader.version > Version ||
+       mHeader.pitch == 0 ||
+       mHeader.height == 0)
+    {
+        close();
+        return false;
+    }
+
+    mRecovered = !readIndex();
+    if(mRecovered)
+        scanFrames();
+
+    return true;
+}
+
+void RawContainerReader::close()
+{
+    if(mData != nullptr)
+        mFile.unmap(const_cast<uchar*>(mData));
+    mData = nullptr;
+    mSize = 0;
+    mIndex.clear();
+    mRecovered = false;
+    mFile.close();
+}
+
+const FrameHeader* RawContainerReader::frameHeader(quint64 offset, quint64 end) const
+{
+    //Chunk has to fit before end and have both magics.
+    //Offsets come from the file, so sizes are compared without sums which can wrap.
+    const quint64 framing = sizeof(FrameHeader) + sizeof(FrameTrailer);
+    if(end > mSize || end < framing ||
+       offset % Alignment != 0 || offset < Alignment || offset > end - framing)
+        return nullptr;
+
+    const FrameHeader* hdr = reinterpret_cast<const FrameHeader*>(mData + offset);
+    if(hdr->magic != FrameMagic ||
+       hdr->size == 0 ||
+       hdr->size > quint64(mHeader.pitch) * mHeader.height ||
+       hdr->size > end - framing - offset)
+        return nullptr;
+
+    FrameTrailer trailer;
+    memcpy(&trailer, mData + offset + sizeof(FrameHeader) + hdr->size, sizeof(trailer));
+    if(trailer.magic != TrailerMagic || trailer.size != hdr->size)
+        return nullptr;
+
+    return hdr;
+}
+
+bool RawContainerReader::readIndex()
+{
+    if(mSize < Alignment + sizeof(Footer))
+        return false;
+
+    Footer footer;
+    memcpy(&footer, mData + mSize - sizeof(Footer), sizeof(footer));
+    if(memcmp(footer.magic, FooterMagic, sizeof(footer.magic)) != 0)
+        return false;
+
+    //Footer is not trusted, no sum of its fields may wrap around
+    const quint64 indexEnd = mSize - sizeof(Footer);
+    if(footer.indexOffset < Alignment || footer.indexOffset > indexEnd ||
+       footer.frameCount > (indexEnd - footer.indexOffset) / sizeof(quint64) ||
+       footer.frameCount > quint64(std::numeric_limits<int>::max()) ||
+       footer.indexOffset + footer.frameCount * sizeof(quint64) != indexEnd)
+        return false;
+
+    mIndex.resize(int(footer.frameCount));
+    memcpy(mIndex.data(), mData + footer.indexOffset, footer.frameCount * sizeof(quint64));
+    //Every chunk has to end before the index
+    for(quint64 offset : mIndex)
+    {
+        if(frameHeader(offset, footer.indexOffset) == nullptr)
+        {
+            mIndex.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void RawContainerReader::scanFrames()
+{
+    mIndex.clear();
+    quint64 offset = Alignment;
+    while(const FrameHeader* hdr = frameHeader(offset, mSize))
+    {
+        mIndex.append(offset);
+        offset += chunkSize(hdr->size);
+    }
+}
+
+const unsigned char* RawContainerReader::frame(int index, FrameMetadata* meta, unsigned* size) const
+{
+    if(mData == nullptr || index < 0 || index >= mIndex.size())
+        return nullptr;
+
+    const FrameHeader* hdr = reinterpret_cast<const FrameHeader*>(mData + mIndex[index]);
+    if(meta)
+    {
+        meta->seq = hdr->seq;
+        meta->hostTimestamp = hdr->hostTimestamp;
+        meta->sensorTimestamp = hdr->sensorTimestamp;
+        meta->exposure = hdr->exposure;
+        meta->gain = hdr->gain;
+    }
+    if(size)
+        *size = hdr->size;
+
+    return mData + mIndex[index] + sizeof(FrameHeader);
+}
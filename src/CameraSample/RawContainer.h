@@ -0,0 +1,174 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef RAWCONTAINER_H
+#define RAWCONTAINER_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "FrameMetadata.h"
+#include "DirectFileWriter.h"
+
+/// Single file raw recording.
+/// File header is followed by frame chunks, each starts at Alignment boundary
+/// with FrameHeader, then pixel data and FrameTrailer. Index of chunk offsets
+/// and Footer are written on close. Files without valid footer (writer crashed)
+/// are indexed by scanning chunks up to the first incomplete one.
+/// All fields are little endian, same as every supported host.
+namespace RawContainer
+{
+    const unsigned Alignment = 4096;
+    const quint32  Version = 1;
+    const quint32  FrameMagic = 0x314D5246;   //"FRM1"
+    const quint32  TrailerMagic = 0x444E4546; //"FEND"
+    const char     HeaderMagic[8] = {'F', 'V', 'R', 'A', 'W', 'C', 'N', '1'};
+    const char     FooterMagic[8] = {'F', 'V', 'R', 'A', 'W', 'I', 'D', 'X'};
+
+    struct FileHeader
+    {
+        char    magic[8];
+        quint32 version;
+        quint32 headerSize;
+        quint32 width;
+        quint32 height;
+        /// Bytes per row of frame data
+        quint32 pitch;
+        quint32 bitsPerChannel;
+        /// fastSurfaceFormat_t
+        quint32 surfaceFmt;
+        /// fastBayerPattern_t
+        qint32  pattern;
+        quint32 isColor;
+        quint32 whiteLevel;
+        quint32 blackLevel;
+        quint32 reserved[3];
+    };
+
+    struct FrameHeader
+    {
+        quint32 magic;
+        /// Bytes of pixel data after header
+        quint32 size;
+        quint64 seq;
+        qint64  hostTimestamp;
+        qint64  sensorTimestamp;
+        float   exposure;
+        float   gain;
+        quint32 reserved[6];
+    };
+
+    struct FrameTrailer
+    {
+        quint32 magic;
+        quint32 size;
+    };
+
+    struct Footer
+    {
+        quint64 indexOffset;
+        quint64 frameCount;
+        char    magic[8];
+        quint64 reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 64, "RawContainer::FileHeader layout");
+    static_assert(sizeof(FrameHeader) == 64, "RawContainer::FrameHeader layout");
+    static_assert(sizeof(Footer) == 32, "RawContainer::Footer layout");
+
+    /// Chunk size of a frame with size bytes of pixel data
+    inline quint64 chunkSize(quint64 size)
+    {
+        const quint64 sz = sizeof(FrameHeader) + size + sizeof(FrameTrailer);
+        return (sz + Alignment - 1) / Alignment * Alignment;
+    }
+}
+
+/// Append only writer, file space is preallocated in large steps
+/// to keep the file contiguous and avoid metadata updates on every frame.
+class RawContainerWriter
+{
+public:
+    RawContainerWriter() = default;
+    ~RawContainerWriter();
+
+    /// Creates file, magic, version and header size of header are filled in here.
+    /// queueDepth > 0 asks for DirectFileWriter direct backend.
+    bool open(const QString& fileName, const RawContainer::FileHeader& header, int queueDepth = 0);
+    bool isOpened() const {return mFile.isOpened();}
+    bool addFrame(const unsigned char* data, unsigned size, const FrameMetadata& meta);
+    /// Writes index and footer, trims preallocated space
+    void close();
+    int  frameCount() const {return mIndex.size();}
+    DirectFileWriter::Backend backend() const {return mFile.backend();}
+    /// Average write speed since open, MB/s
+    double throughput() const {return mFile.throughput();}
+
+private:
+    DirectFileWriter mFile;
+    quint64 mPos = 0;
+    quint64 mAllocated = 0;
+    QVector<quint64> mIndex;
+    QByteArray mPadding;
+};
+
+/// Maps whole container to memory and gives random access to frames
+class RawContainerReader
+{
+public:
+    RawContainerReader() = default;
+    ~RawContainerReader();
+
+    bool open(const QString& fileName);
+    void close();
+    bool isOpened() const {return mData != nullptr;}
+
+    const RawContainer::FileHeader& header() const {return mHeader;}
+    int  frameCount() const {return mIndex.size();}
+    /// Pixel data of frame, nullptr if index is out of range.
+    /// Points to mapped file and is valid until close.
+    const unsigned char* frame(int index, FrameMetadata* meta = nullptr, unsigned* size = nullptr) const;
+    /// Index was rebuilt by scanning chunks, file was not closed properly
+    bool isRecovered() const {return mRecovered;}
+
+private:
+    bool readIndex();
+    void scanFrames();
+    /// Valid header of a chunk which ends before end, nullptr otherwise
+    const RawContainer::FrameHeader* frameHeader(quint64 offset, quint64 end) const;
+
+    QFile mFile;
+    const uchar* mData = nullptr;
+    quint64 mSize = 0;
+    RawContainer::FileHeader mHeader {};
+    QVector<quint64> mIndex;
+    bool mRecovered = false;
+};
+
+#endif // RAWCONTAINER_H
@@ -27,40 +27,92 @@
 */
 
 #include "RawProcessor.h"
+#ifndef HOST_ONLY
 #include "CUDAProcessorBase.h"
 #include "CUDAProcessorGray.h"
+#endif
+#include "CPUProcessor.h"
+#include "CPUKernels.h"
 #include "FrameBuffer.h"
 #include "CameraBase.h"
-#include "MainWindow.h"
+#ifndef HEADLESS
+#include "GLImageViewer.h"
+#endif
 #include "FPNReader.h"
 #include "FFCReader.h"
+#include "Metrics.h"
+#include "SurfaceTraits.hpp"
 
 #include <QElapsedTimer>
 #include <QDateTime>
 #include <QDebug>
 #include <QPoint>
 
+#include <cmath>
+#include <limits>
+
 RawProcessor::RawProcessor(CameraBase *camera, GLRenderer *renderer):QObject(nullptr),
     mCamera(camera),
     mRenderer(renderer)
 {
-    if(camera->isColor())
-        mProcessorPtr.reset(new CUDAProcessorBase());
-    else
-        mProcessorPtr.reset(new CUDAProcessorGray());
+    mSegmentLimits.maxBytes = Globals::MaxFileSize;
 
-    connect(mProcessorPtr.data(), SIGNAL(error()), this, SIGNAL(error()));
+    mProcessorPtr.reset(createProcessor());
+    if(mProcessorPtr)
+        connect(mProcessorPtr.data(), SIGNAL(error()), this, SIGNAL(error()));
+
+    createPipeline();
 
     mCUDAThread.setObjectName(QStringLiteral("CUDAThread"));
     moveToThread(&mCUDAThread);
     mCUDAThread.start();
 }
 
+ProcessorBase* RawProcessor::createProcessor()
+{
+    //Processor has to match memory camera frames are allocated in
+    if(mCamera->getFrameBuffer()->backend() == mbHost)
+        return new CPUProcessor(!mCamera->isColor());
+
+#ifndef HOST_ONLY
+    if(mCamera->isColor())
+        return new CUDAProcessorBase();
+
+    return new CUDAProcessorGray();
+#else
+    //GPU processors are not built
+    return nullptr;
+#endif
+}
+
+void RawProcessor::createPipeline()
+{
+    //GPU encoder works on processor buffers, so CUDA processors encode in the process stage.
+    //Host JPEG encoding is the longest step for CPU processor, every frame is split
+    //into restart interval strips encoded on all cores, which also keeps latency low.
+    mHostEncoding = mProcessorPtr && mProcessorPtr->backend() == mbHost;
+    const int encoders = 1;
+    if(mHostEncoding)
+        mJpegEncoderPtr.reset(new jpeg_parallel_encoder(QThread::idealThreadCount()));
+
+    const QStringList stages = pipelineStages();
+    mPipelinePtr.reset(new PipelineScheduler<ProcessedFrame>(encoders + 2));
+    mPipelinePtr->addStage(stages[0], [this](ProcessedFrame& frame){processFrame(frame);});
+    mPipelinePtr->addStage(stages[1], [this](ProcessedFrame& frame){encodeFrame(frame);}, encoders, encoders);
+    mPipelinePtr->addStage(stages[2], [this](ProcessedFrame& frame){outputFrame(frame);}, 1, encoders);
+}
+
+QStringList RawProcessor::pipelineStages()
+{
+    return {QStringLiteral("process"), QStringLiteral("encode"), QStringLiteral("output")};
+}
+
 RawProcessor::~RawProcessor()
 {
     stop();
     mCUDAThread.quit();
     mCUDAThread.wait(3000);
+    mPipelinePtr->stop();
 }
 
 fastStatus_t RawProcessor::init()
@@ -73,11 +125,20 @@ fastStatus_t RawProcessor::init()
     return mProcessorPtr->Init(mOptions);
 }
 
+fastStatus_t RawProcessor::reconfigure()
+{
+    if(!mProcessorPtr)
+        return FAST_INVALID_VALUE;
+
+    return mProcessorPtr->Reconfigure(mOptions);
+}
+
 void RawProcessor::start()
 {
     if(!mProcessorPtr || mCamera == nullptr)
         return;
 
+    Metrics::reset();
     QTimer::singleShot(0, this, [this](){startWorking();});
 }
 
@@ -88,7 +149,7 @@ void RawProcessor::stop()
 
     if(mFileWriterPtr)
     {
-        mFileWriterPtr->waitFinish();
+        mFileWriterPtr->flush();
         mFileWriterPtr->stop();
     }
 
@@ -119,15 +180,13 @@ void RawProcessor::startWorking()
 {
     mWorking = true;
 
-//    int frameTime = qRound(1000.F / mRenderFps);
-    qint64 lastTime = 0;
-    QElapsedTimer tm;
-    tm.start();
-
-    QByteArray buffer;
-    buffer.resize(mOptions.Width * mOptions.Height * 4);
+    mRenderTimer.start();
+    mLastRenderTime = 0;
     mWake = false;
 
+    //Frames are taken from the camera buffer by the process stage,
+    //this loop only dispatches them, up to pipeline frame count in flight
+    mPipelinePtr->start();
     while(mWorking)
     {
         if(!mWake)
@@ -143,109 +202,277 @@ void RawProcessor::startWorking()
         if(!mProcessorPtr || mCamera == nullptr)
             continue;
 
-        ImageT* img = mCamera->getFrameBuffer()->getLastImage();
-        mProcessorPtr->Transform(img, mOptions);
-        if(mRenderer)
-        {
+        ProcessedFrame* frame = mPipelinePtr->acquire();
+        if(frame == nullptr)
+            break;
+
+        mPipelinePtr->submit(frame);
+    }
+    mPipelinePtr->stop();
+    mWorking = false;
+}
+
+void RawProcessor::processFrame(ProcessedFrame& frame)
+{
+    frame.valid = false;
+    frame.stream = false;
+    frame.encoded = false;
+    frame.task = nullptr;
+
+    CircularBuffer* inputBuffer = mCamera->getFrameBuffer();
+    ImageT* img = inputBuffer->consume(&frame.meta);
+    if(img == nullptr)
+        return;
+
+    frame.valid = true;
+    frame.surfaceFmt = img->surfaceFmt;
+    frame.codec = mOptions.Codec;
+    frame.width = mOptions.Width;
+    frame.height = mOptions.Height;
+    frame.jpegQuality = mQualityController.isActive() ? mQualityController.quality() : mOptions.JpegQuality;
+
+    mProcessorPtr->Transform(img, mOptions, frame.meta);
+    inputBuffer->release();
+
+    //Ordered policies can have more frames queued
+    if(inputBuffer->count() > 0)
+        wake();
+
+#ifndef HEADLESS
+    if(mRenderer)
+    {
 /// on arm processor cannot show 60 fps
-            const qint64 frameTime = 32;
-            qint64 curTime = tm.elapsed();
+        const qint64 frameTime = 32;
+        qint64 curTime = mRenderTimer.elapsed();
 #ifdef __ARM_ARCH
-            if(curTime - lastTime >= frameTime)
+        if(curTime - mLastRenderTime >= frameTime)
 #endif
-            {
-                mRenderer->loadImage(mProcessorPtr->GetFrameBuffer(), mOptions.Width, mOptions.Height);
-                mRenderer->update();
-                lastTime = curTime;
+        {
+            mRenderer->loadImage(mProcessorPtr->GetFrameBuffer(), mOptions.Width, mOptions.Height, mProcessorPtr->backend());
+            mRenderer->update();
+            mLastRenderTime = curTime;
 
-                emit finished();
-            }
+            emit finished();
         }
+    }
+#endif
+
+    const bool jpeg = frame.codec == CUDAProcessorOptions::vcJPG ||
+                      frame.codec == CUDAProcessorOptions::vcMJPG;
 
-        /// added sending by rtsp
-        if(mOptions.Codec == CUDAProcessorOptions::vcJPG ||
-           mOptions.Codec == CUDAProcessorOptions::vcMJPG)
+    /// added sending by rtsp
+    frame.stream = mRtspServer && mRtspServer->isConnected();
+    frame.streamJpeg.size = 0;
+    if(frame.stream && frame.codec == CUDAProcessorOptions::vcH264)
+    {
+        frame.image.resize(size_t(frame.width) * frame.height * 4);
+        mProcessorPtr->export8bitData(frame.image.data(), true);
+    }
+    else if(frame.stream && jpeg)
+    {
+        //Stream gets JPEG of this very frame, so image and timestamp always match.
+        //Host processor is encoded by the encode stage from the copy below
+        if(mHostEncoding)
         {
-            if(mRtspServer && mRtspServer->isConnected())
-            {
-                mRtspServer->addFrame(nullptr);
-            }
+            copyHostImage(frame);
         }
-        if(mOptions.Codec == CUDAProcessorOptions::vcH264)
+        else
         {
-            if(mRtspServer && mRtspServer->isConnected())
-            {
-                unsigned char* data = (uchar*)buffer.data();
-                mProcessorPtr->export8bitData((void*)data, true);
+            int channels = mProcessorPtr->isGrayscale() ? 1 : 3;
+            unsigned pitch = channels * (((frame.width + FAST_ALIGNMENT - 1) / FAST_ALIGNMENT) * FAST_ALIGNMENT);
+            unsigned sz = pitch * frame.height;
 
-                mRtspServer->addFrame(data);
-            }
+            frame.streamJpeg.buffer.resize(sz);
+            if(mProcessorPtr->exportJPEGData(frame.streamJpeg.buffer.data(), frame.jpegQuality, sz) == FAST_OK)
+                frame.streamJpeg.size = sz;
         }
+    }
+
+    if(!mWriting || !mFileWriterPtr)
+        return;
+
+    //Blocking recording policy waits for the writer instead of dropping the frame
+    const int leaseTimeout = mRecordingPolicy == CircularBuffer::fpBlock ? mRecordingPolicyParam : 0;
 
-        if(mWriting && mFileWriterPtr)
+    if(jpeg)
+    {
+        //No free buffer, the writer is behind, do not encode the frame at all
+        frame.task = mFileWriterPtr->createTask(leaseTimeout);
+        if(frame.task == nullptr)
         {
-            if(mOptions.Codec == CUDAProcessorOptions::vcJPG ||
-               mOptions.Codec == CUDAProcessorOptions::vcMJPG)
-            {
-                unsigned char* buf = mFileWriterPtr->getBuffer();
-                if(buf != nullptr)
-                {
-                    FileWriterTask* task = new FileWriterTask();
-                    task->fileName =  QStringLiteral("%1/%2%3.jpg").arg(mOutputPath,mFilePrefix).arg(mFrameCnt);
-                    task->size = mFileWriterPtr->bufferSize();
-                    task->data = buf;
-                    mProcessorPtr->exportJPEGData(task->data, mOptions.JpegQuality, task->size);
-                    mFileWriterPtr->put(task);
-                    mFileWriterPtr->wake();
-                    mFrameCnt++;
-                }
-            }
-            else if(mOptions.Codec == CUDAProcessorOptions::vcPGM)
-            {
-                int bpc = GetBitsPerChannelFromSurface(img->surfaceFmt);
-                int maxVal = (1 << bpc) - 1;
-                unsigned char* buf = mFileWriterPtr->getBuffer();
-                if(buf != nullptr)
-                {
-                    unsigned w = 0;
-                    unsigned h = 0;
-                    unsigned pitch = 0;
-                    mProcessorPtr->exportRawData(nullptr, w, h, pitch);
-
-                    QString header = QString("P5\n%1 %2\n%3\n").arg(w).arg(h).arg(maxVal);
-
-                    int sz = header.size() + pitch * h;
-
-                    FileWriterTask* task = new FileWriterTask();
-                    task->fileName =  QStringLiteral("%1/%2%3.pgm").arg(mOutputPath,mFilePrefix).arg(mFrameCnt);
-                    task->size = sz;
-
-                    task->data = buf;
-                    memcpy(task->data, header.toStdString().c_str(), header.size());
-                    unsigned char* data = task->data + header.size();
-                    mProcessorPtr->exportRawData((void*)data, w, h, pitch);
-
-                    //Not 8 bit pgm requires big endian byte order
-                    if(img->surfaceFmt != FAST_I8)
-                    {
-                        unsigned short* data16 = (unsigned short*)data;
-                        for(unsigned i = 0; i < w * h; i++)
-                        {
-                            unsigned short val = *data16;
-                            *data16 = (val << 8) | (val >> 8);
-                            data16++;
-                        }
-                    }
-
-                    mFileWriterPtr->put(task);
-                    mFileWriterPtr->wake();
-                    mFrameCnt++;
-                }
+            mQualityController.dropped();
+            return;
+        }
 
-            }
+        frame.task->fileName =  QStringLiteral("%1%2.jpg").arg(mFilePrefix).arg(frame.meta.seq);
+        frame.task->meta = frame.meta;
+
+        if(mHostEncoding)
+        {
+            //Already copied for the stream
+            if(!frame.stream)
+                copyHostImage(frame);
+        }
+        else if(frame.streamJpeg.size > 0 && frame.streamJpeg.size <= frame.task->size)
+        {
+            //Same quality for file and stream, encode once
+            memcpy(frame.task->data, frame.streamJpeg.buffer.data(), frame.streamJpeg.size);
+            frame.task->size = unsigned(frame.streamJpeg.size);
+            frame.encoded = true;
+        }
+        else
+        {
+            mProcessorPtr->exportJPEGData(frame.task->data, frame.jpegQuality, frame.task->size);
+            frame.encoded = true;
         }
     }
-    mWorking = false;
+    else if(frame.codec == CUDAProcessorOptions::vcPGM)
+    {
+        int bpc = GetBitsPerChannelFromSurface(frame.surfaceFmt);
+        int maxVal = (1 << bpc) - 1;
+        frame.task = mFileWriterPtr->createTask(leaseTimeout);
+        if(frame.task == nullptr)
+            return;
+
+        unsigned w = 0;
+        unsigned h = 0;
+        unsigned pitch = 0;
+        mProcessorPtr->exportRawData(nullptr, w, h, pitch);
+
+        QString header = QString("P5\n%1 %2\n%3\n").arg(w).arg(h).arg(maxVal);
+
+        int sz = header.size() + pitch * h;
+
+        frame.task->fileName =  QStringLiteral("%1%2.pgm").arg(mFilePrefix).arg(frame.meta.seq);
+        frame.task->size = sz;
+        frame.task->meta = frame.meta;
+
+        memcpy(frame.task->data, header.toStdString().c_str(), header.size());
+        mProcessorPtr->exportRawData(frame.task->data + header.size(), w, h, pitch);
+
+        //Byte order is fixed by encode stage
+        frame.pitch = pitch;
+        frame.height = h;
+        frame.encoded = frame.surfaceFmt == FAST_I8;
+    }
+    else if(frame.codec == CUDAProcessorOptions::vcRAW)
+    {
+        //Container keeps host byte order and geometry in file header,
+        //nothing is left for the encode stage
+        frame.task = mFileWriterPtr->createTask(leaseTimeout);
+        if(frame.task == nullptr)
+            return;
+
+        unsigned w = 0;
+        unsigned h = 0;
+        unsigned pitch = 0;
+        mProcessorPtr->exportRawData(frame.task->data, w, h, pitch);
+
+        frame.task->size = pitch * h;
+        frame.task->meta = frame.meta;
+        frame.encoded = true;
+    }
+}
+
+void RawProcessor::copyHostImage(ProcessedFrame& frame)
+{
+    //Display buffer of host processor is tightly packed RGB
+    QMutexLocker lock(&mProcessorPtr->mut);
+    const size_t sz = size_t(frame.width) * frame.height * 3;
+    frame.image.resize(sz);
+    memcpy(frame.image.data(), mProcessorPtr->GetFrameBuffer(), sz);
+}
+
+void RawProcessor::encodeFrame(ProcessedFrame& frame)
+{
+    if(!frame.valid)
+        return;
+
+    encodeTask(frame);
+
+    //Host stream JPEG, shares the file when it has one
+    if(frame.stream && mHostEncoding && frame.streamJpeg.size == 0 &&
+       (frame.codec == CUDAProcessorOptions::vcJPG || frame.codec == CUDAProcessorOptions::vcMJPG))
+    {
+        if(frame.task != nullptr && frame.encoded)
+        {
+            frame.streamJpeg.buffer.assign(frame.task->data, frame.task->data + frame.task->size);
+            frame.streamJpeg.size = frame.task->size;
+        }
+        else
+        {
+            Metrics::ScopedTimer timer(Metrics::mtMjpegEncoder);
+            if(!mJpegEncoderPtr->encode(frame.image.data(), int(frame.width), int(frame.height), 3,
+                                        frame.streamJpeg, int(frame.jpegQuality)))
+                frame.streamJpeg.size = 0;
+        }
+    }
+}
+
+void RawProcessor::encodeTask(ProcessedFrame& frame)
+{
+    if(frame.task == nullptr || frame.encoded)
+        return;
+
+    if(frame.codec == CUDAProcessorOptions::vcPGM)
+    {
+        //Not 8 bit pgm requires big endian byte order
+        const unsigned count = frame.pitch * frame.height / 2;
+        unsigned short* data16 = (unsigned short*)(frame.task->data + frame.task->size - count * 2);
+        CPUKernels::byteSwap16(data16, data16, int(count));
+    }
+    else
+    {
+        Metrics::ScopedTimer timer(Metrics::mtMjpegEncoder);
+        //Task size is the capacity of the writer buffer, stream goes there directly
+        uint size = frame.task->size;
+        bool res = mJpegEncoderPtr->encode(frame.image.data(), int(frame.width), int(frame.height), 3,
+                                           frame.task->data, size, int(frame.jpegQuality));
+        if(!res || size == 0)
+        {
+            delete frame.task;
+            frame.task = nullptr;
+            return;
+        }
+        frame.task->size = size;
+    }
+    frame.encoded = true;
+}
+
+void RawProcessor::outputFrame(ProcessedFrame& frame)
+{
+    if(!frame.valid)
+        return;
+
+    if(frame.stream && mRtspServer)
+    {
+        if(frame.codec == CUDAProcessorOptions::vcJPG ||
+           frame.codec == CUDAProcessorOptions::vcMJPG)
+        {
+            if(frame.streamJpeg.size > 0)
+                mRtspServer->addJpegFrame(frame.streamJpeg.buffer.data(), frame.streamJpeg.size, &frame.meta);
+        }
+        else if(frame.codec == CUDAProcessorOptions::vcH264)
+        {
+            mRtspServer->addFrame(frame.image.data(), &frame.meta);
+        }
+    }
+
+    if(frame.task != nullptr)
+    {
+        if(mQualityController.isActive())
+            mQualityController.update(outputLoad(frame.stream), frame.task->size, frame.meta.hostTimestamp);
+
+        if(mPreTriggerActive)
+            putTriggered(frame.task);
+        else
+            mFileWriterPtr->put(frame.task);
+        frame.task = nullptr;
+        mFrameCnt++;
+    }
+
+    if(mFrameCallback)
+        mFrameCallback(frame.meta);
 }
 
 fastStatus_t RawProcessor::getLastError()
@@ -261,27 +488,112 @@ QString RawProcessor::getLastErrorDescription()
     return  (mProcessorPtr) ? mProcessorPtr->getLastErrorDescription() : QString();
 }
 
+QString RawProcessor::getWriterError()
+{
+    return (mWriting && mFileWriterPtr) ? mFileWriterPtr->errorString() : QString();
+}
+
 QMap<QString, float> RawProcessor::getStats()
 {
     QMap<QString, float> ret;
     if(mProcessorPtr)
     {
-        {
-            QMutexLocker l(&mProcessorPtr->mut);
-            ret = mProcessorPtr->stats;
-        }
+        ret = mProcessorPtr->statsSnapshot();
+
+        const QMap<QString, float> pipelineStats = mPipelinePtr->stats();
+        for(auto it = pipelineStats.cbegin(); it != pipelineStats.cend(); ++it)
+            ret[it.key()] = it.value();
 
         if(mWriting)
         {
             ret[QStringLiteral("procFrames")] = mFileWriterPtr->getProcessedFrames();
             ret[QStringLiteral("droppedFrames")] = mFileWriterPtr->getDroppedFrames();
+            ret[QStringLiteral("writerFailed")] = mFileWriterPtr->failed() ? 1 : 0;
+            ret[QStringLiteral("writerBuffers")] = mFileWriterPtr->bufferCount();
+            ret[QStringLiteral("writerBuffersLeased")] = mFileWriterPtr->buffersLeased();
+
+            if(mPreTriggerActive)
+            {
+                ret[QStringLiteral("preTriggerFrames")] = mPreTrigger.count();
+                ret[QStringLiteral("preTriggerMB")] = float(mPreTrigger.bytes() / (1024. * 1024.));
+                ret[QStringLiteral("preTriggerSeconds")] = float(mPreTrigger.span() / 1000000000.);
+                ret[QStringLiteral("triggered")] = mTriggered ? 1 : 0;
+            }
+
+            if(mQualityController.isActive())
+            {
+                ret[QStringLiteral("jpegQuality")] = mQualityController.quality();
+                ret[QStringLiteral("jpegQualityChanges")] = mQualityController.changes();
+                ret[QStringLiteral("jpegBytesPerFrame")] = float(mQualityController.bytesPerFrame());
+                ret[QStringLiteral("jpegMBps")] = float(mQualityController.bandwidth() / 1048576.);
+            }
+
+            if(mCodec != CUDAProcessorOptions::vcMJPG && mCodec != CUDAProcessorOptions::vcRAW)
+            {
+                AsyncFileWriter* writer = static_cast<AsyncFileWriter*>(mFileWriterPtr.data());
+                const QVector<AsyncFileWriter::VolumeStats> volumes = writer->volumeStats();
+                ret[QStringLiteral("writerVolumes")] = volumes.size();
+                for(int i = 0; i < volumes.size(); i++)
+                {
+                    ret[QStringLiteral("volume%1_queue").arg(i)] = volumes[i].queued;
+                    ret[QStringLiteral("volume%1_queueMax").arg(i)] = volumes[i].maxQueued;
+                    ret[QStringLiteral("volume%1_frames").arg(i)] = volumes[i].frames;
+                    ret[QStringLiteral("volume%1_MBps").arg(i)] = float(volumes[i].throughput);
+                }
+            }
+            else if(mCodec == CUDAProcessorOptions::vcRAW)
+            {
+                AsyncRawWriter* writer = static_cast<AsyncRawWriter*>(mFileWriterPtr.data());
+                ret[QStringLiteral("rawBackend")] = writer->backend();
+                ret[QStringLiteral("rawMBps")] = float(writer->throughput());
+                ret[QStringLiteral("segments")] = writer->segmentCount();
+            }
+            else
+            {
+                AsyncMJPEGWriter* writer = static_cast<AsyncMJPEGWriter*>(mFileWriterPtr.data());
+                ret[QStringLiteral("segments")] = writer->segmentCount();
+            }
         }
         else
         {
             ret[QStringLiteral("procFrames")] = -1;
             ret[QStringLiteral("droppedFrames")] = -1;
         }
-        ret[QStringLiteral("acqTime")] = acqTimeNsec;
+    }
+
+    if(mCamera)
+    {
+        CircularBuffer* inputBuffer = mCamera->getFrameBuffer();
+        ret[QStringLiteral("acqTime")] = inputBuffer->frameInterval();
+        ret[QStringLiteral("captureFrames")] = inputBuffer->written();
+        ret[QStringLiteral("captureDropped")] = inputBuffer->dropped();
+        ret[QStringLiteral("capturePolicy")] = inputBuffer->policy();
+        for(int i = 0; i < CircularBuffer::fpCount; i++)
+        {
+            auto policy = static_cast<CircularBuffer::FramePolicy>(i);
+            QString name = CircularBuffer::policyName(policy);
+            ret[QStringLiteral("captureDropped_%1").arg(name)] = inputBuffer->dropped(policy);
+            ret[QStringLiteral("captureBlocked_%1").arg(name)] = inputBuffer->blocked(policy);
+            ret[QStringLiteral("captureBlockedTime_%1").arg(name)] = inputBuffer->blockedTime(policy) / 1000000.F;
+        }
+    }
+
+    //Last value and percentiles, -1 for stages not run
+    for(int i = 0; i < Metrics::mtCount; i++)
+    {
+        auto metric = static_cast<Metrics::Metric>(i);
+        const Metrics::Snapshot s = Metrics::snapshot(metric);
+        const QString name = Metrics::name(metric);
+        if(s.count == 0 || (Metrics::isProcessorStage(metric) && !s.current))
+        {
+            ret[name] = -1;
+            continue;
+        }
+        ret[name] = float(s.last);
+        ret[name + QStringLiteral("_p50")] = float(s.p50);
+        ret[name + QStringLiteral("_p95")] = float(s.p95);
+        ret[name + QStringLiteral("_p99")] = float(s.p99);
+        ret[name + QStringLiteral("_max")] = float(s.max);
     }
 
     return ret;
@@ -293,61 +605,207 @@ void RawProcessor::startWriting()
         return;
 
     mWriting = false;
-    if(QFileInfo(mOutputPath).exists())
+
+    //Several output folders are separated like in PATH, frames are striped over them
+    const QStringList volumes = mOutputPath.split(QDir::listSeparator(), QString::SkipEmptyParts);
+    if(volumes.isEmpty())
+        return;
+
+    for(const QString& volume : volumes)
     {
-        QDir dir;
-        if(!dir.mkpath(mOutputPath))
+        if(!QDir().mkpath(volume))
             return;
     }
 
-    if(!QFileInfo(mOutputPath).isDir())
-        return;
-
     mCodec = mOptions.Codec;
 
+    //Frames in flight can still hold buffers of the previous writer
+    mPipelinePtr->flush();
+
+    CircularBuffer* inputBuffer = mCamera->getFrameBuffer();
+    mLivePolicy = inputBuffer->policy();
+    mLivePolicyParam = inputBuffer->policyParam();
+    inputBuffer->setPolicy(mRecordingPolicy, mRecordingPolicyParam);
+
     if(mCodec == CUDAProcessorOptions::vcMJPG)
     {
         QString fileName = QDir::toNativeSeparators(
                     QStringLiteral("%1/%2.avi").
-                    arg(mOutputPath).
+                    arg(volumes.first()).
                     arg(QDateTime::currentDateTime().toString(QStringLiteral("dd_MM_yyyy_hh_mm_ss"))));
         AsyncMJPEGWriter* writer = new AsyncMJPEGWriter();
+        writer->setSegmentLimits(mSegmentLimits);
         writer->open(mCamera->width(),
                      mCamera->height(),
-                     25,
-                     mCamera->isColor() ? mOptions.JpegSamplingFmt : JPEG_Y,
+                     mCamera->fps() > 0 ? double(mCamera->fps()) : 25.,
                      fileName);
         mFileWriterPtr.reset(writer);
     }
+    else if(mCodec == CUDAProcessorOptions::vcRAW)
+    {
+        QString fileName = QDir::toNativeSeparators(
+                    QStringLiteral("%1/%2.fvraw").
+                    arg(volumes.first()).
+                    arg(QDateTime::currentDateTime().toString(QStringLiteral("dd_MM_yyyy_hh_mm_ss"))));
+
+        unsigned w = 0;
+        unsigned h = 0;
+        unsigned pitch = 0;
+        mProcessorPtr->exportRawData(nullptr, w, h, pitch);
+
+        RawContainer::FileHeader header {};
+        header.width = w;
+        header.height = h;
+        header.pitch = pitch;
+        header.bitsPerChannel = unsigned(GetBitsPerChannelFromSurface(mCamera->surfaceFormat()));
+        header.surfaceFmt = mCamera->surfaceFormat();
+        header.pattern = mCamera->bayerPattern();
+        header.isColor = mCamera->isColor() ? 1 : 0;
+        header.whiteLevel = unsigned(mCamera->whiteLevel());
+        header.blackLevel = unsigned(mCamera->blackLevel());
+
+        AsyncRawWriter* writer = new AsyncRawWriter();
+        writer->setSegmentLimits(mSegmentLimits);
+        writer->open(fileName, header, mRawQueueDepth);
+        mFileWriterPtr.reset(writer);
+    }
     else
-        mFileWriterPtr.reset(new AsyncFileWriter());
+    {
+        AsyncFileWriter* writer = new AsyncFileWriter();
+        writer->setVolumes(volumes, mWriterThreads);
+        mFileWriterPtr.reset(writer);
+    }
 
     unsigned pitch = 3 *(((mOptions.Width + FAST_ALIGNMENT - 1) / FAST_ALIGNMENT ) * FAST_ALIGNMENT);
     unsigned sz = pitch * mOptions.Height;
+
+    //Kept frames hold writer buffers, pool gets them on top of the usual count,
+    //so live frames never wait for the ring. Ring buffers are allocated
+    //as the ring fills up and then reused, the byte limit caps them.
+    int ringFrames = 0;
+    if(isPreTrigger())
+    {
+        const float fps = mCamera->fps() > 0 ? mCamera->fps() : 30;
+        ringFrames = std::numeric_limits<int>::max();
+        if(mPreTriggerSeconds > 0)
+            ringFrames = int(std::ceil(mPreTriggerSeconds * fps)) + 1;
+        if(mPreTriggerBytes > 0)
+            ringFrames = int(qMin(qint64(ringFrames), mPreTriggerBytes / sz));
+        ringFrames = qMax(ringFrames, 1);
+    }
+    mPreTrigger.clear();
+    mPreTrigger.setLimits(ringFrames, qint64(mPreTriggerSeconds * 1000000000.), mPreTriggerBytes);
+    mPreTriggerActive = ringFrames > 0;
+    mPreTriggerFrames = ringFrames;
+    mTriggerTime = 0;
+    mTriggered = false;
+
+    mFileWriterPtr->setBufferCount(mWriterBufferCount + ringFrames, mWriterBufferCount);
     mFileWriterPtr->initBuffers(sz);
 
+    if(mCodec == CUDAProcessorOptions::vcJPG || mCodec == CUDAProcessorOptions::vcMJPG)
+        mQualityController.start(mOptions.JpegQuality);
+
     mFrameCnt = 0;
     mWriting = true;
 }
 
+void RawProcessor::setPreTrigger(double seconds, qint64 maxBytes, double postSeconds)
+{
+    mPreTriggerSeconds = qMax(seconds, 0.);
+    mPreTriggerBytes = qMax(maxBytes, qint64(0));
+    mPostTriggerSeconds = qMax(postSeconds, 0.);
+}
+
+void RawProcessor::setSegmentLimits(qint64 maxBytes, double maxSeconds, int maxFrames)
+{
+    mSegmentLimits.maxBytes = qMax(maxBytes, qint64(0));
+    mSegmentLimits.maxDuration = qint64(qMax(maxSeconds, 0.) * 1000000000.);
+    mSegmentLimits.maxFrames = qMax(maxFrames, 0);
+}
+
+void RawProcessor::trigger()
+{
+    mTriggerTime = FrameMetadata::now();
+}
+
+double RawProcessor::outputLoad(bool stream)
+{
+    //Buffers kept by pre-trigger ring are expected to be in use
+    const int count = mFileWriterPtr->bufferCount() - mPreTriggerFrames;
+    const int leased = mFileWriterPtr->buffersLeased() - mPreTrigger.count();
+    double load = count > 0 ? double(qMax(leased, 0)) / count : 0;
+    if(stream && mRtspServer)
+        load = qMax(load, mRtspServer->queueLoad());
+    return load;
+}
+
+void RawProcessor::putTriggered(FileWriterTask* task)
+{
+    //Handled by output stage only, frames reach it in capture order
+    const qint64 triggerTime = mTriggerTime.exchange(0);
+    if(triggerTime > 0)
+    {
+        //Writer queue takes kept frames without waiting, they are written in background
+        for(FileWriterTask* kept : mPreTrigger.take())
+            mFileWriterPtr->put(kept);
+
+        mPostTriggerEnd = triggerTime + qint64(mPostTriggerSeconds * 1000000000.);
+        mTriggered = true;
+    }
+
+    const qint64 captureTime = task->meta.hostTimestamp > 0 ? task->meta.hostTimestamp : FrameMetadata::now();
+    if(mTriggered && captureTime > mPostTriggerEnd)
+        mTriggered = false;
+
+    if(mTriggered)
+        mFileWriterPtr->put(task);
+    else
+        mPreTrigger.push(task);
+}
+
 void RawProcessor::stopWriting()
 {
+    if(mWriting && mCamera)
+        mCamera->getFrameBuffer()->setPolicy(mLivePolicy, mLivePolicyParam);
+
     mWriting = false;
+    mQualityController.stop();
     if(!mFileWriterPtr)
     {
         mCodec = CUDAProcessorOptions::vcNone;
         return;
     }
 
+    //Let frames already in the pipeline reach the writer
+    //and wait until all of them are written
+    mPipelinePtr->flush();
+    mFileWriterPtr->flush();
+
+    //Frames kept for a trigger which did not come
+    mPreTrigger.clear();
+    mTriggered = false;
+
     if(mCodec == CUDAProcessorOptions::vcMJPG)
     {
         AsyncMJPEGWriter* writer = static_cast<AsyncMJPEGWriter*>(mFileWriterPtr.data());
         writer->close();
     }
+    else if(mCodec == CUDAProcessorOptions::vcRAW)
+    {
+        AsyncRawWriter* writer = static_cast<AsyncRawWriter*>(mFileWriterPtr.data());
+        writer->close();
+    }
 
     mCodec = CUDAProcessorOptions::vcNone;
 }
 
+void RawProcessor::setRecordingPolicy(CircularBuffer::FramePolicy policy, int param)
+{
+    mRecordingPolicy = policy;
+    mRecordingPolicyParam = param;
+}
+
 void RawProcessor::setSAM(const QString& fpnFileName, const QString& ffcFileName)
 {
     FPNReader* fpnReader = gFPNStore->getReader(fpnFileName);
@@ -386,7 +844,7 @@ void RawProcessor::setSAM(const QString& fpnFileName, const QString& ffcFileName
     else
         mOptions.MatrixA = nullptr;
 
-    init();
+    reconfigure();
 }
 
 QColor RawProcessor::getAvgRawColor(QPoint rawPoint)
@@ -540,22 +998,8 @@ void RawProcessor::setRtspServer(const QString &url)
 
     mRtspServer->setMultithreading(false);
 
-	auto funEncode = [this](int, unsigned char* , int width, int height, int, Buffer& output){
-
-		int channels = dynamic_cast<CUDAProcessorGray*>(mProcessorPtr.data()) == nullptr? 3 : 1;
-
-		unsigned pitch = channels *(((width + FAST_ALIGNMENT - 1) / FAST_ALIGNMENT ) * FAST_ALIGNMENT);
-        unsigned sz = pitch * height;
-
-		output.buffer.resize(sz);
-		mProcessorPtr->exportJPEGData(output.buffer.data(), mOptions.JpegQuality, sz);
-		output.size = sz;
-    };
-    mRtspServer->setUseCustomEncodeJpeg(true);
-    mRtspServer->setEncodeFun(funEncode);
-
     auto funEncodeNv12 = [this](unsigned char* yuv, unsigned char*, int , int ){
-        //int channels = dynamic_cast<CUDAProcessorGray*>(mProcessorPtr.data()) == nullptr? 3 : 1;
+        //int channels = mProcessorPtr->isGrayscale() ? 1 : 3;
 
         mProcessorPtr->exportNV12Data(yuv);
     };
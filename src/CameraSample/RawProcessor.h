@@ -36,17 +36,54 @@
 #include <QScopedPointer>
 #include <QDir>
 #include <QColor>
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <functional>
+#include <vector>
+#include <atomic>
 
 #include "CUDAProcessorOptions.h"
 #include "AsyncFileWriter.h"
 #include "RTSPStreamerServer.h"
+#include "FrameBuffer.h"
+#include "PipelineScheduler.h"
+#include "PreTriggerBuffer.h"
+#include "JpegQualityController.h"
+#include "JpegParallelEncoder.h"
 
-class CUDAProcessorBase;
-class CircularBuffer;
+class ProcessorBase;
 class MainWindow;
 class GLRenderer;
 class CameraBase;
 
+/// Frame passed through process, encode and output stages of RawProcessor pipeline.
+/// Everything needed after the process stage is copied out of the processor,
+/// so next frame can be transformed while this one is encoded and written.
+struct ProcessedFrame
+{
+    //Set if a frame was taken from the camera buffer
+    bool valid = false;
+    FrameMetadata meta;
+    fastSurfaceFormat_t surfaceFmt = FAST_I8;
+    CUDAProcessorOptions::VideoCodec codec = CUDAProcessorOptions::vcNone;
+    unsigned width = 0;
+    unsigned height = 0;
+    //Row pitch of raw image in PGM task
+    unsigned pitch = 0;
+    unsigned jpegQuality = 0;
+    //Send to RTSP server
+    bool stream = false;
+    //Task for file writer, data points to writer buffer
+    FileWriterTask* task = nullptr;
+    //Task data is ready to be written, otherwise encode stage has to finish it
+    bool encoded = false;
+    //Host copy of processed image, RGB 8 bit
+    std::vector<unsigned char> image;
+    //JPEG of this frame for RTSP server, capacity is kept between frames
+    Buffer streamJpeg;
+};
+
 class RawProcessor : public QObject
 {
     Q_OBJECT
@@ -55,20 +92,55 @@ public:
     ~RawProcessor();
 
     fastStatus_t init();
+    /// Apply current options, rebuilds only processor stages affected by the change
+    fastStatus_t reconfigure();
     void start();
     void stop();
     void wake();
     void updateOptions(const CUDAProcessorOptions& opts);
-    CUDAProcessorBase*   getCUDAProcessor() {return mProcessorPtr.data();}
+    ProcessorBase*       getProcessor() {return mProcessorPtr.data();}
     fastStatus_t         getLastError();
     QString              getLastErrorDescription();
+    /// Empty while the file writer stores every frame it gets
+    QString              getWriterError();
     QMap<QString, float> getStats();
     void startWriting();
     void stopWriting();
+    /// Output folder, several folders separated by QDir::listSeparator() are written round robin
     void setOutputPath(const QString& path){mOutputPath = path;}
     void setFilePrefix(const QString& prefix){mFilePrefix = prefix;}
     void setSAM(const QString& fpnFileName, const QString& ffcFileName);
 
+    /// Input buffer policy used while recording, live policy is restored on stopWriting
+    void setRecordingPolicy(CircularBuffer::FramePolicy policy, int param);
+    /// Writer buffers for frames queued to disk, applied by the next startWriting
+    void setWriterBufferCount(int count){mWriterBufferCount = count;}
+    /// File writer threads, at least one per output folder, applied by the next startWriting
+    void setWriterThreads(int count){mWriterThreads = count;}
+    /// Raw container writes in flight with O_DIRECT and io_uring, 0 writes through page cache.
+    /// Applied by the next startWriting.
+    void setRawQueueDepth(int depth){mRawQueueDepth = depth;}
+    /// Splits MJPEG and raw container recordings into files of up to maxBytes,
+    /// maxSeconds of capture time or maxFrames, 0 is no limit for one of them.
+    /// Default is Globals::MaxFileSize. Applied by the next startWriting.
+    void setSegmentLimits(qint64 maxBytes, double maxSeconds, int maxFrames);
+
+    /// Pre-trigger recording. After startWriting the last frames are kept in RAM instead
+    /// of being written: up to seconds of capture time and up to maxBytes of writer buffers,
+    /// 0 is no limit for one of them, both 0 switch pre-trigger off.
+    /// trigger() writes kept frames and records for postSeconds, then frames are kept again.
+    /// Applied by the next startWriting.
+    void setPreTrigger(double seconds, qint64 maxBytes, double postSeconds);
+    bool isPreTrigger() const {return mPreTriggerSeconds > 0 || mPreTriggerBytes > 0;}
+    /// Event to record around, can be called from any thread
+    void trigger();
+
+    /// Adaptive JPEG quality while recording JPEG or MJPEG, starts from the options quality.
+    /// Applied by the next startWriting.
+    void setAdaptiveQuality(const JpegQualityController::Settings& settings){mQualityController.setSettings(settings);}
+    /// Quality changes of the current recording
+    QVector<JpegQualityController::Adjustment> qualityHistory() const {return mQualityController.history();}
+
     QColor getAvgRawColor(QPoint rawPoint);
 
     void setRtspServer(const QString& url);
@@ -78,7 +150,12 @@ public:
     bool isStartedRtsp() const;
     bool isConnectedRtspClient() const;
 
-    float acqTimeNsec = -1.;
+    /// Names of pipeline stages used in getStats keys
+    static QStringList pipelineStages();
+
+    /// Called from the output stage for every processed frame, in capture order.
+    /// Has to be set before start().
+    void setFrameCallback(const std::function<void(const FrameMetadata&)>& callback){mFrameCallback = callback;}
 
 signals:
     void finished();
@@ -95,7 +172,7 @@ private:
     QString mFPNFile;
     QString mFFCFile;
 
-    QScopedPointer<CUDAProcessorBase> mProcessorPtr;
+    QScopedPointer<ProcessorBase>     mProcessorPtr;
     QScopedPointer<AsyncWriter>       mFileWriterPtr;
     QMutex               mWaitMutex;
     QWaitCondition       mWaitCond;
@@ -107,11 +184,50 @@ private:
     QString              mOutputPath;
     QString              mFilePrefix;
     unsigned             mFrameCnt = 0;
+    CircularBuffer::FramePolicy mRecordingPolicy = CircularBuffer::fpBlock;
+    int                  mRecordingPolicyParam = 100;
+    int                  mWriterBufferCount = 32;
+    int                  mWriterThreads = 0;
+    int                  mRawQueueDepth = 0;
+    SegmentRotation::Limits mSegmentLimits;
+    double               mPreTriggerSeconds = 0;
+    qint64               mPreTriggerBytes = 0;
+    double               mPostTriggerSeconds = 0;
+    PreTriggerBuffer     mPreTrigger;
+    //Pre-trigger settings applied by startWriting
+    bool                 mPreTriggerActive = false;
+    //Writer buffers taken by pre-trigger ring, not counted as writer load
+    int                  mPreTriggerFrames = 0;
+    //Host time of trigger not handled by output stage yet, 0 if none
+    std::atomic<qint64>  mTriggerTime {0};
+    //Capture time up to which frames are written, output stage only
+    qint64               mPostTriggerEnd = 0;
+    std::atomic<bool>    mTriggered {false};
+    JpegQualityController mQualityController;
+    CircularBuffer::FramePolicy mLivePolicy = CircularBuffer::fpLatest;
+    int                  mLivePolicyParam = 0;
     QString              mUrl;
     QScopedPointer<RTSPStreamerServer> mRtspServer;
-
+    std::function<void(const FrameMetadata&)> mFrameCallback;
+    QElapsedTimer        mRenderTimer;
+    qint64               mLastRenderTime = 0;
+    //JPEG is encoded by the pipeline from a host copy of the image, not by the processor
+    bool                 mHostEncoding = false;
+    QScopedPointer<jpeg_parallel_encoder> mJpegEncoderPtr;
+    //Declared last to be stopped before the objects stages use are destroyed
+    QScopedPointer<PipelineScheduler<ProcessedFrame>> mPipelinePtr;
 
     void startWorking();
+    ProcessorBase* createProcessor();
+    void createPipeline();
+    void processFrame(ProcessedFrame& frame);
+    void encodeFrame(ProcessedFrame& frame);
+    void encodeTask(ProcessedFrame& frame);
+    void copyHostImage(ProcessedFrame& frame);
+    void outputFrame(ProcessedFrame& frame);
+    void putTriggered(FileWriterTask* task);
+    /// Writer buffers and RTSP queue in use, 0..1
+    double outputLoad(bool stream);
 };
 
 //class AsyncCUDATransformer : public QObject
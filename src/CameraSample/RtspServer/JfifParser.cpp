@@ -0,0 +1,424 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "JfifParser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+    const uint8_t M_SOF0 = 0xC0;
+    const uint8_t M_SOF1 = 0xC1;
+    const uint8_t M_SOF3 = 0xC3;
+    const uint8_t M_DHT  = 0xC4;
+    const uint8_t M_JPG  = 0xC8;
+    const uint8_t M_SOF15 = 0xCF;
+    const uint8_t M_RST0 = 0xD0;
+    const uint8_t M_RST7 = 0xD7;
+    const uint8_t M_SOI  = 0xD8;
+    const uint8_t M_EOI  = 0xD9;
+    const uint8_t M_SOS  = 0xDA;
+    const uint8_t M_DQT  = 0xDB;
+    const uint8_t M_DRI  = 0xDD;
+    const uint8_t M_APP0 = 0xE0;
+    const uint8_t M_APP15 = 0xEF;
+    const uint8_t M_COM  = 0xFE;
+    const uint8_t M_TEM  = 0x01;
+
+    inline int read16(const uint8_t* data)
+    {
+        return (data[0] << 8) | data[1];
+    }
+
+    jfif_status parseDQT(const jfif_segment& seg, jfif_view& view)
+    {
+        size_t pos = 0;
+        while(pos < seg.size)
+        {
+            const int pq = seg.data[pos] >> 4;
+            const int tq = seg.data[pos] & 15;
+            if(pq > 1 || tq > 3)
+                return JFIF_INVALID;
+
+            const size_t size = pq ? 128 : 64;
+            if(seg.size - pos - 1 < size)
+                return JFIF_INVALID;
+
+            jfif_table& table = view.quant[tq];
+            table.data = seg.data + pos + 1;
+            table.size = size;
+            table.precision = pq;
+            pos += 1 + size;
+        }
+        return JFIF_OK;
+    }
+
+    jfif_status parseDHT(const jfif_segment& seg, jfif_view& view)
+    {
+        size_t pos = 0;
+        while(pos < seg.size)
+        {
+            if(seg.size - pos < 17)
+                return JFIF_INVALID;
+
+            const int tc = seg.data[pos] >> 4;
+            const int th = seg.data[pos] & 15;
+            if(tc > 1 || th > 3)
+                return JFIF_INVALID;
+
+            size_t symbols = 0;
+            for(int i = 1; i <= 16; ++i)
+                symbols += seg.data[pos + i];
+            if(symbols > 256 || seg.size - pos - 17 < symbols)
+                return JFIF_INVALID;
+
+            jfif_table& table = view.huffman[tc][th];
+            table.data = seg.data + pos + 1;
+            table.size = 16 + symbols;
+            table.precision = 0;
+            pos += 17 + symbols;
+        }
+        return JFIF_OK;
+    }
+
+    jfif_status parseSOF(const jfif_segment& seg, jfif_view& view)
+    {
+        if(!view.sof.empty())
+            return JFIF_UNSUPPORTED;
+        if(seg.size < 6)
+            return JFIF_INVALID;
+
+        const int nf = seg.data[5];
+        if(nf < 1 || nf > 4 || seg.size != 6 + size_t(nf) * 3)
+            return JFIF_INVALID;
+
+        view.sof = seg;
+        view.frameType = seg.marker;
+        view.precision = seg.data[0];
+        view.height = read16(seg.data + 1);
+        view.width = read16(seg.data + 3);
+        view.components = nf;
+
+        //Height 0 needs DNL after the scan
+        if(view.width == 0 || view.height == 0)
+            return JFIF_UNSUPPORTED;
+
+        int maxH = 1;
+        int maxV = 1;
+        for(int i = 0; i < nf; ++i)
+        {
+            const uint8_t* c = seg.data + 6 + i * 3;
+            jfif_component& comp = view.component[i];
+            comp.id = c[0];
+            comp.h = c[1] >> 4;
+            comp.v = c[1] & 15;
+            comp.tq = c[2];
+            if(comp.h < 1 || comp.h > 4 || comp.v < 1 || comp.v > 4 || comp.tq > 3)
+                return JFIF_INVALID;
+
+            for(int j = 0; j < i; ++j)
+                if(view.component[j].id == comp.id)
+                    return JFIF_INVALID;
+
+            maxH = std::max(maxH, int(comp.h));
+            maxV = std::max(maxV, int(comp.v));
+        }
+
+        //Single component scan is not interleaved, its MCU is one block
+        const int block = view.frameType == M_SOF3 ? 1 : 8;
+        view.mcuWidth = nf == 1 ? block : maxH * block;
+        view.mcuHeight = nf == 1 ? block : maxV * block;
+        view.mcuCols = (view.width + view.mcuWidth - 1) / view.mcuWidth;
+        view.mcuRows = (view.height + view.mcuHeight - 1) / view.mcuHeight;
+        return JFIF_OK;
+    }
+
+    jfif_status parseSOS(const jfif_segment& seg, jfif_view& view)
+    {
+        if(view.sof.empty())
+            return JFIF_INVALID;
+        if(seg.size < 1)
+            return JFIF_INVALID;
+
+        const int ns = seg.data[0];
+        if(ns < 1 || ns > 4 || seg.size != 4 + size_t(ns) * 2)
+            return JFIF_INVALID;
+
+        //One interleaved scan of every component
+        if(ns != view.components)
+            return JFIF_UNSUPPORTED;
+
+        for(int i = 0; i < ns; ++i)
+        {
+            const uint8_t* c = seg.data + 1 + i * 2;
+            jfif_component* comp = nullptr;
+            for(int j = 0; j < view.components; ++j)
+                if(view.component[j].id == c[0])
+                    comp = &view.component[j];
+
+            if(comp == nullptr)
+                return JFIF_INVALID;
+
+            for(int j = 0; j < i; ++j)
+                if(seg.data[1 + j * 2] == c[0])
+                    return JFIF_INVALID;
+
+            comp->td = c[1] >> 4;
+            comp->ta = c[1] & 15;
+            if(comp->td > 3 || comp->ta > 3)
+                return JFIF_INVALID;
+        }
+
+        const uint8_t* spectral = seg.data + 1 + ns * 2;
+        if(view.frameType == M_SOF3)
+        {
+            if(spectral[0] < 1 || spectral[0] > 7 || spectral[1] != 0 || (spectral[2] >> 4) != 0)
+                return JFIF_UNSUPPORTED;
+        }
+        else
+        {
+            if(spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0)
+                return JFIF_UNSUPPORTED;
+
+            for(int i = 0; i < view.components; ++i)
+                if(view.quant[view.component[i].tq].data == nullptr)
+                    return JFIF_INVALID;
+        }
+
+        view.sos = seg;
+        return JFIF_OK;
+    }
+
+    jfif_status parseScan(jfif_view& view)
+    {
+        const uint8_t* data = view.data;
+        const size_t size = view.size;
+        size_t pos = view.headerSize;
+
+        for(;;)
+        {
+            const uint8_t* ff = static_cast<const uint8_t*>(pos < size ? std::memchr(data + pos, 0xFF, size - pos) : nullptr);
+            if(ff == nullptr || size_t(ff - data) + 1 >= size)
+            {
+                view.scanSize = size - view.headerSize;
+                return JFIF_TRUNCATED;
+            }
+
+            pos = size_t(ff - data);
+            const uint8_t marker = data[pos + 1];
+            if(marker == 0x00)
+            {
+                pos += 2;
+            }
+            else if(marker == 0xFF)
+            {
+                pos += 1;
+            }
+            else if(marker >= M_RST0 && marker <= M_RST7)
+            {
+                if(marker != M_RST0 + (view.restartMarkers.size() & 7))
+                    return JFIF_INVALID;
+
+                view.restartMarkers.push_back(pos);
+                pos += 2;
+            }
+            else if(marker == M_EOI)
+            {
+                view.eoi = pos;
+                view.scanSize = pos - view.headerSize;
+                return JFIF_OK;
+            }
+            else
+            {
+                return JFIF_INVALID;
+            }
+        }
+    }
+}
+
+int jfif_view::intervals() const
+{
+    if(restartInterval == 0)
+        return 1;
+
+    const long long mcus = (long long)mcuCols * mcuRows;
+    return int((mcus + restartInterval - 1) / restartInterval);
+}
+
+void jfif_view::clear()
+{
+    data = nullptr;
+    size = 0;
+    frameType = 0;
+    precision = 0;
+    width = 0;
+    height = 0;
+    components = 0;
+    std::fill(std::begin(component), std::end(component), jfif_component());
+    mcuWidth = 0;
+    mcuHeight = 0;
+    mcuCols = 0;
+    mcuRows = 0;
+    restartInterval = 0;
+
+    app.clear();
+    dqt.clear();
+    dht.clear();
+    sof = jfif_segment();
+    sos = jfif_segment();
+    dri = jfif_segment();
+
+    std::fill(std::begin(quant), std::end(quant), jfif_table());
+    for(auto& tables : huffman)
+        std::fill(std::begin(tables), std::end(tables), jfif_table());
+
+    headerSize = 0;
+    scanSize = 0;
+    restartMarkers.clear();
+    eoi = 0;
+}
+
+jfif_status jfif_parse(const uint8_t *data, size_t size, jfif_view &view, bool scanMarkers)
+{
+    view.clear();
+    if(data == nullptr || size < 2 || data[0] != 0xFF || data[1] != M_SOI)
+        return data == nullptr || size < 2 ? JFIF_TRUNCATED : JFIF_INVALID;
+
+    view.data = data;
+    view.size = size;
+
+    size_t pos = 2;
+    for(;;)
+    {
+        if(pos + 2 > size)
+            return JFIF_TRUNCATED;
+        if(data[pos] != 0xFF)
+            return JFIF_INVALID;
+
+        const uint8_t marker = data[pos + 1];
+        //Fill bytes in front of a marker
+        if(marker == 0xFF)
+        {
+            pos += 1;
+            continue;
+        }
+        //Standalone markers have no length
+        if(marker == M_TEM)
+        {
+            pos += 2;
+            continue;
+        }
+        if(marker == M_SOI || marker == M_EOI || (marker >= M_RST0 && marker <= M_RST7) || marker == 0x00)
+            return JFIF_INVALID;
+
+        if(pos + 4 > size)
+            return JFIF_TRUNCATED;
+
+        const size_t length = size_t(read16(data + pos + 2));
+        if(length < 2)
+            return JFIF_INVALID;
+        if(length > size - pos - 2)
+            return JFIF_TRUNCATED;
+
+        jfif_segment seg;
+        seg.data = data + pos + 4;
+        seg.size = length - 2;
+        seg.offset = pos;
+        seg.marker = marker;
+        pos += 2 + length;
+
+        jfif_status status = JFIF_OK;
+        if(marker == M_SOF0 || marker == M_SOF1 || marker == M_SOF3)
+        {
+            status = parseSOF(seg, view);
+        }
+        else if(marker == M_DHT)
+        {
+            view.dht.push_back(seg);
+            status = parseDHT(seg, view);
+        }
+        else if(marker == M_DQT)
+        {
+            view.dqt.push_back(seg);
+            status = parseDQT(seg, view);
+        }
+        else if(marker == M_DRI)
+        {
+            if(seg.size != 2)
+                return JFIF_INVALID;
+            view.dri = seg;
+            view.restartInterval = read16(seg.data);
+        }
+        else if((marker >= M_APP0 && marker <= M_APP15) || marker == M_COM)
+        {
+            view.app.push_back(seg);
+        }
+        else if(marker > M_SOF1 && marker <= M_SOF15 && marker != M_JPG)
+        {
+            //Progressive, hierarchical and arithmetic coded frames
+            return JFIF_UNSUPPORTED;
+        }
+        else if(marker == M_SOS)
+        {
+            status = parseSOS(seg, view);
+            if(status != JFIF_OK)
+                return status;
+
+            view.headerSize = pos;
+            break;
+        }
+
+        if(status != JFIF_OK)
+            return status;
+    }
+
+    if(!scanMarkers)
+    {
+        view.scanSize = size - view.headerSize;
+        return JFIF_OK;
+    }
+    return parseScan(view);
+}
+
+const char* jfif_status_name(jfif_status status)
+{
+    switch(status)
+    {
+    case JFIF_OK:
+        return "ok";
+    case JFIF_TRUNCATED:
+        return "truncated";
+    case JFIF_INVALID:
+        return "invalid";
+    case JFIF_UNSUPPORTED:
+        return "unsupported";
+    }
+    return "unknown";
+}
@@ -0,0 +1,129 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef JFIF_PARSER_H
+#define JFIF_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum jfif_status
+{
+    JFIF_OK,
+    JFIF_TRUNCATED,     /// stream ends inside a segment or before EOI
+    JFIF_INVALID,       /// malformed segment or marker
+    JFIF_UNSUPPORTED    /// progressive, hierarchical, arithmetic coded or multi scan
+};
+
+/// Marker segment, points into the parsed stream
+struct jfif_segment
+{
+    const uint8_t* data = nullptr;  /// payload after the length field
+    size_t size = 0;                /// payload size
+    size_t offset = 0;              /// of the FF marker
+    uint8_t marker = 0;
+
+    bool empty() const {return data == nullptr;}
+};
+
+/// Table inside a DQT or DHT segment
+struct jfif_table
+{
+    const uint8_t* data = nullptr;  /// 64 entries of DQT, 16 counts and the symbols of DHT
+    size_t size = 0;
+    int precision = 0;              /// DQT entries are 16 bit if 1
+};
+
+struct jfif_component
+{
+    uint8_t id = 0;
+    uint8_t h = 0;
+    uint8_t v = 0;
+    uint8_t tq = 0;     /// quantization table
+    uint8_t td = 0;     /// DC Huffman table
+    uint8_t ta = 0;     /// AC Huffman table
+};
+
+/**
+ * @brief JFIF stream parsed in place.
+ * Segments, tables and restart markers are views into the parsed buffer and are
+ * valid while it is. Vectors keep their capacity between frames, so parsing
+ * into the same view does not allocate once it has seen the largest frame.
+ */
+struct jfif_view
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    uint8_t frameType = 0;          /// SOF marker, 0xC0, 0xC1 or 0xC3
+    int precision = 0;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    jfif_component component[4];
+    int mcuWidth = 0;
+    int mcuHeight = 0;
+    int mcuCols = 0;
+    int mcuRows = 0;
+    int restartInterval = 0;
+
+    std::vector<jfif_segment> app;  /// APPn and COM
+    std::vector<jfif_segment> dqt;
+    std::vector<jfif_segment> dht;
+    jfif_segment sof;
+    jfif_segment sos;
+    jfif_segment dri;
+
+    /// Last definitions in front of the scan, DHT may be absent in MJPEG
+    jfif_table quant[4];
+    jfif_table huffman[2][4];
+
+    /// Offset of entropy coded data, the same as fastJfifInfo_t::headerSize
+    size_t headerSize = 0;
+    /// Entropy coded data up to EOI, up to the end of stream if markers are not scanned
+    size_t scanSize = 0;
+    /// Offsets of RSTn markers in the scan
+    std::vector<size_t> restartMarkers;
+    /// Offset of EOI, 0 if markers are not scanned
+    size_t eoi = 0;
+
+    const uint8_t* scan() const {return data + headerSize;}
+    /// Restart intervals of the frame, one more than RSTn markers in a complete stream
+    int intervals() const;
+    void clear();
+};
+
+/// Parses SOI up to SOS and, if scanMarkers is set, the entropy coded data up to EOI.
+/// Every read is bounds checked, any input gives a status and never reads outside of data.
+/// On JFIF_TRUNCATED of the scan, header views and markers found so far are filled.
+jfif_status jfif_parse(const uint8_t* data, size_t size, jfif_view& view, bool scanMarkers = true);
+
+const char* jfif_status_name(jfif_status status);
+
+#endif // JFIF_PARSER_H
@@ -29,6 +29,9 @@
 #include "JpegEncoder.h"
 
 #include <iostream>
+#include <array>
+#include <map>
+#include <csetjmp>
 
 #if 0
 #include "turbojpeg.h"
@@ -36,16 +39,6 @@
 #include "jpeglib.h"
 #endif
 
-jpeg_encoder::jpeg_encoder()
-{
-
-}
-
-jpeg_encoder::~jpeg_encoder()
-{
-
-}
-
 #if 0
 bool jpeg_encoder::encode(unsigned char *input, int width, int height, std::vector<uchar> &output, int quality)
 {
@@ -108,13 +101,15 @@ bool jpeg_encoder::encode(unsigned char *input, int width, int height, uchar *ou
 }
 #else
 
-#define OUTPUT_BUF_SIZE  4096
-
+/// Destination writes into one contiguous block, either the caller's or the context's own.
+/// When the caller's block is full the data is moved to the own one and encoding goes on there.
 typedef struct {
     struct jpeg_destination_mgr pub; /* public fields */
 
-    std::vector<uchar> *output;
-    std::vector<uchar> *buffer;		/* start of buffer */
+    std::vector<uchar> *spill;
+    uchar *data;
+    size_t capacity;
+    bool overflow;
 } my_destination_mgr;
 
 typedef my_destination_mgr * my_dest_ptr;
@@ -124,122 +119,174 @@ init_destination (j_compress_ptr cinfo)
 {
     my_dest_ptr dest = (my_dest_ptr) cinfo->dest;
 
-    dest->buffer->clear();
-    dest->output->clear();
-
-    /* Allocate the output buffer --- it will be released when done with image */
-    dest->buffer->resize(OUTPUT_BUF_SIZE);
-
-    dest->pub.next_output_byte = (JOCTET*)dest->buffer->data();
-    dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
+    dest->overflow = false;
+    dest->pub.next_output_byte = (JOCTET*)dest->data;
+    dest->pub.free_in_buffer = dest->capacity;
 }
 
+/*
+ * Called only when the whole block is full. Happens with noisy frames at
+ * high quality or with a caller's buffer smaller than the worst case.
+ */
 
 METHODDEF(boolean)
 empty_dst (j_compress_ptr cinfo)
 {
     my_dest_ptr dest = (my_dest_ptr) cinfo->dest;
 
-    size_t size = dest->output->size();
-    size_t size_add = dest->buffer->size();
-    dest->output->resize(size + size_add);
-    std::copy(dest->buffer->data(), dest->buffer->data() + size_add, dest->output->data() + size);//append(*dest->buffer);
+    size_t used = dest->capacity;
+    if(dest->data != dest->spill->data()){
+        dest->overflow = true;
+        if(dest->spill->size() < used * 2)
+            dest->spill->resize(used * 2);
+        std::copy(dest->data, dest->data + used, dest->spill->data());
+    }else{
+        dest->spill->resize(used * 2);
+    }
 
-    dest->pub.next_output_byte = (JOCTET*)dest->buffer->data();
-    dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
+    dest->data = dest->spill->data();
+    dest->capacity = dest->spill->size();
+    dest->pub.next_output_byte = (JOCTET*)(dest->data + used);
+    dest->pub.free_in_buffer = dest->capacity - used;
 
     return TRUE;
 }
 
-
-/*
- * Terminate destination --- called by jpeg_finish_compress
- * after all data has been written.  Usually needs to flush buffer.
- *
- * NB: *not* called by jpeg_abort or jpeg_destroy; surrounding
- * application must deal with any cleanup that should happen even
- * for error exit.
- */
-
 METHODDEF(void)
-term_destination (j_compress_ptr cinfo)
+term_destination (j_compress_ptr)
 {
-    my_dest_ptr dest = (my_dest_ptr) cinfo->dest;
-    size_t datacount = OUTPUT_BUF_SIZE - dest->pub.free_in_buffer;
-
-    /* Write any data remaining in the buffer */
-    if (datacount > 0) {
-        size_t size = dest->output->size();
-        size_t size_add = datacount;
-        dest->output->resize(size + size_add);
-        std::copy(dest->buffer->data(), dest->buffer->data() + size_add, dest->output->data() + size);//append(*dest->buffer);
-        //dest->output->insert(dest->buffer->data(), datacount);
-    }
+    /* Data is already in place */
 }
 
 ////////////
 
-void error_exit(j_common_ptr cinfo)
+struct my_error_mgr {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+METHODDEF(void)
+error_exit(j_common_ptr cinfo)
 {
     std::cout << "Error " << cinfo->err->msg_code << " " << cinfo->err->msg_parm.i[0] << std::endl;
+
+    /* libjpeg must not continue after an error, return to jpeg_encoder::compress */
+    my_error_mgr *err = (my_error_mgr*) cinfo->err;
+    longjmp(err->jump, 1);
 }
 
-bool jpeg_encoder::encode(unsigned char *input, int width, int height,
-                          int channels, std::vector<uchar> &output, int quality)
+typedef std::array<UINT16, DCTSIZE2> quant_table;
+
+struct jpeg_encoder::context
 {
     jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
+    my_error_mgr jerr;
+    my_destination_mgr dest;
 
-    cinfo.err = jpeg_std_error(&jerr);
+    /// Own output block, used when the caller has no buffer or its buffer is too small
+    std::vector<uchar> output;
+    /// Gray to RGB row
+    std::vector<uchar> row;
+
+    /// Luma and chroma tables for each quality used so far
+    std::map<int, std::array<quant_table, 2>> tables;
+    int quality = -1;
+};
+
+jpeg_encoder::jpeg_encoder()
+    : mContext(new context)
+{
+    jpeg_compress_struct &cinfo = mContext->cinfo;
+
+    cinfo.err = jpeg_std_error(&mContext->jerr.pub);
+    mContext->jerr.pub.error_exit = error_exit;
     jpeg_create_compress(&cinfo);
 
-    cinfo.err = jpeg_std_error(&jerr);
-    cinfo.err->error_exit = error_exit;
+    cinfo.dest = (struct jpeg_destination_mgr *)&mContext->dest;
+    mContext->dest.pub.init_destination = init_destination;
+    mContext->dest.pub.empty_output_buffer = empty_dst;
+    mContext->dest.pub.term_destination = term_destination;
+    mContext->dest.spill = &mContext->output;
+    mContext->dest.data = nullptr;
+    mContext->dest.capacity = 0;
+    mContext->dest.overflow = false;
 
+    /* Parameters and standard Huffman tables stay for the whole life of the compressor */
     cinfo.in_color_space = JCS_RGB;
-    cinfo.image_width = width;
-    cinfo.image_height = height;
     cinfo.input_components = 3;
-    cinfo.jpeg_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+}
 
-    my_destination_mgr dest;
+jpeg_encoder::~jpeg_encoder()
+{
+    jpeg_destroy_compress(&mContext->cinfo);
+}
 
-//    if (cinfo.dest == nullptr) {	/* first time for this JPEG object? */
-//        cinfo.dest = (struct jpeg_destination_mgr *)
-//                (*cinfo.mem->alloc_small) ((j_common_ptr) &cinfo, JPOOL_PERMANENT,
-//                                           sizeof(my_destination_mgr));
-//    }
+size_t jpeg_encoder::maxOutputSize(int width, int height)
+{
+    /* 4:2:0 MCU is 16x16 with 1.5 samples per pixel. Two bytes per sample covers
+       real frames at any quality, the rest spills into the own block in empty_dst */
+    size_t w = (size_t(width) + 15) & ~size_t(15);
+    size_t h = (size_t(height) + 15) & ~size_t(15);
+    return w * h * 3 + 2048;
+}
 
-    cinfo.dest = (struct jpeg_destination_mgr *)&dest;
+void jpeg_encoder::setQuality(int quality)
+{
+    if(quality == mContext->quality)
+        return;
 
-    dest.pub.init_destination = init_destination;
-    dest.pub.empty_output_buffer = empty_dst;
-    dest.pub.term_destination = term_destination;
+    jpeg_compress_struct &cinfo = mContext->cinfo;
 
-    std::vector<uchar> buffer;
-    dest.buffer = &buffer;
-    dest.output = &output;
+    auto it = mContext->tables.find(quality);
+    if(it == mContext->tables.end()){
+        jpeg_set_quality(&cinfo, quality, TRUE /* limit to baseline-JPEG values */);
 
-    jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, quality, TRUE /* limit to baseline-JPEG values */);
-    jpeg_start_compress(&cinfo, true);
+        std::array<quant_table, 2> tables;
+        for(int i = 0; i < 2; ++i)
+            std::copy(cinfo.quant_tbl_ptrs[i]->quantval, cinfo.quant_tbl_ptrs[i]->quantval + DCTSIZE2, tables[i].begin());
+        mContext->tables[quality] = tables;
+    }else{
+        for(int i = 0; i < 2; ++i)
+            std::copy(it->second[i].begin(), it->second[i].end(), cinfo.quant_tbl_ptrs[i]->quantval);
+    }
+    mContext->quality = quality;
+}
+
+bool jpeg_encoder::compress(unsigned char *input, int width, int height, int channels, int quality)
+{
+    jpeg_compress_struct &cinfo = mContext->cinfo;
+
+    setQuality(quality);
+
+    cinfo.image_width = JDIMENSION(width);
+    cinfo.image_height = JDIMENSION(height);
 
-    JSAMPROW arr[1];
     int pitch = width * 3;
+    if(channels == 1 && mContext->row.size() < size_t(pitch))
+        mContext->row.resize(pitch);
+
+    /* No objects with destructors below, longjmp skips them */
+    if(setjmp(mContext->jerr.jump)){
+        jpeg_abort_compress(&cinfo);
+        return false;
+    }
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    JSAMPROW arr[1];
 
     if(channels == 1){
         int pitchIn = width;
-
-        std::vector<unsigned char> row;
-        row.resize(pitch);
-        arr[0] = row.data();
+        unsigned char *row = mContext->row.data();
+        arr[0] = row;
 
         while(cinfo.next_scanline < cinfo.image_height){
             unsigned char *in = input + cinfo.next_scanline * pitchIn;
             for(int i = 0; i < width; ++i){
-                row.data()[i * 3 + 0] = in[i];
-                row.data()[i * 3 + 1] = in[i];
-                row.data()[i * 3 + 2] = in[i];
+                row[i * 3 + 0] = in[i];
+                row[i * 3 + 1] = in[i];
+                row[i * 3 + 2] = in[i];
             }
 
             jpeg_write_scanlines(&cinfo, arr, 1);
@@ -252,7 +299,27 @@ bool jpeg_encoder::encode(unsigned char *input, int width, int height,
     }
 
     jpeg_finish_compress(&cinfo);
-    jpeg_destroy_compress(&cinfo);
+
+    return true;
+}
+
+bool jpeg_encoder::encode(unsigned char *input, int width, int height,
+                          int channels, std::vector<uchar> &output, int quality)
+{
+    size_t size = 0;
+    if(mContext->output.size() < maxOutputSize(width, height))
+        mContext->output.resize(maxOutputSize(width, height));
+
+    mContext->dest.data = mContext->output.data();
+    mContext->dest.capacity = mContext->output.size();
+
+    if(!compress(input, width, height, channels, quality)){
+        output.clear();
+        return false;
+    }
+
+    size = mContext->dest.capacity - mContext->dest.pub.free_in_buffer;
+    output.assign(mContext->dest.data, mContext->dest.data + size);
 
     return true;
 }
@@ -260,8 +327,78 @@ bool jpeg_encoder::encode(unsigned char *input, int width, int height,
 bool jpeg_encoder::encode(unsigned char *input, int width, int height,
                           int channels, uchar *output, uint &size, int quality)
 {
-    input, width, height, channels, output, size, quality;
-    return false;
+    const uint capacity = size;
+    mContext->dest.data = output;
+    mContext->dest.capacity = size;
+
+    if(output == nullptr || size == 0 || !compress(input, width, height, channels, quality)){
+        size = 0;
+        return false;
+    }
+
+    size = uint(mContext->dest.capacity - mContext->dest.pub.free_in_buffer);
+
+    /* Stream is complete in the own block, the caller has to provide more room.
+       An exactly full block also gets here, its data is in place already */
+    if(mContext->dest.overflow && size > capacity)
+        return false;
+
+    return true;
+}
+
+bool jpeg_encoder::encode(unsigned char *input, int width, int height,
+                          int channels, Buffer &output, int quality)
+{
+    size_t maxSize = maxOutputSize(width, height);
+    if(output.buffer.size() < maxSize)
+        output.buffer.resize(maxSize);
+
+    uint size = uint(output.buffer.size());
+    bool res = encode(input, width, height, channels, output.buffer.data(), size, quality);
+
+    if(!res && size > 0){
+        output.buffer.resize(size);
+        std::copy(mContext->output.data(), mContext->output.data() + size, output.buffer.data());
+        res = true;
+    }
+
+    output.size = res ? size : 0;
+    return res;
 }
 
 #endif
+
+////////////
+
+jpeg_encoder_pool::lease::lease(jpeg_encoder_pool &pool)
+    : mPool(pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(mPool.mLock);
+        if(!mPool.mFree.empty()){
+            mEncoder = std::move(mPool.mFree.back());
+            mPool.mFree.pop_back();
+            return;
+        }
+        mPool.mCreated++;
+    }
+    mEncoder.reset(new jpeg_encoder);
+}
+
+jpeg_encoder_pool::lease::~lease()
+{
+    std::lock_guard<std::mutex> lock(mPool.mLock);
+    mPool.mFree.push_back(std::move(mEncoder));
+}
+
+jpeg_encoder_pool &jpeg_encoder_pool::instance()
+{
+    static jpeg_encoder_pool pool;
+    return pool;
+}
+
+size_t jpeg_encoder_pool::size() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mCreated;
+}
@@ -33,8 +33,17 @@
 #include <QByteArray>
 #include <QSharedPointer>
 
+#include <memory>
+#include <mutex>
+
 #include "common_utils.h"
 
+/**
+ * @brief libjpeg compressor that stays alive between frames.
+ * Output goes straight into a buffer sized for the worst case, quantization tables
+ * are kept per quality and standard Huffman tables are set up only once.
+ * One instance must not be used from several threads at the same time, see jpeg_encoder_pool.
+ */
 class jpeg_encoder
 {
 public:
@@ -42,10 +51,62 @@ public:
 	~jpeg_encoder();
 
     bool encode(unsigned char* input, int width, int height, int channels, std::vector<uchar>& output, int quality = 60);
+    /// size is the capacity of output on input and the stream size on return.
+    /// Returns false with the required size if the stream does not fit.
     bool encode(unsigned char* input, int width, int height, int channels, uchar* output, uint &size, int quality = 60);
+    /// Encodes into a reusable buffer, it grows to the worst case size once and is never shrunk
+    bool encode(unsigned char* input, int width, int height, int channels, Buffer& output, int quality = 60);
+
+    /// Preallocated output size for the frame, larger streams are still handled
+    static size_t maxOutputSize(int width, int height);
+
+private:
+    struct context;
+    std::unique_ptr<context> mContext;
+
+    bool compress(unsigned char* input, int width, int height, int channels, int quality);
+    void setQuality(int quality);
+
+    jpeg_encoder(const jpeg_encoder&) = delete;
+    jpeg_encoder& operator=(const jpeg_encoder&) = delete;
+};
+
+/**
+ * @brief Process wide set of encoders, one per concurrently encoding thread.
+ * Encoders are taken for the duration of a frame and returned on release,
+ * so the pool grows up to the number of threads that encode at the same time.
+ */
+class jpeg_encoder_pool
+{
+public:
+    class lease
+    {
+    public:
+        explicit lease(jpeg_encoder_pool& pool);
+        ~lease();
+
+        jpeg_encoder* operator->() const {return mEncoder.get();}
+        jpeg_encoder& operator*() const {return *mEncoder;}
+
+    private:
+        jpeg_encoder_pool& mPool;
+        std::unique_ptr<jpeg_encoder> mEncoder;
+
+        lease(const lease&) = delete;
+        lease& operator=(const lease&) = delete;
+    };
+
+    static jpeg_encoder_pool& instance();
+
+    /// Number of encoders created so far
+    size_t size() const;
 
 private:
+    jpeg_encoder_pool() = default;
 
+    mutable std::mutex mLock;
+    std::vector<std::unique_ptr<jpeg_encoder>> mFree;
+    size_t mCreated = 0;
 };
 
 #endif // JPEG_ENCODER_H
@@ -0,0 +1,269 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "JpegParallelEncoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const uchar M_SOF0 = 0xC0;
+    const uchar M_RST0 = 0xD0;
+    const uchar M_EOI  = 0xD9;
+    const uchar M_SOS  = 0xDA;
+    const uchar M_DRI  = 0xDD;
+
+    /// Offset of marker segment in jpeg_encoder output, 0 if it is not there.
+    /// Only looks at segments in front of entropy coded data.
+    size_t findMarker(const uchar* data, size_t size, uchar marker)
+    {
+        size_t pos = 2;
+        while(pos + 4 <= size && data[pos] == 0xFF)
+        {
+            if(data[pos + 1] == marker)
+                return pos;
+            if(data[pos + 1] == M_SOS)
+                break;
+            pos += 2 + ((size_t(data[pos + 2]) << 8) | data[pos + 3]);
+        }
+        return 0;
+    }
+
+    size_t segmentEnd(const uchar* data, size_t pos)
+    {
+        return pos + 2 + ((size_t(data[pos + 2]) << 8) | data[pos + 3]);
+    }
+}
+
+jpeg_parallel_encoder::jpeg_parallel_encoder(int threads)
+{
+    if(threads <= 0)
+        threads = std::max(1, int(std::thread::hardware_concurrency()));
+
+    for(int i = 0; i < threads; ++i)
+        mEncoders.emplace_back(new jpeg_encoder);
+
+    //Calling thread is the first worker
+    for(int i = 1; i < threads; ++i)
+        mThreads.emplace_back([this, i](){run(i);});
+}
+
+jpeg_parallel_encoder::~jpeg_parallel_encoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStop = true;
+    }
+    mStart.notify_all();
+
+    for(auto& thread : mThreads)
+        thread.join();
+}
+
+void jpeg_parallel_encoder::run(int index)
+{
+    unsigned generation = 0;
+
+    std::unique_lock<std::mutex> lock(mLock);
+    for(;;)
+    {
+        mStart.wait(lock, [this, generation](){return mStop || mGeneration != generation;});
+        if(mStop)
+            break;
+        generation = mGeneration;
+        lock.unlock();
+
+        encodeStrips(index);
+
+        lock.lock();
+        if(--mBusy == 0)
+            mDone.notify_all();
+    }
+}
+
+void jpeg_parallel_encoder::encodeStrips(int index)
+{
+    jpeg_encoder& encoder = *mEncoders[index];
+    const size_t pitch = size_t(mWidth) * mChannels;
+
+    for(int strip = mNextStrip++; strip < mStrips; strip = mNextStrip++)
+    {
+        const int top = strip * mStripHeight;
+        const int height = std::min(mStripHeight, mHeight - top);
+        if(!encoder.encode(mInput + top * pitch, mWidth, height, mChannels, mSegments[strip], mQuality))
+            mFailed = true;
+    }
+}
+
+bool jpeg_parallel_encoder::encodeFrame(unsigned char *input, int width, int height, int channels, int quality)
+{
+    const int mcuCols = (width + MCU_SIZE - 1) / MCU_SIZE;
+    const int mcuRows = (height + MCU_SIZE - 1) / MCU_SIZE;
+
+    //Restart interval is 16 bit, so is the count of MCUs in a strip
+    int rows = mStripRows > 0 ? mStripRows : (mcuRows + threads() * 2 - 1) / (threads() * 2);
+    rows = std::max(1, std::min(rows, 0xFFFF / mcuCols));
+
+    mInput = input;
+    mWidth = width;
+    mHeight = height;
+    mChannels = channels;
+    mQuality = quality;
+    mStripHeight = rows * MCU_SIZE;
+    mStrips = (mcuRows + rows - 1) / rows;
+    mNextStrip = 0;
+    mFailed = false;
+
+    if(mSegments.size() < size_t(mStrips))
+        mSegments.resize(mStrips);
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mBusy = int(mThreads.size());
+        mGeneration++;
+    }
+    mStart.notify_all();
+
+    encodeStrips(0);
+
+    std::unique_lock<std::mutex> lock(mLock);
+    mDone.wait(lock, [this](){return mBusy == 0;});
+
+    return !mFailed;
+}
+
+size_t jpeg_parallel_encoder::outputSize() const
+{
+    //Headers of the first strip with DRI, entropy coded data of every strip,
+    //RSTn between strips and EOI
+    const Buffer& first = mSegments[0];
+    size_t size = findMarker(first.buffer.data(), first.size, M_SOS);
+    size = segmentEnd(first.buffer.data(), size) + 6;
+
+    for(int i = 0; i < mStrips; ++i)
+    {
+        const Buffer& seg = mSegments[i];
+        size += seg.size - 2 - segmentEnd(seg.buffer.data(), findMarker(seg.buffer.data(), seg.size, M_SOS));
+    }
+    return size + size_t(mStrips - 1) * 2 + 2;
+}
+
+size_t jpeg_parallel_encoder::join(uchar *output) const
+{
+    const Buffer& first = mSegments[0];
+    const uchar* data = first.buffer.data();
+
+    const size_t sos = findMarker(data, first.size, M_SOS);
+    const size_t sof = findMarker(data, first.size, M_SOF0);
+    const unsigned interval = unsigned((mWidth + MCU_SIZE - 1) / MCU_SIZE * (mStripHeight / MCU_SIZE));
+
+    uchar* out = output;
+    std::memcpy(out, data, sos);
+
+    //Frame height instead of the first strip's one
+    out[sof + 5] = uchar(mHeight >> 8);
+    out[sof + 6] = uchar(mHeight);
+    out += sos;
+
+    const uchar dri[6] = {0xFF, M_DRI, 0x00, 0x04, uchar(interval >> 8), uchar(interval)};
+    std::memcpy(out, dri, sizeof(dri));
+    out += sizeof(dri);
+
+    const size_t sosEnd = segmentEnd(data, sos);
+    std::memcpy(out, data + sos, sosEnd - sos);
+    out += sosEnd - sos;
+
+    for(int i = 0; i < mStrips; ++i)
+    {
+        const Buffer& seg = mSegments[i];
+        const size_t start = segmentEnd(seg.buffer.data(), findMarker(seg.buffer.data(), seg.size, M_SOS));
+        //Strip ends with its EOI, entropy coded data is already padded to a byte
+        const size_t len = seg.size - 2 - start;
+        std::memcpy(out, seg.buffer.data() + start, len);
+        out += len;
+
+        *out++ = 0xFF;
+        *out++ = i + 1 < mStrips ? uchar(M_RST0 + (i & 7)) : M_EOI;
+    }
+
+    return size_t(out - output);
+}
+
+bool jpeg_parallel_encoder::encode(unsigned char *input, int width, int height,
+                                   int channels, uchar *output, uint &size, int quality)
+{
+    if(input == nullptr || width <= 0 || height <= 0 || !encodeFrame(input, width, height, channels, quality))
+    {
+        size = 0;
+        return false;
+    }
+
+    //Single strip is a complete stream already
+    if(mStrips == 1)
+    {
+        const Buffer& seg = mSegments[0];
+        const bool fit = output != nullptr && seg.size <= size;
+        if(fit)
+            std::memcpy(output, seg.buffer.data(), seg.size);
+        size = uint(seg.size);
+        return fit;
+    }
+
+    const size_t required = outputSize();
+    if(output == nullptr || required > size)
+    {
+        size = uint(required);
+        return false;
+    }
+
+    size = uint(join(output));
+    return true;
+}
+
+bool jpeg_parallel_encoder::encode(unsigned char *input, int width, int height,
+                                   int channels, Buffer &output, int quality)
+{
+    if(input == nullptr || width <= 0 || height <= 0 || !encodeFrame(input, width, height, channels, quality))
+    {
+        output.size = 0;
+        return false;
+    }
+
+    const size_t required = mStrips == 1 ? mSegments[0].size : outputSize();
+    if(output.buffer.size() < required)
+        output.buffer.resize(required);
+
+    if(mStrips == 1)
+        std::copy(mSegments[0].buffer.data(), mSegments[0].buffer.data() + required, output.buffer.data());
+    else
+        join(output.buffer.data());
+
+    output.size = required;
+    return true;
+}
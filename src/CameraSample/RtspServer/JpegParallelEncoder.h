@@ -0,0 +1,103 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef JPEG_PARALLEL_ENCODER_H
+#define JPEG_PARALLEL_ENCODER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "JpegEncoder.h"
+
+/**
+ * @brief Baseline JPEG encoder that splits a frame into strips of whole MCU rows.
+ * Strips are encoded on a thread pool, each starts with zero DC prediction like
+ * a restart interval does, so entropy coded segments are joined with RSTn markers
+ * and the frame gets a DRI of one strip. Output decodes to the same image as the
+ * single threaded jpeg_encoder gives. One frame at a time, calling thread takes part.
+ */
+class jpeg_parallel_encoder
+{
+public:
+    /// threads 0 means all cores
+    explicit jpeg_parallel_encoder(int threads = 0);
+    ~jpeg_parallel_encoder();
+
+    /// size is the capacity of output on input and the stream size on return.
+    /// Returns false with the required size if the stream does not fit.
+    bool encode(unsigned char* input, int width, int height, int channels, uchar* output, uint &size, int quality = 60);
+    bool encode(unsigned char* input, int width, int height, int channels, Buffer& output, int quality = 60);
+
+    int threads() const {return int(mEncoders.size());}
+    /// MCU rows per strip, 0 picks two strips per thread
+    void setStripRows(int rows) {mStripRows = rows;}
+    /// Strips of the last frame, it is the number of restart intervals
+    int strips() const {return mStrips;}
+
+private:
+    /// 4:2:0 MCU set by jpeg_encoder
+    static const int MCU_SIZE = 16;
+
+    std::vector<std::unique_ptr<jpeg_encoder>> mEncoders;
+    std::vector<std::thread> mThreads;
+    std::vector<Buffer> mSegments;
+
+    std::mutex mLock;
+    std::condition_variable mStart;
+    std::condition_variable mDone;
+    unsigned mGeneration = 0;
+    int  mBusy = 0;
+    bool mStop = false;
+
+    //Current frame
+    unsigned char* mInput = nullptr;
+    int mWidth = 0;
+    int mHeight = 0;
+    int mChannels = 0;
+    int mQuality = 0;
+    int mStripRows = 0;
+    int mStripHeight = 0;
+    int mStrips = 0;
+    std::atomic<int>  mNextStrip {0};
+    std::atomic<bool> mFailed {false};
+
+    void run(int index);
+    void encodeStrips(int index);
+    bool encodeFrame(unsigned char* input, int width, int height, int channels, int quality);
+    size_t outputSize() const;
+    size_t join(uchar* output) const;
+
+    jpeg_parallel_encoder(const jpeg_parallel_encoder&) = delete;
+    jpeg_parallel_encoder& operator=(const jpeg_parallel_encoder&) = delete;
+};
+
+#endif // JPEG_PARALLEL_ENCODER_H
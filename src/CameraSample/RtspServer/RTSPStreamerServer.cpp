@@ -35,6 +35,7 @@
 
 #include "common_utils.h"
 #include "vutils.h"
+#include "Metrics.h"
 
 #include <QPainter>
 #include <QImage>
@@ -429,13 +430,18 @@ void RTSPStreamerServer::Gray2Yuv420p(unsigned char *yuv, unsigned char *gray, i
 	  }
 }
 
-bool RTSPStreamerServer::addBigFrame(unsigned char* rgbPtr, size_t linesize)
+bool RTSPStreamerServer::addBigFrame(unsigned char* rgbPtr, size_t linesize, const FrameMetadata *meta)
 {
     if(!mIsInitialized || mClients.empty())
 		return false;
 
     if(mEncoderType != etJPEG || (mWidth <= MAX_WIDTH_RTP_JPEG && mHeight <= MAX_HEIGHT_RTP_JPEG))
-		return addFrame(rgbPtr);
+		return addFrame(rgbPtr, meta);
+
+    Metrics::ScopedTimer encodeTimer(Metrics::mtRtspEncode);
+
+    // all tiles of the frame share the same timestamp
+    mCurrentPts = rtpTimestamp(meta ? meta->hostTimestamp : 0);
 
     size_t cntW = std::round(1. * mWidth/MAX_WIDTH_JPEG), cntH = std::round(mHeight/MAX_HEIGHT_JPEG);
     while(cntW * MAX_WIDTH_JPEG < mWidth)cntW++;
@@ -485,12 +491,12 @@ bool RTSPStreamerServer::addBigFrame(unsigned char* rgbPtr, size_t linesize)
     auto fun = [&](size_t t)
     {
         av_init_packet(&pkts[t]);
-        pkts[t].pts = mFramesProcessed + t;
+        pkts[t].pts = mCurrentPts;
 
         mJpegEncode(static_cast<int>(t), mData[t].data(), MAX_WIDTH_JPEG, MAX_HEIGHT_JPEG, mChannels, mJpegData[t]);
 
 		av_new_packet(&pkts[t], static_cast<int>(mJpegData[t].size + rtp_packet_add_header::sizeof_header));
-        pkts[t].pts = mFramesProcessed + t;
+        pkts[t].pts = mCurrentPts;
 
         uchar x = static_cast<uchar>(t % cntW);
         uchar y = static_cast<uchar>(t / cntW);
@@ -536,7 +542,21 @@ bool RTSPStreamerServer::addBigFrame(unsigned char* rgbPtr, size_t linesize)
 	return true;
 }
 
-bool RTSPStreamerServer::addFrame(unsigned char *rgbPtr)
+qint64 RTSPStreamerServer::rtpTimestamp(qint64 hostTimestamp)
+{
+    if(hostTimestamp <= 0)
+        hostTimestamp = FrameMetadata::now();
+    if(mFirstTimestamp == 0)
+        mFirstTimestamp = hostTimestamp;
+
+    qint64 pts = av_rescale(hostTimestamp - mFirstTimestamp, 90000, 1000000000);
+    if(pts <= mLastPts)
+        pts = mLastPts + 1;
+    mLastPts = pts;
+    return pts;
+}
+
+bool RTSPStreamerServer::addFrame(unsigned char *rgbPtr, const FrameMetadata *meta)
 {
 //	if(mTimerCtrlFps.elapsed() - mDelayFps < mCurrentTimeElapsed){
 //		return false;
@@ -546,14 +566,50 @@ bool RTSPStreamerServer::addFrame(unsigned char *rgbPtr)
 	std::lock_guard<std::mutex> lg(mFrameMutex);
 
 	if(mFrameBuffers.size() < mMaxFrameBuffers)
-		mFrameBuffers.push_back(FrameBuffer(rgbPtr));
+		mFrameBuffers.push_back(FrameBuffer(rgbPtr, meta ? meta->hostTimestamp : FrameMetadata::now()));
+
+	startFrameThread();
+	return true;
+}
+
+bool RTSPStreamerServer::addJpegFrame(const unsigned char *jpeg, size_t size, const FrameMetadata *meta)
+{
+	if(jpeg == nullptr || size == 0)
+		return false;
+
+	std::lock_guard<std::mutex> lg(mFrameMutex);
+
+	// frame is dropped if the sender is behind, as for rgb frames
+	if(mFrameBuffers.size() < mMaxFrameBuffers)
+	{
+		if(mSpareFrameBuffers.empty())
+			mSpareFrameBuffers.emplace_back();
+		mFrameBuffers.splice(mFrameBuffers.end(), mSpareFrameBuffers, mSpareFrameBuffers.begin());
+
+		FrameBuffer& fb = mFrameBuffers.back();
+		fb.buffer = nullptr;
+		fb.jpeg.assign(jpeg, jpeg + size);
+		fb.size = size;
+		fb.timestamp = meta ? meta->hostTimestamp : FrameMetadata::now();
+	}
 
+	startFrameThread();
+	return true;
+}
+
+void RTSPStreamerServer::startFrameThread()
+{
 	if(!mFrameThread.get()){
 		mFrameThread.reset(new std::thread([this](){
 			doFrameBuffer();
 		}));
 	}
-	return true;
+}
+
+double RTSPStreamerServer::queueLoad()
+{
+	std::lock_guard<std::mutex> lg(mFrameMutex);
+	return mMaxFrameBuffers > 0 ? double(mFrameBuffers.size()) / mMaxFrameBuffers : 0;
 }
 
 void RTSPStreamerServer::doFrameBuffer()
@@ -562,12 +618,24 @@ void RTSPStreamerServer::doFrameBuffer()
 		if(mFrameBuffers.empty()){
 			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}else{
+			std::list<FrameBuffer> current;
 			mFrameMutex.lock();
-			FrameBuffer fb = mFrameBuffers.front();
-			mFrameBuffers.pop_front();
+			current.splice(current.begin(), mFrameBuffers, mFrameBuffers.begin());
 			mFrameMutex.unlock();
 
-			addInternalFrame(fb.buffer);
+			FrameBuffer& fb = current.front();
+			if(fb.size > 0)
+			{
+				sendJpegFrame(fb.jpeg.data(), fb.size, fb.timestamp);
+
+				mFrameMutex.lock();
+				mSpareFrameBuffers.splice(mSpareFrameBuffers.begin(), current);
+				mFrameMutex.unlock();
+			}
+			else
+			{
+				addInternalFrame(fb.buffer, fb.timestamp);
+			}
 		}
 	}
 }
@@ -604,7 +672,7 @@ void drawTimeToImageGray(uchar *gray, int width, int height, const QDateTime& ti
     qDebug("time %s", time.toString("hh:mm:ss.zzz").toLatin1().data());
 }
 
-bool RTSPStreamerServer::addInternalFrame(uchar *rgbPtr)
+bool RTSPStreamerServer::addInternalFrame(uchar *rgbPtr, qint64 timestamp)
 {
 	auto starttime = getNow();
 
@@ -612,6 +680,8 @@ bool RTSPStreamerServer::addInternalFrame(uchar *rgbPtr)
         return false;
 	int ret = 0;
 
+    mCurrentPts = rtpTimestamp(timestamp);
+
     if(((mCodecId == AV_CODEC_ID_H264 || mCodecId == AV_CODEC_ID_INDEO3) && !mUseCustomEncodeH264)
             || (mEncoderType == etJPEG && !mUseCustomEncodeJpeg))
 	{
@@ -670,7 +740,8 @@ bool RTSPStreamerServer::addInternalFrame(uchar *rgbPtr)
 		}
 
 		av_new_packet(&pkt, static_cast<int>(mJpegData[t].size));
-		pkt.pts = mFramesProcessed++;
+		pkt.pts = mCurrentPts;
+		mFramesProcessed++;
 
 		std::copy(mJpegData[t].buffer.data(), mJpegData[t].buffer.data() + mJpegData[t].size, pkt.data);
 
@@ -678,8 +749,8 @@ bool RTSPStreamerServer::addInternalFrame(uchar *rgbPtr)
 		av_packet_unref(&pkt);
 	}
 
-	double duration = getDuration(starttime);
-	qDebug("encode duration %f", duration);
+	// includes sending to clients, send alone is measured by TcpClient
+	Metrics::record(Metrics::mtRtspEncode, getDuration(starttime));
 
 	if(ret == 0)
 	{
@@ -690,6 +761,31 @@ bool RTSPStreamerServer::addInternalFrame(uchar *rgbPtr)
 	return false;
 }
 
+bool RTSPStreamerServer::sendJpegFrame(const uchar *jpeg, size_t size, qint64 timestamp)
+{
+	auto starttime = getNow();
+
+	if(!mIsInitialized || mClients.empty())
+		return false;
+
+	mCurrentPts = rtpTimestamp(timestamp);
+
+	AVPacket pkt;
+	av_init_packet(&pkt);
+	av_new_packet(&pkt, static_cast<int>(size));
+	pkt.pts = mCurrentPts;
+	mFramesProcessed++;
+
+	std::copy(jpeg, jpeg + size, pkt.data);
+
+	sendPkt(&pkt);
+	av_packet_unref(&pkt);
+
+	// includes sending to clients, send alone is measured by TcpClient
+	Metrics::record(Metrics::mtRtspEncode, getDuration(starttime));
+	return true;
+}
+
 #ifdef __ARM_ARCH
 void RTSPStreamerServer::encodeWriteFrame(uint8_t *buf, int width, int height)
 {
@@ -702,7 +798,7 @@ void RTSPStreamerServer::encodeWriteFrame(uint8_t *buf, int width, int height)
                 av_init_packet(&enc_pkt);
 
                 av_new_packet(&enc_pkt, static_cast<int>(mUserBuffer.size()));
-                enc_pkt.pts = enc_pkt.dts = mFramesProcessed;
+                enc_pkt.pts = enc_pkt.dts = mCurrentPts;
                 enc_pkt.flags = AV_PKT_FLAG_KEY;
                 std::copy(mUserBuffer.data(),mUserBuffer.data() + mUserBuffer.size(), enc_pkt.data);
 
@@ -725,7 +821,8 @@ void RTSPStreamerServer::encodeWriteFrame(AVFrame *frame)
 
     ret = avcodec_encode_video2(mCtx, &enc_pkt, frame, &got);
     if(got > 0){
-        enc_pkt.pts = frame->pts;
+        // encoder works without delay, so the packet belongs to the current frame
+        enc_pkt.pts = mCurrentPts;
         sendPkt(&enc_pkt);
         av_packet_unref(&enc_pkt);
     }
@@ -56,6 +56,7 @@ extern "C" {
 
 #include "common_utils.h"
 #include "TcpClient.h"
+#include "FrameMetadata.h"
 
 #ifdef __ARM_ARCH
 #include "v4l2encoder.h"
@@ -117,22 +118,38 @@ public:
      * @return
      */
     bool isStarted() const;
+    /**
+     * @brief queueLoad
+     * @return frames waiting for the sender thread relative to queue length, 0..1
+     */
+    double queueLoad();
 
 	/**
 	 * @brief addRGBFrame
 	 * the function to split rgb frame to tiles
 	 * @param rgbPtr
 	 * @param linesize - size of one line in bytes
+	 * @param meta - frame metadata, RTP timestamp is taken from capture time
 	 * @return
 	 */
-	bool addBigFrame (unsigned char* rgbPtr, size_t linesize);
+	bool addBigFrame (unsigned char* rgbPtr, size_t linesize, const FrameMetadata* meta = nullptr);
 	/**
 	 * @brief addRGBFrame
 	 * default function to add rgb frame
 	 * @param rgbPtr
+	 * @param meta - frame metadata, RTP timestamp is taken from capture time
+	 * @return
+	 */
+	bool addFrame (unsigned char* rgbPtr, const FrameMetadata* meta = nullptr);
+	/**
+	 * @brief addJpegFrame
+	 * add frame already encoded to JPEG, bytes are copied to the sender queue
+	 * @param jpeg
+	 * @param size - size of JPEG stream in bytes
+	 * @param meta - metadata of the frame the stream was encoded from
 	 * @return
 	 */
-	bool addFrame (unsigned char* rgbPtr);
+	bool addJpegFrame (const unsigned char* jpeg, size_t size, const FrameMetadata* meta = nullptr);
 
 	bool startServer();
 
@@ -166,6 +183,12 @@ private:
     qint64      mFramesProcessed = 0;
     qint64      mBitrate = 20000000;
 
+    /// 90 kHz RTP clock of the frame being sent
+    qint64      mCurrentPts = 0;
+    qint64      mLastPts = -1;
+    qint64      mFirstTimestamp = 0;
+    qint64      rtpTimestamp(qint64 hostTimestamp);
+
     std::unique_ptr<QTcpServer> mServer;
     std::shared_ptr<QThread>    mThread;
 
@@ -179,17 +202,24 @@ private:
 
 	struct FrameBuffer{
 		uchar *buffer = nullptr;
+		// encoded frame owned by the queue, used if size is not zero
+		bytearray jpeg;
 		size_t size = 0;
+		qint64 timestamp = 0;
 		FrameBuffer(){}
-		FrameBuffer(uchar *buf){ buffer = buf; }
+		FrameBuffer(uchar *buf, qint64 ts){ buffer = buf; timestamp = ts; }
 	};
 	// very unsafe
 	size_t mMaxFrameBuffers = 2;
 	std::list<FrameBuffer> mFrameBuffers;
+	// sent JPEG buffers, reused with their capacity
+	std::list<FrameBuffer> mSpareFrameBuffers;
 	std::mutex mFrameMutex;
 	bool mDone = false;
 	void doFrameBuffer();
-	bool addInternalFrame(uchar *rgbPtr);
+	void startFrameThread();
+	bool addInternalFrame(uchar *rgbPtr, qint64 timestamp);
+	bool sendJpegFrame(const uchar *jpeg, size_t size, qint64 timestamp);
 
     QHostAddress    mHost;
     ushort          mPort;
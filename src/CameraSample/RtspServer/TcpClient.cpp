@@ -27,6 +27,7 @@
 */
 
 #include "TcpClient.h"
+#include "Metrics.h"
 
 #include <QDateTime>
 #include <QCryptographicHash>
@@ -115,15 +116,14 @@ void TcpClient::sendpkt(AVPacket *pkt)
 
         //AVRational *time_base = &m_fmt->streams[pkt->stream_index]->time_base;
 
-        pkt->pts = pkt->pts * 90000/60;     /// 60 fps
+        /// pts is already in 90 kHz RTP clock taken from capture time
 
         int ret;
         //ret = avformat_write_header(m_fmt, nullptr);
         ret = av_write_frame(m_fmt, pkt);
 	}
 
-	double duration = getDuration(starttime);
-	qDebug("send duration %f", duration);
+	Metrics::record(Metrics::mtRtspSend, getDuration(starttime));
 }
 
 bool TcpClient::isInit() const
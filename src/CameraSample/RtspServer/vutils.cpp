@@ -50,9 +50,9 @@ void encodeJpeg(int idthread, unsigned char* data, int width, int height, int ch
 	std::copy(d.data(), d.data() + d.size(), output.buffer.data());
 #else
     idthread;
-	jpeg_encoder enc;
-	enc.encode(data, width, height, channels, output.buffer, 30);
-	output.size = output.buffer.size();
+	//Tiles are encoded by short lived threads, encoders stay in the pool between frames
+	jpeg_encoder_pool::lease enc(jpeg_encoder_pool::instance());
+	enc->encode(data, width, height, channels, output, 30);
 #endif
 }
 
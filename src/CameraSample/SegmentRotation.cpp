@@ -0,0 +1,91 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "SegmentRotation.h"
+
+#include <QFileInfo>
+#include <QDir>
+
+bool SegmentRotation::isEnabled() const
+{
+    return mLimits.maxBytes > 0 || mLimits.maxDuration > 0 || mLimits.maxFrames > 0;
+}
+
+void SegmentRotation::start(const QString& fileName)
+{
+    QFileInfo info(fileName);
+    mFileName = fileName;
+    mBase = QDir(info.path()).filePath(info.completeBaseName());
+    mSuffix = info.suffix();
+    mIndex = 0;
+    mBytes = 0;
+    mFrames = 0;
+    mFirstTimestamp = 0;
+}
+
+QString SegmentRotation::fileName(int index) const
+{
+    if(!isEnabled())
+        return mFileName;
+
+    QString name = QStringLiteral("%1_%2").arg(mBase).arg(index, 3, 10, QLatin1Char('0'));
+    if(!mSuffix.isEmpty())
+        name += QStringLiteral(".%1").arg(mSuffix);
+    return QDir::toNativeSeparators(name);
+}
+
+bool SegmentRotation::isFull(qint64 size, qint64 timestamp) const
+{
+    if(!isEnabled() || mFrames == 0)
+        return false;
+
+    if(mLimits.maxFrames > 0 && mFrames >= mLimits.maxFrames)
+        return true;
+    if(mLimits.maxBytes > 0 && mBytes + size > mLimits.maxBytes)
+        return true;
+    if(mLimits.maxDuration > 0 && mFirstTimestamp > 0 && timestamp - mFirstTimestamp >= mLimits.maxDuration)
+        return true;
+
+    return false;
+}
+
+void SegmentRotation::add(qint64 size, qint64 timestamp)
+{
+    if(mFrames == 0)
+        mFirstTimestamp = timestamp;
+    mBytes += size;
+    mFrames++;
+}
+
+void SegmentRotation::next()
+{
+    mIndex++;
+    mBytes = 0;
+    mFrames = 0;
+    mFirstTimestamp = 0;
+}
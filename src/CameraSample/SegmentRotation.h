@@ -0,0 +1,79 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef SEGMENTROTATION_H
+#define SEGMENTROTATION_H
+
+#include <QString>
+
+/// Rollover bookkeeping of writers splitting a recording into several files.
+/// With limits set files are named base_000.ext, base_001.ext and so on,
+/// without limits a single file with the base name is written.
+class SegmentRotation
+{
+public:
+    /// 0 is no limit
+    struct Limits
+    {
+        qint64 maxBytes = 0;
+        /// Capture time, ns
+        qint64 maxDuration = 0;
+        int    maxFrames = 0;
+    };
+
+    void setLimits(const Limits& limits){mLimits = limits;}
+    const Limits& limits() const {return mLimits;}
+    bool isEnabled() const;
+
+    /// Starts with segment 0 of fileName
+    void start(const QString& fileName);
+    QString fileName(int index) const;
+    QString currentFileName() const {return fileName(mIndex);}
+    QString nextFileName() const {return fileName(mIndex + 1);}
+    int index() const {return mIndex;}
+    /// Frames in current segment
+    int frames() const {return mFrames;}
+
+    /// True if frame does not fit current segment. A segment always gets at least one frame.
+    bool isFull(qint64 size, qint64 timestamp) const;
+    void add(qint64 size, qint64 timestamp);
+    /// Moves to next segment
+    void next();
+
+private:
+    Limits  mLimits;
+    QString mFileName;
+    QString mBase;
+    QString mSuffix;
+    int     mIndex = 0;
+    qint64  mBytes = 0;
+    int     mFrames = 0;
+    qint64  mFirstTimestamp = 0;
+};
+
+#endif // SEGMENTROTATION_H
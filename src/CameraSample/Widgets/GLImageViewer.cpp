@@ -532,18 +532,13 @@ void GLRenderer::render()
     glFinish();
 }
 
-void GLRenderer::loadImage(void* img, int width, int height)
+void GLRenderer::loadImage(void* img, int width, int height, MemoryBackend backend)
 {
-    QTimer::singleShot(0, this, [this, img,width,height](){loadImageInternal(img, width, height);});
+    QTimer::singleShot(0, this, [this, img, width, height, backend](){loadImageInternal(img, width, height, backend);});
 }
 
-void GLRenderer::loadImageInternal(void* img, int width, int height)
+void GLRenderer::loadImageInternal(void* img, int width, int height, MemoryBackend backend)
 {
-    unsigned char *data = NULL;
-    size_t pboBufferSize = 0;
-
-    cudaError_t error = cudaSuccess;
-
     mImageSize = QSize(width, height);
 
     if(!m_context->makeCurrent(mRenderWnd))
@@ -555,52 +550,88 @@ void GLRenderer::loadImageInternal(void* img, int width, int height)
         m_initialized = true;
     }
 
-    GLint bsize;
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_buffer);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
+    if(backend == mbHost)
+    {
+        //Host image is uploaded by the driver, no interop needed
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, 3 * sizeof(unsigned char) * width * height, img, GL_STREAM_DRAW);
+        if(img == nullptr)
+            return;
+    }
+    else if(!loadDeviceImage(img, width, height))
+    {
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_buffer);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    m_context->doneCurrent();
+}
+
+bool GLRenderer::loadDeviceImage(void* img, int width, int height)
+{
+#ifdef HOST_ONLY
+    Q_UNUSED(img)
+    Q_UNUSED(width)
+    Q_UNUSED(height)
+    return false;
+#else
+    unsigned char *data = NULL;
+    size_t pboBufferSize = 0;
+
+    cudaError_t error = cudaSuccess;
+
+    GLint bsize;
     glBufferData(GL_PIXEL_UNPACK_BUFFER, 3 * sizeof(unsigned char) * width * height, NULL, GL_STREAM_COPY);
     glGetBufferParameteriv(GL_PIXEL_UNPACK_BUFFER, GL_BUFFER_SIZE, &bsize);
     struct cudaGraphicsResource* cuda_pbo_resource = 0;
 
     if(img == nullptr)
-        return;
+        return false;
 
     error = cudaGraphicsGLRegisterBuffer(&cuda_pbo_resource, pbo_buffer, cudaGraphicsMapFlagsWriteDiscard);
     if(error != cudaSuccess)
     {
         qDebug("Cannot register CUDA Graphic Resource: %s\n", cudaGetErrorString(error));
-        return;
+        return false;
     }
 
     if((error = cudaGraphicsMapResources( 1, &cuda_pbo_resource, 0 ) ) != cudaSuccess)
     {
         qDebug("cudaGraphicsMapResources failed: %s\n", cudaGetErrorString(error) );
-        return;
+        return false;
     }
 
     if((error = cudaGraphicsResourceGetMappedPointer( (void **)&data, &pboBufferSize, cuda_pbo_resource ) ) != cudaSuccess )
     {
         qDebug("cudaGraphicsResourceGetMappedPointer failed: %s\n", cudaGetErrorString(error) );
-        return;
+        return false;
     }
 
     if(pboBufferSize < ( width * height * 3 * sizeof(unsigned char) ))
     {
         qDebug("cudaGraphicsResourceGetMappedPointer failed: %s\n", cudaGetErrorString(error) );
-        return;
+        return false;
     }
 
     if((error = cudaMemcpy( data, img, width * height * 3 * sizeof(unsigned char), cudaMemcpyDeviceToDevice ) ) != cudaSuccess)
     {
         qDebug("cudaMemcpy failed: %s\n", cudaGetErrorString(error) );
-        return;
+        return false;
     }
 
     if((error = cudaGraphicsUnmapResources( 1, &cuda_pbo_resource, 0 ) ) != cudaSuccess )
     {
          qDebug("cudaGraphicsUnmapResources failed: %s\n", cudaGetErrorString(error) );
-         return;
+         return false;
     }
 
     if(cuda_pbo_resource)
@@ -608,18 +639,10 @@ void GLRenderer::loadImageInternal(void* img, int width, int height)
         if((error  = cudaGraphicsUnregisterResource(cuda_pbo_resource))!= cudaSuccess)
         {
             qDebug("Cannot unregister CUDA Graphic Resource: %s\n", cudaGetErrorString(error));
-            return;
+            return false;
         }
         cuda_pbo_resource = 0;
     }
-
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_buffer);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-
-    m_context->doneCurrent();
+    return true;
+#endif
 }
@@ -40,8 +40,12 @@
 #include <QMutex>
 #include <QSize>
 
+#ifndef HOST_ONLY
 #include <cuda_runtime.h>
 #include <cuda_gl_interop.h>
+#endif
+
+#include "MemoryBackend.h"
 
 class GLImageViewer;
 
@@ -54,7 +58,8 @@ public:
     QSurfaceFormat format() const { return m_format; }
     QOpenGLContext* context() const {return m_context;}
     void setRenderWnd(GLImageViewer* wnd){mRenderWnd = wnd;}
-    void loadImage(void* img, int width, int height);
+    /// img is 8-bit RGB image, allocated with backend
+    void loadImage(void* img, int width, int height, MemoryBackend backend = mbCUDA);
     void showImage(bool show = true);
     void update();
     QSize imageSize(){return mImageSize;}
@@ -67,7 +72,9 @@ protected:
 
 private:
     void initialize();
-    void loadImageInternal(void* img, int width, int height);
+    void loadImageInternal(void* img, int width, int height, MemoryBackend backend);
+    /// Copies device image to pixel buffer through CUDA-GL interop
+    bool loadDeviceImage(void* img, int width, int height);
     bool m_initialized = false;
 
     QSize  mImageSize;
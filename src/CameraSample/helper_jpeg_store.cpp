@@ -177,17 +177,8 @@ void AppendAPP0(
 	stream << uint16_t(0xFFE0) << uint16_t(16) << data;
 }
 
-void AppendAPP(
-	Bytestream &stream,
-	fastJpegExifSection_t &exif
-) {
-	stream << uint16_t(exif.exifCode) << uint16_t(exif.exifLength + 2);
-	for(int i = 0; i < exif.exifLength; i++) {
-		stream << exif.exifData[i];
-	}
-}
-
-void AppendHeader(
+// DQT, SOF0, DHT, DRI and SOS, everything that follows SOI and APP sections
+void AppendTables(
 	Bytestream &stream,
 
 	uint16_t imageH,
@@ -199,19 +190,8 @@ void AppendHeader(
 	const fastJpegScanStruct_t      *scanMap,
 
 	fastJpegFormat_t samplingFmt,
-	uint16_t restartInterval,
-	fastJpegExifSection_t *exifSections,
-	unsigned exifSectionsCount
+	uint16_t restartInterval
 ) {
-	AppendSOI(stream);
-    if(exifSections == nullptr || exifSectionsCount == 0) {
-		AppendAPP0(stream);
-	} else {
-        for(unsigned i = 0; i < exifSectionsCount; i++) {
-			AppendAPP(stream, exifSections[i]);
-		}
-	}
-
 	bool isQuant[4], isHuffman[2][2];
 
 	memset(isQuant, 0, sizeof(isQuant));
@@ -241,6 +221,112 @@ void AppendHeader(
 	AppendSOS(stream, samplingFmt, *scanMap);
 }
 
+// Tables change only with quality, sampling, restart interval or bit depth,
+// so they are built once and copied into every frame. Frame size is patched in SOF.
+struct JfifHeaderTemplate {
+	bool valid = false;
+	unsigned bitsPerChannel = 0;
+	fastJpegFormat_t samplingFmt = JPEG_Y;
+	unsigned restartInterval = 0;
+	fastJpegScanStruct_t scanMap;
+	fastJpegQuantState_t quantState;
+	fastJpegHuffmanState_t huffmanState;
+
+	std::vector<uint8_t> app0;		// SOI and APP0 for frames without EXIF
+	std::vector<uint8_t> tables;	// DQT to SOS
+	size_t sizeOffset = 0;			// height and width in tables
+};
+
+const JfifHeaderTemplate &GetHeaderTemplate(const fastJfifInfo_t *jfifInfo) {
+	// Encoder and its stream stay on one thread, so one template per thread is enough
+	static thread_local JfifHeaderTemplate cache;
+
+	if(cache.valid &&
+	   cache.bitsPerChannel == jfifInfo->bitsPerChannel &&
+	   cache.samplingFmt == jfifInfo->jpegFmt &&
+	   cache.restartInterval == jfifInfo->restartInterval &&
+	   memcmp(&cache.scanMap, &jfifInfo->scanMap, sizeof(cache.scanMap)) == 0 &&
+	   memcmp(&cache.quantState, &jfifInfo->quantState, sizeof(cache.quantState)) == 0 &&
+	   memcmp(&cache.huffmanState, &jfifInfo->huffmanState, sizeof(cache.huffmanState)) == 0)
+		return cache;
+
+	cache.bitsPerChannel = jfifInfo->bitsPerChannel;
+	cache.samplingFmt = jfifInfo->jpegFmt;
+	cache.restartInterval = jfifInfo->restartInterval;
+	memcpy(&cache.scanMap, &jfifInfo->scanMap, sizeof(cache.scanMap));
+	memcpy(&cache.quantState, &jfifInfo->quantState, sizeof(cache.quantState));
+	memcpy(&cache.huffmanState, &jfifInfo->huffmanState, sizeof(cache.huffmanState));
+
+	Bytestream app0;
+	AppendSOI(app0);
+	AppendAPP0(app0);
+	cache.app0.assign(app0.GetBase(), app0.GetBase() + app0.GetSize());
+
+	Bytestream tables;
+	AppendTables(
+		tables,
+
+		0,
+		0,
+		jfifInfo->bitsPerChannel,
+
+		&jfifInfo->quantState,
+		&jfifInfo->huffmanState,
+		&jfifInfo->scanMap,
+
+		jfifInfo->jpegFmt,
+		uint16_t(jfifInfo->restartInterval)
+	);
+	cache.tables.assign(tables.GetBase(), tables.GetBase() + tables.GetSize());
+
+	// Marker segments up to SOF: 0xFF, code, 16 bit length
+	size_t pos = 0;
+	while(cache.tables[pos + 1] != 0xC0 && cache.tables[pos + 1] != 0xC1)
+		pos += 2 + ((size_t(cache.tables[pos + 2]) << 8) | cache.tables[pos + 3]);
+	cache.sizeOffset = pos + 5;
+
+	cache.valid = true;
+	return cache;
+}
+
+size_t GetHeaderSize(const fastJfifInfo_t *jfifInfo, const JfifHeaderTemplate &header) {
+	if(jfifInfo->exifSections == nullptr || jfifInfo->exifSectionsCount == 0)
+		return header.app0.size() + header.tables.size();
+
+	size_t size = 2 + header.tables.size();
+	for(unsigned i = 0; i < jfifInfo->exifSectionsCount; i++)
+		size += 4 + size_t(jfifInfo->exifSections[i].exifLength);
+	return size;
+}
+
+// Output has to hold GetHeaderSize bytes
+void WriteHeader(uint8_t *output, const fastJfifInfo_t *jfifInfo, const JfifHeaderTemplate &header) {
+	uint8_t *dst = output;
+    if(jfifInfo->exifSections == nullptr || jfifInfo->exifSectionsCount == 0) {
+		memcpy(dst, header.app0.data(), header.app0.size());
+		dst += header.app0.size();
+	} else {
+		*dst++ = 0xFF;
+		*dst++ = 0xD8;
+        for(unsigned i = 0; i < jfifInfo->exifSectionsCount; i++) {
+			const fastJpegExifSection_t &exif = jfifInfo->exifSections[i];
+			const auto length = uint16_t(exif.exifLength + 2);
+			dst[0] = uint8_t(uint16_t(exif.exifCode) >> 8);
+			dst[1] = uint8_t(exif.exifCode);
+			dst[2] = uint8_t(length >> 8);
+			dst[3] = uint8_t(length);
+			memcpy(dst + 4, exif.exifData, size_t(exif.exifLength));
+			dst += 4 + exif.exifLength;
+		}
+	}
+
+	memcpy(dst, header.tables.data(), header.tables.size());
+	dst[header.sizeOffset + 0] = uint8_t(jfifInfo->height >> 8);
+	dst[header.sizeOffset + 1] = uint8_t(jfifInfo->height);
+	dst[header.sizeOffset + 2] = uint8_t(jfifInfo->width >> 8);
+	dst[header.sizeOffset + 3] = uint8_t(jfifInfo->width);
+}
+
 template<typename T> void Write(std::ofstream &fd, const T *data, size_t count = 1) {
 	if(count > 0)
         fd.write(reinterpret_cast<const char *>(data), std::streamsize(count * sizeof(T)));
@@ -254,25 +340,11 @@ fastStatus_t fastJfifStoreToFile(
         std::ofstream fd(filename, std::ios::out | std::ios::binary | std::ios::trunc);
         fd.exceptions(std::ios::failbit | std::ios::badbit);
 
-        Bytestream header;
-        AppendHeader(
-            header,
+        const JfifHeaderTemplate &header = GetHeaderTemplate(jfifInfo);
+        std::vector<uint8_t> headerData(GetHeaderSize(jfifInfo, header));
+        WriteHeader(headerData.data(), jfifInfo, header);
 
-            uint16_t(jfifInfo->height),
-            uint16_t(jfifInfo->width),
-			jfifInfo->bitsPerChannel,
-
-            &jfifInfo->quantState,
-            &jfifInfo->huffmanState,
-            &jfifInfo->scanMap,
-
-            jfifInfo->jpegFmt,
-            uint16_t(jfifInfo->restartInterval),
-			jfifInfo->exifSections,
-			jfifInfo->exifSectionsCount
-        );
-
-        Write(fd, header.GetBase(), header.GetSize());
+        Write(fd, headerData.data(), headerData.size());
         Write(fd, jfifInfo->h_Bytestream, jfifInfo->bytestreamSize);
         fd.flush();
     }catch(...){
@@ -289,30 +361,15 @@ fastStatus_t fastJfifStoreToMemory(
     fastJfifInfo_t *jfifInfo
 ){
     try {
-        Bytestream header;
-        AppendHeader(
-            header,
-
-            uint16_t(jfifInfo->height),
-            uint16_t(jfifInfo->width),
-			jfifInfo->bitsPerChannel,
+        const JfifHeaderTemplate &header = GetHeaderTemplate(jfifInfo);
+        const size_t headerSize = GetHeaderSize(jfifInfo, header);
 
-            &jfifInfo->quantState,
-            &jfifInfo->huffmanState,
-            &jfifInfo->scanMap,
-
-            jfifInfo->jpegFmt,
-            uint16_t(jfifInfo->restartInterval),
-			jfifInfo->exifSections,
-			jfifInfo->exifSectionsCount
-        );
-
-		if(header.GetSize() + jfifInfo->bytestreamSize > *outputStreamSize)
+		if(headerSize + jfifInfo->bytestreamSize > *outputStreamSize)
 			return FAST_INSUFFICIENT_HOST_MEMORY;
-		
-		memcpy(outputStream, header.GetBase(), header.GetSize());
-		memcpy(outputStream + header.GetSize(), jfifInfo->h_Bytestream, jfifInfo->bytestreamSize);
-        *outputStreamSize = static_cast<unsigned>(header.GetSize() + jfifInfo->bytestreamSize);
+
+		WriteHeader(outputStream, jfifInfo, header);
+		memcpy(outputStream + headerSize, jfifInfo->h_Bytestream, jfifInfo->bytestreamSize);
+        *outputStreamSize = static_cast<unsigned>(headerSize + jfifInfo->bytestreamSize);
     }catch(...){
         return FAST_INTERNAL_ERROR;
     }
@@ -0,0 +1,71 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef HOST_ONLY_BASEALLOCATOR_H
+#define HOST_ONLY_BASEALLOCATOR_H
+
+#include <cstdlib>
+#include <new>
+
+#include "fastvideo_sdk.h"
+
+/// Stands in for BaseAllocator.h of Fastvideo SDK samples in HOST_ONLY builds.
+/// allocate throws std::bad_alloc on failure.
+class BaseAllocator
+{
+public:
+    virtual ~BaseAllocator() = default;
+
+    virtual void* allocate(size_t bytesCount) = 0;
+    virtual void deallocate(void* p) = 0;
+    virtual unsigned getAlignment() {return FAST_ALIGNMENT;}
+
+    void operator()(void* p)
+    {
+        deallocate(p);
+    }
+};
+
+class MallocAllocator : public BaseAllocator
+{
+public:
+    void* allocate(size_t bytesCount) override
+    {
+        void* p = malloc(bytesCount);
+        if(p == nullptr)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    void deallocate(void* p) override
+    {
+        free(p);
+    }
+};
+
+#endif // HOST_ONLY_BASEALLOCATOR_H
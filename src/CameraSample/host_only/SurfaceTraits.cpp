@@ -0,0 +1,76 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "SurfaceTraits.hpp"
+#include "alignment.hpp"
+
+unsigned GetBitsPerChannelFromSurface(fastSurfaceFormat_t surfaceFmt)
+{
+    switch(surfaceFmt)
+    {
+    case FAST_I10:
+        return 10;
+    case FAST_I12:
+    case FAST_RGB12:
+        return 12;
+    case FAST_I14:
+        return 14;
+    case FAST_I16:
+    case FAST_RGB16:
+    case FAST_BGR16:
+        return 16;
+    default:
+        return 8;
+    }
+}
+
+unsigned GetNumberOfChannelsFromSurface(fastSurfaceFormat_t surfaceFmt)
+{
+    switch(surfaceFmt)
+    {
+    case FAST_RGB8:
+    case FAST_BGR8:
+    case FAST_RGB12:
+    case FAST_RGB16:
+    case FAST_BGR16:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+unsigned GetBytesPerChannelFromSurface(fastSurfaceFormat_t surfaceFmt)
+{
+    return uDivUp(GetBitsPerChannelFromSurface(surfaceFmt), 8u);
+}
+
+unsigned GetPitchFromSurface(fastSurfaceFormat_t surfaceFmt, unsigned width)
+{
+    const unsigned rowSize = width * GetNumberOfChannelsFromSurface(surfaceFmt) * GetBytesPerChannelFromSurface(surfaceFmt);
+    return _uSnapUp(rowSize, FAST_ALIGNMENT);
+}
@@ -0,0 +1,107 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef HOST_ONLY_FASTVIDEO_SDK_H
+#define HOST_ONLY_FASTVIDEO_SDK_H
+
+/// Stands in for fastvideo_sdk.h in HOST_ONLY builds.
+/// Declares only plain types and constants used outside of GPU processors,
+/// there are no SDK functions. Numeric values are local to host only builds.
+
+#define FAST_ALIGNMENT 4U
+
+typedef enum
+{
+    FAST_OK = 0,
+    FAST_INVALID_DEVICE,
+    FAST_INCOMPATIBLE_DEVICE,
+    FAST_INSUFFICIENT_DEVICE_MEMORY,
+    FAST_INSUFFICIENT_HOST_MEMORY,
+    FAST_INVALID_HANDLE,
+    FAST_INVALID_VALUE,
+    FAST_UNAPPLICABLE_OPERATION,
+    FAST_INVALID_SIZE,
+    FAST_UNALIGNED_DATA,
+    FAST_INVALID_TABLE,
+    FAST_BITSTREAM_CORRUPT,
+    FAST_EXECUTION_FAILURE,
+    FAST_INTERNAL_ERROR,
+    FAST_UNSUPPORTED_SURFACE,
+    FAST_IO_ERROR,
+    FAST_INVALID_FORMAT,
+    FAST_UNSUPPORTED_FORMAT,
+    FAST_MJPEG_THREAD_ERROR,
+    FAST_MJPEG_OPEN_FILE_ERROR,
+    FAST_UNKNOWN_ERROR
+} fastStatus_t;
+
+typedef enum
+{
+    FAST_I8 = 0,
+    FAST_I10,
+    FAST_I12,
+    FAST_I14,
+    FAST_I16,
+    FAST_RGB8,
+    FAST_BGR8,
+    FAST_RGB12,
+    FAST_RGB16,
+    FAST_BGR16
+} fastSurfaceFormat_t;
+
+typedef enum
+{
+    FAST_BAYER_NONE = 0,
+    FAST_BAYER_RGGB,
+    FAST_BAYER_BGGR,
+    FAST_BAYER_GBRG,
+    FAST_BAYER_GRBG
+} fastBayerPattern_t;
+
+typedef enum
+{
+    FAST_DFPD = 0,
+    FAST_HQLI,
+    FAST_MG
+} fastDebayerType_t;
+
+typedef enum
+{
+    JPEG_Y = 0,
+    JPEG_444,
+    JPEG_422,
+    JPEG_420
+} fastJpegFormat_t;
+
+/// Output LUT, 16 bit data is looked up by 14 MSB
+typedef struct
+{
+    unsigned short lut[16384];
+} fastLut_16_t;
+
+#endif // HOST_ONLY_FASTVIDEO_SDK_H
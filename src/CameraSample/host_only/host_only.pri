@@ -0,0 +1,16 @@
+# Stand-ins for Fastvideo SDK headers used outside of GPU processors,
+# included with CONFIG+=host_only instead of SDK include paths.
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/fastvideo_sdk.h \
+    $$PWD/fastvideo_denoise.h \
+    $$PWD/BaseAllocator.h \
+    $$PWD/FastAllocator.h \
+    $$PWD/Image.h \
+    $$PWD/SurfaceTraits.hpp \
+    $$PWD/alignment.hpp \
+    $$PWD/helper_image/helper_common.h
+
+SOURCES += \
+    $$PWD/SurfaceTraits.cpp
@@ -1,4 +1,7 @@
 TEMPLATE = subdirs
 SUBDIRS = \
         CameraSample \
-        RtspPlayer
+        HeadlessRunner
+
+# Player decodes with Fastvideo SDK and NVDEC, not built with CONFIG+=host_only
+!host_only: SUBDIRS += RtspPlayer
@@ -0,0 +1,1240 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "HeadlessRunner.h"
+#include "RawProcessor.h"
+#include "CameraBase.h"
+#include "PGMCamera.h"
+#include "RawFileCamera.h"
+#include "CPUProcessor.h"
+#include "CPUKernels.h"
+#include "Metrics.h"
+#include "AviMuxer.h"
+#include "MJPEGEncoder.h"
+#include "JpegEncoder.h"
+#include "JpegParallelEncoder.h"
+#include "JfifParser.h"
+#ifndef HOST_ONLY
+#include "helper_jpeg.hpp"
+#endif
+#include "ppm.h"
+
+#ifdef SUPPORT_XIMEA
+#include "XimeaCamera.h"
+#endif
+
+#ifdef SUPPORT_GENICAM
+#include "GeniCamCamera.h"
+#endif
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace
+{
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if(sorted.empty())
+        return 0;
+    size_t idx = size_t(p / 100. * double(sorted.size() - 1) + 0.5);
+    return sorted[qMin(idx, sorted.size() - 1)];
+}
+}
+
+HeadlessRunner::HeadlessRunner(const RunnerSettings& settings, QObject* parent) :
+    QObject(parent),
+    mSettings(settings)
+{
+    mLatencies.reserve(100000);
+}
+
+HeadlessRunner::~HeadlessRunner()
+{
+    stop();
+}
+
+CameraBase* HeadlessRunner::createCamera()
+{
+    if(mSettings.camera == QLatin1String("pgm"))
+    {
+        QString fileName = mSettings.fileName;
+        if(fileName.isEmpty())
+        {
+            fileName = mTempDir.filePath(QStringLiteral("frame.pgm"));
+            if(!writeTestFrame(fileName))
+            {
+                mError = QStringLiteral("Cannot create test frame %1").arg(fileName);
+                return nullptr;
+            }
+        }
+        return new PGMCamera(fileName, mSettings.pattern, mSettings.color);
+    }
+
+    if(mSettings.camera == QLatin1String("raw"))
+    {
+        if(mSettings.fileName.isEmpty())
+        {
+            mError = QStringLiteral("Raw file camera requires --file");
+            return nullptr;
+        }
+        return new RawFileCamera(mSettings.fileName);
+    }
+
+#ifdef SUPPORT_XIMEA
+    if(mSettings.camera == QLatin1String("ximea"))
+        return new XimeaCamera();
+#endif
+
+#ifdef SUPPORT_GENICAM
+    if(mSettings.camera == QLatin1String("genicam"))
+        return new GeniCamCamera();
+#endif
+
+    mError = QStringLiteral("Camera %1 is not supported by this build").arg(mSettings.camera);
+    return nullptr;
+}
+
+bool HeadlessRunner::writeTestFrame(const QString& fileName)
+{
+    //Gradient with some noise, so debayer and denoise have something to work on
+    const unsigned w = unsigned(mSettings.frameSize.width());
+    const unsigned h = unsigned(mSettings.frameSize.height());
+    const int bits = qBound(8, mSettings.bitsPerPixel, 16);
+    const unsigned maxVal = (1u << bits) - 1;
+    const unsigned bpp = bits > 8 ? 2 : 1;
+
+    if(w == 0 || h == 0 || !mTempDir.isValid())
+        return false;
+
+    std::vector<unsigned char> data(size_t(w) * h * bpp);
+    unsigned seed = 12345;
+    for(unsigned y = 0; y < h; y++)
+    {
+        for(unsigned x = 0; x < w; x++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            unsigned val = (x * maxVal / w + y * maxVal / h) / 2;
+            val = qMin(maxVal, val + ((seed >> 16) & 0x3F));
+
+            const size_t idx = size_t(y) * w + x;
+            if(bpp == 2)
+                reinterpret_cast<unsigned short*>(data.data())[idx] = static_cast<unsigned short>(val);
+            else
+                data[idx] = static_cast<unsigned char>(val);
+        }
+    }
+
+    return savePPM(fileName.toStdString().c_str(), data.data(), w, w * bpp, h, bits, 1) == 1;
+}
+
+bool HeadlessRunner::start()
+{
+    int devCount = 0;
+#ifndef HOST_ONLY
+    if(cudaGetDeviceCount(&devCount) != cudaSuccess)
+        devCount = 0;
+#endif
+
+    //Without CUDA device camera frames are kept in host memory and processed on CPU
+    if(devCount == 0)
+        mSettings.cpu = true;
+    if(mSettings.cpu)
+        ImageAllocator::setDefaultBackend(mbHost);
+
+    mCameraPtr.reset(createCamera());
+    if(!mCameraPtr)
+        return false;
+
+    mCameraPtr->getFrameBuffer()->setBackend(mSettings.cpu ? mbHost : mbCUDA);
+    if(!mCameraPtr->open(mSettings.devID))
+    {
+        mError = QStringLiteral("Cannot open camera");
+        return false;
+    }
+
+    if(mSettings.fps > 0)
+        mCameraPtr->setParameter(CameraBase::prmFrameRate, mSettings.fps);
+
+    mProcessorPtr.reset(new RawProcessor(mCameraPtr.data(), nullptr));
+    mCameraPtr->setProcessor(mProcessorPtr.data());
+
+    auto* cpuProcessor = dynamic_cast<CPUProcessor*>(mProcessorPtr->getProcessor());
+    if(cpuProcessor)
+        cpuProcessor->setThreadCount(mSettings.threads);
+
+    mOptions.Width = mCameraPtr->width();
+    mOptions.Height = mCameraPtr->height();
+    mOptions.MaxWidth = mCameraPtr->width();
+    mOptions.MaxHeight = mCameraPtr->height();
+    mOptions.BayerFormat = mCameraPtr->bayerPattern();
+    mOptions.SurfaceFmt = mCameraPtr->surfaceFormat();
+    mOptions.WhiteLevel = mCameraPtr->whiteLevel();
+    mOptions.BlackLevel = 0;
+    mOptions.Packed = mCameraPtr->isPacked();
+    mOptions.Codec = mSettings.codec;
+    mOptions.JpegQuality = mSettings.jpegQuality;
+    mProcessorPtr->updateOptions(mOptions);
+
+    if(mProcessorPtr->init() != FAST_OK)
+    {
+        mError = QStringLiteral("Processor init failed: %1").arg(mProcessorPtr->getLastErrorDescription());
+        return false;
+    }
+
+    if(mSettings.policy >= 0)
+    {
+        auto policy = static_cast<CircularBuffer::FramePolicy>(mSettings.policy);
+        mCameraPtr->getFrameBuffer()->setPolicy(policy, mSettings.policyParam);
+        mProcessorPtr->setRecordingPolicy(policy, mSettings.policyParam);
+    }
+
+    mProcessorPtr->setFrameCallback([this](const FrameMetadata& meta){onFrame(meta);});
+
+    if(!mSettings.rtspUrl.isEmpty())
+        mProcessorPtr->setRtspServer(mSettings.rtspUrl);
+
+    mCameraPtr->start();
+    mProcessorPtr->start();
+
+    if(!mSettings.outputPath.isEmpty())
+    {
+        mProcessorPtr->setOutputPath(mSettings.outputPath);
+        mProcessorPtr->setFilePrefix(QStringLiteral("frame_"));
+        mProcessorPtr->setWriterBufferCount(mSettings.writerBuffers);
+        mProcessorPtr->setWriterThreads(mSettings.writerThreads);
+        mProcessorPtr->setRawQueueDepth(mSettings.ioDepth);
+        mProcessorPtr->setPreTrigger(mSettings.preTrigger, mSettings.preTriggerBytes, mSettings.postTrigger);
+        mProcessorPtr->setSegmentLimits(mSettings.segmentBytes >= 0 ? mSettings.segmentBytes : Globals::MaxFileSize,
+                                        mSettings.segmentSeconds, mSettings.segmentFrames);
+
+        JpegQualityController::Settings quality;
+        quality.enabled = mSettings.adaptiveQuality;
+        quality.minQuality = mSettings.qualityMin;
+        quality.maxQuality = mSettings.qualityMax;
+        quality.targetBandwidth = mSettings.targetMBps * 1048576.;
+        mProcessorPtr->setAdaptiveQuality(quality);
+        mProcessorPtr->startWriting();
+
+        if(mProcessorPtr->isPreTrigger() && mSettings.triggerAt >= 0)
+        {
+            QTimer::singleShot(qRound(mSettings.triggerAt * 1000), this, [this](){
+                if(mProcessorPtr)
+                    mProcessorPtr->trigger();
+            });
+        }
+    }
+
+    mRunning = true;
+    return true;
+}
+
+void HeadlessRunner::onFrame(const FrameMetadata& meta)
+{
+    //Called from RawProcessor output stage
+    const qint64 now = FrameMetadata::now();
+
+    QMutexLocker lock(&mLock);
+    mFrames++;
+    if(mFrames <= mSettings.warmup || mStopping)
+        return;
+
+    if(mMeasuredFrames == 0)
+    {
+        //Histograms cover measured frames only
+        Metrics::reset();
+        mMeasureStart = now;
+        if(mSettings.frames <= 0)
+            QMetaObject::invokeMethod(this, "startStopTimer", Qt::QueuedConnection);
+    }
+    mMeasuredFrames++;
+    mLastFrame = now;
+
+    if(meta.hostTimestamp > 0)
+        mLatencies.push_back(double(now - meta.hostTimestamp) / 1000000.);
+
+    if(mSettings.frames > 0 && mMeasuredFrames >= mSettings.frames)
+    {
+        mStopping = true;
+        QMetaObject::invokeMethod(this, "stop", Qt::QueuedConnection);
+    }
+}
+
+void HeadlessRunner::startStopTimer()
+{
+    QTimer::singleShot(qRound(mSettings.seconds * 1000), this, SLOT(stop()));
+}
+
+void HeadlessRunner::stop()
+{
+    if(!mRunning)
+        return;
+    mRunning = false;
+
+    {
+        QMutexLocker lock(&mLock);
+        mStopping = true;
+    }
+
+    if(mCameraPtr)
+        mCameraPtr->stop();
+
+    //Pipeline is drained by stop, writer counters are reported while still writing
+    mProcessorPtr->stop();
+    printReport(mProcessorPtr->getStats());
+    mProcessorPtr->stopWriting();
+
+    mProcessorPtr.reset();
+    mCameraPtr.reset();
+
+    emit finished();
+}
+
+void HeadlessRunner::printReport(const QMap<QString, float>& stats)
+{
+    QMutexLocker lock(&mLock);
+
+    std::sort(mLatencies.begin(), mLatencies.end());
+
+    const double seconds = double(mLastFrame - mMeasureStart) / 1000000000.;
+    const double fps = (seconds > 0 && mMeasuredFrames > 1) ? double(mMeasuredFrames - 1) / seconds : 0;
+    const double mpix = fps * mOptions.Width * mOptions.Height / 1000000.;
+    const QString backend = mSettings.cpu ?
+                QStringLiteral("CPU %1").arg(QLatin1String(CPUKernels::simdName(CPUKernels::simdLevel()))) :
+                QStringLiteral("CUDA");
+
+    QJsonObject report;
+    report[QStringLiteral("backend")] = backend;
+    report[QStringLiteral("width")] = int(mOptions.Width);
+    report[QStringLiteral("height")] = int(mOptions.Height);
+    report[QStringLiteral("frames")] = double(mMeasuredFrames);
+    report[QStringLiteral("seconds")] = seconds;
+    report[QStringLiteral("fps")] = fps;
+    report[QStringLiteral("mpixPerSecond")] = mpix;
+
+    QJsonObject latency;
+    latency[QStringLiteral("p50")] = percentile(mLatencies, 50);
+    latency[QStringLiteral("p90")] = percentile(mLatencies, 90);
+    latency[QStringLiteral("p99")] = percentile(mLatencies, 99);
+    latency[QStringLiteral("max")] = mLatencies.empty() ? 0. : mLatencies.back();
+    report[QStringLiteral("latencyMs")] = latency;
+
+    report[QStringLiteral("captureFrames")] = double(stats.value(QStringLiteral("captureFrames")));
+    report[QStringLiteral("captureDropped")] = double(stats.value(QStringLiteral("captureDropped")));
+    report[QStringLiteral("writerFrames")] = double(stats.value(QStringLiteral("procFrames"), -1));
+    report[QStringLiteral("writerDropped")] = double(stats.value(QStringLiteral("droppedFrames"), -1));
+    const QString writerError = mProcessorPtr->getWriterError();
+    if(!writerError.isEmpty())
+        report[QStringLiteral("writerError")] = writerError;
+
+    const QStringList outputPaths = mSettings.outputPath.split(QDir::listSeparator(), QString::SkipEmptyParts);
+    QJsonArray volumes;
+    for(int i = 0; i < int(stats.value(QStringLiteral("writerVolumes"))); i++)
+    {
+        QJsonObject obj;
+        obj[QStringLiteral("path")] = outputPaths.value(i);
+        obj[QStringLiteral("frames")] = double(stats.value(QStringLiteral("volume%1_frames").arg(i)));
+        obj[QStringLiteral("MBps")] = double(stats.value(QStringLiteral("volume%1_MBps").arg(i)));
+        obj[QStringLiteral("queue")] = double(stats.value(QStringLiteral("volume%1_queue").arg(i)));
+        obj[QStringLiteral("queueMax")] = double(stats.value(QStringLiteral("volume%1_queueMax").arg(i)));
+        volumes.append(obj);
+    }
+    if(!volumes.isEmpty())
+        report[QStringLiteral("volumes")] = volumes;
+
+    const float rawMBps = stats.value(QStringLiteral("rawMBps"), -1);
+    const QString rawBackend = DirectFileWriter::backendName(
+                static_cast<DirectFileWriter::Backend>(int(stats.value(QStringLiteral("rawBackend")))));
+    if(rawMBps >= 0)
+    {
+        report[QStringLiteral("rawMBps")] = double(rawMBps);
+        report[QStringLiteral("rawBackend")] = rawBackend;
+    }
+    const int segments = int(stats.value(QStringLiteral("segments"), -1));
+    if(segments >= 0)
+        report[QStringLiteral("segments")] = segments;
+    const int preTriggerFrames = int(stats.value(QStringLiteral("preTriggerFrames"), -1));
+    if(preTriggerFrames >= 0)
+    {
+        report[QStringLiteral("preTriggerFrames")] = preTriggerFrames;
+        report[QStringLiteral("preTriggerMB")] = double(stats.value(QStringLiteral("preTriggerMB")));
+        report[QStringLiteral("triggered")] = stats.value(QStringLiteral("triggered")) > 0;
+    }
+
+    const int jpegQuality = int(stats.value(QStringLiteral("jpegQuality"), -1));
+    QJsonArray qualityChanges;
+    if(jpegQuality >= 0)
+    {
+        report[QStringLiteral("jpegQuality")] = jpegQuality;
+        report[QStringLiteral("jpegMBps")] = double(stats.value(QStringLiteral("jpegMBps")));
+
+        const QVector<JpegQualityController::Adjustment> history = mProcessorPtr->qualityHistory();
+        for(const JpegQualityController::Adjustment& adjustment : history)
+        {
+            QJsonObject obj;
+            obj[QStringLiteral("seconds")] = double(adjustment.timestamp - mMeasureStart) / 1000000000.;
+            obj[QStringLiteral("quality")] = int(adjustment.quality);
+            obj[QStringLiteral("load")] = adjustment.load;
+            obj[QStringLiteral("MBps")] = adjustment.bandwidth / 1048576.;
+            qualityChanges.append(obj);
+        }
+        report[QStringLiteral("qualityChanges")] = qualityChanges;
+    }
+
+    QJsonObject stages;
+    for(const QString& stage : RawProcessor::pipelineStages())
+    {
+        QJsonObject obj;
+        obj[QStringLiteral("occupancy")] = double(stats.value(QStringLiteral("pipelineOccupancy_%1").arg(stage)));
+        obj[QStringLiteral("timeMs")] = double(stats.value(QStringLiteral("pipelineTime_%1").arg(stage)));
+        obj[QStringLiteral("queue")] = double(stats.value(QStringLiteral("pipelineQueue_%1").arg(stage)));
+        stages[stage] = obj;
+    }
+    report[QStringLiteral("stages")] = stages;
+
+    QJsonObject metrics;
+    for(int i = 0; i < Metrics::mtCount; i++)
+    {
+        auto metric = static_cast<Metrics::Metric>(i);
+        const Metrics::Snapshot s = Metrics::snapshot(metric);
+        if(s.count == 0)
+            continue;
+        QJsonObject obj;
+        obj[QStringLiteral("count")] = double(s.count);
+        obj[QStringLiteral("mean")] = s.mean;
+        obj[QStringLiteral("p50")] = s.p50;
+        obj[QStringLiteral("p95")] = s.p95;
+        obj[QStringLiteral("p99")] = s.p99;
+        obj[QStringLiteral("max")] = s.max;
+        metrics[Metrics::name(metric)] = obj;
+    }
+    report[QStringLiteral("metricsMs")] = metrics;
+
+    QTextStream out(stdout);
+    if(mSettings.json)
+    {
+        out << QJsonDocument(report).toJson(QJsonDocument::Compact) << endl;
+        return;
+    }
+
+    out << QStringLiteral("Backend: %1, %2x%3\n").arg(backend).arg(mOptions.Width).arg(mOptions.Height);
+    out << QStringLiteral("Frames: %1 in %2 s, %3 fps, %4 MPix/s\n").
+           arg(mMeasuredFrames).
+           arg(seconds, 0, 'f', 2).
+           arg(fps, 0, 'f', 1).
+           arg(mpix, 0, 'f', 1);
+    out << QStringLiteral("Latency: p50 %1 ms, p90 %2 ms, p99 %3 ms, max %4 ms\n").
+           arg(latency[QStringLiteral("p50")].toDouble(), 0, 'f', 2).
+           arg(latency[QStringLiteral("p90")].toDouble(), 0, 'f', 2).
+           arg(latency[QStringLiteral("p99")].toDouble(), 0, 'f', 2).
+           arg(latency[QStringLiteral("max")].toDouble(), 0, 'f', 2);
+    out << QStringLiteral("Capture: %1 frames, %2 dropped\n").
+           arg(qint64(stats.value(QStringLiteral("captureFrames")))).
+           arg(qint64(stats.value(QStringLiteral("captureDropped"))));
+    if(stats.value(QStringLiteral("procFrames"), -1) >= 0)
+    {
+        out << QStringLiteral("Writer: %1 frames, %2 dropped\n").
+               arg(qint64(stats.value(QStringLiteral("procFrames")))).
+               arg(qint64(stats.value(QStringLiteral("droppedFrames"))));
+    }
+    if(!writerError.isEmpty())
+        out << QStringLiteral("Writer failed: %1\n").arg(writerError);
+    if(rawMBps >= 0)
+        out << QStringLiteral("Raw writer: %1 MB/s, %2\n").arg(double(rawMBps), 0, 'f', 1).arg(rawBackend);
+    if(segments > 1)
+        out << QStringLiteral("Segments: %1\n").arg(segments);
+    if(jpegQuality >= 0)
+    {
+        out << QStringLiteral("JPEG quality: %1, %2 changes, %3 MB/s\n").
+               arg(jpegQuality).
+               arg(int(stats.value(QStringLiteral("jpegQualityChanges")))).
+               arg(double(stats.value(QStringLiteral("jpegMBps"))), 0, 'f', 1);
+    }
+    if(preTriggerFrames >= 0)
+        out << QStringLiteral("Pre-trigger: %1 frames, %2 MB in ring%3\n").arg(preTriggerFrames).
+               arg(double(stats.value(QStringLiteral("preTriggerMB"))), 0, 'f', 1).
+               arg(stats.value(QStringLiteral("triggered")) > 0 ? QStringLiteral(", recording") : QString());
+    for(const QJsonValue& value : volumes)
+    {
+        const QJsonObject obj = value.toObject();
+        out << QStringLiteral("Volume %1: %2 frames, %3 MB/s, queue %4 (max %5)\n").
+               arg(obj[QStringLiteral("path")].toString()).
+               arg(qint64(obj[QStringLiteral("frames")].toDouble())).
+               arg(obj[QStringLiteral("MBps")].toDouble(), 0, 'f', 1).
+               arg(obj[QStringLiteral("queue")].toInt()).
+               arg(obj[QStringLiteral("queueMax")].toInt());
+    }
+    for(const QString& stage : RawProcessor::pipelineStages())
+    {
+        const QJsonObject obj = stages[stage].toObject();
+        out << QStringLiteral("Stage %1: %2 ms, busy %3%, queue %4\n").
+               arg(stage).
+               arg(obj[QStringLiteral("timeMs")].toDouble(), 0, 'f', 2).
+               arg(obj[QStringLiteral("occupancy")].toDouble(), 0, 'f', 0).
+               arg(obj[QStringLiteral("queue")].toDouble(), 0, 'f', 1);
+    }
+    for(auto it = metrics.constBegin(); it != metrics.constEnd(); ++it)
+    {
+        const QJsonObject obj = it.value().toObject();
+        out << QStringLiteral("%1: p50 %2 ms, p95 %3 ms, p99 %4 ms, max %5 ms\n").
+               arg(it.key()).
+               arg(obj[QStringLiteral("p50")].toDouble(), 0, 'f', 2).
+               arg(obj[QStringLiteral("p95")].toDouble(), 0, 'f', 2).
+               arg(obj[QStringLiteral("p99")].toDouble(), 0, 'f', 2).
+               arg(obj[QStringLiteral("max")].toDouble(), 0, 'f', 2);
+    }
+    out.flush();
+}
+
+bool HeadlessRunner::ringStress(int frames, bool json)
+{
+    struct
+    {
+        CircularBuffer::FramePolicy policy;
+        int param;
+        bool switching;
+        const char* name;
+    } runs[] = {
+        {CircularBuffer::fpLatest, 0, false, "latest"},
+        {CircularBuffer::fpBlock, 20, false, "block"},
+        {CircularBuffer::fpDropOldest, 2, false, "dropOldest"},
+        {CircularBuffer::fpDropOldest, 0, false, "dropOldestDepth"},
+        {CircularBuffer::fpDropOldest, 3, false, "dropOldestFull"},
+        {CircularBuffer::fpLatest, 0, true, "switching"}
+    };
+
+    QJsonObject report;
+    QTextStream out(stdout);
+    bool passed = true;
+
+    for(const auto& run : runs)
+    {
+        //Small frames, so producer and consumer meet on the same slots often
+        CircularBuffer ring;
+        ring.setBackend(mbHost);
+        ring.setDepth(4);
+        ring.setPolicy(run.policy, run.param);
+        if(!ring.allocate(256, 64, FAST_I16))
+        {
+            out << QStringLiteral("Ring allocation failed\n");
+            return false;
+        }
+        const size_t bytes = size_t(ring.pitch()) * size_t(ring.height());
+
+        std::atomic<bool> done {false};
+        std::atomic<quint64> lastConsumed {0};
+        //Newest frame the producer is done with, committed or dropped
+        std::atomic<quint64> newest {0};
+        quint64 consumed = 0;
+        quint64 torn = 0;
+        quint64 unordered = 0;
+        quint64 stale = 0;
+
+        //Every byte of a frame is derived from its sequence number
+        auto pattern = [](quint64 seq){return static_cast<unsigned char>(seq * 31 + 7);};
+        auto intact = [&](const unsigned char* data, unsigned char value)
+        {
+            for(size_t i = 0; i < bytes; i++)
+            {
+                if(data[i] != value)
+                    return false;
+            }
+            return true;
+        };
+
+        std::thread consumer([&]()
+        {
+            quint64 lastSeq = 0;
+            for(;;)
+            {
+                const quint64 before = newest.load();
+                FrameMetadata meta;
+                ImageT* img = ring.consume(&meta);
+                if(img == nullptr)
+                {
+                    if(done.load() && ring.count() == 0)
+                        break;
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                const unsigned char value = pattern(meta.seq);
+                bool ok = intact(img->data.get(), value);
+
+                //Slow consumer holds the slot while producer runs ahead
+                if((consumed & 7) == 7)
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                ok = ok && intact(img->data.get(), value);
+
+                if(!ok)
+                    torn++;
+                if(meta.seq <= lastSeq)
+                    unordered++;
+                //Latest frame may only be one behind, the newest one can be being written over
+                if(!run.switching && run.policy == CircularBuffer::fpLatest && meta.seq + 1 < before)
+                    stale++;
+                lastSeq = meta.seq;
+                lastConsumed = lastSeq;
+                consumed++;
+                ring.release();
+            }
+        });
+
+        std::thread producer([&]()
+        {
+            for(int i = 1; i <= frames; i++)
+            {
+                unsigned char* dst = ring.acquire();
+                if(dst != nullptr)
+                {
+                    memset(dst, pattern(quint64(i)), bytes);
+                    FrameMetadata meta;
+                    meta.seq = quint64(i);
+                    ring.commit(meta);
+                }
+                newest = quint64(i);
+            }
+            done = true;
+        });
+
+        //Policy changes while the producer may be blocked
+        int step = 0;
+        while(run.switching && !done.load())
+        {
+            const auto policy = CircularBuffer::FramePolicy(step++ % CircularBuffer::fpCount);
+            ring.setPolicy(policy, policy == CircularBuffer::fpBlock ? 20 : 2);
+            std::this_thread::sleep_for(std::chrono::microseconds(300));
+        }
+
+        producer.join();
+        consumer.join();
+
+        //Frames refused by acquire() are counted as dropped without being committed
+        const quint64 dropped = ring.dropped();
+        const quint64 refused = quint64(frames) - ring.written();
+        const bool balanced = ring.written() == consumed + dropped - refused;
+        //Drop oldest policy never drops the incoming frame, the last one is always delivered
+        const bool keepsNewest = run.switching || run.policy != CircularBuffer::fpDropOldest ||
+                                 (refused == 0 && lastConsumed.load() == quint64(frames));
+        const bool ok = torn == 0 && unordered == 0 && stale == 0 && balanced && keepsNewest;
+        passed = passed && ok;
+
+        QJsonObject obj;
+        obj[QStringLiteral("consumed")] = qint64(consumed);
+        obj[QStringLiteral("dropped")] = qint64(dropped);
+        obj[QStringLiteral("committed")] = qint64(ring.written());
+        obj[QStringLiteral("torn")] = qint64(torn);
+        obj[QStringLiteral("unordered")] = qint64(unordered);
+        obj[QStringLiteral("stale")] = qint64(stale);
+        obj[QStringLiteral("refused")] = qint64(refused);
+        obj[QStringLiteral("ok")] = ok;
+        report[QLatin1String(run.name)] = obj;
+
+        if(!json)
+        {
+            out << QStringLiteral("Ring %1: %2 consumed, %3 dropped, %4 committed, %5 torn, %6 out of order, %7 stale, %8 refused, %9\n").
+                   arg(QLatin1String(run.name)).
+                   arg(consumed).arg(dropped).arg(ring.written()).
+                   arg(torn).arg(unordered).arg(stale).arg(refused).
+                   arg(ok ? QStringLiteral("ok") : QStringLiteral("FAILED"));
+        }
+    }
+
+    report[QStringLiteral("ok")] = passed;
+    if(json)
+        out << QJsonDocument(report).toJson(QJsonDocument::Compact) << endl;
+    out.flush();
+    return passed;
+}
+
+void HeadlessRunner::unpackBenchmark(const QSize& frameSize, int iterations, bool json)
+{
+    struct
+    {
+        CPUKernels::PackedLayout layout;
+        const char* name;
+    } layouts[] = {
+        {CPUKernels::plXimea12, "Ximea12"},
+        {CPUKernels::plMono12Packed, "Mono12Packed"},
+        {CPUKernels::plGenICam12p, "GenICam12p"},
+        {CPUKernels::plGenICam10p, "GenICam10p"}
+    };
+
+    const int w = frameSize.width();
+    const int h = frameSize.height();
+    const CPUKernels::SimdLevel detected = CPUKernels::detectedLevel();
+    const CPUKernels::SimdLevel levels[] = {detected, CPUKernels::slScalar};
+
+    std::vector<unsigned short> dst(size_t(w) * h);
+    QJsonObject report;
+    QTextStream out(stdout);
+
+    for(const auto& l : layouts)
+    {
+        const int rowBytes = CPUKernels::packedBytes(l.layout, w);
+        std::vector<unsigned char> src(size_t(rowBytes) * h);
+        unsigned seed = 12345;
+        for(auto& byte : src)
+        {
+            seed = seed * 1103515245u + 12345u;
+            byte = static_cast<unsigned char>(seed >> 16);
+        }
+
+        QJsonObject layoutReport;
+        for(CPUKernels::SimdLevel level : levels)
+        {
+            CPUKernels::setSimdLevel(level);
+
+            QElapsedTimer timer;
+            timer.start();
+            for(int i = 0; i < iterations; i++)
+            {
+                for(int y = 0; y < h; y++)
+                    CPUKernels::unpack(l.layout, src.data() + size_t(y) * rowBytes, dst.data() + size_t(y) * w, w);
+            }
+            const double seconds = double(timer.nsecsElapsed()) / 1000000000.;
+            const double gbps = double(src.size()) * iterations / seconds / 1000000000.;
+            const double mpix = double(w) * h * iterations / seconds / 1000000.;
+
+            QJsonObject obj;
+            obj[QStringLiteral("GBps")] = gbps;
+            obj[QStringLiteral("MPixps")] = mpix;
+            layoutReport[QLatin1String(CPUKernels::simdName(level))] = obj;
+
+            if(!json)
+            {
+                out << QStringLiteral("Unpack %1 %2: %3 GB/s, %4 MPix/s\n").
+                       arg(QLatin1String(l.name)).
+                       arg(QLatin1String(CPUKernels::simdName(level))).
+                       arg(gbps, 0, 'f', 2).
+                       arg(mpix, 0, 'f', 0);
+            }
+        }
+        report[QLatin1String(l.name)] = layoutReport;
+    }
+
+    //Big endian conversion of 16 bit PGM recording, per frame
+    {
+        std::vector<unsigned short> src(size_t(w) * h);
+        for(size_t i = 0; i < src.size(); i++)
+            src[i] = static_cast<unsigned short>(i * 2654435761u >> 16);
+
+        QJsonObject swapReport;
+        for(CPUKernels::SimdLevel level : levels)
+        {
+            CPUKernels::setSimdLevel(level);
+
+            QElapsedTimer timer;
+            timer.start();
+            for(int i = 0; i < iterations; i++)
+                CPUKernels::byteSwap16(src.data(), dst.data(), w * h);
+            const double seconds = double(timer.nsecsElapsed()) / 1000000000.;
+            const double gbps = double(src.size()) * 2 * iterations / seconds / 1000000000.;
+            const double ms = seconds * 1000. / iterations;
+
+            QJsonObject obj;
+            obj[QStringLiteral("GBps")] = gbps;
+            obj[QStringLiteral("msPerFrame")] = ms;
+            swapReport[QLatin1String(CPUKernels::simdName(level))] = obj;
+
+            if(!json)
+            {
+                out << QStringLiteral("ByteSwap16 %1: %2 GB/s, %3 ms per frame\n").
+                       arg(QLatin1String(CPUKernels::simdName(level))).
+                       arg(gbps, 0, 'f', 2).
+                       arg(ms, 0, 'f', 2);
+            }
+        }
+        report[QStringLiteral("ByteSwap16")] = swapReport;
+    }
+    CPUKernels::setSimdLevel(detected);
+
+    if(json)
+        out << QJsonDocument(report).toJson(QJsonDocument::Compact) << endl;
+    out.flush();
+}
+
+void HeadlessRunner::muxBenchmark(int frames, bool json)
+{
+    const int width = 640;
+    const int height = 480;
+    const int fps = 1000;
+    const unsigned frameSize = 16 * 1024;
+
+    //Muxers do not look into JPEG data, markers are enough
+    std::vector<unsigned char> frame(frameSize);
+    unsigned seed = 12345;
+    for(auto& byte : frame)
+    {
+        seed = seed * 1103515245u + 12345u;
+        byte = static_cast<unsigned char>(seed >> 16);
+    }
+    frame[0] = 0xFF;
+    frame[1] = 0xD8;
+    frame[frameSize - 2] = 0xFF;
+    frame[frameSize - 1] = 0xD9;
+
+    const QString fileName = QDir::temp().filePath(QStringLiteral("mux_bench.avi"));
+    QJsonObject report;
+    QTextStream out(stdout);
+
+    auto measure = [&](const char* name, const std::function<bool(const FrameMetadata&)>& add, const std::function<void()>& close)
+    {
+        FrameMetadata meta;
+        const qint64 start = FrameMetadata::now();
+        QElapsedTimer timer;
+        timer.start();
+        int written = 0;
+        for(int i = 0; i < frames; i++)
+        {
+            meta.hostTimestamp = start + qint64(i) * 1000000000 / fps;
+            if(add(meta))
+                written++;
+        }
+        close();
+        const double seconds = double(timer.nsecsElapsed()) / 1000000000.;
+        const qint64 fileSize = QFileInfo(fileName).size();
+        QFile::remove(fileName);
+
+        QJsonObject obj;
+        obj[QStringLiteral("frames")] = written;
+        obj[QStringLiteral("fps")] = written / seconds;
+        obj[QStringLiteral("usPerFrame")] = seconds * 1000000. / qMax(written, 1);
+        obj[QStringLiteral("fileSize")] = double(fileSize);
+        report[QLatin1String(name)] = obj;
+
+        if(!json)
+        {
+            out << QStringLiteral("Mux %1: %2 frames, %3 fps, %4 us/frame\n").
+                   arg(QLatin1String(name)).
+                   arg(written).
+                   arg(written / seconds, 0, 'f', 0).
+                   arg(seconds * 1000000. / qMax(written, 1), 0, 'f', 2);
+        }
+    };
+
+    {
+        AviMuxer muxer;
+        muxer.open(fileName, width, height, fps);
+        measure("AviMuxer",
+                [&](const FrameMetadata& meta){return muxer.addFrame(frame.data(), frameSize, &meta);},
+                [&](){muxer.close();});
+    }
+    {
+        MJPEGEncoder encoder(width, height, fps, JPEG_420, fileName);
+        measure("MJPEGEncoder",
+                [&](const FrameMetadata& meta){return encoder.addJPEGFrame(frame.data(), int(frameSize), &meta);},
+                [&](){encoder.close();});
+    }
+
+    if(json)
+        out << QJsonDocument(report).toJson(QJsonDocument::Compact) << endl;
+    out.flush();
+}
+
+#ifndef HOST_ONLY
+void HeadlessRunner::jfifBenchmark(int frames, bool json)
+{
+    //Small frames at high frame rate, where header writing is a noticeable share
+    const unsigned width = 640;
+    const unsigned height = 480;
+    const unsigned bytestreamSize = 16 * 1024;
+
+    fastJfifInfo_t jfifInfo;
+    memset(&jfifInfo, 0, sizeof(jfifInfo));
+    jfifInfo.width = width;
+    jfifInfo.height = height;
+    jfifInfo.bitsPerChannel = 8;
+    jfifInfo.jpegFmt = JPEG_420;
+    jfifInfo.restartInterval = 16;
+
+    //Tables are not decoded, any content of the right shape is fine
+    for(auto& table : jfifInfo.quantState.table)
+    {
+        for(unsigned i = 0; i < DCT_SIZE * DCT_SIZE; i++)
+            table.data[i] = static_cast<unsigned short>(1 + i);
+    }
+    for(auto& tables : jfifInfo.huffmanState.table)
+    {
+        for(auto& table : tables)
+        {
+            table.bucket[0] = 0;
+            for(unsigned i = 1; i < MAX_CODE_LEN; i++)
+                table.bucket[i] = i < 10 ? 1 : 0;
+            for(int i = 0; i < 9; i++)
+                table.alphabet[i] = static_cast<unsigned char>(i);
+        }
+    }
+    jfifInfo.scanMap.scanChannelMask = 0x020100;
+    jfifInfo.scanMap.quantTableMask = 0x010100;
+    jfifInfo.scanMap.huffmanTableMask[0] = 0x010100;
+    jfifInfo.scanMap.huffmanTableMask[1] = 0x010100;
+
+    std::vector<unsigned char> bytestream(bytestreamSize, 0x55);
+    jfifInfo.h_Bytestream = bytestream.data();
+    jfifInfo.bytestreamSize = bytestreamSize;
+
+    std::vector<unsigned char> output(bytestreamSize + 64 * 1024);
+    QJsonObject report;
+    QTextStream out(stdout);
+
+    //Restart interval switching every frame makes header template to be built
+    //for every frame, that is what fastJfifStoreToMemory did before templates
+    auto measure = [&](const char* name, bool rebuild)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for(int i = 0; i < frames; i++)
+        {
+            if(rebuild)
+                jfifInfo.restartInterval = (i & 1) ? 16 : 32;
+            unsigned size = unsigned(output.size());
+            fastJfifStoreToMemory(output.data(), &size, &jfifInfo);
+        }
+        const double us = double(timer.nsecsElapsed()) / 1000. / frames;
+
+        QJsonObject obj;
+        obj[QStringLiteral("usPerFrame")] = us;
+        report[QLatin1String(name)] = obj;
+
+        if(!json)
+        {
+            out << QStringLiteral("JFIF %1x%2 %3: %4 us/frame\n").
+                   arg(width).arg(height).
+                   arg(QLatin1String(name)).
+                   arg(us, 0, 'f', 3);
+        }
+        return us;
+    };
+
+    const double rebuilt = measure("rebuilt", true);
+    jfifInfo.restartInterval = 16;
+    const double cached = measure("cached", false);
+    report[QStringLiteral("savedUsPerFrame")] = rebuilt - cached;
+
+    if(json)
+        out << QJsonDocument(report).toJson(QJsonDocument::Compact) << endl;
+    else
+        out << QStringLiteral("JFIF header template saves %1 us/frame\n").arg(rebuilt - cached, 0, 'f', 3);
+    out.flush();
+}
+
+void HeadlessRunner::jfifParseBenchmark(int frames, bool json)
+{
+    const int width = 1920;
+    const int height = 1080;
+
+    std::vector<unsigned char> rgb(size_t(width) * height * 3);
+    unsigned seed = 12345;
+    for(int y = 0; y < height; y++)
+    {
+        unsigned char* row = rgb.data() + size_t(y) * width * 3;
+        for(int x = 0; x < width; x++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            const int noise = int((seed >> 16) & 15) - 8;
+            row[x * 3 + 0] = static_cast<unsigned char>(qBound(0, x * 255 / width + noise, 255));
+            row[x * 3 + 1] = static_cast<unsigned char>(qBound(0, y * 255 / height + noise, 255));
+            row[x * 3 + 2] = static_cast<unsigned char>(qBound(0, ((x ^ y) & 63) * 4 + noise, 255));
+        }
+    }
+
+    //Parallel encoder output has DRI and a restart marker every few MCU rows
+    Buffer frame;
+    jpeg_parallel_encoder encoder(4);
+    encoder.encode(rgb.data(), width, height, 3, frame, 90);
+    const unsigned char* data = frame.buffer.data();
+    const unsigned size = unsigned(frame.size);
+
+    QJsonObject report;
+    QTextStream out(stdout);
+
+    fastJfifInfo_t jfifInfo;
+    jfif_view view;
+
+    auto measure = [&](const char* name, const std::function<bool()>& parse)
+    {
+        bool ok = parse();
+        QElapsedTimer timer;
+        timer.start();
+        for(int i = 0; i < frames; i++)
+            ok = parse() && ok;
+        const double us = double(timer.nsecsElapsed()) / 1000. / frames;
+
+        QJsonObject obj;
+        obj[QStringLiteral("usPerFrame")] = us;
+        obj[QStringLiteral("ok")] = ok;
+        report[QLatin1String(name)] = obj;
+
+        if(!json)
+        {
+            out << QStringLiteral("JFIF parse %1x%2 %3: %4 us/frame%5\n").
+                   arg(width).arg(height).
+                   arg(QLatin1String(name)).
+                   arg(us, 0, 'f', 3).
+                   arg(ok ? QString() : QStringLiteral(", FAILED"));
+        }
+        return us;
+    };
+
+    const double stream = measure("istream", [&]()
+    {
+        memset(&jfifInfo, 0, sizeof(jfifInfo));
+        const bool ok = fastJfifHeaderLoadFromMemory(data, size, &jfifInfo) == FAST_OK;
+        for(unsigned i = 0; i < jfifInfo.exifSectionsCount; i++)
+            free(jfifInfo.exifSections[i].exifData);
+        free(jfifInfo.exifSections);
+        return ok;
+    });
+    const double header = measure("viewHeader", [&]()
+    {
+        return jfif_parse(data, size, view, false) == JFIF_OK;
+    });
+    const double markers = measure("viewMarkers", [&]()
+    {
+        return jfif_parse(data, size, view) == JFIF_OK;
+    });
+
+    //Both parsers have to agree on the frame
+    const bool match = view.width == int(jfifInfo.width) &&
+            view.height == int(jfifInfo.height) &&
+            view.headerSize == jfifInfo.headerSize &&
+            view.restartInterval == int(jfifInfo.restartInterval) &&
+            int(view.restartMarkers.size()) + 1 == view.intervals() &&
+            view.eoi + 2 == size;
+    const int restartMarkers = int(view.restartMarkers.size());
+    report[QStringLiteral("restartMarkers")] = restartMarkers;
+    report[QStringLiteral("match")] = match;
+
+    //Truncated and corrupted frames, headers are hit more often than entropy
+    //coded data as most of the checks are there
+    int statuses[JFIF_UNSUPPORTED + 1] = {};
+    int escaped = 0;
+    std::vector<uint8_t> corrupted;
+    const unsigned headerBytes = unsigned(view.headerSize);
+    for(int i = 0; i < frames; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        unsigned length = size;
+        corrupted.assign(data, data + size);
+        if((seed >> 8) % 4 == 0)
+        {
+            length = (seed >> 12) % size;
+        }
+        else
+        {
+            const int count = 1 + int(seed >> 24) % 8;
+            for(int j = 0; j < count; j++)
+            {
+                seed = seed * 1103515245u + 12345u;
+                const unsigned pos = (seed >> 4) % ((seed & 1) ? headerBytes : size);
+                corrupted[pos] = ((seed >> 28) & 1) ? 0xFF : uint8_t(seed >> 16);
+            }
+        }
+        corrupted.resize(length);
+
+        const jfif_status status = jfif_parse(corrupted.data(), corrupted.size(), view, (i & 1) == 0);
+        statuses[status]++;
+
+        //Views of a parsed frame are inside of the input
+        const uint8_t* begin = corrupted.data();
+        const uint8_t* end = begin + corrupted.size();
+        auto inside = [&](const uint8_t* p, size_t n){return p == nullptr || (p >= begin && n <= size_t(end - p));};
+        bool ok = view.headerSize + view.scanSize <= corrupted.size();
+        for(const auto* list : {&view.app, &view.dqt, &view.dht})
+            for(const jfif_segment& seg : *list)
+                ok = ok && inside(seg.data, seg.size);
+        for(const jfif_table& table : view.quant)
+            ok = ok && inside(table.data, table.size);
+        for(const auto& tables : view.huffman)
+            for(const jfif_table& table : tables)
+                ok = ok && inside(table.data, table.size);
+        for(size_t marker : view.restartMarkers)
+            ok = ok && marker + 2 <= corrupted.size();
+        if(!ok)
+            escaped++;
+    }
+
+    QJsonObject fuzz;
+    for(int s = JFIF_OK; s <= JFIF_UNSUPPORTED; s++)
+        fuzz[QLatin1String(jfif_status_name(jfif_status(s)))] = statuses[s];
+    fuzz[QStringLiteral("escaped")] = escaped;
+    report[QStringLiteral("fuzz")] = fuzz;
+    report[QStringLiteral("speedup")] = stream / header;
+
+    if(json)
+    {
+        out << QJsonDocument(report).toJson(QJsonDocument::Compact) << endl;
+    }
+    else
+    {
+        out << QStringLiteral("jfif_parse headers %1x faster than istream, with %2 restart markers %3x, results %4\n").
+               arg(stream / header, 0, 'f', 1).
+               arg(restartMarkers).
+               arg(stream / markers, 0, 'f', 1).
+               arg(match ? QStringLiteral("match") : QStringLiteral("DIFFER"));
+        out << QStringLiteral("Corrupted frames: %1 ok, %2 truncated, %3 invalid, %4 unsupported, %5 views outside of input\n").
+               arg(statuses[JFIF_OK]).arg(statuses[JFIF_TRUNCATED]).
+               arg(statuses[JFIF_INVALID]).arg(statuses[JFIF_UNSUPPORTED]).
+               arg(escaped);
+    }
+    out.flush();
+}
+#endif
+
+void HeadlessRunner::jpegBenchmark(int iterations, int quality, bool json)
+{
+    const QSize sizes[] = {QSize(1920, 1080), QSize(4096, 3000)};
+
+    QJsonObject report;
+    QTextStream out(stdout);
+
+    for(const QSize& size : sizes)
+    {
+        const int w = size.width();
+        const int h = size.height();
+
+        //Gradient with sensor like noise, flat or random frames are not realistic for JPEG
+        std::vector<unsigned char> rgb(size_t(w) * h * 3);
+        unsigned seed = 12345;
+        for(int y = 0; y < h; y++)
+        {
+            unsigned char* row = rgb.data() + size_t(y) * w * 3;
+            for(int x = 0; x < w; x++)
+            {
+                seed = seed * 1103515245u + 12345u;
+                const int noise = int((seed >> 16) & 15) - 8;
+                row[x * 3 + 0] = static_cast<unsigned char>(qBound(0, x * 255 / w + noise, 255));
+                row[x * 3 + 1] = static_cast<unsigned char>(qBound(0, y * 255 / h + noise, 255));
+                row[x * 3 + 2] = static_cast<unsigned char>(qBound(0, ((x ^ y) & 63) * 4 + noise, 255));
+            }
+        }
+
+        QJsonObject sizeReport;
+        auto measure = [&](const char* name, const std::function<size_t()>& encode)
+        {
+            encode();
+            size_t bytes = 0;
+            QElapsedTimer timer;
+            timer.start();
+            for(int i = 0; i < iterations; i++)
+                bytes += encode();
+            const double seconds = double(timer.nsecsElapsed()) / 1000000000.;
+
+            QJsonObject obj;
+            obj[QStringLiteral("fps")] = iterations / seconds;
+            obj[QStringLiteral("msPerFrame")] = seconds * 1000. / iterations;
+            obj[QStringLiteral("bytesPerFrame")] = double(bytes) / iterations;
+            sizeReport[QLatin1String(name)] = obj;
+
+            if(!json)
+            {
+                out << QStringLiteral("JPEG %1x%2 %3: %4 fps, %5 ms/frame, %6 KB/frame\n").
+                       arg(w).arg(h).
+                       arg(QLatin1String(name)).
+                       arg(iterations / seconds, 0, 'f', 1).
+                       arg(seconds * 1000. / iterations, 0, 'f', 2).
+                       arg(double(bytes) / iterations / 1024., 0, 'f', 0);
+            }
+        };
+
+        std::vector<unsigned char> stream;
+        measure("perCall", [&]()
+        {
+            jpeg_encoder encoder;
+            encoder.encode(rgb.data(), w, h, 3, stream, quality);
+            return stream.size();
+        });
+
+        Buffer buffer;
+        measure("pooled", [&]()
+        {
+            jpeg_encoder_pool::lease encoder(jpeg_encoder_pool::instance());
+            encoder->encode(rgb.data(), w, h, 3, buffer, quality);
+            return buffer.size;
+        });
+
+        //Restart interval streams have to decode to the same image as the single threaded one
+        const QImage reference = QImage::fromData(buffer.buffer.data(), int(buffer.size), "JPG");
+
+        QList<int> threadCounts;
+        for(int threads = 1; threads < QThread::idealThreadCount(); threads *= 2)
+            threadCounts << threads;
+        threadCounts << QThread::idealThreadCount();
+
+        for(int threads : threadCounts)
+        {
+            jpeg_parallel_encoder encoder(threads);
+            Buffer stream;
+            const QByteArray name = QStringLiteral("parallel%1").arg(threads).toLatin1();
+            measure(name.constData(), [&]()
+            {
+                encoder.encode(rgb.data(), w, h, 3, stream, quality);
+                return stream.size;
+            });
+
+            const QImage decoded = QImage::fromData(stream.buffer.data(), int(stream.size), "JPG");
+            const bool conformant = !decoded.isNull() && decoded == reference;
+
+            QJsonObject obj = sizeReport[QLatin1String(name)].toObject();
+            obj[QStringLiteral("strips")] = encoder.strips();
+            obj[QStringLiteral("conformant")] = conformant;
+            sizeReport[QLatin1String(name)] = obj;
+
+            if(!json)
+            {
+                out << QStringLiteral("JPEG %1x%2 %3: %4 strips, %5\n").
+                       arg(w).arg(h).
+                       arg(QLatin1String(name)).
+                       arg(encoder.strips()).
+                       arg(conformant ? QStringLiteral("decodes to the same image") : QStringLiteral("DECODED IMAGE DIFFERS"));
+            }
+        }
+
+        report[QStringLiteral("%1x%2").arg(w).arg(h)] = sizeReport;
+    }
+
+    if(json)
+        out << QJsonDocument(report).toJson(QJsonDocument::Compact) << endl;
+    out.flush();
+}
@@ -0,0 +1,176 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QMutex>
+#include <QSize>
+#include <QMap>
+
+#include <vector>
+
+#include "CUDAProcessorOptions.h"
+#include "FrameMetadata.h"
+
+class CameraBase;
+class RawProcessor;
+
+/// Settings of a headless run, filled from command line
+struct RunnerSettings
+{
+    /// pgm, ximea or genicam
+    QString  camera = QStringLiteral("pgm");
+    uint32_t devID = 0;
+    /// PGM file for the simulator, synthetic Bayer frame of frameSize is used if empty
+    QString  fileName;
+    QSize    frameSize = QSize(4096, 3000);
+    int      bitsPerPixel = 12;
+    fastBayerPattern_t pattern = FAST_BAYER_RGGB;
+    bool     color = true;
+    /// Camera frame rate, 0 keeps camera default
+    float    fps = 0;
+
+    bool     cpu = false;
+    /// CPU processor stripes, 0 means one per core
+    int      threads = 0;
+
+    /// Run stops after frames processed frames, or after seconds if frames is 0
+    qint64   frames = 0;
+    double   seconds = 10;
+    /// Frames processed before measurement starts
+    qint64   warmup = 0;
+
+    CUDAProcessorOptions::VideoCodec codec = CUDAProcessorOptions::vcNone;
+    unsigned jpegQuality = 90;
+    /// JPEG quality follows writer load within bounds, see JpegQualityController
+    bool     adaptiveQuality = false;
+    unsigned qualityMin = 50;
+    unsigned qualityMax = 95;
+    /// Bandwidth adaptive quality holds, MB/s, 0 follows load only
+    double   targetMBps = 0;
+    QString  outputPath;
+    QString  rtspUrl;
+    /// Input buffer policy, -1 keeps default
+    int      policy = -1;
+    int      policyParam = 0;
+    int      writerBuffers = 32;
+    /// File writer threads, 0 is one per output folder
+    int      writerThreads = 0;
+    /// Raw container writes in flight with O_DIRECT and io_uring, 0 is buffered
+    int      ioDepth = 0;
+    /// MJPEG and raw container segment limits, 0 is no limit, maxBytes < 0 keeps default
+    qint64   segmentBytes = -1;
+    double   segmentSeconds = 0;
+    int      segmentFrames = 0;
+    /// Pre-trigger ring limits, both 0 record from start
+    double   preTrigger = 0;
+    qint64   preTriggerBytes = 0;
+    double   postTrigger = 0;
+    /// Software trigger after seconds from start, negative is none
+    double   triggerAt = -1;
+
+    bool     json = false;
+};
+
+/// Wires camera -> RawProcessor -> file writer / RTSP server without GUI
+/// and reports throughput, latency percentiles and dropped frames.
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HeadlessRunner(const RunnerSettings& settings, QObject* parent = nullptr);
+    ~HeadlessRunner();
+
+    /// Opens camera and starts processing, returns false on error
+    bool start();
+    QString errorString() const {return mError;}
+
+    /// Runs a producer and a consumer thread on a host CircularBuffer under
+    /// every policy and with policy switched while running. Checks frames
+    /// are not torn, sequence numbers grow and every frame is either
+    /// consumed or counted as dropped. Returns false if any check fails.
+    static bool ringStress(int frames, bool json);
+    /// Measures CPUKernels::unpack bandwidth for every packed layout and
+    /// CPUKernels::byteSwap16 time per frame, with detected SIMD level and scalar code
+    static void unpackBenchmark(const QSize& frameSize, int iterations, bool json);
+    /// Writes small frames at 1000 fps capture timing through AviMuxer
+    /// and libavformat based MJPEGEncoder, measures frames per second
+    static void muxBenchmark(int frames, bool json);
+    /// Encodes 1080p and 12 MP frames with libjpeg, a new encoder per frame
+    /// against a pooled one writing into a preallocated buffer, and with
+    /// jpeg_parallel_encoder from one thread to all cores. Parallel streams
+    /// are decoded and compared with the single threaded one.
+    static void jpegBenchmark(int iterations, int quality, bool json);
+#ifndef HOST_ONLY
+    /// Stores 640x480 JFIF frames with a cached header template and with
+    /// the template rebuilt for every frame, measures time per frame
+    static void jfifBenchmark(int frames, bool json);
+    /// Parses a 1080p JFIF frame with restart markers through the istream
+    /// loader and jfif_parse, checks both agree, then feeds jfif_parse with
+    /// truncated and corrupted copies and checks views stay inside the input
+    static void jfifParseBenchmark(int frames, bool json);
+#endif
+
+signals:
+    void finished();
+
+public slots:
+    void stop();
+
+private slots:
+    void startStopTimer();
+
+private:
+    RunnerSettings       mSettings;
+    CUDAProcessorOptions mOptions;
+    QTemporaryDir        mTempDir;
+    QScopedPointer<CameraBase>   mCameraPtr;
+    QScopedPointer<RawProcessor> mProcessorPtr;
+    QString              mError;
+    bool                 mRunning = false;
+
+    QMutex               mLock;
+    //Latencies of measured frames, ms
+    std::vector<double>  mLatencies;
+    qint64               mFrames = 0;
+    qint64               mMeasuredFrames = 0;
+    qint64               mMeasureStart = 0;
+    qint64               mLastFrame = 0;
+    bool                 mStopping = false;
+
+    CameraBase* createCamera();
+    bool writeTestFrame(const QString& fileName);
+    void onFrame(const FrameMetadata& meta);
+    void printReport(const QMap<QString, float>& stats);
+};
+
+#endif // HEADLESSRUNNER_H
@@ -0,0 +1,146 @@
+# Command line runner of the camera sample pipeline:
+# camera -> RawProcessor -> file writer / RTSP server, no GUI and no OpenGL.
+# Runs for a number of frames or seconds and prints throughput, latency and drops.
+QT += core gui network
+QT -= widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../common_defs.pri)
+include(../common_funcs.pri)
+win32: include(../common.pri)
+unix:  include(../common_unix.pri)
+
+DEFINES += HEADLESS
+
+# qmake CONFIG+=host_only builds CPU processing only, without CUDA and Fastvideo SDK
+host_only {
+    DEFINES += HOST_ONLY
+    include(../CameraSample/host_only/host_only.pri)
+}
+
+unix:uring {
+    DEFINES += USE_URING
+    LIBS += -luring
+}
+
+# win32 gets /openmp from common.pri
+unix {
+    QMAKE_CXXFLAGS += -fopenmp
+    LIBS += -fopenmp
+}
+
+TARGET = $${PROJECT_NAME}Headless
+TEMPLATE = app
+
+CAMERA_SAMPLE = $$PWD/../CameraSample
+
+INCLUDEPATH += $$PWD
+INCLUDEPATH += $$CAMERA_SAMPLE
+INCLUDEPATH += $$CAMERA_SAMPLE/CUDASupport
+INCLUDEPATH += $$CAMERA_SAMPLE/Camera
+INCLUDEPATH += $$CAMERA_SAMPLE/RtspServer
+
+SOURCES += main.cpp \
+    HeadlessRunner.cpp \
+    $$CAMERA_SAMPLE/Globals.cpp \
+    $$CAMERA_SAMPLE/AppSettings.cpp \
+    $$CAMERA_SAMPLE/CUDASupport/ProcessorBase.cpp \
+    $$CAMERA_SAMPLE/CUDASupport/CPUProcessor.cpp \
+    $$CAMERA_SAMPLE/CUDASupport/CPUKernels.cpp \
+    $$CAMERA_SAMPLE/FFCReader.cpp \
+    $$CAMERA_SAMPLE/FPNReader.cpp \
+    $$CAMERA_SAMPLE/ppm.cpp \
+    $$CAMERA_SAMPLE/Camera/CameraBase.cpp \
+    $$CAMERA_SAMPLE/Camera/FrameBuffer.cpp \
+    $$CAMERA_SAMPLE/Camera/PGMCamera.cpp \
+    $$CAMERA_SAMPLE/Camera/RawFileCamera.cpp \
+    $$CAMERA_SAMPLE/Camera/GeniCamCamera.cpp \
+    $$CAMERA_SAMPLE/RawProcessor.cpp \
+    $$CAMERA_SAMPLE/AsyncFileWriter.cpp \
+    $$CAMERA_SAMPLE/PreTriggerBuffer.cpp \
+    $$CAMERA_SAMPLE/SegmentRotation.cpp \
+    $$CAMERA_SAMPLE/JpegQualityController.cpp \
+    $$CAMERA_SAMPLE/Metrics.cpp \
+    $$CAMERA_SAMPLE/MJPEGEncoder.cpp \
+    $$CAMERA_SAMPLE/AviMuxer.cpp \
+    $$CAMERA_SAMPLE/RawContainer.cpp \
+    $$CAMERA_SAMPLE/DirectFileWriter.cpp \
+    $$CAMERA_SAMPLE/RtspServer/CTPTransport.cpp \
+    $$CAMERA_SAMPLE/RtspServer/JpegEncoder.cpp \
+    $$CAMERA_SAMPLE/RtspServer/JfifParser.cpp \
+    $$CAMERA_SAMPLE/RtspServer/JpegParallelEncoder.cpp \
+    $$CAMERA_SAMPLE/RtspServer/RTSPStreamerServer.cpp \
+    $$CAMERA_SAMPLE/RtspServer/TcpClient.cpp \
+    $$CAMERA_SAMPLE/RtspServer/vutils.cpp
+
+contains( DEFINES, SUPPORT_GENICAM ){
+    SOURCES += $$CAMERA_SAMPLE/rc_genicam_api/buffer.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/config.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/cport.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/device.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/exception.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/image.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/imagelist.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/interface.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/pointcloud.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/stream.cc \
+    $$CAMERA_SAMPLE/rc_genicam_api/system.cc
+    unix:  SOURCES += $$CAMERA_SAMPLE/rc_genicam_api/gentl_wrapper_linux.cc
+    win32: SOURCES += $$CAMERA_SAMPLE/rc_genicam_api/gentl_wrapper_win32.cc
+}
+contains( DEFINES, SUPPORT_XIMEA ){
+   SOURCES += $$CAMERA_SAMPLE/Camera/XimeaCamera.cpp
+}
+
+!host_only {
+    INCLUDEPATH += $$OTHER_LIB_PATH/FastvideoSDK/core_samples
+
+    SOURCES += $$CAMERA_SAMPLE/CUDASupport/CUDAProcessorBase.cpp \
+        $$CAMERA_SAMPLE/CUDASupport/CUDAProcessorGray.cpp \
+        $$CAMERA_SAMPLE/helper_jpeg_load.cpp \
+        $$CAMERA_SAMPLE/helper_jpeg_store.cpp \
+        $$OTHER_LIB_PATH/FastvideoSDK/common/SurfaceTraits.cpp \
+        $$OTHER_LIB_PATH/FastvideoSDK/common/alignment.cpp
+
+    win32: SOURCES += $$OTHER_LIB_PATH/FastvideoSDK/core_samples/SurfaceTraitsInternal.cpp
+
+    HEADERS += $$CAMERA_SAMPLE/CUDASupport/CUDAProcessorBase.h \
+        $$CAMERA_SAMPLE/CUDASupport/CUDAProcessorGray.h
+}
+
+HEADERS += HeadlessRunner.h \
+    $$CAMERA_SAMPLE/RawProcessor.h \
+    $$CAMERA_SAMPLE/AsyncFileWriter.h \
+    $$CAMERA_SAMPLE/PreTriggerBuffer.h \
+    $$CAMERA_SAMPLE/SegmentRotation.h \
+    $$CAMERA_SAMPLE/JpegQualityController.h \
+    $$CAMERA_SAMPLE/PipelineScheduler.h \
+    $$CAMERA_SAMPLE/Metrics.h \
+    $$CAMERA_SAMPLE/Camera/CameraBase.h \
+    $$CAMERA_SAMPLE/Camera/FrameBuffer.h \
+    $$CAMERA_SAMPLE/Camera/PGMCamera.h \
+    $$CAMERA_SAMPLE/Camera/RawFileCamera.h \
+    $$CAMERA_SAMPLE/Camera/XimeaCamera.h \
+    $$CAMERA_SAMPLE/Camera/GeniCamCamera.h \
+    $$CAMERA_SAMPLE/CUDASupport/ProcessorBase.h \
+    $$CAMERA_SAMPLE/CUDASupport/CPUProcessor.h \
+    $$CAMERA_SAMPLE/CUDASupport/CPUKernels.h \
+    $$CAMERA_SAMPLE/MJPEGEncoder.h \
+    $$CAMERA_SAMPLE/AviMuxer.h \
+    $$CAMERA_SAMPLE/RawContainer.h \
+    $$CAMERA_SAMPLE/DirectFileWriter.h \
+    $$CAMERA_SAMPLE/RtspServer/RTSPStreamerServer.h \
+    $$CAMERA_SAMPLE/RtspServer/TcpClient.h
+
+unix {
+    contains(TARGET_ARCH, arm64){
+        include($$CAMERA_SAMPLE/jetson_api/jetson_api.pri)
+    }
+}
+
+win32:!host_only {
+    copyToDestdir($$FASTVIDEO_DLL)
+    copyToDestdir($$CUDA_DLL)
+}
+copyToDestdir($$FASTVIDEO_EXTRA_DLLS)
@@ -0,0 +1,268 @@
+/*
+ Copyright 2011-2019 Fastvideo, LLC.
+ All rights reserved.
+
+ This file is a part of the GPUCameraSample project
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ 3. Any third-party SDKs from that project (XIMEA SDK, Fastvideo SDK, etc.) are licensed on different terms. Please see their corresponding license terms.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QTimer>
+#include <QDir>
+
+#include "HeadlessRunner.h"
+#include "CPUKernels.h"
+#include "FrameBuffer.h"
+#include "version.h"
+
+namespace
+{
+bool parseSize(const QString& str, QSize& size)
+{
+    const QStringList parts = str.toLower().split(QLatin1Char('x'));
+    if(parts.size() != 2)
+        return false;
+    bool okW = false;
+    bool okH = false;
+    size = QSize(parts[0].toInt(&okW), parts[1].toInt(&okH));
+    return okW && okH && size.width() > 0 && size.height() > 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication::setOrganizationName(QStringLiteral(APP_ORGANIZATION_NAME));
+    QCoreApplication::setOrganizationDomain(QStringLiteral(APP_ORGANIZATION_DOMAIN));
+    QCoreApplication::setApplicationName(QStringLiteral(MAIN_APPLICATION_NAME));
+    QCoreApplication::setApplicationVersion(QStringLiteral(APP_VERSION_STRING));
+    QCoreApplication::addLibraryPath(QStringLiteral("."));
+    QCoreApplication::addLibraryPath(QCoreApplication::applicationDirPath());
+
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Headless camera pipeline runner"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption cameraOpt(QStringLiteral("camera"), QStringLiteral("Camera: pgm, raw, ximea or genicam."), QStringLiteral("name"), QStringLiteral("pgm"));
+    QCommandLineOption deviceOpt(QStringLiteral("device"), QStringLiteral("Camera device index."), QStringLiteral("index"), QStringLiteral("0"));
+    QCommandLineOption fileOpt(QStringLiteral("file"), QStringLiteral("PGM file for the simulator, synthetic frame is used if omitted. Recording to play for raw camera."), QStringLiteral("file"));
+    QCommandLineOption sizeOpt(QStringLiteral("size"), QStringLiteral("Synthetic frame size, e.g. 2048x1080, 4096x2160, 4096x3000."), QStringLiteral("WxH"), QStringLiteral("4096x3000"));
+    QCommandLineOption bitsOpt(QStringLiteral("bits"), QStringLiteral("Synthetic frame bit depth."), QStringLiteral("bits"), QStringLiteral("12"));
+    QCommandLineOption patternOpt(QStringLiteral("pattern"), QStringLiteral("Bayer pattern: RGGB, BGGR, GBRG or GRBG."), QStringLiteral("pattern"), QStringLiteral("RGGB"));
+    QCommandLineOption grayOpt(QStringLiteral("gray"), QStringLiteral("Treat PGM frames as monochrome."));
+    QCommandLineOption fpsOpt(QStringLiteral("fps"), QStringLiteral("Camera frame rate."), QStringLiteral("fps"));
+    QCommandLineOption cpuOpt(QStringLiteral("cpu"), QStringLiteral("Process on CPU even if CUDA device is present."));
+    QCommandLineOption threadsOpt(QStringLiteral("threads"), QStringLiteral("CPU processing threads, 0 for one per core."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption simdOpt(QStringLiteral("simd"), QStringLiteral("CPU kernels: scalar, sse4.1, avx2 or neon."), QStringLiteral("level"));
+    QCommandLineOption framesOpt(QStringLiteral("frames"), QStringLiteral("Stop after number of measured frames."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption secondsOpt(QStringLiteral("seconds"), QStringLiteral("Stop after number of seconds if frames is not set."), QStringLiteral("seconds"), QStringLiteral("10"));
+    QCommandLineOption warmupOpt(QStringLiteral("warmup"), QStringLiteral("Frames skipped before measurement."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption codecOpt(QStringLiteral("codec"), QStringLiteral("Output codec: jpg, mjpg, pgm, raw or h264."), QStringLiteral("codec"));
+    QCommandLineOption qualityOpt(QStringLiteral("quality"), QStringLiteral("JPEG quality."), QStringLiteral("quality"), QStringLiteral("90"));
+    QCommandLineOption adaptiveOpt(QStringLiteral("adaptive-quality"), QStringLiteral("Lower JPEG quality instead of dropping frames when output falls behind."));
+    QCommandLineOption qualityMinOpt(QStringLiteral("quality-min"), QStringLiteral("Lowest adaptive JPEG quality."), QStringLiteral("quality"), QStringLiteral("50"));
+    QCommandLineOption qualityMaxOpt(QStringLiteral("quality-max"), QStringLiteral("Highest adaptive JPEG quality."), QStringLiteral("quality"), QStringLiteral("95"));
+    QCommandLineOption targetMBpsOpt(QStringLiteral("target-mbps"), QStringLiteral("Output bandwidth adaptive quality holds, MB/s."), QStringLiteral("MBps"), QStringLiteral("0"));
+    QCommandLineOption outputOpt(QStringLiteral("output"), QStringLiteral("Write encoded frames to folder. Several folders separated by %1 are written round robin.").arg(QDir::listSeparator()), QStringLiteral("path"));
+    QCommandLineOption rtspOpt(QStringLiteral("rtsp"), QStringLiteral("Stream to RTSP url, e.g. rtsp://0.0.0.0:1234/live.sdp."), QStringLiteral("url"));
+    QCommandLineOption policyOpt(QStringLiteral("policy"), QStringLiteral("Frame buffer policy: latest, block or dropoldest."), QStringLiteral("policy"));
+    QCommandLineOption policyParamOpt(QStringLiteral("policy-param"), QStringLiteral("Block timeout in ms or queue length."), QStringLiteral("value"), QStringLiteral("0"));
+    QCommandLineOption writerBuffersOpt(QStringLiteral("writer-buffers"), QStringLiteral("Frames the file writer can hold in flight."), QStringLiteral("count"), QStringLiteral("32"));
+    QCommandLineOption writerThreadsOpt(QStringLiteral("writer-threads"), QStringLiteral("File writer threads, at least one per output folder."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption ioDepthOpt(QStringLiteral("io-depth"), QStringLiteral("Raw codec: writes in flight with O_DIRECT and io_uring, 0 writes through page cache."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption preTriggerOpt(QStringLiteral("pre-trigger"), QStringLiteral("Keep last seconds of frames in RAM and write them on trigger."), QStringLiteral("seconds"), QStringLiteral("0"));
+    QCommandLineOption preTriggerMemOpt(QStringLiteral("pre-trigger-mb"), QStringLiteral("Memory limit of pre-trigger frames, MB."), QStringLiteral("MB"), QStringLiteral("0"));
+    QCommandLineOption postTriggerOpt(QStringLiteral("post-trigger"), QStringLiteral("Seconds recorded after trigger."), QStringLiteral("seconds"), QStringLiteral("5"));
+    QCommandLineOption triggerAtOpt(QStringLiteral("trigger-at"), QStringLiteral("Software trigger after seconds from start."), QStringLiteral("seconds"));
+    QCommandLineOption segmentMemOpt(QStringLiteral("segment-mb"), QStringLiteral("Start a new MJPEG or raw file after MB, 0 is no limit."), QStringLiteral("MB"));
+    QCommandLineOption segmentSecondsOpt(QStringLiteral("segment-seconds"), QStringLiteral("Start a new MJPEG or raw file after seconds of capture."), QStringLiteral("seconds"), QStringLiteral("0"));
+    QCommandLineOption segmentFramesOpt(QStringLiteral("segment-frames"), QStringLiteral("Start a new MJPEG or raw file after frames."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption jsonOpt(QStringLiteral("json"), QStringLiteral("Print report as JSON."));
+    QCommandLineOption ringOpt(QStringLiteral("ring-stress"), QStringLiteral("Stress the host frame ring with producer and consumer threads under every policy, exit code 1 on failure."), QStringLiteral("frames"));
+    QCommandLineOption unpackOpt(QStringLiteral("unpack-bench"), QStringLiteral("Measure packed format unpack and 16 bit byte swap bandwidth and exit."), QStringLiteral("iterations"));
+    QCommandLineOption muxOpt(QStringLiteral("mux-bench"), QStringLiteral("Measure AVI muxer speed on small frames and exit."), QStringLiteral("frames"));
+    QCommandLineOption jpegOpt(QStringLiteral("jpeg-bench"), QStringLiteral("Measure CPU JPEG encoder speed and restart interval thread scaling at 1080p and 12 MP, check parallel streams and exit."), QStringLiteral("iterations"));
+    QCommandLineOption jfifOpt(QStringLiteral("jfif-bench"), QStringLiteral("Measure JFIF header writing time per frame and exit."), QStringLiteral("frames"));
+    QCommandLineOption jfifParseOpt(QStringLiteral("jfif-parse-bench"), QStringLiteral("Compare in place JFIF parsing with the istream loader, parse corrupted frames and exit."), QStringLiteral("frames"));
+
+    parser.addOptions({cameraOpt, deviceOpt, fileOpt, sizeOpt, bitsOpt, patternOpt, grayOpt,
+                       fpsOpt, cpuOpt, threadsOpt, simdOpt, framesOpt, secondsOpt, warmupOpt,
+                       codecOpt, qualityOpt, adaptiveOpt, qualityMinOpt, qualityMaxOpt, targetMBpsOpt,
+                       outputOpt, rtspOpt, policyOpt, policyParamOpt,
+                       writerBuffersOpt, writerThreadsOpt, ioDepthOpt, preTriggerOpt, preTriggerMemOpt,
+                       postTriggerOpt, triggerAtOpt, segmentMemOpt, segmentSecondsOpt, segmentFramesOpt,
+                       jsonOpt, ringOpt, unpackOpt, muxOpt, jpegOpt});
+#ifndef HOST_ONLY
+    //JFIF benchmarks compare with Fastvideo SDK JPEG helpers
+    parser.addOptions({jfifOpt, jfifParseOpt});
+#endif
+    parser.process(a);
+
+    QTextStream err(stderr);
+
+    RunnerSettings settings;
+    if(!parseSize(parser.value(sizeOpt), settings.frameSize))
+    {
+        err << QStringLiteral("Invalid frame size %1").arg(parser.value(sizeOpt)) << endl;
+        return 1;
+    }
+
+    if(parser.isSet(simdOpt))
+    {
+        const QString name = parser.value(simdOpt).toLower();
+        CPUKernels::SimdLevel level = CPUKernels::slScalar;
+        if(name == QLatin1String("sse4.1") || name == QLatin1String("sse41"))
+            level = CPUKernels::slSSE41;
+        else if(name == QLatin1String("avx2"))
+            level = CPUKernels::slAVX2;
+        else if(name == QLatin1String("neon"))
+            level = CPUKernels::slNEON;
+        CPUKernels::setSimdLevel(level);
+    }
+
+    settings.json = parser.isSet(jsonOpt);
+
+    if(parser.isSet(ringOpt))
+    {
+        const bool ok = HeadlessRunner::ringStress(qMax(1, parser.value(ringOpt).toInt()), settings.json);
+        return ok ? 0 : 1;
+    }
+
+    if(parser.isSet(unpackOpt))
+    {
+        HeadlessRunner::unpackBenchmark(settings.frameSize, qMax(1, parser.value(unpackOpt).toInt()), settings.json);
+        return 0;
+    }
+
+    if(parser.isSet(muxOpt))
+    {
+        HeadlessRunner::muxBenchmark(qMax(1, parser.value(muxOpt).toInt()), settings.json);
+        return 0;
+    }
+
+    if(parser.isSet(jpegOpt))
+    {
+        HeadlessRunner::jpegBenchmark(qMax(1, parser.value(jpegOpt).toInt()), parser.value(qualityOpt).toInt(), settings.json);
+        return 0;
+    }
+
+#ifndef HOST_ONLY
+    if(parser.isSet(jfifOpt))
+    {
+        HeadlessRunner::jfifBenchmark(qMax(1, parser.value(jfifOpt).toInt()), settings.json);
+        return 0;
+    }
+
+    if(parser.isSet(jfifParseOpt))
+    {
+        HeadlessRunner::jfifParseBenchmark(qMax(1, parser.value(jfifParseOpt).toInt()), settings.json);
+        return 0;
+    }
+#endif
+
+    settings.camera = parser.value(cameraOpt).toLower();
+    settings.devID = parser.value(deviceOpt).toUInt();
+    settings.fileName = parser.value(fileOpt);
+    settings.bitsPerPixel = parser.value(bitsOpt).toInt();
+    settings.color = !parser.isSet(grayOpt);
+    settings.fps = parser.value(fpsOpt).toFloat();
+    settings.cpu = parser.isSet(cpuOpt);
+    settings.threads = parser.value(threadsOpt).toInt();
+    settings.frames = parser.value(framesOpt).toLongLong();
+    settings.seconds = parser.value(secondsOpt).toDouble();
+    settings.warmup = parser.value(warmupOpt).toLongLong();
+    settings.jpegQuality = parser.value(qualityOpt).toUInt();
+    settings.targetMBps = parser.value(targetMBpsOpt).toDouble();
+    settings.adaptiveQuality = parser.isSet(adaptiveOpt) || settings.targetMBps > 0;
+    settings.qualityMin = parser.value(qualityMinOpt).toUInt();
+    settings.qualityMax = parser.value(qualityMaxOpt).toUInt();
+    settings.outputPath = parser.value(outputOpt);
+    settings.rtspUrl = parser.value(rtspOpt);
+    settings.policyParam = parser.value(policyParamOpt).toInt();
+    settings.writerBuffers = parser.value(writerBuffersOpt).toInt();
+    settings.writerThreads = parser.value(writerThreadsOpt).toInt();
+    settings.ioDepth = parser.value(ioDepthOpt).toInt();
+    settings.preTrigger = parser.value(preTriggerOpt).toDouble();
+    settings.preTriggerBytes = parser.value(preTriggerMemOpt).toLongLong() * 1024 * 1024;
+    settings.postTrigger = parser.value(postTriggerOpt).toDouble();
+    if(parser.isSet(segmentMemOpt))
+        settings.segmentBytes = parser.value(segmentMemOpt).toLongLong() * 1024 * 1024;
+    settings.segmentSeconds = parser.value(segmentSecondsOpt).toDouble();
+    settings.segmentFrames = parser.value(segmentFramesOpt).toInt();
+    if(parser.isSet(triggerAtOpt))
+        settings.triggerAt = parser.value(triggerAtOpt).toDouble();
+
+    const QString pattern = parser.value(patternOpt).toUpper();
+    if(pattern == QLatin1String("BGGR"))
+        settings.pattern = FAST_BAYER_BGGR;
+    else if(pattern == QLatin1String("GBRG"))
+        settings.pattern = FAST_BAYER_GBRG;
+    else if(pattern == QLatin1String("GRBG"))
+        settings.pattern = FAST_BAYER_GRBG;
+
+    const QString codec = parser.value(codecOpt).toLower();
+    if(codec == QLatin1String("jpg") || codec == QLatin1String("jpeg"))
+        settings.codec = CUDAProcessorOptions::vcJPG;
+    else if(codec == QLatin1String("mjpg") || codec == QLatin1String("mjpeg"))
+        settings.codec = CUDAProcessorOptions::vcMJPG;
+    else if(codec == QLatin1String("pgm"))
+        settings.codec = CUDAProcessorOptions::vcPGM;
+    else if(codec == QLatin1String("raw"))
+        settings.codec = CUDAProcessorOptions::vcRAW;
+    else if(codec == QLatin1String("h264"))
+        settings.codec = CUDAProcessorOptions::vcH264;
+    else if(!codec.isEmpty())
+    {
+        err << QStringLiteral("Unknown codec %1").arg(codec) << endl;
+        return 1;
+    }
+
+    if(parser.isSet(policyOpt))
+    {
+        const QString policy = parser.value(policyOpt).toLower();
+        if(policy == QLatin1String("latest"))
+            settings.policy = CircularBuffer::fpLatest;
+        else if(policy == QLatin1String("block"))
+            settings.policy = CircularBuffer::fpBlock;
+        else if(policy == QLatin1String("dropoldest"))
+            settings.policy = CircularBuffer::fpDropOldest;
+        else
+        {
+            err << QStringLiteral("Unknown policy %1").arg(policy) << endl;
+            return 1;
+        }
+    }
+
+    HeadlessRunner runner(settings);
+    QObject::connect(&runner, &HeadlessRunner::finished, &a, &QCoreApplication::quit, Qt::QueuedConnection);
+    if(!runner.start())
+    {
+        err << runner.errorString() << endl;
+        return 1;
+    }
+
+    return QCoreApplication::exec();
+}
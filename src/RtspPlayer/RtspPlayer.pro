@@ -9,6 +9,9 @@ unix:  include(../common_unix.pri)
 TARGET = RtspPlayer
 TEMPLATE = app
 
+# In place JFIF parser shared with the camera sample
+JFIF_PARSER = $$PWD/../CameraSample/RtspServer
+
 SOURCES = main.cpp \
     $$OTHER_LIB_PATH/FastvideoSDK/common/helper_jpeg/helper_jpeg_load.cpp \
     $$OTHER_LIB_PATH/FastvideoSDK/common/helper_jpeg/helper_jpeg_store.cpp \
@@ -20,6 +23,8 @@ SOURCES = main.cpp \
     common.cpp \
     fastvideo_decoder.cpp \
     jpegenc.cpp \
+    jpeg_parallel_decoder.cpp \
+    $$JFIF_PARSER/JfifParser.cpp \
     MainWindow.cpp \
     RTSPServer.cpp \
     vdecoder.cpp
@@ -38,6 +43,8 @@ HEADERS += \
     DialogOpenServer.h \
     fastvideo_decoder.h \
     jpegenc.h \
+    jpeg_parallel_decoder.h \
+    $$JFIF_PARSER/JfifParser.h \
     MainWindow.h \
     RTSPServer.h \
     common_utils.h \
@@ -53,7 +60,8 @@ INCLUDEPATH += $$FFMPEGDIR/include \
                 $$JPEGTURBO/include \
                 $$FASTVIDEO/fastvideo_sdk/inc \
                 $$FASTVIDEO/common \
-                $$PWD/Widgets
+                $$PWD/Widgets \
+                $$JFIF_PARSER
 
 LIBS += -L$$FFMPEGDIR/bin \
         -lavformat -lavcodec -lavutil
@@ -0,0 +1,259 @@
+#include "jpeg_parallel_decoder.h"
+
+#include "jpegenc.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <iostream>
+
+#include "jpeglib.h"
+
+namespace{
+
+const uint8_t M_SOF3 = 0xC3;
+const uint8_t M_RST0 = 0xD0;
+const uint8_t M_EOI = 0xD9;
+
+struct strip_error_mgr{
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+void strip_error_exit(j_common_ptr cinfo)
+{
+    std::cout << "Error " << cinfo->err->msg_code << " " << cinfo->err->msg_parm.i[0] << std::endl;
+
+    strip_error_mgr *err = (strip_error_mgr*)cinfo->err;
+    longjmp(err->jump, 1);
+}
+
+}
+
+struct jpeg_parallel_decoder::worker{
+    jpeg_decompress_struct cinfo;
+    strip_error_mgr jerr;
+    /// strip as a separate stream: frame headers, entropy coded data, EOI
+    bytearray stream;
+
+    worker(){
+        cinfo.err = jpeg_std_error(&jerr.pub);
+        jerr.pub.error_exit = strip_error_exit;
+        jpeg_create_decompress(&cinfo);
+    }
+    ~worker(){
+        jpeg_destroy_decompress(&cinfo);
+    }
+};
+
+jpeg_parallel_decoder::jpeg_parallel_decoder(int threads)
+{
+    if(threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    for(int i = 0; i < threads; ++i)
+        m_workers.emplace_back(new worker);
+
+    //calling thread is the first worker
+    for(int i = 1; i < threads; ++i)
+        m_threads.emplace_back([this, i](){ run(i); });
+}
+
+jpeg_parallel_decoder::~jpeg_parallel_decoder()
+{
+    {
+        std::lock_guard<std::mutex> lg(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+
+    for(auto& thread: m_threads)
+        thread.join();
+}
+
+bool jpeg_parallel_decoder::split(const uint8_t *input, size_t len, int &width, int &height)
+{
+    //lossless frames are not decoded by libjpeg
+    if(jfif_parse(input, len, m_frame) != JFIF_OK || m_frame.frameType == M_SOF3)
+        return false;
+
+    const jfif_view& frame = m_frame;
+    const int restartInterval = frame.restartInterval;
+    const int intervals = frame.intervals();
+    if(restartInterval == 0 || (int)frame.restartMarkers.size() + 1 != intervals)
+        return false;
+
+    width = frame.width;
+    height = frame.height;
+    m_sof = frame.sof.offset;
+    m_sosEnd = frame.headerSize;
+
+    const int mcuCols = frame.mcuCols;
+    const int mcuRows = frame.mcuRows;
+    const int mcuHeight = frame.mcuHeight;
+
+    //positions of RST markers, the last one is EOI
+    m_markers.assign(frame.restartMarkers.begin(), frame.restartMarkers.end());
+    m_markers.push_back(frame.eoi);
+
+    //strips start with intervals that start an MCU row, about two strips per thread
+    int rowsPerStrip = (mcuRows + threads() * 2 - 1) / (threads() * 2);
+    m_stripList.clear();
+    int nextRow = 0;
+    for(int i = 0; i < intervals; ++i){
+        int mcu = i * restartInterval;
+        if(mcu % mcuCols != 0 || mcu / mcuCols < nextRow)
+            continue;
+
+        int row = mcu / mcuCols;
+        if(!m_stripList.empty()){
+            strip& last = m_stripList.back();
+            last.end = m_markers[i - 1];
+            last.height = row * mcuHeight - last.top;
+        }
+
+        strip s;
+        s.start = i == 0? m_sosEnd : m_markers[i - 1] + 2;
+        s.firstInterval = i;
+        s.top = row * mcuHeight;
+        m_stripList.push_back(s);
+        nextRow = row + rowsPerStrip;
+    }
+    strip& last = m_stripList.back();
+    last.end = m_markers.back();
+    last.height = height - last.top;
+
+    m_strips = (int)m_stripList.size();
+    return m_strips > 1;
+}
+
+void jpeg_parallel_decoder::run(int index)
+{
+    unsigned generation = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(;;){
+        m_start.wait(lock, [this, generation](){ return m_stop || m_generation != generation; });
+        if(m_stop)
+            break;
+        generation = m_generation;
+        lock.unlock();
+
+        decodeStrips(index);
+
+        lock.lock();
+        if(--m_busy == 0)
+            m_done.notify_all();
+    }
+}
+
+void jpeg_parallel_decoder::decodeStrips(int index)
+{
+    worker& w = *m_workers[index];
+    for(int i = m_nextStrip++; i < m_strips; i = m_nextStrip++){
+        if(!decodeStrip(w, m_stripList[i]))
+            m_failed = true;
+    }
+}
+
+bool jpeg_parallel_decoder::decodeStrip(worker &w, const strip &s)
+{
+    //frame headers with the strip height
+    bytearray& stream = w.stream;
+    stream.resize(m_sosEnd + (s.end - s.start) + 2);
+    std::copy(m_input, m_input + m_sosEnd, stream.data());
+    stream[m_sof + 5] = uint8_t(s.height >> 8);
+    stream[m_sof + 6] = uint8_t(s.height);
+
+    //restart markers are counted from RST0 in every stream
+    uint8_t* out = stream.data() + m_sosEnd;
+    size_t pos = s.start;
+    for(int i = s.firstInterval; m_markers[i] < s.end; ++i){
+        size_t marker = m_markers[i];
+        std::copy(m_input + pos, m_input + marker, out);
+        out += marker - pos;
+        *out++ = 0xFF;
+        *out++ = uint8_t(M_RST0 + ((i - s.firstInterval) & 7));
+        pos = marker + 2;
+    }
+    std::copy(m_input + pos, m_input + s.end, out);
+    out += s.end - pos;
+    *out++ = 0xFF;
+    *out++ = M_EOI;
+
+    jpeg_decompress_struct& cinfo = w.cinfo;
+
+    //no objects with destructors below, longjmp skips them
+    if(setjmp(w.jerr.jump)){
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_mem_src(&cinfo, stream.data(), (unsigned long)(out - stream.data()));
+    jpeg_read_header(&cinfo, TRUE);
+
+    //chroma of a strip can not be interpolated from rows of the neighbours,
+    //same as TJFLAG_FASTUPSAMPLE of the turbojpeg path
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+
+    if((int)cinfo.output_width != m_width || (int)cinfo.output_height != s.height){
+        jpeg_abort_decompress(&cinfo);
+        return false;
+    }
+
+    size_t pitch = size_t(m_width) * 3;
+    JSAMPROW rows[16];
+    while(cinfo.output_scanline < cinfo.output_height){
+        int count = std::min<int>(16, cinfo.output_height - cinfo.output_scanline);
+        for(int i = 0; i < count; ++i)
+            rows[i] = m_output + (s.top + cinfo.output_scanline + i) * pitch;
+        jpeg_read_scanlines(&cinfo, rows, count);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    return true;
+}
+
+bool jpeg_parallel_decoder::decode(const uint8_t *input, int len, PImage &image)
+{
+    int width = 0;
+    int height = 0;
+    if(input == nullptr || len <= 0 || !split(input, size_t(len), width, height)){
+        m_strips = 1;
+        jpegenc dec;
+        return dec.decode(input, len, image);
+    }
+
+    if(!image.get() || image->width != width || image->height != height || image->type != Image::RGB){
+        image.reset(new Image);
+        image->setRGB(width, height);
+    }
+
+    m_input = input;
+    m_output = image->rgb.data();
+    m_width = width;
+    m_nextStrip = 0;
+    m_failed = false;
+
+    {
+        std::lock_guard<std::mutex> lg(m_mutex);
+        m_busy = (int)m_threads.size();
+        m_generation++;
+    }
+    m_start.notify_all();
+
+    decodeStrips(0);
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this](){ return m_busy == 0; });
+    }
+
+    if(m_failed){
+        m_strips = 1;
+        jpegenc dec;
+        return dec.decode(input, len, image);
+    }
+    return true;
+}
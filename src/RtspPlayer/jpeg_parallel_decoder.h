@@ -0,0 +1,73 @@
+#ifndef JPEG_PARALLEL_DECODER_H
+#define JPEG_PARALLEL_DECODER_H
+
+#include "common.h"
+#include "common_utils.h"
+#include "JfifParser.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief libjpeg decoder for streams with restart markers.
+ * Restart intervals starting at MCU rows split the frame into strips, every strip
+ * is decoded as a separate stream on a thread pool straight into the output image.
+ * Streams without such markers are decoded by jpegenc on the calling thread.
+ */
+class jpeg_parallel_decoder
+{
+public:
+    /// threads 0 means all cores
+    explicit jpeg_parallel_decoder(int threads = 0);
+    ~jpeg_parallel_decoder();
+
+    bool decode(const uint8_t* input, int len, PImage &image);
+
+    int threads() const { return (int)m_workers.size(); }
+    /// Strips of the last frame, 1 if it was decoded serially
+    int strips() const { return m_strips; }
+
+private:
+    struct worker;
+    struct strip{
+        size_t start = 0;       /// first byte of entropy coded data
+        size_t end = 0;         /// RST marker or EOI after the strip
+        int firstInterval = 0;
+        int top = 0;            /// first output line
+        int height = 0;
+    };
+
+    std::vector<std::unique_ptr<worker>> m_workers;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    unsigned m_generation = 0;
+    int m_busy = 0;
+    bool m_stop = false;
+
+    //current frame
+    const uint8_t* m_input = nullptr;
+    jfif_view m_frame;
+    size_t m_sof = 0;
+    size_t m_sosEnd = 0;
+    std::vector<size_t> m_markers;
+    std::vector<strip> m_stripList;
+    int m_strips = 0;
+    uint8_t* m_output = nullptr;
+    int m_width = 0;
+    std::atomic<int> m_nextStrip{0};
+    std::atomic<bool> m_failed{false};
+
+    bool split(const uint8_t* input, size_t len, int& width, int& height);
+    void run(int index);
+    void decodeStrips(int index);
+    bool decodeStrip(worker& w, const strip& s);
+};
+
+#endif // JPEG_PARALLEL_DECODER_H
@@ -230,12 +230,16 @@ bool jpegenc::decode(const bytearray &input, PImage &image)
     cinfo.err = jpeg_std_error(&jerr);
     cinfo.err->error_exit = error_exit;
 
-    cinfo.out_color_space = JCS_RGB;
-
     jpeg_mem_src(&cinfo, input.data(), input.size());
 
     jpeg_read_header(&cinfo, true);
 
+    //jpeg_read_header resets both. Plain chroma upsampling as TJFLAG_FASTUPSAMPLE
+    //of the turbojpeg path and as restart interval strips of jpeg_parallel_decoder,
+    //so a frame looks the same whichever way it is decoded
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.do_fancy_upsampling = FALSE;
+
     jpeg_start_decompress(&cinfo);
 
     JSAMPROW scanline;
@@ -306,12 +310,16 @@ bool jpegenc::decode(const uint8_t *input, int len, PImage &image)
     cinfo.err = jpeg_std_error(&jerr);
     cinfo.err->error_exit = error_exit;
 
-    cinfo.out_color_space = JCS_RGB;
-
     jpeg_mem_src(&cinfo, input, len);
 
     jpeg_read_header(&cinfo, true);
 
+    //jpeg_read_header resets both. Plain chroma upsampling as TJFLAG_FASTUPSAMPLE
+    //of the turbojpeg path and as restart interval strips of jpeg_parallel_decoder,
+    //so a frame looks the same whichever way it is decoded
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.do_fancy_upsampling = FALSE;
+
     jpeg_start_decompress(&cinfo);
 
     JSAMPROW scanline;
@@ -5,6 +5,7 @@
 
 #include "fastvideo_decoder.h"
 #include "jpegenc.h"
+#include "jpeg_parallel_decoder.h"
 
 #ifndef __ARM_ARCH
 #include "cuviddecoder.h"
@@ -284,9 +285,10 @@ bool VDecoder::decodePacket(PImage& image, QString& decodeName, quint64 &sizeRea
                 m_decoderFv.reset(new fastvideo_decoder);
             m_decoderFv->decode(mEncodedData, image, true);
         }else{
-            decodeName = "JpegTurbo";
-            jpegenc dec;
-            dec.decode(mEncodedData, image);
+            if(!mJpegDecoder.get())
+                mJpegDecoder.reset(new jpeg_parallel_decoder);
+            mJpegDecoder->decode(mEncodedData.data(), (int)mEncodedData.size(), image);
+            decodeName = mJpegDecoder->strips() > 1? "JpegTurbo, restart intervals" : "JpegTurbo";
         }
 
 
@@ -316,9 +318,10 @@ bool VDecoder::decodePacket(const QByteArray &enc, PImage &image, QString &decod
 
             m_decoderFv->decode((uchar*)enc.data(), enc.size(), image, true);
         }else{
-            decodeName = "JpegTurbo";
-            jpegenc dec;
-            dec.decode((uchar*)enc.data(), enc.size(), image);
+            if(!mJpegDecoder.get())
+                mJpegDecoder.reset(new jpeg_parallel_decoder);
+            mJpegDecoder->decode((uchar*)enc.data(), enc.size(), image);
+            decodeName = mJpegDecoder->strips() > 1? "JpegTurbo, restart intervals" : "JpegTurbo";
         }
 
         if(!decodeName.isEmpty()){
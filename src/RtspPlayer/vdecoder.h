@@ -13,6 +13,7 @@ extern "C"{
 
 class CuvidDecoder;
 class fastvideo_decoder;
+class jpeg_parallel_decoder;
 
 class VDecoder
 {
@@ -96,6 +97,7 @@ private:
 
     std::unique_ptr<fastvideo_decoder> m_decoderFv;
     std::unique_ptr<CuvidDecoder> mCuvidDecoder;
+    std::unique_ptr<jpeg_parallel_decoder> mJpegDecoder;
 
     bool m_done = false;
     bool m_is_open = false;
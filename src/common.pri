@@ -72,13 +72,16 @@ CUDA_DLL += $$CUDA_DLL_PATH/nppig64_10.dll
 
 # NVIDIA VIDEO CODEC SDK
 # https://developer.nvidia.com/nvidia-video-codec-sdk/download
-NVCODECS = $$OTHER_LIB_PATH/nvcodecs
-INCLUDEPATH += $$NVCODECS/include
-LIBS += -L$$NVCODECS/Lib/$$PLATFORM -lnvcuvid
-
-INCLUDEPATH += $$CUDAINC
-INCLUDEPATH += $$FASTVIDEO_INC
-INCLUDEPATH += $$FASTVIDEOPATH/core_samples
+# qmake CONFIG+=host_only builds without CUDA and Fastvideo SDK
+!host_only {
+    NVCODECS = $$OTHER_LIB_PATH/nvcodecs
+    INCLUDEPATH += $$NVCODECS/include
+    LIBS += -L$$NVCODECS/Lib/$$PLATFORM -lnvcuvid
+
+    INCLUDEPATH += $$CUDAINC
+    INCLUDEPATH += $$FASTVIDEO_INC
+    INCLUDEPATH += $$FASTVIDEOPATH/core_samples
+}
 INCLUDEPATH += $$FFMPEG_PATH/include
 INCLUDEPATH += $$JPEGTURBO/include
 
@@ -104,10 +107,12 @@ CONFIG(debug, debug|release){
     QMAKE_CXXFLAGS += "/Zi /DEBUG"
 }
 
-LIBS += $$FASTVIDEO_LIB
-LIBS += $$FASTVIDEO_EXTRA_LIBS
+!host_only {
+    LIBS += $$FASTVIDEO_LIB
+    LIBS += $$FASTVIDEO_EXTRA_LIBS
+    LIBS += -L$$CUDA_TOOLKIT_PATH/lib/$$PLATFORM -lcudart -lcuda
+}
 LIBS += -L$$FFMPEG_LIB  -lavcodec -lavformat -lavutil -lswresample
-LIBS += -L$$CUDA_TOOLKIT_PATH/lib/$$PLATFORM -lcudart -lcuda
 LIBS += -lglu32 -lopengl32 -lgdi32 -luser32 -lMscms -lShell32 -lOle32 -lWs2_32 -lstrmiids -lComdlg32
 LIBS += -L$$JPEGTURBO/lib -ljpeg-static -lturbojpeg-static
 
@@ -1,4 +1,6 @@
-DEFINES += SUPPORT_XIMEA
+# host_only builds target plain machines without XIMEA API,
+# add DEFINES+=SUPPORT_XIMEA to qmake arguments to keep the camera
+!host_only: DEFINES += SUPPORT_XIMEA
 #DEFINES += SUPPORT_GENICAM
 
 TARGET_ARCH=$${QT_ARCH}
@@ -10,7 +10,8 @@ contains(TARGET_ARCH, arm64 ) {
     CUDA_TOOLKIT_PATH = "/usr/local/cuda-10.1"
 }
 
-INCLUDEPATH += $${CUDA_TOOLKIT_PATH}/include
+# qmake CONFIG+=host_only builds without CUDA and Fastvideo SDK
+!host_only: INCLUDEPATH += $${CUDA_TOOLKIT_PATH}/include
 CUDA_LIB  = -L$${CUDA_TOOLKIT_PATH}/lib64
 CUDA_LIB += -lnppicc
 CUDA_LIB += -lnppig
@@ -102,9 +103,11 @@ FASTVIDEO_EXTRA_DLLS += $$(_PRO_FILE_PWD_)/GPUCameraSample.sh
 # https://developer.nvidia.com/nvidia-video-codec-sdk/download
 
 !contains(TARGET_ARCH, arm64){
-    NVCODECS = $$OTHER_LIB_PATH/nvcodecs
-    INCLUDEPATH += $$NVCODECS/include
-    LIBS += -L$$NVCODECS/Lib/$$PLATFORM -lnvcuvid -lcuda
+    !host_only {
+        NVCODECS = $$OTHER_LIB_PATH/nvcodecs
+        INCLUDEPATH += $$NVCODECS/include
+        LIBS += -L$$NVCODECS/Lib/$$PLATFORM -lnvcuvid -lcuda
+    }
     FFMPEG_LIB += -lavformat -lavcodec -lavutil -lswresample -lm -lz -lx264
 }
 
@@ -121,14 +124,16 @@ contains(TARGET_ARCH, arm64){
 #    FFMPEG_LIB = -L$$FFMPEG_PATH/lib/linux/x86_64/
 #}
 #
-INCLUDEPATH += $$FASTVIDEO_INC
+!host_only {
+    INCLUDEPATH += $$FASTVIDEO_INC
+    LIBS += $$FASTVIDEO_LIB
+    LIBS += $$CUDA_LIB
+}
 INCLUDEPATH += $$FFMPEG_PATH/include
 #
-LIBS += $$FASTVIDEO_LIB
-LIBS += $$CUDA_LIB
 LIBS += -L$$FFMPEG_LIB_PATH/ $$FFMPEG_LIB
 LIBS += -ldl
-LIBS += -ljpeg
+LIBS += -ljpeg -lturbojpeg
 
 #
 contains(TARGET_ARCH, arm64 ): LIBS += -lGL